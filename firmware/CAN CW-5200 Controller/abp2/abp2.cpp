@@ -0,0 +1,195 @@
+#include <Arduino.h>
+#include <cstdio>
+#include <board.h>
+#include <abp2.h>
+
+/*
+ *   ABP2 frame parsing and read sequence, against a scripted bus
+ *
+ *   Frames laid out as the part sends them, status byte then 24 bit
+ *   pressure and temperature, are run through abp2_transfer::parse() for
+ *   the filter sensor's part: the ends of its output range, no flow, a
+ *   typical filter drop each way, and the busy and error status bits.
+ *   Then abp2_sensor is stepped a millisecond at a time on the stand-in
+ *   bus in abp2/i2c_queue.h, which finishes each transaction before the
+ *   next step, through a conversion that is still busy when first read,
+ *   a read and a command that are not acknowledged, and a status byte
+ *   that reports an error. The exit status is 1 if any check fails:
+ *
+ *     abp2
+ */
+
+#define PERIOD_MS 100
+#define UNTOUCHED 0x5A5A5A5A // sample fields a busy frame must leave alone
+
+uint32_t replay_millis = 0;
+
+typedef abp2_002pd part;
+
+static uint32_t checks = 0;
+static uint32_t failures = 0;
+
+static void check(bool ok, const char *scenario, const char *what)
+{
+    ++checks;
+    if (ok)
+        return;
+    ++failures;
+    printf("  %s: FAILED %s\n", scenario, what);
+}
+
+struct frame_case
+{
+    const char *name;
+    uint8_t frame[ABP2_FRAME_BYTES];
+    abp2_event event;
+    int32_t pressure_cpa;
+    int32_t temperature_cdegc;
+};
+
+static const frame_case frames[] = {
+    {"no flow, 30.00 degC", {0x40, 0x80, 0x00, 0x00, 0x66, 0x66, 0x66}, ABP2_READY, 0, 3000},
+    {"100 Pa, 24.00 degC", {0x40, 0x80, 0x5F, 0x0D, 0x5E, 0xB8, 0x52}, ABP2_READY, 9999, 2400},
+    {"-35 Pa, 0.00 degC", {0x40, 0x7F, 0xDE, 0x5A, 0x40, 0x00, 0x00}, ABP2_READY, -3541, 0},
+    {"output min, -50 degC", {0x40, 0x4C, 0xCC, 0xCD, 0x00, 0x00, 0x00}, ABP2_READY, part::pressure_min_cpa, -5000},
+    {"output max, 150 degC", {0x40, 0xB3, 0x33, 0x33, 0xFF, 0xFF, 0xFF}, ABP2_READY, part::pressure_max_cpa, 15000},
+    {"busy", {0x60, 0x80, 0x00, 0x00, 0x66, 0x66, 0x66}, ABP2_WAITING, (int32_t)UNTOUCHED, (int32_t)UNTOUCHED},
+    {"memory error", {0x44, 0x80, 0x00, 0x00, 0x66, 0x66, 0x66}, ABP2_FAULT, (int32_t)UNTOUCHED, (int32_t)UNTOUCHED},
+    {"math saturation", {0x41, 0xFF, 0xFF, 0xFF, 0x66, 0x66, 0x66}, ABP2_FAULT, (int32_t)UNTOUCHED, (int32_t)UNTOUCHED},
+    {"not powered", {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, ABP2_FAULT, (int32_t)UNTOUCHED, (int32_t)UNTOUCHED},
+};
+
+static void parseFrames()
+{
+    for (const frame_case &c : frames)
+    {
+        struct_abp2_sample sample = {0, (int32_t)UNTOUCHED, (int32_t)UNTOUCHED};
+        abp2_event event = abp2_transfer<part>::parse(c.frame, &sample);
+        char what[96];
+        snprintf(what, sizeof(what), "event %d %ld cPa %ld cdegC, expected %d %ld cPa %ld cdegC", event,
+                 (long)sample.pressure_cpa, (long)sample.temperature_cdegc, c.event, (long)c.pressure_cpa,
+                 (long)c.temperature_cdegc);
+        check(event == c.event && sample.pressure_cpa == c.pressure_cpa &&
+                  sample.temperature_cdegc == c.temperature_cdegc,
+              c.name, what);
+        // a busy frame is not a reading, so not even its status is kept
+        if (c.event != ABP2_WAITING)
+            check(sample.status == c.frame[0], c.name, "status byte not kept");
+        else
+            check(sample.status == 0, c.name, "status byte kept from a busy frame");
+    }
+}
+
+struct rig
+{
+    i2c_bus bus;
+    abp2_sensor<part> sensor{bus};
+    const char *name = "";
+    uint32_t now = 0;
+    uint32_t ready_at[4] = {};
+    uint8_t ready = 0;
+    uint32_t fault_at[4] = {};
+    uint8_t faulted = 0;
+    uint32_t command_at[4] = {}; // when each conversion was started
+    uint8_t commands = 0;
+
+    rig(const char *scenario, const i2c_reply *replies, uint8_t count) : name(scenario)
+    {
+        bus.script(replies, count);
+        sensor.begin(PERIOD_MS);
+    }
+
+    void run(uint32_t ms)
+    {
+        for (uint32_t i = 0; i < ms; i++, now++)
+        {
+            uint32_t writes = bus.writes;
+            abp2_event event = sensor.service(now);
+            if (event == ABP2_READY && ready < 4)
+                ready_at[ready++] = now;
+            if (event == ABP2_FAULT && faulted < 4)
+                fault_at[faulted++] = now;
+            // the transaction is on the wire until the next pass
+            bus.complete();
+            if (bus.writes != writes && commands < 4)
+                command_at[commands++] = now;
+        }
+    }
+
+    void expect(bool ok, const char *what) { check(ok, name, what); }
+};
+
+static const i2c_reply busy = {I2C_DONE, {0x60, 0x80, 0x00, 0x00, 0x66, 0x66, 0x66}};
+static const i2c_reply first = {I2C_DONE, {0x40, 0x80, 0x5F, 0x0D, 0x5E, 0xB8, 0x52}};
+static const i2c_reply second = {I2C_DONE, {0x40, 0x7F, 0xDE, 0x5A, 0x40, 0x00, 0x00}};
+
+// begin() is a bare address probe: true only if the part acknowledges
+static void probe()
+{
+    rig acked("probe acked", nullptr, 0);
+    acked.expect(acked.bus.writes == 1, "one probe written");
+    i2c_bus quiet;
+    quiet.write_status = I2C_NACK;
+    abp2_sensor<part> missing(quiet);
+    check(!missing.begin(PERIOD_MS), "probe not acked", "begin() true without an ACK");
+}
+
+// the first read finds the conversion still running: read again a millisecond later
+static void busyThenReady()
+{
+    const i2c_reply replies[] = {busy, first, second};
+    rig r("busy then ready", replies, 3);
+    r.run(2 * PERIOD_MS);
+    // command at 0, done at 1, read at 1 + ABP2_CONVERSION_MS, busy at 7, read again at 8, ready at 9
+    r.expect(r.ready == 2 && r.faulted == 0, "two samples, no faults");
+    r.expect(r.ready_at[0] == 2 + ABP2_CONVERSION_MS + ABP2_BUSY_RETRY_MS + 1, "first sample after one busy poll");
+    r.expect(r.sensor.busy_polls == 1 && r.bus.reads == 3, "one busy poll, three reads");
+    // the next conversion is timed from the start of the last, not from its late finish
+    r.expect(r.commands == 2 && r.command_at[0] == 0 && r.command_at[1] == PERIOD_MS, "conversions a period apart");
+    r.expect(r.ready_at[1] == PERIOD_MS + 1 + ABP2_CONVERSION_MS + 1, "second sample without a busy poll");
+    r.expect(r.sensor.samples == 2 && r.sensor.sample.pressure_cpa == -3541 && r.sensor.sample.temperature_cdegc == 0,
+             "second sample is the last frame");
+}
+
+// a read that is not acknowledged: a fault, and nothing more until a period later
+static void readNack()
+{
+    rig r("read not acked", nullptr, 0);
+    r.run(PERIOD_MS + 10);
+    uint32_t failed = 2 + ABP2_CONVERSION_MS;
+    r.expect(r.faulted == 1 && r.fault_at[0] == failed, "one fault, on the read");
+    r.expect(r.sensor.faults == 1 && r.sensor.sample.status == 0, "fault counted, status cleared");
+    r.expect(r.commands == 2 && r.command_at[1] == failed + PERIOD_MS, "retried a period after the fault");
+}
+
+// the start command is not acknowledged: a fault before any read
+static void commandNack()
+{
+    rig r("command not acked", nullptr, 0);
+    r.bus.write_status = I2C_NACK;
+    r.run(PERIOD_MS + 20);
+    r.expect(r.faulted == 2 && r.fault_at[0] == 1 && r.fault_at[1] == PERIOD_MS + 2, "a fault each period");
+    r.expect(r.bus.reads == 0, "nothing read");
+}
+
+// the part answers, but with an error in its status byte
+static void statusError()
+{
+    const i2c_reply replies[] = {{I2C_DONE, {0x44, 0x80, 0x00, 0x00, 0x66, 0x66, 0x66}}};
+    rig r("memory error", replies, 1);
+    r.run(PERIOD_MS / 2);
+    r.expect(r.faulted == 1 && r.ready == 0, "one fault, no sample");
+    r.expect(r.sensor.sample.status == 0x44, "status byte kept for the fault report");
+}
+
+int main()
+{
+    parseFrames();
+    probe();
+    busyThenReady();
+    readNack();
+    commandNack();
+    statusError();
+    printf("%lu checks run, %lu failed\n", (unsigned long)checks, (unsigned long)failures);
+    return failures ? 1 : 0;
+}
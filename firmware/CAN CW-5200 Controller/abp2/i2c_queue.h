@@ -0,0 +1,126 @@
+#ifndef __FIRMWARE_I2C_QUEUE__
+#define __FIRMWARE_I2C_QUEUE__
+#include <cstdint>
+#include <cstring>
+
+/*
+ *   A scripted stand-in for the queued I2C master
+ *
+ *   The transaction is the real one's, so abp2.h builds against it as it is.
+ *   The bus holds one submitted transaction until complete() finishes it, as
+ *   the ISR would: a write gets write_status, and a read the next of the
+ *   scripted replies, its bytes copied into rx. Past the end of the script
+ *   every read is a NACK.
+ */
+
+enum i2c_priority : uint8_t
+{
+    I2C_PRIORITY_SENSOR = 0,
+    I2C_PRIORITY_DISPLAY,
+    I2C_PRIORITIES,
+};
+
+enum i2c_status : uint8_t
+{
+    I2C_IDLE = 0,
+    I2C_QUEUED,
+    I2C_ACTIVE,
+    I2C_DONE,
+    I2C_NACK,
+    I2C_TIMEOUT,
+    I2C_LOST,
+};
+
+struct i2c_transaction
+{
+    uint8_t address;
+    i2c_priority priority;
+    uint8_t command[4];
+    uint8_t command_length;
+    const uint8_t *tx;
+    uint16_t tx_length;
+    uint8_t *rx;
+    uint16_t rx_length;
+    uint16_t timeout_us;
+    void (*done)(i2c_transaction *);
+    void *context;
+
+    volatile i2c_status status;
+    i2c_transaction *next;
+};
+
+inline bool i2cPending(const i2c_transaction &t)
+{
+    return t.status == I2C_QUEUED || t.status == I2C_ACTIVE;
+}
+
+struct i2c_reply
+{
+    i2c_status status;
+    uint8_t rx[8];
+};
+
+class i2c_bus
+{
+public:
+    bool submit(i2c_transaction *t)
+    {
+        if (i2cPending(*t) || current)
+            return false;
+        t->status = I2C_QUEUED;
+        current = t;
+        ++submitted;
+        return true;
+    }
+
+    bool transfer(i2c_transaction *t)
+    {
+        if (!submit(t))
+            return false;
+        complete();
+        return t->status == I2C_DONE;
+    }
+
+    void complete()
+    {
+        i2c_transaction *t = current;
+        if (!t)
+            return;
+        current = nullptr;
+        if (!t->rx_length)
+        {
+            ++writes;
+            t->status = write_status;
+            return;
+        }
+        ++reads;
+        if (next_reply >= reply_count)
+        {
+            t->status = I2C_NACK;
+            return;
+        }
+        const i2c_reply &reply = replies[next_reply++];
+        memcpy(t->rx, reply.rx, t->rx_length < sizeof(reply.rx) ? t->rx_length : sizeof(reply.rx));
+        t->status = reply.status;
+    }
+
+    void script(const i2c_reply *list, uint8_t count)
+    {
+        replies = list;
+        reply_count = count;
+        next_reply = 0;
+    }
+
+    i2c_status write_status = I2C_DONE;
+    uint32_t submitted = 0;
+    uint32_t writes = 0;
+    uint32_t reads = 0;
+
+private:
+    i2c_transaction *current = nullptr;
+    const i2c_reply *replies = nullptr;
+    uint8_t reply_count = 0;
+    uint8_t next_reply = 0;
+};
+
+#endif
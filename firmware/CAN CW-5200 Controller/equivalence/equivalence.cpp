@@ -0,0 +1,146 @@
+#include <Arduino.h>
+#include <cstdio>
+#include <cmath>
+#include <board.h>
+#include <fixed_point.h>
+
+/*
+ *   Fixed point against the float maths it replaced
+ *
+ *   Every input each conversion can see on the boards is run through both:
+ *   every ADC code for the loop controller's NTCs, every flow sensor speed,
+ *   tach periods from a stalled to a flat-out fan, and every DS18B20 count
+ *   from its disconnected value up. Then the chiller's edges: every
+ *   centidegree out to a float and back, as the telemetry and the replay
+ *   take it, and the cooling decision in centidegrees against the float
+ *   compare it replaced, over the setpoints and hysteresis the menu
+ *   allows, where the two may only differ at the threshold itself. The worst difference of each is printed against its
+ *   tolerance, and the exit status is 1 if any is over:
+ *
+ *     equivalence
+ */
+
+#define NTC_TOLERANCE_C 0.02       // over the coolant's 0..60 degC
+#define NTC_WIDE_TOLERANCE_C 0.1   // over -20..100 degC
+#define FLOW_TOLERANCE_LPH 1       // the float version truncates a double that is a hair under
+#define RPM_TOLERANCE 0.051        // half the 0.1 rpm step, and the reference's float rounding
+#define DS18B20_TOLERANCE_C 0.0051 // half a centidegree
+#define DS18B20_DISCONNECTED -7040 // DEVICE_DISCONNECTED_RAW
+#define ROUND_TRIP_TOLERANCE_C 0   // a centidegree comes back as itself
+#define DECISION_TOLERANCE_C 0.005 // a decision may differ only this close to its threshold
+
+uint32_t replay_millis = 0;
+
+typedef loop_controller_board::ntc ntc;
+typedef loop_controller_board::flow flow_sensor;
+
+struct check
+{
+    const char *name;
+    const char *units;
+    double tolerance;
+    double worst = 0;
+    double worst_at = 0;
+    uint32_t cases = 0;
+
+    void add(double fixed, double reference, double at)
+    {
+        ++cases;
+        double error = fabs(fixed - reference);
+        if (error > worst)
+        {
+            worst = error;
+            worst_at = at;
+        }
+    }
+
+    bool report() const
+    {
+        bool ok = worst <= tolerance;
+        printf("%-22s %8u %10.4f %-4s at %-10.0f %s\n", name, cases, worst, units, worst_at, ok ? "ok" : "OVER");
+        return ok;
+    }
+};
+
+// the B equation in double, as ntc_thermistor::celsiusFromADC() has it
+static double ntcCelsius(uint16_t adc)
+{
+    double resistance = ntc::reference_resistance / (ntc::adc_full_scale / adc - 1);
+    double inverse_kelvin = 1.0 / (ntc::nominal_temperature + 273.15) +
+                            log(resistance / ntc::nominal_resistance) / ntc::b_value;
+    return 1.0 / inverse_kelvin - 273.15;
+}
+
+int main()
+{
+    check ntc_coolant = {"NTC 0..60C", "C", NTC_TOLERANCE_C};
+    check ntc_wide = {"NTC -20..100C", "C", NTC_WIDE_TOLERANCE_C};
+    for (uint16_t adc = 1; adc < ntc::adc_full_scale; adc++)
+    {
+        double reference = ntcCelsius(adc);
+        double fixed = ntcCentiCelsius<ntc>(adc) / 100.0;
+        if (reference >= 0 && reference <= 60)
+            ntc_coolant.add(fixed, reference, adc);
+        if (reference >= -20 && reference <= 100)
+            ntc_wide.add(fixed, reference, adc);
+    }
+
+    check flow = {"flow", "L/h", FLOW_TOLERANCE_LPH};
+    for (uint32_t rpm = 0; rpm <= 5000; rpm++)
+    {
+        // the coefficients as the doubles they were
+        double reference = 0.181 * rpm - 9.75;
+        // a negative double into an unsigned int is undefined; the Teensy's library gives 0
+        flow.add(flowFromSpeed<flow_sensor>(rpm), reference > 0 ? (unsigned int)reference : 0, rpm);
+    }
+
+    check tach = {"fan tach", "rpm", RPM_TOLERANCE};
+    for (uint32_t period = 1000; period < 1000000; period += 7)
+    {
+        double reference = 60.0 * 1000000.0 / ((float)period * 2);
+        tach.add(deciRPMFromPeriod(period, 2) / 10.0, reference, period);
+    }
+
+    check probe = {"DS18B20", "C", DS18B20_TOLERANCE_C};
+    for (int32_t raw = DS18B20_DISCONNECTED; raw <= 125 * 128; raw++)
+        probe.add(centiFrom128ths(raw) / 100.0, raw / 128.0, raw);
+
+    check round_trip = {"centi C round trip", "C", ROUND_TRIP_TOLERANCE_C};
+    for (int32_t centi = CENTI_C_ZERO_KELVIN; centi <= INT16_MAX; centi++)
+        round_trip.add(centiFromCelsius(centiToCelsius(centi)) / 100.0, centi / 100.0, centi);
+
+    // runCoolingControl() without the feed-forward: start above setpoint + hysteresis, stop at or below it - hysteresis
+    check decision = {"cooling decision", "C", DECISION_TOLERANCE_C};
+    for (int halves = 10; halves <= 60; halves++)
+    {
+        for (int tenths = 1; tenths <= 20; tenths++)
+        {
+            float setpoint = halves / 2.0f;
+            float hysteresis = tenths / 10.0f;
+            int32_t centi_setpoint = centiFromCelsius(setpoint);
+            int32_t centi_hysteresis = centiFromCelsius(hysteresis);
+            for (int32_t centi = 0; centi <= 4000; centi++)
+            {
+                float reservoir = centiToCelsius(centi);
+                float high = setpoint + hysteresis;
+                float low = setpoint - hysteresis;
+                double off = 0;
+                if ((centi > centi_setpoint + centi_hysteresis) != (reservoir > high))
+                    off = fabs(reservoir - high);
+                if ((centi <= centi_setpoint - centi_hysteresis) != (reservoir <= low))
+                    off = fmax(off, fabs(reservoir - low));
+                decision.add(off, 0, centi);
+            }
+        }
+    }
+
+    printf("%-22s %8s %10s %-4s    %s\n", "", "cases", "worst", "", "input");
+    bool ok = ntc_coolant.report();
+    ok = ntc_wide.report() && ok;
+    ok = flow.report() && ok;
+    ok = tach.report() && ok;
+    ok = probe.report() && ok;
+    ok = round_trip.report() && ok;
+    ok = decision.report() && ok;
+    return ok ? 0 : 1;
+}
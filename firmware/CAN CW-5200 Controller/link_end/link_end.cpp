@@ -0,0 +1,127 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <cstdio>
+#include <cstdlib>
+#include <poll.h>
+#include <device_clock.h>
+
+#include "error_codes.h"
+#include "settings.h"
+#include "control.h"
+#include "link.h"
+
+/*
+ *   The chiller's end of the link, natively over a pty
+ *
+ *   link.cpp as it is, with the default settings, serviced every pass and
+ *   sending a readings frame every CHILLER_PERIOD_MS as loop() does. The
+ *   readings are made up, every field moving from one set to the next, with
+ *   a safety trip raised for a few sets from LINK_END_FAULT_FROM. Each
+ *   setpoint the link applies is printed as it is applied, each readings
+ *   set as it is sent if --readings is given, and the last heat load when
+ *   the other side of the pty hangs up, which ends it:
+ *
+ *     link_end PORT [SPEEDUP] [--readings]
+ *
+ *   tools/link_test.py runs it, and the loop controller's end, through a
+ *   relay that loses bytes; tools/can_test.py runs it behind the loop
+ *   controller's CAN node.
+ */
+
+#define LINK_END_POLL_MS 1
+#define LINK_END_FAULT_FROM 5 // readings sequence the trip is raised in
+#define LINK_END_FAULT_SETS 3 // and how many sets it stays raised for
+
+double link_speedup = 1;
+EEPROMClass EEPROM;
+
+static struct_readings readings;
+static struct_control control;
+
+// something different in every field, so a field lost or swapped on the way shows
+static void sample(uint32_t sequence)
+{
+    readings.header.sequence = sequence;
+    readings.header.time_us = micros64();
+    readings.reservoir.temperature = 18.0f + (sequence % 200) * 0.01f;
+    readings.reservoir.level_sense = 1200.0f + sequence;
+    readings.reservoir.level_ref = 2000.0f - sequence;
+    readings.chassis.inside_temperature = 27.5f + (sequence % 8) * 0.25f;
+    readings.chassis.outside_temperature = 24.0f - (sequence % 4) * 0.5f;
+    readings.chassis.humidity = 40.0f + sequence % 20;
+    readings.chassis.filter_dp = 120 - (int16_t)(sequence % 240);
+    readings.chassis.fan.top_tach = 1500.0f + sequence;
+    readings.chassis.fan.bottom_tach = 1400.0f + sequence;
+    readings.chassis.fan.pwm = sequence * 7;
+    readings.compressor.running = sequence & 1;
+    readings.compressor.valve = sequence & 2;
+    readings.compressor.compressor_time = sequence * 1000;
+    readings.compressor.valve_time = sequence * 500;
+    readings.pump.running = true;
+    readings.pump.flow_ok = sequence % 3 != 0;
+    readings.error.alert = sequence >= LINK_END_FAULT_FROM && sequence < LINK_END_FAULT_FROM + LINK_END_FAULT_SETS;
+    if (readings.error.alert)
+        readings.error.code = SAFETY_OVER_TEMP;
+    readings.maintenance.compressor_seconds = sequence * 3;
+    readings.maintenance.compressor_starts = sequence / 4;
+    readings.maintenance.starts_per_hour = sequence % 16;
+    readings.maintenance.short_cycles = sequence / 8;
+    readings.maintenance.pump_seconds = sequence * 2;
+    readings.maintenance.fan_seconds = sequence;
+    readings.maintenance.filter_hours_left = 0xFFFF - sequence;
+}
+
+static void printReadings()
+{
+    const uint8_t *bytes = (const uint8_t *)&readings;
+    printf("readings ");
+    for (size_t i = 0; i < sizeof(readings); i++)
+        printf("%02x", bytes[i]);
+    printf("\n");
+}
+
+static void setSetpoint(float celsius)
+{
+    readings.reservoir.setpoint = celsius;
+    printf("applied %.2f\n", celsius);
+}
+
+int main(int argc, char **argv)
+{
+    bool print_readings = argc > 1 && strcmp(argv[argc - 1], "--readings") == 0;
+    if (print_readings)
+        --argc;
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s PORT [SPEEDUP] [--readings]\n", argv[0]);
+        return 2;
+    }
+    if (argc > 2)
+        link_speedup = atof(argv[2]);
+    Stream port;
+    if (!port.open(argv[1]))
+    {
+        perror(argv[1]);
+        return 2;
+    }
+    const struct_settings *settings = loadSettings();
+    beginLink(port, setSetpoint);
+
+    uint32_t last_readings = millis();
+    while (!port.hungUp())
+    {
+        serviceLink(&control, settings, &readings);
+        if (millis() - last_readings >= CHILLER_PERIOD_MS)
+        {
+            last_readings = millis();
+            sample(readings.header.sequence + 1);
+            sendReadings(&readings);
+            if (print_readings)
+                printReadings();
+        }
+        pollfd wait = {port.descriptor(), POLLIN, 0};
+        poll(&wait, 1, LINK_END_POLL_MS);
+    }
+    printf("heat_load %.0f\n", control.have_load ? control.load_w : 0.0f);
+    return 0;
+}
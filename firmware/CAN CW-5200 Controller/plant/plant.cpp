@@ -0,0 +1,321 @@
+#include <Arduino.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <EEPROM.h>
+#include <heat_load.h>
+
+#include "settings.h"
+#include "comms.h"
+#include "measured.h"
+#include "control.h"
+#include "actuators.h"
+#include "safety.h"
+
+/*
+ *   Closed-loop plant simulation of the chiller and the PC's coolant loops
+ *
+ *   A lumped thermal model stands in for the hardware: the PC's load heats
+ *   the internal loop, the heat exchanger passes it on to the reservoir, and
+ *   the compressor takes heat out of the reservoir once its refrigerant has
+ *   come up to pressure. runCoolingControl() makes the decisions, with the
+ *   board's settings and timing, and the loop controller's heat load frames
+ *   are built from the simulated loop with the same trend code it runs.
+ *
+ *   The same load profile is run with the feed-forward off and on, and the
+ *   reservoir overshoot of each is printed side by side. --wrap starts the
+ *   clock ten minutes short of the millis() wrap, which should change
+ *   nothing in the results.
+ *
+ *   Then the flow is cut with the compressor running while loop() is held
+ *   up for --stall ms, and the safety monitor, ticking to the ms as its
+ *   timer would, has to have the compressor and pump relays off within
+ *   SAFETY_REACTION_MS regardless. The exit status is 1 if it does not:
+ *
+ *     plant [--horizon <s>] [--stall <ms>] [--wrap] [--trace <file.csv>]
+ */
+
+#define PLANT_STEP_MS 500         // loop controller heat sampling
+#define PLANT_CONTROL_MS 1000     // the board's LOOP_PERIOD_MS
+#define PLANT_DURATION_S 7200
+#define PLANT_WRAP_LEAD_MS 600000 // --wrap: uptime this far short of 2^32 ms at the start
+#define PLANT_AMBIENT 25.0        // degC
+#define PLANT_AMBIENT_UA 5.0      // W/K, reservoir to the room
+#define PLANT_INTERNAL_MASS 8.0e3 // J/K, blocks, radiators and internal water
+#define PLANT_EXCHANGER_UA 60.0   // W/K, internal loop to the reservoir
+#define PLANT_COMPRESSOR_W 900.0  // heat the compressor takes out once up to pressure
+#define PLANT_COMPRESSOR_TAU 20.0 // s, refrigerant coming up to pressure
+#define PLANT_SENSOR_TAU 5.0      // s, block temperatures following the load
+#define PLANT_NOISE_W 5.0         // on the measured load
+#define PLANT_STALL_MS 5000       // --stall default: loop() blocked this long from the flow cut
+#define PLANT_FAULT_AFTER_MS 10000 // flow cut this long after the compressor starts
+#define PLANT_FAULT_WATCH_MS 60000 // run on after the cut
+
+uint32_t replay_millis = 0;
+EEPROMClass EEPROM;
+
+struct plant_result
+{
+    float peak;
+    float overshoot_s; // time above setpoint + hysteresis
+    float lowest;
+    uint16_t starts;
+};
+
+// idle, a long render, idle, a shorter game session, idle
+static float pcLoad(float t)
+{
+    struct step
+    {
+        float start_s;
+        float watts;
+    };
+    static const step profile[] = {{0, 80}, {900, 650}, {2700, 80}, {4200, 420}, {5400, 80}};
+    float watts = profile[0].watts;
+    for (const step &s : profile)
+    {
+        if (t < s.start_s)
+            break;
+        // 20 s ramps, as a GPU boosts up rather than switching on
+        float into = (t - s.start_s) / 20.0f;
+        watts = into >= 1.0f ? s.watts : watts + (s.watts - watts) * into;
+    }
+    return watts;
+}
+
+static float noise()
+{
+    // deterministic, so runs compare like for like
+    static uint32_t state = 12345;
+    state = state * 1664525 + 1013904223;
+    return ((state >> 8) / (float)(1 << 24) - 0.5f) * 2.0f * PLANT_NOISE_W;
+}
+
+struct fault_result
+{
+    bool cut;             // the compressor ran, so the flow could be cut under it
+    int32_t compressor_ms; // from the cut to each relay off, -1 for never
+    int32_t pump_ms;
+    int32_t loop_ms;      // to loop()'s first look at the flow after the cut
+    uint8_t trips;        // SAFETY_TRIP_* raised
+};
+
+// the relays as the pins have them: what the actuators drove, less what the safety monitor holds
+static uint8_t relay[ACTUATORS];
+
+static void plantApply(actuator which, uint8_t level)
+{
+    uint8_t holds = safetyHolds();
+    if (level && which == ACTUATOR_COMPRESSOR && (holds & SAFETY_HOLD_COMPRESSOR))
+        return;
+    if (level && which == ACTUATOR_PUMP && (holds & SAFETY_HOLD_PUMP))
+        return;
+    relay[which] = level;
+}
+
+static fault_result simulateFlowLoss(uint32_t stall_ms, uint32_t start_ms)
+{
+    struct_settings *settings = loadSettings();
+    static timer_wheel wheel;
+    wheel.begin(start_ms);
+    memset(relay, 0, sizeof(relay));
+    relay[ACTUATOR_PUMP] = 1;
+    beginActuators(&wheel, settings, plantApply, start_ms);
+    beginSafety(settings, start_ms);
+    struct_control control;
+    struct_readings readings = {};
+    struct_measured measured;
+    readings.reservoir.setpoint = 20.0;
+    // warm enough to want cooling, inside the limits
+    readings.reservoir.temperature = readings.reservoir.setpoint + 2 * settings->hysteresis;
+
+    fault_result result = {false, -1, -1, -1, 0};
+    uint32_t cut = 0;
+    uint32_t loop_time = start_ms - PLANT_CONTROL_MS;
+    uint32_t tick_time = start_ms;
+    for (uint32_t elapsed = 0; !result.cut || elapsed - cut < PLANT_FAULT_WATCH_MS; elapsed++)
+    {
+        replay_millis = start_ms + elapsed;
+        uint32_t now = millis();
+        if (!result.cut && relay[ACTUATOR_COMPRESSOR] && now - actuatorState()->changed[ACTUATOR_COMPRESSOR] >= PLANT_FAULT_AFTER_MS)
+        {
+            result.cut = true;
+            cut = elapsed;
+        }
+        else if (!result.cut && elapsed > 2 * (settings->valve_lockout + settings->compressor_lockout))
+        {
+            return result; // never started; nothing to cut
+        }
+        bool flow_ok = relay[ACTUATOR_PUMP] && !result.cut;
+
+        // the timer interrupt, whatever loop() is doing
+        if (now - tick_time >= SAFETY_TICK_US / 1000)
+        {
+            tick_time = now;
+            uint8_t holds = serviceSafety(now, flow_ok, relay[ACTUATOR_PUMP], relay[ACTUATOR_COMPRESSOR]);
+            if (holds & SAFETY_HOLD_COMPRESSOR)
+                relay[ACTUATOR_COMPRESSOR] = 0;
+            if (holds & SAFETY_HOLD_PUMP)
+                relay[ACTUATOR_PUMP] = 0;
+        }
+        if (result.cut)
+        {
+            if (result.compressor_ms < 0 && !relay[ACTUATOR_COMPRESSOR])
+                result.compressor_ms = elapsed - cut;
+            if (result.pump_ms < 0 && !relay[ACTUATOR_PUMP])
+                result.pump_ms = elapsed - cut;
+        }
+
+        // loop(), unless it is stuck
+        if (result.cut && elapsed - cut < stall_ms)
+            continue;
+        wheel.advance(now);
+        result.trips |= takeSafetyTrips();
+        uint8_t holds = safetyHolds();
+        if ((holds & SAFETY_HOLD_COMPRESSOR) && actuatorState()->level[ACTUATOR_COMPRESSOR])
+            seedActuator(ACTUATOR_COMPRESSOR, 0, now);
+        if ((holds & SAFETY_HOLD_PUMP) && actuatorState()->level[ACTUATOR_PUMP])
+            seedActuator(ACTUATOR_PUMP, 0, now);
+        if (now - loop_time < PLANT_CONTROL_MS)
+            continue;
+        loop_time = now;
+        if (result.cut && result.loop_ms < 0)
+            result.loop_ms = elapsed - cut;
+        reportSafetySnapshot(lroundf(readings.reservoir.temperature * 100), now);
+        readings.pump.flow_ok = flow_ok;
+        measuredFromReadings(&readings, &measured);
+        runCoolingControl(&measured, &readings, settings, &control, now);
+    }
+    return result;
+}
+
+static plant_result simulate(uint16_t horizon, uint32_t start_ms, FILE *trace)
+{
+    struct_settings *settings = loadSettings();
+    settings->feedforward_horizon = horizon;
+    static timer_wheel wheel;
+    wheel.begin(start_ms);
+    beginActuators(&wheel, settings, nullptr, start_ms);
+    struct_control control;
+    struct_readings readings = {};
+    struct_measured inputs;
+    readings.reservoir.setpoint = 20.0;
+    readings.pump.running = true;
+    readings.pump.flow_ok = true;
+    struct_heat_trend trend;
+    struct_heat_load heat_load = {};
+
+    float reservoir = readings.reservoir.setpoint;
+    float internal = reservoir + pcLoad(0) / PLANT_EXCHANGER_UA;
+    float measured = pcLoad(0);
+    float cooling = 0;
+    bool was_running = false;
+    plant_result result = {reservoir, 0, reservoir, 0};
+    float limit = readings.reservoir.setpoint + settings->hysteresis;
+    float dt = PLANT_STEP_MS / 1000.0f;
+
+    for (uint32_t elapsed = 0; elapsed < PLANT_DURATION_S * 1000; elapsed += PLANT_STEP_MS)
+    {
+        replay_millis = start_ms + elapsed;
+        wheel.advance(millis());
+        float t = elapsed / 1000.0f;
+        float load = pcLoad(t);
+        float exchanged = PLANT_EXCHANGER_UA * (internal - reservoir);
+        float target = readings.compressor.running ? PLANT_COMPRESSOR_W : 0.0f;
+        cooling += (target - cooling) * dt / PLANT_COMPRESSOR_TAU;
+        internal += (load - exchanged) * dt / PLANT_INTERNAL_MASS;
+        reservoir += (exchanged - cooling + PLANT_AMBIENT_UA * (PLANT_AMBIENT - reservoir)) * dt / (settings->thermal_mass * 1000.0f);
+
+        // the loop controller's view: internal loop delta-T x flow
+        measured += (load - measured) * dt / PLANT_SENSOR_TAU;
+        addHeatSample(trend, millis(), measured + noise());
+        heat_load.internal_w = measured;
+        heat_load.external_w = exchanged;
+        heat_load.trend_w_per_s = heatTrend(trend);
+
+        if (elapsed % PLANT_CONTROL_MS == 0)
+        {
+            setHeatLoad(&control, &heat_load, millis());
+            readings.reservoir.temperature = reservoir;
+            measuredFromReadings(&readings, &inputs);
+            runCoolingControl(&inputs, &readings, settings, &control, millis());
+            if (readings.compressor.running && !was_running)
+                ++result.starts;
+            was_running = readings.compressor.running;
+        }
+
+        result.peak = fmaxf(result.peak, reservoir);
+        result.lowest = fminf(result.lowest, reservoir);
+        if (reservoir > limit)
+            result.overshoot_s += dt;
+        if (trace != nullptr)
+            fprintf(trace, "%u,%.1f,%.1f,%.3f,%.3f,%d\n", horizon, t, load, reservoir, internal, readings.compressor.running);
+    }
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t horizon = loadSettings()->feedforward_horizon;
+    const char *trace_path = nullptr;
+    uint32_t start_ms = 0;
+    uint32_t stall_ms = PLANT_STALL_MS;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--horizon") && i + 1 < argc)
+            horizon = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--stall") && i + 1 < argc)
+            stall_ms = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--wrap"))
+            start_ms = 0 - PLANT_WRAP_LEAD_MS;
+        else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+            trace_path = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: %s [--horizon <s>] [--stall <ms>] [--wrap] [--trace <file.csv>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    FILE *trace = nullptr;
+    if (trace_path != nullptr)
+    {
+        if ((trace = fopen(trace_path, "w")) == nullptr)
+        {
+            perror(trace_path);
+            return 2;
+        }
+        fprintf(trace, "horizon_s,time_s,load_w,reservoir,internal,compressor\n");
+    }
+
+    struct_settings *settings = loadSettings();
+    float limit = 20.0f + settings->hysteresis;
+    printf("%.0f s of load steps, setpoint 20.0C +/-%.1fC, %u kJ/K\n", (float)PLANT_DURATION_S, settings->hysteresis, settings->thermal_mass);
+    printf("%-16s %8s %10s %12s %8s %7s\n", "", "peak C", "over C", "over limit", "low C", "starts");
+    const uint16_t horizons[] = {0, horizon};
+    for (uint16_t h : horizons)
+    {
+        plant_result r = simulate(h, start_ms, trace);
+        char name[24];
+        snprintf(name, sizeof(name), h ? "feed-forward %us" : "feedback only", h);
+        printf("%-16s %8.2f %10.2f %11.0fs %8.2f %7u\n", name, r.peak, fmaxf(r.peak - limit, 0.0f), r.overshoot_s, r.lowest, r.starts);
+    }
+    if (trace != nullptr)
+        fclose(trace);
+
+    fault_result f = simulateFlowLoss(stall_ms, start_ms);
+    if (!f.cut)
+    {
+        printf("\ncompressor never started; no flow cut to run\n");
+        return 1;
+    }
+    printf("\nflow cut with the compressor running, loop() stalled %lu ms\n", (unsigned long)stall_ms);
+    printf("  safety monitor   compressor off +%ld ms, pump off +%ld ms, bound %u ms\n",
+           (long)f.compressor_ms, (long)f.pump_ms, SAFETY_REACTION_MS);
+    printf("  loop() alone     first sees the flow at +%ld ms\n", (long)f.loop_ms);
+    for (uint8_t bit = 1; bit; bit <<= 1)
+        if (f.trips & bit)
+            printf("  trip: %s\n", safetyTripName((safety_trip)bit));
+    bool ok = f.compressor_ms >= 0 && f.compressor_ms <= SAFETY_REACTION_MS && f.pump_ms >= 0 && f.pump_ms <= SAFETY_REACTION_MS;
+    return ok ? 0 : 1;
+}
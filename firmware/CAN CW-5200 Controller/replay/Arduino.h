@@ -0,0 +1,26 @@
+#ifndef __CW5200_REPLAY_ARDUINO__
+#define __CW5200_REPLAY_ARDUINO__
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+/*
+ *   Just enough of the Arduino core for the control modules to build natively.
+ *   Time comes from the log being replayed, never from the host clock.
+ */
+
+// the Teensy 3.2's analog pin numbers, for board.h
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A7 21
+#define A8 22
+#define A9 23
+
+extern uint32_t replay_millis;
+
+inline uint32_t millis() { return replay_millis; }
+inline uint32_t micros() { return replay_millis * 1000; }
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef __CW5200_REPLAY_EEPROM__
+#define __CW5200_REPLAY_EEPROM__
+#include <cstdint>
+#include <cstring>
+
+/*
+ *   In-memory stand-in for the Teensy 3.2's 2KB emulated EEPROM. It starts
+ *   erased, so settings and maintenance counters load their defaults.
+ */
+
+#define E2END 0x7FF
+
+class EEPROMClass
+{
+public:
+    EEPROMClass() { memset(data, 0xFF, sizeof(data)); }
+    uint8_t read(int address) { return data[address]; }
+    void write(int address, uint8_t value) { data[address] = value; }
+    void update(int address, uint8_t value) { data[address] = value; }
+    uint16_t length() { return E2END + 1; }
+
+    template <typename T>
+    T &get(int address, T &value)
+    {
+        memcpy(&value, &data[address], sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    const T &put(int address, const T &value)
+    {
+        memcpy(&data[address], &value, sizeof(T));
+        return value;
+    }
+
+private:
+    uint8_t data[E2END + 1];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
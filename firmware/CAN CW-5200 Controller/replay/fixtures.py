@@ -0,0 +1,154 @@
+"""Scripted sensor faults through the replay build's anomaly detection.
+
+Each fixture is a few hours of synthetic telemetry at one record a second,
+written in the raw layout telemetry_log exports, with one fault scripted into
+it. It is run through the replay program, and the anomalies it prints are
+checked against the ones the fixture expects, by code and by time:
+
+    pio run -e replay && python replay/fixtures.py .pio/build/replay/program
+
+The control is replayed stopped, so the compressor, valve and fans must
+come out exactly as logged; only the error codes are expected to differ.
+The exit status is 1 if any fixture fails.
+"""
+
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+import numpy as np
+
+sys.path.insert(0, str(Path(__file__).resolve().parents[3] / "tools"))
+import comms  # noqa: E402
+
+RECORD = np.dtype([("time_ns", "<i8"), ("readings", comms.READINGS)])
+DS18B20_LSB = 0.5  # degC at 9 bits, ANOMALY_DS18B20_LSB
+SENSOR_STUCK = 0x0410
+SENSOR_RATE_OF_CHANGE = 0x0420
+SENSOR_OUTLIER = 0x0430
+RES_T, CASE_T, CASE_RH = 0, 2, 3  # anomaly channel indices
+
+
+def quantise(values, lsb):
+    return np.round(np.asarray(values) / lsb) * lsb
+
+
+def settled(seconds: int, seed: int = 1) -> np.ndarray:
+    """An idle chiller in a still room: both probes sit on one code, the BME280 and eTape jitter."""
+    rng = np.random.default_rng(seed)
+    records = np.zeros(seconds, dtype=RECORD)
+    records["time_ns"] = np.arange(seconds, dtype=np.int64) * 1_000_000_000
+    r = records["readings"]
+    r["header.sequence"] = np.arange(seconds)
+    r["reservoir.temperature"] = 20.0
+    r["reservoir.setpoint"] = 20.0
+    r["reservoir.level_sense"] = 1200.0 + rng.normal(0, 0.3, seconds)
+    r["reservoir.level_ref"] = 2000.0 + rng.normal(0, 0.3, seconds)
+    r["chassis.inside_temperature"] = 27.0 + quantise(rng.normal(0, 0.02, seconds), 0.01)
+    r["chassis.outside_temperature"] = 22.0
+    r["chassis.humidity"] = 45.0 + quantise(rng.normal(0, 0.05, seconds), 1 / 1024)
+    r["chassis.filter_dp"] = 100 + rng.integers(-1, 2, seconds)
+    r["pump.running"] = True
+    r["pump.flow_ok"] = True
+    r["maintenance.filter_hours_left"] = 0xFFFF
+    return records
+
+
+def idle_setpoint():
+    # the false trip this guards against: four hours on one code is not stuck while nothing moves it
+    return settled(4 * 3600), []
+
+
+def stuck_probe():
+    # the room warms 3 degC over three hours and the reservoir probe never moves off its code;
+    # outside reads a degree up from 2700 s, where the count starts, and it runs 3600 samples
+    records = settled(4 * 3600)
+    t = np.arange(len(records))
+    outside = 22.0 + quantise(np.minimum(t, 3 * 3600) * 3.0 / (3 * 3600), DS18B20_LSB)
+    records["readings"]["chassis.outside_temperature"] = outside
+    return records, [(SENSOR_STUCK + RES_T, 6290, 6310)]
+
+
+def step_change():
+    # the reservoir reading jumps 5 degC between two samples and stays there: too fast, and
+    # from the next sample on an outlier, as the jump is kept out of the statistics
+    records = settled(3600)
+    records["readings"]["reservoir.temperature"][1800:] += 5.0
+    return records, [(SENSOR_RATE_OF_CHANGE + RES_T, 1799, 1801), (SENSOR_OUTLIER + RES_T, 1800, 1802)]
+
+
+def outlier():
+    # one case temperature sample 1.5 degC off, inside the rate limit but far outside the spread
+    records = settled(3600)
+    records["readings"]["chassis.inside_temperature"][1800] += 1.5
+    return records, [(SENSOR_OUTLIER + CASE_T, 1799, 1801)]
+
+
+def several_at_once():
+    # a step on one channel and an outlier on another in the same update: both are reported
+    records = settled(3600)
+    records["readings"]["reservoir.temperature"][1800:] += 5.0
+    records["readings"]["chassis.humidity"][1800] += 4.0
+    return records, [(SENSOR_RATE_OF_CHANGE + RES_T, 1799, 1801), (SENSOR_OUTLIER + CASE_RH, 1799, 1801),
+                     (SENSOR_OUTLIER + RES_T, 1800, 1802)]
+
+
+def bme_late():
+    # the BME280 is not read until 900 s in, past its stuck count, and its fields hold 0 until then:
+    # neither the wait nor the jump to its first reading is a fault
+    records = settled(3600)
+    records["readings"]["chassis.inside_temperature"][:900] = 0.0
+    records["readings"]["chassis.humidity"][:900] = 0.0
+    return records, []
+
+
+FIXTURES = [idle_setpoint, stuck_probe, step_change, outlier, several_at_once, bme_late]
+
+
+def run(program: str, fixture, folder: Path) -> list[str]:
+    records, expected = fixture()
+    path = folder / f"{fixture.__name__}.bin"
+    records.tofile(path)
+    result = subprocess.run([program, str(path), "--stopped"], capture_output=True, text=True)
+    failures = []
+    raised = []
+    for line in result.stdout.splitlines():
+        fields = line.split()
+        if len(fields) >= 3 and fields[1] == "anomaly":
+            raised.append((int(fields[2], 16), float(fields[0].rstrip("s"))))
+        elif len(fields) == 3 and fields[0] in ("valve", "compressor") and fields[1] != "0":
+            failures.append(f"{fields[1]} {fields[0]} mismatches")
+        elif fields[:2] == ["fan", "pwm"] and fields[2] != "0":
+            failures.append(f"{fields[2]} fan pwm mismatches")
+    for code, earliest, latest in expected:
+        times = [t for c, t in raised if c == code]
+        if not times:
+            failures.append(f"{code:04X} not raised")
+        elif not earliest <= times[0] <= latest:
+            failures.append(f"{code:04X} raised at {times[0]:.0f}s, expected {earliest}-{latest}s")
+    expected_codes = {code for code, _, _ in expected}
+    for code, t in raised:
+        if code not in expected_codes:
+            failures.append(f"{code:04X} raised at {t:.0f}s, not expected")
+    return failures
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__, file=sys.stderr)
+        return 2
+    failed = 0
+    with tempfile.TemporaryDirectory() as folder:
+        for fixture in FIXTURES:
+            failures = run(sys.argv[1], fixture, Path(folder))
+            print(f"{fixture.__name__:<18} {'FAILED' if failures else 'ok'}")
+            for failure in failures:
+                print(f"  {failure}")
+            failed += bool(failures)
+    print(f"{len(FIXTURES)} fixtures run, {failed} failed")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
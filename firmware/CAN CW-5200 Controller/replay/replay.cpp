@@ -0,0 +1,299 @@
+#include <Arduino.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <EEPROM.h>
+
+#include "error_codes.h"
+#include "settings.h"
+#include "comms.h"
+#include "measured.h"
+#include "maintenance.h"
+#include "filter_trend.h"
+#include "anomaly.h"
+#include "control.h"
+#include "actuators.h"
+
+/*
+ *   Deterministic replay of logged telemetry
+ *
+ *   Input is a file of records, each an int64 host receive time in ns followed
+ *   by a packed struct_readings, as written by the host's telemetry log
+ *
+ *     tools/telemetry/.pio/build/telemetry_log/program export --format raw > week.bin
+ *
+ *   The sensor fields are taken from the log and run through the same modules
+ *   the board uses, in the same order as loop(), with millis() driven from the
+ *   log's timestamps. The decisions (valve, compressor, fan PWM and the error
+ *   code) are recomputed and compared with what the board reported, so a
+ *   change to the control or detection code can be checked against days of
+ *   real history in a second or two.
+ *
+ *     replay <file> [--stopped] [--verbose] [--output <file>]
+ */
+
+#define REPLAY_START_MS 1000   // simulated uptime at the first record
+#define REPLAY_SHOW_MISMATCHES 10
+
+uint32_t replay_millis = REPLAY_START_MS;
+EEPROMClass EEPROM;
+
+struct __attribute__((packed)) struct_record
+{
+    int64_t time_ns;
+    struct_readings readings;
+};
+
+enum replay_field : uint8_t
+{
+    FIELD_VALVE = 0,
+    FIELD_COMPRESSOR,
+    FIELD_FAN_PWM,
+    FIELD_ERROR,
+    FIELD_COUNT,
+};
+
+static const char *const field_names[FIELD_COUNT] = {"valve", "compressor", "fan pwm", "error"};
+
+static struct_readings replayed;
+static struct_control control;
+static timer_wheel wheel;
+static struct_settings *settings;
+static struct_maintenance *maintenance;
+
+static void setError(uint16_t error)
+{
+    replayed.error.code = error;
+    replayed.error.alert = true;
+}
+
+static bool isAcquisitionError(uint16_t code)
+{
+    // raised by the drivers rather than from the readings, so they cannot be replayed
+    switch (code)
+    {
+    case RESERVOIR_NO_DS18B20_ADDRESS:
+    case RESERVOIR_NO_DS18B20_READ:
+    case CASE_BME280_NO_CONNECT:
+    case CASE_NO_OUTSIDE_DS18B20_ADDRESS:
+    case CASE_NO_OUTSIDE_DS18B20_READ:
+    case CASE_DISPLAY_NO_CONNECT:
+    case CASE_TOP_FAN_LOW_RPM:
+    case CASE_BOTTOM_FAN_LOW_RPM:
+    case SYSTEM_WATCHDOG_RESET:
+    case SYSTEM_HEAP_ALLOCATION:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void seed(const struct_record *first)
+{
+    replay_millis = REPLAY_START_MS;
+    settings = loadSettings();
+    maintenance = loadMaintenance();
+    clearFilterTrend();
+    clearAnomalies();
+
+    // the log usually starts mid-run, so pick up the outputs where the board had them
+    replayed = first->readings;
+    wheel.begin(replay_millis);
+    beginActuators(&wheel, settings, nullptr, replay_millis);
+    seedActuator(ACTUATOR_COMPRESSOR, first->readings.compressor.running, replay_millis - first->readings.compressor.compressor_time);
+    seedActuator(ACTUATOR_VALVE, first->readings.compressor.valve, replay_millis - first->readings.compressor.valve_time);
+    seedActuator(ACTUATOR_PUMP, first->readings.pump.running, replay_millis);
+    seedActuator(ACTUATOR_FANS, first->readings.chassis.fan.pwm, replay_millis);
+    maintenance->compressor_seconds = first->readings.maintenance.compressor_seconds;
+    maintenance->compressor_starts = first->readings.maintenance.compressor_starts;
+    maintenance->short_cycles = first->readings.maintenance.short_cycles;
+    maintenance->pump_seconds = first->readings.maintenance.pump_seconds;
+    maintenance->fan_seconds = first->readings.maintenance.fan_seconds;
+}
+
+// the log does not say which sensors had been read, but an unread one leaves its fields at exactly 0
+static uint8_t absentChannels(const struct_readings *logged)
+{
+    uint8_t absent = 0;
+    if (logged->reservoir.temperature == 0)
+        absent |= ANOMALY_CHANNEL(ANOMALY_RES_T);
+    if (logged->chassis.outside_temperature == 0)
+        absent |= ANOMALY_CHANNEL(ANOMALY_OUT_T);
+    if (logged->chassis.inside_temperature == 0 && logged->chassis.humidity == 0)
+        absent |= ANOMALY_CHANNEL(ANOMALY_CASE_T) | ANOMALY_CHANNEL(ANOMALY_CASE_RH);
+    return absent;
+}
+
+static void step(const struct_readings *logged)
+{
+    // inputs: everything the board measured rather than decided
+    replayed.reservoir = logged->reservoir;
+    replayed.chassis.inside_temperature = logged->chassis.inside_temperature;
+    replayed.chassis.outside_temperature = logged->chassis.outside_temperature;
+    replayed.chassis.humidity = logged->chassis.humidity;
+    replayed.chassis.filter_dp = logged->chassis.filter_dp;
+    replayed.chassis.fan.top_tach = logged->chassis.fan.top_tach;
+    replayed.chassis.fan.bottom_tach = logged->chassis.fan.bottom_tach;
+    replayed.pump = logged->pump;
+    // the pump is switched by hand, so its relay is an input here too
+    setPump(logged->pump.running, millis());
+    wheel.advance(millis());
+    struct_measured measured;
+    measuredFromReadings(&replayed, &measured);
+    if (isAcquisitionError(logged->error.code) && logged->error.code != replayed.error.code)
+        setError(logged->error.code);
+
+    // measureFilterDP()
+    updateFilterTrend(replayed.chassis.filter_dp, replayed.chassis.fan.pwm, settings->filter_zero, settings->filter_high_limit);
+    replayed.maintenance.filter_hours_left = getFilterHoursLeft();
+
+    // measureSensorHealth()
+    anomaly_report reports[ANOMALY_REPORTS_MAX];
+    uint8_t raised = updateAnomalies(&replayed, absentChannels(logged), reports);
+    for (uint8_t i = 0; i < raised; i++)
+    {
+        setError(reports[i].code);
+        printf("%10.3fs anomaly    %04X %s\n", (millis() - REPLAY_START_MS) / 1000.0, reports[i].code, reports[i].name);
+    }
+
+    // runCoolingCycle()
+    uint16_t code = runCoolingControl(&measured, &replayed, settings, &control, millis());
+    if (code != 0)
+        setError(code);
+    updateMaintenance(replayed.compressor.running, replayed.pump.running, replayed.chassis.fan.pwm > 0);
+    replayed.maintenance.compressor_seconds = maintenance->compressor_seconds;
+    replayed.maintenance.compressor_starts = maintenance->compressor_starts;
+    replayed.maintenance.starts_per_hour = getStartsPerHour();
+    replayed.maintenance.short_cycles = maintenance->short_cycles;
+    replayed.maintenance.pump_seconds = maintenance->pump_seconds;
+    replayed.maintenance.fan_seconds = maintenance->fan_seconds;
+
+    // checkReadingLimits()
+    const limit_check *violations[LIMIT_VIOLATIONS_MAX];
+    uint8_t count = checkLimits(&measured, &replayed, settings, violations);
+    for (uint8_t i = 0; i < count; i++)
+        setError(violations[i]->code);
+}
+
+static uint32_t compare(const struct_readings *logged, uint32_t *values)
+{
+    uint32_t mismatched = 0;
+    values[0] = logged->compressor.valve;
+    values[1] = replayed.compressor.valve;
+    values[2] = logged->compressor.running;
+    values[3] = replayed.compressor.running;
+    values[4] = logged->chassis.fan.pwm;
+    values[5] = replayed.chassis.fan.pwm;
+    values[6] = logged->error.code;
+    values[7] = replayed.error.code;
+    for (uint8_t field = 0; field < FIELD_COUNT; field++)
+    {
+        if (values[2 * field] != values[2 * field + 1])
+            mismatched |= 1 << field;
+    }
+    return mismatched;
+}
+
+int main(int argc, char **argv)
+{
+    const char *input = nullptr;
+    const char *output = nullptr;
+    bool verbose = false;
+    bool stopped = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--verbose"))
+            verbose = true;
+        else if (!strcmp(argv[i], "--stopped"))
+            stopped = true;
+        else if (!strcmp(argv[i], "--output") && i + 1 < argc)
+            output = argv[++i];
+        else
+            input = argv[i];
+    }
+    if (input == nullptr)
+    {
+        fprintf(stderr, "usage: %s <file> [--stopped] [--verbose] [--output <file>]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *in = fopen(input, "rb");
+    if (in == nullptr)
+    {
+        perror(input);
+        return 2;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    size_t records = size / sizeof(struct_record);
+    if (size % sizeof(struct_record) != 0)
+        fprintf(stderr, "%s: %ld trailing bytes ignored; was it exported with this comms.h?\n", input, size % (long)sizeof(struct_record));
+    if (records == 0)
+    {
+        fprintf(stderr, "%s: no records\n", input);
+        return 2;
+    }
+    struct_record *log = (struct_record *)malloc(records * sizeof(struct_record));
+    if (log == nullptr || fread(log, sizeof(struct_record), records, in) != records)
+    {
+        fprintf(stderr, "%s: read failed\n", input);
+        return 2;
+    }
+    fclose(in);
+
+    FILE *out = nullptr;
+    if (output != nullptr && (out = fopen(output, "wb")) == nullptr)
+    {
+        perror(output);
+        return 2;
+    }
+
+    uint32_t mismatches[FIELD_COUNT] = {0};
+    uint32_t shown = 0;
+    uint32_t values[2 * FIELD_COUNT];
+
+    auto started = std::chrono::steady_clock::now();
+    seed(&log[0]);
+    control.running = !stopped;
+    int64_t first_ns = log[0].time_ns;
+    for (size_t i = 0; i < records; i++)
+    {
+        replay_millis = REPLAY_START_MS + (uint32_t)((log[i].time_ns - first_ns) / 1000000);
+        step(&log[i].readings);
+        uint32_t mismatched = compare(&log[i].readings, values);
+        for (uint8_t field = 0; field < FIELD_COUNT; field++)
+        {
+            if (!(mismatched & (1 << field)))
+                continue;
+            ++mismatches[field];
+            if (verbose || shown < REPLAY_SHOW_MISMATCHES)
+            {
+                ++shown;
+                printf("%10.3fs %-10s logged %04X replayed %04X\n", (log[i].time_ns - first_ns) / 1e9,
+                       field_names[field], values[2 * field], values[2 * field + 1]);
+            }
+        }
+        if (out != nullptr)
+        {
+            struct_record record = {log[i].time_ns, replayed};
+            fwrite(&record, sizeof(record), 1, out);
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    double simulated = (log[records - 1].time_ns - first_ns) / 1e9;
+    if (out != nullptr)
+        fclose(out);
+    free(log);
+
+    uint32_t total = 0;
+    printf("%zu records, %.1f h simulated in %.3f s (%.0f records/s, %.0fx real time)\n", records,
+           simulated / 3600.0, elapsed, records / elapsed, simulated / elapsed);
+    for (uint8_t field = 0; field < FIELD_COUNT; field++)
+    {
+        printf("%-10s %u mismatches\n", field_names[field], mismatches[field]);
+        total += mismatches[field];
+    }
+    return total == 0 ? 0 : 1;
+}
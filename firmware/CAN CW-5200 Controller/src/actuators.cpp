@@ -0,0 +1,140 @@
+#include "actuators.h"
+#include "control.h"
+
+static timer_wheel *wheel = nullptr;
+static const struct_settings *settings = nullptr;
+static void (*apply)(actuator, uint8_t) = nullptr;
+static struct_actuators state;
+
+static wheel_timer compressor_start;
+static wheel_timer fan_ramp;
+static wheel_timer pump_stop;
+
+static bool permitted(actuator which, uint8_t level, uint32_t now)
+{
+    bool compressor = state.level[ACTUATOR_COMPRESSOR];
+    switch (which)
+    {
+    case ACTUATOR_COMPRESSOR:
+        return !level || (state.level[ACTUATOR_PUMP] && state.level[ACTUATOR_VALVE] &&
+                          now - state.changed[ACTUATOR_VALVE] >= settings->valve_lockout &&
+                          now - state.changed[ACTUATOR_COMPRESSOR] >= settings->compressor_lockout);
+    case ACTUATOR_VALVE:
+    case ACTUATOR_PUMP:
+    case ACTUATOR_FANS:
+        return level || !compressor;
+    default:
+        return false;
+    }
+}
+
+bool actuate(actuator which, uint8_t level, uint32_t now)
+{
+    if (state.level[which] == level)
+        return true;
+    if (!permitted(which, level, now))
+    {
+        ++state.refused;
+        return false;
+    }
+    state.level[which] = level;
+    state.changed[which] = now;
+    if (apply != nullptr)
+        apply(which, level);
+    return true;
+}
+
+static void rampFans(wheel_timer *, uint32_t now)
+{
+    uint16_t level = state.level[ACTUATOR_FANS] + FAN_PWM_ON / FAN_RAMP_STEPS;
+    actuate(ACTUATOR_FANS, level < FAN_PWM_ON ? level : FAN_PWM_ON, now);
+    if (state.level[ACTUATOR_FANS] < FAN_PWM_ON)
+        wheel->schedule(&fan_ramp, now, FAN_RAMP_STEP_MS);
+}
+
+static void startCompressor(wheel_timer *, uint32_t now)
+{
+    // the condenser fans come up with it
+    if (actuate(ACTUATOR_COMPRESSOR, 1, now))
+        rampFans(&fan_ramp, now);
+}
+
+static void stopPump(wheel_timer *, uint32_t now)
+{
+    actuate(ACTUATOR_PUMP, 0, now);
+}
+
+void beginActuators(timer_wheel *timers, const struct_settings *config, void (*output)(actuator, uint8_t), uint32_t now)
+{
+    wheel = timers;
+    settings = config;
+    apply = output;
+    compressor_start.fire = startCompressor;
+    fan_ramp.fire = rampFans;
+    pump_stop.fire = stopPump;
+    wheel->cancel(&compressor_start);
+    wheel->cancel(&fan_ramp);
+    wheel->cancel(&pump_stop);
+    // as safeOutputs() leaves the pins: pump on, the rest off
+    state = {};
+    state.level[ACTUATOR_PUMP] = 1;
+    for (uint32_t &changed : state.changed)
+        changed = now;
+}
+
+void seedActuator(actuator which, uint8_t level, uint32_t changed)
+{
+    state.level[which] = level;
+    state.changed[which] = changed;
+}
+
+const struct_actuators *actuatorState()
+{
+    return &state;
+}
+
+void startCooling(uint32_t now)
+{
+    if (state.level[ACTUATOR_COMPRESSOR] || compressor_start.armed || !state.level[ACTUATOR_PUMP])
+        return;
+    actuate(ACTUATOR_VALVE, 1, now);
+    uint32_t valve = now - state.changed[ACTUATOR_VALVE];
+    uint32_t compressor = now - state.changed[ACTUATOR_COMPRESSOR];
+    uint32_t wait = 0;
+    if (valve < settings->valve_lockout)
+        wait = settings->valve_lockout - valve;
+    if (compressor < settings->compressor_lockout && settings->compressor_lockout - compressor > wait)
+        wait = settings->compressor_lockout - compressor;
+    wheel->schedule(&compressor_start, now, wait);
+}
+
+void stopCooling(uint32_t now)
+{
+    wheel->cancel(&compressor_start);
+    // a compressor still waiting on its lockouts never started, so there is no run time to wait out
+    if (state.level[ACTUATOR_COMPRESSOR] && now - state.changed[ACTUATOR_COMPRESSOR] < settings->compressor_lockout)
+        return;
+    wheel->cancel(&fan_ramp);
+    actuate(ACTUATOR_COMPRESSOR, 0, now);
+    actuate(ACTUATOR_VALVE, 0, now);
+    actuate(ACTUATOR_FANS, FAN_PWM_OFF, now);
+}
+
+void setPump(bool on, uint32_t now)
+{
+    if (on)
+    {
+        wheel->cancel(&pump_stop);
+        actuate(ACTUATOR_PUMP, 1, now);
+        return;
+    }
+    if (!state.level[ACTUATOR_PUMP] || pump_stop.armed)
+        return;
+    wheel->cancel(&compressor_start);
+    wheel->cancel(&fan_ramp);
+    bool running = state.level[ACTUATOR_COMPRESSOR];
+    actuate(ACTUATOR_COMPRESSOR, 0, now);
+    actuate(ACTUATOR_VALVE, 0, now);
+    actuate(ACTUATOR_FANS, FAN_PWM_OFF, now);
+    wheel->schedule(&pump_stop, now, running ? PUMP_RUN_ON_MS : 0);
+}
@@ -0,0 +1,57 @@
+#ifndef __CW5200_ACTUATORS__
+#define __CW5200_ACTUATORS__
+#include <cstdint>
+#include <timer_wheel.h>
+#include "settings.h"
+
+/*
+ *   Relays and fans, sequenced on a timer wheel
+ *
+ *   actuate() is the one place an output changes, and so the one place the
+ *   interlocks are enforced:
+ *
+ *     - the compressor only starts with the pump running, the valve open for
+ *       valve_lockout and compressor_lockout since it last switched
+ *     - the valve only closes and the pump only stops with the compressor off
+ *     - the fans only stop with the compressor off
+ *
+ *   Stopping the compressor is never refused. The sequences below are
+ *   deferred actions on the wheel rather than elapsed-time checks in the
+ *   1 s loop, so the compressor starts when its lockout runs out, not at the
+ *   next pass after. No pin I/O happens here: the board hands beginActuators()
+ *   the function that drives the pins, and the native builds pass none.
+ */
+
+#define PUMP_RUN_ON_MS 5000 // pump keeps going after a stop, off the evaporator's cold
+#define FAN_RAMP_STEPS 4    // from a quarter to full speed
+#define FAN_RAMP_STEP_MS 500
+
+enum actuator : uint8_t
+{
+    ACTUATOR_VALVE = 0,
+    ACTUATOR_COMPRESSOR,
+    ACTUATOR_PUMP,
+    ACTUATOR_FANS, // PWM
+    ACTUATORS,
+};
+
+struct struct_actuators
+{
+    uint8_t level[ACTUATORS];    // 0 or 1 for the relays, PWM for the fans
+    uint32_t changed[ACTUATORS]; // millis() of the last change
+    uint32_t refused;            // requests an interlock turned down
+};
+
+void beginActuators(timer_wheel *wheel, const struct_settings *settings, void (*apply)(actuator, uint8_t), uint32_t now);
+void seedActuator(actuator which, uint8_t level, uint32_t changed);
+bool actuate(actuator which, uint8_t level, uint32_t now);
+const struct_actuators *actuatorState();
+
+// valve now, compressor when its lockouts allow, then the fans ramp up
+void startCooling(uint32_t now);
+// everything off once the compressor has run for compressor_lockout, straight away if it never started
+void stopCooling(uint32_t now);
+// on straight away; off stops the compressor first, whatever its lockout
+void setPump(bool on, uint32_t now);
+
+#endif
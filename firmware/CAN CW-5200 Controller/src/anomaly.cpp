@@ -0,0 +1,240 @@
+#include <Arduino.h>
+#include "anomaly.h"
+#include "error_codes.h"
+
+/*
+ *   Streaming sensor anomaly detection
+ *
+ *   Each channel keeps an exponentially weighted mean and variance, its last
+ *   value and a count of unchanged samples: constant memory and constant work
+ *   per sample. A channel raises each kind of anomaly once, when it first
+ *   appears, and re-arms after a clean sample. Every anomaly that appears
+ *   in an update is reported, however many there are.
+ *
+ *   At 9 bits the reservoir probe reads the same code for hours once the
+ *   loop settles, so it is only called stuck when it should have moved: the
+ *   compressor was running, or the outside probe moved a degree since it
+ *   last did.
+ *
+ *   A channel with nothing measured in an update, a sensor not yet read
+ *   since it came up or one that has gone, is left out of it: its field
+ *   holds a placeholder, not a sample, and the channel starts over from
+ *   its next real one rather than taking the jump to it for a fault.
+ */
+
+static bool cooling(const struct_readings *r)
+{
+    return r->compressor.running;
+}
+
+static const anomaly_channel channels[] = {
+    {"Res T", [](const struct_readings *r) { return r->reservoir.temperature; }, 0.05, 0.25, 6.0, 2.0, ANOMALY_DS18B20_LSB / 2, 3600, cooling, ANOMALY_CHANNEL(ANOMALY_OUT_T), 1.0},
+    {"Out T", [](const struct_readings *r) { return r->chassis.outside_temperature; }, 0.05, 0.25, 6.0, 2.0, ANOMALY_DS18B20_LSB / 2, 0, nullptr, 0, 0.0},
+    {"Case T", [](const struct_readings *r) { return r->chassis.inside_temperature; }, 0.05, 0.1, 6.0, 2.0, ANOMALY_BME280_T_LSB / 2, 600, nullptr, 0, 0.0},
+    {"Case RH", [](const struct_readings *r) { return r->chassis.humidity; }, 0.05, 0.5, 6.0, 5.0, ANOMALY_BME280_RH_LSB / 2, 600, nullptr, 0, 0.0},
+    {"Res Lvl", [](const struct_readings *r) { return r->reservoir.level_sense; }, 0.02, 2.0, 8.0, 50.0, 0.001, 300, nullptr, 0, 0.0},
+    {"Res Ref", [](const struct_readings *r) { return r->reservoir.level_ref; }, 0.02, 2.0, 8.0, 50.0, 0.001, 300, nullptr, 0, 0.0},
+    {"\x83P", [](const struct_readings *r) { return (float)r->chassis.filter_dp; }, 0.02, 2.0, 8.0, 100.0, 0.0, 0, nullptr, 0, 0.0},
+};
+#define CHANNEL_COUNT (sizeof(channels) / sizeof(channels[0]))
+static_assert(CHANNEL_COUNT == ANOMALY_CHANNELS, "ANOMALY_CHANNELS is out of step with the table");
+static_assert(ANOMALY_FILTER_DP + 1 == ANOMALY_CHANNELS, "anomaly_channel_index is out of step with the table");
+
+static struct_anomaly_state state[CHANNEL_COUNT];
+static bool fan_mismatch[2] = {false, false};
+static bool reservoir_mismatch = false;
+static uint32_t last_update = 0;
+static uint32_t compressor_idle_since = 0;
+static uint32_t pwm_changed = 0;
+static uint8_t last_pwm = 0;
+
+static anomaly_report *reports;
+static uint8_t report_count = 0;
+static uint8_t absent_now = 0;  // channels with no reading this update
+static uint8_t absent_last = 0; // and the update before
+
+// each channel latches its own kind, so at most ANOMALY_REPORTS_MAX can appear at once
+static void raise(uint8_t index, anomaly_kind kind, const char *name)
+{
+    if (report_count >= ANOMALY_REPORTS_MAX)
+        return;
+    anomaly_report &report = reports[report_count++];
+    report.name = name;
+    report.kind = kind;
+    switch (kind)
+    {
+    case ANOMALY_STUCK:
+        report.code = SENSOR_STUCK + index;
+        break;
+    case ANOMALY_RATE:
+        report.code = SENSOR_RATE_OF_CHANGE + index;
+        break;
+    case ANOMALY_OUTLIER:
+        report.code = SENSOR_OUTLIER + index;
+        break;
+    case ANOMALY_RESERVOIR_MISMATCH:
+        report.code = SENSOR_RESERVOIR_MISMATCH;
+        break;
+    case ANOMALY_FAN_MISMATCH:
+        report.code = SENSOR_FAN_PWM_RPM_MISMATCH + index;
+        break;
+    default:
+        report.code = 0;
+        break;
+    }
+}
+
+static float neighbourSum(const anomaly_channel &channel, const struct_readings *readings)
+{
+    float sum = 0.0f;
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++)
+    {
+        if (channel.neighbours & ANOMALY_CHANNEL(i))
+            sum += channels[i].read(readings);
+    }
+    return sum;
+}
+
+// whether a sample the same as the last one counts towards stuck
+static bool shouldMove(const anomaly_channel &channel, const struct_anomaly_state &s, const struct_readings *readings)
+{
+    if (channel.driven == nullptr && channel.neighbours == 0)
+        return true;
+    if (channel.driven != nullptr && channel.driven(readings))
+        return true;
+    return channel.neighbours != 0 && fabsf(neighbourSum(channel, readings) - s.neighbour_ref) >= channel.neighbour_delta;
+}
+
+static anomaly_kind checkChannel(const anomaly_channel &channel, struct_anomaly_state &s, const struct_readings *readings,
+                                 float dt)
+{
+    float value = channel.read(readings);
+    anomaly_kind kind = ANOMALY_NONE;
+    // a neighbour missing now or coming back says nothing about whether this one should have moved
+    if (channel.neighbours & (absent_now | absent_last))
+        s.neighbour_ref = neighbourSum(channel, readings);
+    if (s.samples > 0)
+    {
+        float delta = value - s.last;
+        if (fabsf(delta) > channel.stuck_epsilon)
+        {
+            s.unchanged = 0;
+            s.neighbour_ref = neighbourSum(channel, readings);
+        }
+        else if (s.unchanged < 0xFFFF && shouldMove(channel, s, readings))
+        {
+            ++s.unchanged;
+        }
+
+        if (dt > 0.0f && fabsf(delta) > channel.max_rate * dt)
+            kind = ANOMALY_RATE;
+        else if (channel.stuck_limit > 0 && s.unchanged >= channel.stuck_limit)
+            kind = ANOMALY_STUCK;
+        else if (s.samples * channel.alpha >= 1.0f) // a window's worth, without a division
+        {
+            float sigma = sqrtf(s.variance);
+            if (sigma < channel.min_sigma)
+                sigma = channel.min_sigma;
+            if (fabsf(value - s.mean) > channel.sigma_limit * sigma)
+                kind = ANOMALY_OUTLIER;
+        }
+    }
+
+    // keep bad samples out of the statistics so one glitch does not widen them
+    if (kind == ANOMALY_NONE)
+    {
+        if (s.samples == 0)
+        {
+            s.mean = value;
+            s.variance = 0.0f;
+            s.neighbour_ref = neighbourSum(channel, readings);
+        }
+        else
+        {
+            float diff = value - s.mean;
+            float incr = channel.alpha * diff;
+            s.mean += incr;
+            s.variance = (1.0f - channel.alpha) * (s.variance + diff * incr);
+        }
+        if (s.samples < 0xFFFF)
+            ++s.samples;
+    }
+    s.last = value;
+    return kind;
+}
+
+static float expectedRPM(uint8_t pwm)
+{
+    return ANOMALY_FAN_RPM_AT_MIN + (ANOMALY_FAN_RPM_AT_MAX - ANOMALY_FAN_RPM_AT_MIN) * (pwm - ANOMALY_FAN_MIN_PWM) / (255 - ANOMALY_FAN_MIN_PWM);
+}
+
+void clearAnomalies()
+{
+    memset(state, 0, sizeof(state));
+    absent_now = absent_last = 0;
+    fan_mismatch[0] = fan_mismatch[1] = false;
+    reservoir_mismatch = false;
+    last_update = millis();
+    compressor_idle_since = last_update;
+    pwm_changed = last_update;
+}
+
+uint8_t updateAnomalies(const struct_readings *readings, uint8_t absent, anomaly_report *reports_out)
+{
+    uint32_t now = millis();
+    float dt = (now - last_update) / 1000.0f;
+    last_update = now;
+    reports = reports_out;
+    report_count = 0;
+    absent_last = absent_now;
+    absent_now = absent;
+
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++)
+    {
+        if (absent & ANOMALY_CHANNEL(i))
+        {
+            state[i] = {};
+            continue;
+        }
+        anomaly_kind kind = checkChannel(channels[i], state[i], readings, dt);
+        if (kind != ANOMALY_NONE && kind != state[i].active)
+            raise(i, kind, channels[i].name);
+        state[i].active = kind;
+    }
+
+    /*
+     *   Cross-checks
+     */
+    if (readings->compressor.running)
+        compressor_idle_since = now;
+    bool mismatch = (now - compressor_idle_since >= ANOMALY_IDLE_SETTLE_MS) &&
+                    (readings->reservoir.temperature < readings->chassis.outside_temperature - ANOMALY_RESERVOIR_MARGIN);
+    if (mismatch && !reservoir_mismatch)
+        raise(0, ANOMALY_RESERVOIR_MISMATCH, "Res T");
+    reservoir_mismatch = mismatch;
+
+    uint8_t pwm = readings->chassis.fan.pwm;
+    if (pwm != last_pwm)
+    {
+        last_pwm = pwm;
+        pwm_changed = now;
+    }
+    if (pwm >= ANOMALY_FAN_MIN_PWM && now - pwm_changed >= ANOMALY_FAN_SPINUP_MS)
+    {
+        float expected = expectedRPM(pwm);
+        float tach[2] = {readings->chassis.fan.top_tach, readings->chassis.fan.bottom_tach};
+        for (uint8_t fan = 0; fan < 2; fan++)
+        {
+            mismatch = fabsf(tach[fan] - expected) > ANOMALY_FAN_TOLERANCE * expected;
+            if (mismatch && !fan_mismatch[fan])
+                raise(fan, ANOMALY_FAN_MISMATCH, fan == 0 ? "Top Fan" : "Bot Fan");
+            fan_mismatch[fan] = mismatch;
+        }
+    }
+    else
+    {
+        fan_mismatch[0] = fan_mismatch[1] = false;
+    }
+
+    return report_count;
+}
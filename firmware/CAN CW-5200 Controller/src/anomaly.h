@@ -0,0 +1,83 @@
+#ifndef __CW5200_ANOMALY__
+#define __CW5200_ANOMALY__
+#include <cstdint>
+#include "comms.h"
+
+#define ANOMALY_IDLE_SETTLE_MS (2UL * 60 * 60 * 1000) // compressor off this long before cross-checking temperatures
+#define ANOMALY_RESERVOIR_MARGIN 5.0f                 // reservoir may sit this far under outside with no cooling, degC
+#define ANOMALY_FAN_SPINUP_MS 10000                   // settle time after a PWM change
+#define ANOMALY_FAN_MIN_PWM 23                        // 8.76% kick-on
+#define ANOMALY_FAN_RPM_AT_MIN 468.0f
+#define ANOMALY_FAN_RPM_AT_MAX 3180.0f
+#define ANOMALY_FAN_TOLERANCE 0.4f                    // fractional RPM error allowed
+#define ANOMALY_DS18B20_LSB 0.5f                      // degC, at board::temperature_precision bits
+#define ANOMALY_BME280_T_LSB 0.01f                    // degC
+#define ANOMALY_BME280_RH_LSB (1.0f / 1024)           // %RH
+#define ANOMALY_CHANNELS 7
+#define ANOMALY_REPORTS_MAX (ANOMALY_CHANNELS + 3)    // every channel, the reservoir and both fans at once
+
+// channel indices, in the order of the table in anomaly.cpp; SENSOR_* codes add the index
+enum anomaly_channel_index : uint8_t
+{
+    ANOMALY_RES_T = 0,
+    ANOMALY_OUT_T,
+    ANOMALY_CASE_T,
+    ANOMALY_CASE_RH,
+    ANOMALY_RES_LVL,
+    ANOMALY_RES_REF,
+    ANOMALY_FILTER_DP,
+};
+#define ANOMALY_CHANNEL(index) (1 << (index)) // for masks of channels
+
+enum anomaly_kind : uint8_t
+{
+    ANOMALY_NONE = 0,
+    ANOMALY_STUCK,
+    ANOMALY_RATE,
+    ANOMALY_OUTLIER,
+    ANOMALY_RESERVOIR_MISMATCH,
+    ANOMALY_FAN_MISMATCH,
+};
+
+struct anomaly_channel
+{
+    const char *name;
+    float (*read)(const struct_readings *);
+    float alpha;         // EWMA weight of a new sample
+    float min_sigma;     // floor on the standard deviation, so quiet sensors are not all outliers
+    float sigma_limit;   // outlier threshold in standard deviations
+    float max_rate;      // largest believable change, units per second
+    float stuck_epsilon; // changes smaller than this count as "the same value"; under one LSB
+    uint16_t stuck_limit; // identical samples in a row before it is stuck, 0 to disable
+    // a settled sensor reads the same code for hours, so with either of these set only the
+    // samples it should have moved in count towards stuck_limit: while driven() is true, or
+    // once the neighbours (a mask of channel indices) have moved neighbour_delta since it last did
+    bool (*driven)(const struct_readings *);
+    uint8_t neighbours;
+    float neighbour_delta;
+};
+
+struct struct_anomaly_state
+{
+    float mean;
+    float variance;
+    float last;
+    uint16_t samples;
+    uint16_t unchanged;   // samples it should have moved in and did not
+    float neighbour_ref;  // the neighbours' sum when it last moved
+    anomaly_kind active;
+};
+
+struct anomaly_report
+{
+    uint16_t code;
+    const char *name;
+    anomaly_kind kind;
+};
+
+void clearAnomalies();
+// fills reports with every anomaly that appeared this update, and returns how many; the channels
+// in absent had nothing measured this update, so their fields are not samples and they start over
+uint8_t updateAnomalies(const struct_readings *readings, uint8_t absent, anomaly_report *reports);
+
+#endif
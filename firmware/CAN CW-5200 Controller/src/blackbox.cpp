@@ -0,0 +1,180 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "blackbox.h"
+#include "control.h"
+#include "error_codes.h"
+#include "maintenance.h"
+
+#define SAMPLES_ADDRESS (BLACKBOX_ADDRESS + sizeof(struct_blackbox_header))
+#define RECORDING_BYTES ((BLACKBOX_PRE + BLACKBOX_POST) * sizeof(struct_blackbox_sample))
+
+static_assert(MAINTENANCE_ADDRESS + sizeof(struct_maintenance) <= BLACKBOX_ADDRESS, "maintenance counters overlap the black box");
+static_assert(SAMPLES_ADDRESS + RECORDING_BYTES <= E2END + 1, "black box does not fit in the EEPROM");
+
+// in recording order once frozen: the ring unrolled, then the post-trigger samples
+static struct_blackbox_sample samples[BLACKBOX_PRE + BLACKBOX_POST];
+static uint8_t ring_head = 0;
+static uint8_t ring_count = 0;
+static uint8_t captured = 0; // samples in recording order, pre and post
+static uint32_t first_sequence = 0;
+static uint32_t last_sequence = 0;
+static struct_blackbox_header header;
+static blackbox_state state = BLACKBOX_ARMED;
+static uint16_t written = 0; // bytes of samples[] in the EEPROM so far
+static uint32_t started = 0;
+
+// how much a recording of error is worth, 0 for not recording it at all
+static uint8_t severity(uint16_t error)
+{
+    if ((error & 0xFF00) == (SAFETY_NO_FLOW & 0xFF00))
+        return 3;
+    if (error == RESERVOIR_PUMP_ON_WITH_NO_FLOW)
+        return 2;
+    if (isLimitCode(error))
+        return 1;
+    return 0;
+}
+
+static void pack(const struct_measured *measured, const struct_readings *readings, struct_blackbox_sample *sample)
+{
+    sample->reservoir_temperature = measured->reservoir;
+    sample->setpoint = measured->setpoint;
+    sample->inside_temperature = measured->inside;
+    sample->outside_temperature = measured->outside;
+    sample->humidity = (measured->humidity + 50) / 100;
+    sample->filter_dp = measured->filter_dp;
+    sample->level_sense = (measured->level_sense + 50) / 100;
+    sample->top_tach = min(measured->top_tach / 10, (deci_rpm)UINT16_MAX);
+    sample->bottom_tach = min(measured->bottom_tach / 10, (deci_rpm)UINT16_MAX);
+    sample->fan_pwm = readings->chassis.fan.pwm;
+    sample->flags = (readings->compressor.valve ? BLACKBOX_VALVE : 0) |
+                    (readings->compressor.running ? BLACKBOX_COMPRESSOR : 0) |
+                    (readings->pump.running ? BLACKBOX_PUMP : 0) |
+                    (readings->pump.flow_ok ? BLACKBOX_FLOW_OK : 0) |
+                    (readings->error.alert ? BLACKBOX_ALERT : 0);
+    sample->error = readings->error.code;
+}
+
+void beginBlackBox(uint32_t now)
+{
+    started = now;
+    EEPROM.get(BLACKBOX_ADDRESS, header);
+    state = header.version == BLACKBOX_VERSION ? BLACKBOX_HELD : BLACKBOX_ARMED;
+}
+
+void recordBlackBox(const struct_measured *measured, const struct_readings *readings)
+{
+    switch (state)
+    {
+    case BLACKBOX_ARMED:
+    case BLACKBOX_HELD:
+        pack(measured, readings, &samples[ring_head]);
+        ring_head = (ring_head + 1) % BLACKBOX_PRE;
+        if (ring_count < BLACKBOX_PRE)
+            ++ring_count;
+        last_sequence = readings->header.sequence;
+        break;
+    case BLACKBOX_CAPTURING:
+        pack(measured, readings, &samples[captured++]);
+        if (captured == header.pre + BLACKBOX_POST)
+        {
+            header.post = BLACKBOX_POST;
+            state = BLACKBOX_WRITING;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void startRecording(uint16_t error, uint32_t now)
+{
+    // unroll the ring in place, oldest first, so the recording is one run of samples
+    static struct_blackbox_sample ordered[BLACKBOX_PRE];
+    uint8_t oldest = (ring_head + BLACKBOX_PRE - ring_count) % BLACKBOX_PRE;
+    for (uint8_t i = 0; i < ring_count; i++)
+        ordered[i] = samples[(oldest + i) % BLACKBOX_PRE];
+    memcpy(samples, ordered, ring_count * sizeof(struct_blackbox_sample));
+
+    header.version = 0;
+    header.trigger = error;
+    header.sequence = last_sequence + 1 - ring_count;
+    header.uptime_ms = now;
+    header.pre = ring_count;
+    header.post = 0;
+    first_sequence = header.sequence;
+    captured = ring_count;
+    written = 0;
+    state = BLACKBOX_CAPTURING;
+    // the old recording is invalid from the first byte of the new one
+    EEPROM.update(BLACKBOX_ADDRESS, 0);
+}
+
+void triggerBlackBox(uint16_t error, uint32_t now)
+{
+    if (now - started < BLACKBOX_STARTUP_MS)
+        return;
+    uint8_t worth = severity(error);
+    if (worth == 0)
+        return;
+    if (state == BLACKBOX_ARMED || (state == BLACKBOX_HELD && worth > severity(header.trigger)))
+        startRecording(error, now);
+}
+
+void forceBlackBox(uint16_t error, uint32_t now)
+{
+    if (state == BLACKBOX_ARMED)
+        startRecording(error, now);
+}
+
+void serviceBlackBox()
+{
+    if (state != BLACKBOX_CAPTURING && state != BLACKBOX_WRITING)
+        return;
+    uint16_t available = captured * sizeof(struct_blackbox_sample);
+    const uint8_t *bytes = (const uint8_t *)samples;
+    for (uint8_t n = 0; n < BLACKBOX_BYTES_PER_PASS && written < available; n++, written++)
+        EEPROM.update(SAMPLES_ADDRESS + written, bytes[written]);
+    if (state == BLACKBOX_WRITING && written == available)
+    {
+        header.version = BLACKBOX_VERSION;
+        EEPROM.put(BLACKBOX_ADDRESS, header);
+        state = BLACKBOX_HELD;
+        // samples[] is free again for the history of a worse trip
+        ring_count = 0;
+        ring_head = 0;
+    }
+}
+
+blackbox_state blackBoxState()
+{
+    return state;
+}
+
+bool dumpBlackBox(Print &out)
+{
+    if (state != BLACKBOX_HELD)
+        return false;
+    out.printf("Black box: error %04X at %lums, %u before, %u after, sequence %lu\n", header.trigger,
+               header.uptime_ms, header.pre, header.post, header.sequence);
+    out.println("cycle,res_t,setpoint,case_t,out_t,rh,filter_pa,res_lvl,top_rpm,bot_rpm,pwm,flags,error");
+    struct_blackbox_sample sample;
+    for (uint8_t i = 0; i < header.pre + header.post; i++)
+    {
+        EEPROM.get(SAMPLES_ADDRESS + i * sizeof(sample), sample);
+        out.printf("%d,%.2f,%.2f,%.2f,%.2f,%u,%d,%u,%u,%u,%u,%02X,%04X\n", i - header.pre,
+                   sample.reservoir_temperature / 100.0, sample.setpoint / 100.0, sample.inside_temperature / 100.0,
+                   sample.outside_temperature / 100.0, sample.humidity, sample.filter_dp, sample.level_sense,
+                   sample.top_tach, sample.bottom_tach, sample.fan_pwm, sample.flags, sample.error);
+    }
+    return true;
+}
+
+void clearBlackBox()
+{
+    if (state == BLACKBOX_HELD)
+        EEPROM.update(BLACKBOX_ADDRESS, 0);
+    ring_count = 0;
+    ring_head = 0;
+    state = BLACKBOX_ARMED;
+}
@@ -0,0 +1,89 @@
+#ifndef __CW5200_BLACKBOX__
+#define __CW5200_BLACKBOX__
+#include <cstdint>
+#include "comms.h"
+#include "measured.h"
+
+class Print;
+
+/*
+ *   Fault-triggered black box
+ *
+ *   Every readings cycle goes into a RAM ring of the last BLACKBOX_PRE
+ *   cycles. A trip freezes that history and keeps recording for
+ *   BLACKBOX_POST more, and the lot is written to the top of the EEPROM
+ *   a few bytes per pass of loop(), so the emulated EEPROM's occasional
+ *   flash erase never holds up a control decision. The header is written
+ *   last, so a reset part way through leaves no recording rather than a
+ *   garbled one.
+ *
+ *   Only trips are recorded, least to most severe: a limit violation, the
+ *   pump on with no flow, and a safety monitor trip. Sensor, peripheral and
+ *   system errors are not, nor is anything raised in the first
+ *   BLACKBOX_STARTUP_MS, while the peripherals come up and the sensors
+ *   settle. The recording is kept across resets until it is cleared over
+ *   USB, so the trip that started a fault is not overwritten by the ones
+ *   that follow it; only a more severe trip replaces it.
+ *
+ *   Samples are packed from struct_measured, integers already, to fit:
+ *   temperatures in centidegrees, tachs in rpm, and one byte of output and
+ *   status flags.
+ */
+
+#define BLACKBOX_VERSION 1
+#define BLACKBOX_ADDRESS 128       // EEPROM offset, after the maintenance counters
+#define BLACKBOX_PRE 60            // cycles before the fault, at LOOP_PERIOD_MS
+#define BLACKBOX_POST 30           // cycles after it
+#define BLACKBOX_BYTES_PER_PASS 4  // EEPROM bytes written per loop() pass
+#define BLACKBOX_STARTUP_MS 15000  // nothing raised this soon after beginBlackBox() is recorded
+
+#define BLACKBOX_VALVE 0x01
+#define BLACKBOX_COMPRESSOR 0x02
+#define BLACKBOX_PUMP 0x04
+#define BLACKBOX_FLOW_OK 0x08
+#define BLACKBOX_ALERT 0x10
+
+struct __attribute__((packed)) struct_blackbox_sample
+{
+    int16_t reservoir_temperature; // centidegrees C
+    int16_t setpoint;
+    int16_t inside_temperature;
+    int16_t outside_temperature;
+    uint8_t humidity;              // %
+    int16_t filter_dp;             // Pa
+    uint16_t level_sense;          // ADC
+    uint16_t top_tach;             // rpm
+    uint16_t bottom_tach;
+    uint8_t fan_pwm;
+    uint8_t flags;                 // BLACKBOX_*
+    uint16_t error;
+};
+
+struct __attribute__((packed)) struct_blackbox_header
+{
+    uint8_t version; // BLACKBOX_VERSION once complete, anything else for none
+    uint16_t trigger;
+    uint32_t sequence;  // readings sequence of the first sample
+    uint32_t uptime_ms; // when the error was raised
+    uint8_t pre;        // samples before the trigger
+    uint8_t post;
+};
+
+enum blackbox_state : uint8_t
+{
+    BLACKBOX_ARMED = 0, // filling the ring
+    BLACKBOX_CAPTURING, // after a fault, until BLACKBOX_POST more cycles
+    BLACKBOX_WRITING,   // all captured, still going to the EEPROM
+    BLACKBOX_HELD,      // a recording is in the EEPROM, and the ring fills again for a worse trip
+};
+
+void beginBlackBox(uint32_t now);
+void recordBlackBox(const struct_measured *measured, const struct_readings *readings); // every readings cycle
+void triggerBlackBox(uint16_t error, uint32_t now);   // ignored unless error is a trip worth recording
+void forceBlackBox(uint16_t error, uint32_t now);     // records from now whatever error is, if nothing is held
+void serviceBlackBox();                               // every pass of loop()
+blackbox_state blackBoxState();
+bool dumpBlackBox(Print &out); // false with nothing recorded
+void clearBlackBox();
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef __CW5200_CHANNELS__
+#define __CW5200_CHANNELS__
+#include <cstdint>
+#include <fixed_point.h>
+
+class running_average;
+
+/*
+ *   Descriptors for the sensors hung off the board. Several entries may share
+ *   a role; their readings are averaged into the one telemetry field.
+ */
+
+enum probe_role : uint8_t
+{
+    PROBE_RESERVOIR = 0,
+    PROBE_OUTSIDE,
+    PROBE_ROLES,
+};
+
+struct temperature_probe
+{
+    const char *name;
+    probe_role role;
+    const uint8_t *rom;  // DS18B20 ROM code, matched on the bus at boot
+    centi_c min_valid;   // readings outside this range are treated as failed reads
+    centi_c max_valid;
+    uint16_t no_address_error;
+    uint16_t no_read_error;
+};
+
+enum analog_role : uint8_t
+{
+    ANALOG_RESERVOIR_LEVEL = 0,
+    ANALOG_RESERVOIR_REF,
+};
+
+struct analog_channel
+{
+    const char *name;
+    analog_role role;
+    uint8_t pin;
+    running_average *average;
+};
+
+#endif
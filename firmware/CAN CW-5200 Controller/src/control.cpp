@@ -0,0 +1,136 @@
+#include "control.h"
+#include "error_codes.h"
+#include "actuators.h"
+
+static const limit_check limits[] = {
+    {RESERVOIR_LEVEL_LOW, "Reservoir level too low", "mL", false, 100,
+     [](const struct_measured *m, const struct_readings *) { return (int32_t)m->level_sense; },
+     [](const struct_settings *s) { return (int32_t)s->reservoir_volume_low_limit * 100; }},
+    {CASE_TEMP_TOO_HIGH, "Case temperature too high", "C", true, 100,
+     [](const struct_measured *m, const struct_readings *) { return (int32_t)m->inside; },
+     [](const struct_settings *s) { return (int32_t)s->case_temperature_high_limit * 100; }},
+    {CASE_TEMP_TOO_LOW, "Case temperature too low", "C", false, 100,
+     [](const struct_measured *m, const struct_readings *) { return (int32_t)m->inside; },
+     [](const struct_settings *s) { return (int32_t)s->case_temperature_low_limit * 100; }},
+    {CASE_HUMIDITY_TOO_HIGH, "Case humidity too high", "%", true, 100,
+     [](const struct_measured *m, const struct_readings *) { return (int32_t)m->humidity; },
+     [](const struct_settings *s) { return (int32_t)s->case_humidity_high_limit * 100; }},
+    {RESERVOIR_TEMP_TOO_HIGH, "Reservoir temperature too high", "C", true, 100,
+     [](const struct_measured *m, const struct_readings *) { return (int32_t)m->reservoir; },
+     [](const struct_settings *s) { return (int32_t)s->reservoir_temp_high_limit * 100; }},
+    {RESERVOIR_TEMP_TOO_LOW, "Reservoir temperature too low", "C", false, 100,
+     [](const struct_measured *m, const struct_readings *) { return (int32_t)m->reservoir; },
+     [](const struct_settings *s) { return (int32_t)s->reservoir_temp_low_limit * 100; }},
+    {CASE_OUTSIDE_TEMP_TOO_HIGH, "Outside temperature too high", "C", true, 100,
+     [](const struct_measured *m, const struct_readings *) { return (int32_t)m->outside; },
+     [](const struct_settings *s) { return (int32_t)s->outside_temp_high_limit * 100; }},
+    {CASE_OUTSIDE_TEMP_TOO_LOW, "Outside temperature too low", "C", false, 100,
+     [](const struct_measured *m, const struct_readings *) { return (int32_t)m->outside; },
+     [](const struct_settings *s) { return (int32_t)s->outside_temp_low_limit * 100; }},
+    {CASE_FILTERS_CLOGGED, "Filter delta-P too high", "", true, 1,
+     [](const struct_measured *m, const struct_readings *) { return (int32_t)m->filter_dp; },
+     [](const struct_settings *s) { return (int32_t)s->filter_high_limit; }},
+    {COMPRESSOR_EXCESSIVE_STARTS, "Compressor starts per hour too high", "/h", true, 1,
+     [](const struct_measured *, const struct_readings *r) { return (int32_t)r->maintenance.starts_per_hour; },
+     [](const struct_settings *s) { return (int32_t)s->compressor_starts_limit; }},
+};
+static_assert(sizeof(limits) / sizeof(limits[0]) == LIMIT_CHECKS, "LIMIT_CHECKS is out of step with the table");
+
+void setHeatLoad(struct_control *control, const struct_heat_load *heat_load, uint32_t now)
+{
+    control->have_load = true;
+    control->load_time = now;
+    control->load_w = heat_load->internal_w;
+    control->load_trend = heat_load->trend_w_per_s;
+}
+
+centi_c predictedRise(const struct_settings *settings, const struct_control *control, uint32_t now)
+{
+    if (!control->have_load || now - control->load_time >= FEEDFORWARD_STALE_MS ||
+        settings->feedforward_horizon == 0 || settings->thermal_mass == 0)
+        return 0;
+    // the load integrated over the horizon, ramping at the current trend; the heat load model is float throughout
+    float horizon = settings->feedforward_horizon;
+    float joules = (control->load_w + control->load_trend * horizon / 2) * horizon;
+    return joules > 0 ? centiFromCelsius(joules / (settings->thermal_mass * 1000.0f)) : 0;
+}
+
+uint16_t runCoolingControl(const struct_measured *measured, struct_readings *readings, const struct_settings *settings,
+                           struct_control *control, uint32_t now)
+{
+    /*
+     *   Cooling Cycle
+     */
+    uint16_t error = 0;
+    if (control->running)
+    {
+        // the lockouts are the actuators' business; this only says when
+        int32_t hysteresis = centiFromCelsius(settings->hysteresis);
+        int32_t predicted = measured->reservoir + predictedRise(settings, control, now);
+        if (predicted > measured->setpoint + hysteresis)
+        {
+            startCooling(now);
+        }
+        // not while the load ahead would only start it again
+        if (measured->reservoir <= measured->setpoint - hysteresis && predicted <= measured->setpoint + hysteresis)
+        {
+            stopCooling(now);
+        }
+    }
+    else
+    {
+        // stopped over the link; wind down through the same lockout
+        stopCooling(now);
+    }
+
+    const struct_actuators *outputs = actuatorState();
+    readings->compressor.valve = outputs->level[ACTUATOR_VALVE];
+    readings->compressor.running = outputs->level[ACTUATOR_COMPRESSOR];
+    readings->chassis.fan.pwm = outputs->level[ACTUATOR_FANS];
+    readings->pump.running = outputs->level[ACTUATOR_PUMP];
+    readings->compressor.compressor_time = now - outputs->changed[ACTUATOR_COMPRESSOR];
+    readings->compressor.valve_time = now - outputs->changed[ACTUATOR_VALVE];
+    if (control->running && readings->pump.running && !readings->pump.flow_ok)
+    {
+        error = RESERVOIR_PUMP_ON_WITH_NO_FLOW;
+    }
+    return error;
+}
+
+const char *controlErrorName(uint16_t error)
+{
+    switch (error)
+    {
+    case RESERVOIR_PUMP_ON_WITH_NO_FLOW:
+        return "Pump on with no flow";
+    default:
+        return "Unknown";
+    }
+}
+
+bool isLimitCode(uint16_t error)
+{
+    for (const limit_check &check : limits)
+    {
+        if (check.code == error)
+            return true;
+    }
+    return false;
+}
+
+uint8_t checkLimits(const struct_measured *measured, const struct_readings *readings, const struct_settings *settings,
+                    const limit_check **violations)
+{
+    uint8_t count = 0;
+    for (const limit_check &check : limits)
+    {
+        int32_t value = check.value(measured, readings);
+        int32_t limit = check.limit(settings);
+        if ((check.high && value > limit) || (!check.high && value < limit))
+        {
+            if (count < LIMIT_VIOLATIONS_MAX)
+                violations[count++] = &check;
+        }
+    }
+    return count;
+}
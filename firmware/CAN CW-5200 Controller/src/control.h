@@ -0,0 +1,60 @@
+#ifndef __CW5200_CONTROL__
+#define __CW5200_CONTROL__
+#include <cstdint>
+#include "comms.h"
+#include "measured.h"
+#include "settings.h"
+
+/*
+ *   Cooling decisions and limit checks, kept free of pin I/O so the same code
+ *   runs on the board and in the native replay build. Sensor values come in
+ *   through struct_measured and are compared in its integer units; the flow
+ *   input comes through struct_readings, the decisions go to the sequences
+ *   in actuators.h, and the outputs as they then stand are copied back into
+ *   the compressor, valve, fan and pump fields.
+ *
+ *   With a fresh heat load from the loop controller, cooling starts on the
+ *   temperature the reservoir will reach feedforward_horizon seconds out if
+ *   it is left uncooled, rather than only on the temperature now: the valve
+ *   and compressor lockouts then run while the load is still on its way
+ *   through the loops, instead of after the reservoir has already warmed.
+ */
+
+#define FAN_PWM_ON 255
+#define FAN_PWM_OFF 0
+#define LIMIT_CHECKS 10                    // entries in the limit table
+#define LIMIT_VIOLATIONS_MAX LIMIT_CHECKS  // every limit can be out at once
+#define FEEDFORWARD_STALE_MS 5000          // heat loads older than this are ignored
+
+struct struct_control
+{
+    bool running = true;
+
+    // feed-forward, from the loop controller's PACKET_HEAT_LOAD
+    bool have_load = false;
+    uint32_t load_time = 0;
+    float load_w = 0.0;
+    float load_trend = 0.0; // W/s
+};
+
+struct limit_check
+{
+    uint16_t code;
+    const char *message;
+    const char *units;
+    bool high;      // true: value above limit trips, false: value below limit trips
+    int32_t scale;  // value and limit per unit: 100 where they are in hundredths
+    int32_t (*value)(const struct_measured *, const struct_readings *);
+    int32_t (*limit)(const struct_settings *);
+};
+
+void setHeatLoad(struct_control *control, const struct_heat_load *heat_load, uint32_t now);
+centi_c predictedRise(const struct_settings *settings, const struct_control *control, uint32_t now);
+uint16_t runCoolingControl(const struct_measured *measured, struct_readings *readings, const struct_settings *settings,
+                           struct_control *control, uint32_t now);
+const char *controlErrorName(uint16_t error); // for the codes runCoolingControl() returns
+uint8_t checkLimits(const struct_measured *measured, const struct_readings *readings, const struct_settings *settings,
+                    const limit_check **violations);
+bool isLimitCode(uint16_t error); // raised by checkLimits()
+
+#endif
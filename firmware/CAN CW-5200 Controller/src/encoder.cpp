@@ -0,0 +1,67 @@
+#include <Arduino.h>
+#include "encoder.h"
+
+/*
+ *   Rotary encoder
+ *
+ *   Both quadrature channels interrupt on every edge and step a 4-bit
+ *   previous/current state through a transition table, so contact bounce
+ *   walks back and forth and cancels out instead of adding counts. The loop
+ *   collects whole detents and a latched switch press.
+ */
+
+static const int8_t transitions[16] = {0, -1, 1, 0, 1, 0, 0, -1, -1, 0, 0, 1, 0, 1, -1, 0};
+
+static uint8_t pin_a;
+static uint8_t pin_b;
+static uint8_t pin_switch;
+static volatile uint8_t state = 0;
+static volatile int16_t steps = 0;
+static volatile bool pressed = false;
+static volatile uint32_t last_press = 0;
+
+static void encoderTurn()
+{
+    state = ((state << 2) | (digitalReadFast(pin_a) << 1) | digitalReadFast(pin_b)) & 0x0F;
+    steps += transitions[state];
+}
+
+static void encoderSwitch()
+{
+    uint32_t now = millis();
+    if (now - last_press >= ENCODER_DEBOUNCE_MS)
+        pressed = true;
+    last_press = now;
+}
+
+void beginEncoder(uint8_t a, uint8_t b, uint8_t sw)
+{
+    pin_a = a;
+    pin_b = b;
+    pin_switch = sw;
+    pinMode(pin_a, INPUT_PULLUP);
+    pinMode(pin_b, INPUT_PULLUP);
+    pinMode(pin_switch, INPUT_PULLUP);
+    state = (digitalRead(pin_a) << 1) | digitalRead(pin_b);
+    attachInterrupt(pin_a, encoderTurn, CHANGE);
+    attachInterrupt(pin_b, encoderTurn, CHANGE);
+    attachInterrupt(pin_switch, encoderSwitch, FALLING);
+}
+
+int8_t readEncoder()
+{
+    noInterrupts();
+    int16_t detents = steps / ENCODER_STEPS_PER_DETENT;
+    steps -= detents * ENCODER_STEPS_PER_DETENT;
+    interrupts();
+    return constrain(detents, (int16_t)-127, (int16_t)127);
+}
+
+bool encoderPressed()
+{
+    noInterrupts();
+    bool was_pressed = pressed;
+    pressed = false;
+    interrupts();
+    return was_pressed;
+}
@@ -0,0 +1,12 @@
+#ifndef __CW5200_ENCODER__
+#define __CW5200_ENCODER__
+#include <cstdint>
+
+#define ENCODER_STEPS_PER_DETENT 4 // quadrature transitions per click
+#define ENCODER_DEBOUNCE_MS 30     // switch presses closer than this are bounce
+
+void beginEncoder(uint8_t pin_a, uint8_t pin_b, uint8_t pin_switch);
+int8_t readEncoder();
+bool encoderPressed();
+
+#endif
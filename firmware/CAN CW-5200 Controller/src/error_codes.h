@@ -20,5 +20,20 @@
 #define CASE_TOP_FAN_LOW_RPM 0x020A            // Top Fan Low RPM!
 #define CASE_BOTTOM_FAN_LOW_RPM 0x020B         // Bottom Fan Low RPM!
 #define CASE_FILTERS_CLOGGED 0x020C            // Filters Clogged!
+#define CASE_FILTER_SENSOR_NO_CONNECT 0x020D   // Filter Pressure Sensor No Connect!
+#define CASE_FILTER_SENSOR_FAULT 0x020E        // Filter Pressure Sensor Fault!
+#define COMPRESSOR_EXCESSIVE_STARTS 0x0301     // Compressor Starts Per Hour Too High!
+#define SENSOR_STUCK 0x0410                    // Sensor Stuck! (+ channel)
+#define SENSOR_RATE_OF_CHANGE 0x0420           // Sensor Changing Too Fast! (+ channel)
+#define SENSOR_OUTLIER 0x0430                  // Sensor Outlier! (+ channel)
+#define SENSOR_RESERVOIR_MISMATCH 0x0440       // Reservoir Colder Than Outside With No Cooling!
+#define SENSOR_FAN_PWM_RPM_MISMATCH 0x0450     // Fan RPM Does Not Match PWM! (+ fan)
+#define SYSTEM_WATCHDOG_RESET 0x0501           // Reset By Watchdog!
+#define SYSTEM_HEAP_ALLOCATION 0x0502          // Heap Allocation After Setup!
+#define SAFETY_NO_FLOW 0x0601                  // Safety Trip: No Flow With Pump On!
+#define SAFETY_UNDER_TEMP 0x0602               // Safety Trip: Reservoir Below Low Limit!
+#define SAFETY_OVER_TEMP 0x0603                // Safety Trip: Reservoir Above High Limit!
+#define SAFETY_STALE_TEMPERATURE 0x0604        // Safety Trip: No Reservoir Temperature From The Loop!
+#define SAFETY_COMPRESSOR_LOCKOUT 0x0605       // Safety Trip: Compressor Restarted Inside Its Lockout!
 
 #endif
\ No newline at end of file
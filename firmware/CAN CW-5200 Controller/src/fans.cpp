@@ -1,9 +1,75 @@
 #include <Arduino.h>
 #include "fans.h"
 
-float convertMicrosToRPM(float micros)
+/*
+ *   Fan tachometers
+ *
+ *   Each fan slot has its own ISR, stamped out from one template, which adds
+ *   the pulse interval to a running sum. Reading a fan takes the mean interval
+ *   since the last read and starts a new window, so the cost per loop is one
+ *   short critical section per fan regardless of how fast it spins, and two
+ *   integer divides for the speed.
+ */
+
+static volatile struct_fan fan_state[FANS_MAX];
+static uint8_t fan_count = 0;
+
+template <uint8_t N>
+static void fanPulse()
+{
+    uint32_t now = micros();
+    volatile struct_fan &fan = fan_state[N];
+    ++fan.edges;
+    if (fan.last_pulse != 0 && now - fan.last_pulse < FAN_STALL_US)
+    {
+        fan.pulse_sum += now - fan.last_pulse;
+        ++fan.pulses;
+    }
+    fan.last_pulse = now;
+}
+
+static void (*const fan_isrs[FANS_MAX])() = {fanPulse<0>, fanPulse<1>, fanPulse<2>, fanPulse<3>};
+
+void beginFans(const fan_channel *fans, uint8_t count)
+{
+    fan_count = min(count, (uint8_t)FANS_MAX);
+    clearFans();
+    for (uint8_t i = 0; i < fan_count; i++)
+    {
+        pinMode(fans[i].tach_pin, INPUT);
+        attachInterrupt(fans[i].tach_pin, fan_isrs[i], FALLING);
+    }
+}
+
+void clearFans()
+{
+    noInterrupts();
+    for (uint8_t i = 0; i < FANS_MAX; i++)
+    {
+        fan_state[i].pulses = 0;
+        fan_state[i].pulse_sum = 0;
+        fan_state[i].last_pulse = 0;
+    }
+    interrupts();
+}
+
+deci_rpm readFanRPM(uint8_t fan, uint8_t pulses_per_rev)
 {
-    return HZ_TO_RPM * 1000000.0 / micros;
+    noInterrupts();
+    uint32_t pulses = fan_state[fan].pulses;
+    uint32_t pulse_sum = fan_state[fan].pulse_sum;
+    fan_state[fan].pulses = 0;
+    fan_state[fan].pulse_sum = 0;
+    interrupts();
+    if (pulses == 0)
+        return 0;
+    return deciRPMFromPeriod((pulse_sum + pulses / 2) / pulses, pulses_per_rev);
+}
+
+uint32_t fanEdges(uint8_t fan)
+{
+    // a single aligned word, so no critical section
+    return fan_state[fan].edges;
 }
 
 uint8_t turnOnFans(uint8_t pin, uint8_t pwm)
@@ -16,4 +82,4 @@ uint8_t turnOffFans(uint8_t pin, uint8_t pwm)
 {
     analogWrite(pin, pwm);
     return pwm;
-}
\ No newline at end of file
+}
@@ -1,18 +1,38 @@
 #ifndef __CW5200_FANS__
 #define __CW5200_FANS__
 #include <cstdint>
+#include <fixed_point.h>
 
-const float HZ_TO_RPM = 30.0;
+#define FANS_MAX 4              // one tach ISR is instantiated per slot
+#define FAN_STALL_US 1000000UL  // a gap longer than this is a restart, not a pulse
+
+enum fan_role : uint8_t
+{
+    FAN_TOP = 0,
+    FAN_BOTTOM,
+};
+
+struct fan_channel
+{
+    const char *name;
+    fan_role role;
+    uint8_t tach_pin;
+    uint8_t pulses_per_rev;
+    uint16_t low_rpm_error;
+};
 
 struct struct_fan
 {
-    bool ready = false;
-    uint32_t pulse_len = 0;
+    uint32_t pulses = 0;
+    uint32_t pulse_sum = 0;
     uint32_t last_pulse = 0;
-    uint32_t current_pulse = 0;
+    uint32_t edges = 0; // every edge since reset, for the scope; never cleared
 };
 
-float convertMicrosToRPM(float);
+void beginFans(const fan_channel *fans, uint8_t count);
+void clearFans();
+deci_rpm readFanRPM(uint8_t fan, uint8_t pulses_per_rev);
+uint32_t fanEdges(uint8_t fan);
 uint8_t turnOnFans(uint8_t pin, uint8_t pwm = 255);
 uint8_t turnOffFans(uint8_t pin, uint8_t pwm = 0);
-#endif
\ No newline at end of file
+#endif
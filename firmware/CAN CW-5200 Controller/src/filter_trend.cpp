@@ -0,0 +1,132 @@
+#include <Arduino.h>
+#include "filter_trend.h"
+
+/*
+ *   Filter clog trend
+ *
+ *   Readings taken while the fans run at FILTER_TREND_MIN_PWM or more are
+ *   normalised to full fan speed and averaged into buckets of an hour of fan
+ *   runtime, kept in a ring. Below that the scale-up would be more than 4x,
+ *   and the sensor's noise with it, so those readings are skipped; the fans
+ *   still count towards the bucket's runtime. A least-squares line is kept
+ *   over the ring through running sums indexed by bucket age (0 == newest),
+ *   so adding a bucket and dropping the oldest are both O(1):
+ *
+ *     y = a + b * age,  b = (n*Sky - Sk*Sy) / (n*Skk - Sk^2),  a = (Sy - b*Sk) / n
+ *
+ *   Sk and Skk only depend on n. Ageing every bucket by one adds Sy to Sky.
+ *   The hours left are hours of fan runtime, like the buckets.
+ */
+
+static uint16_t history[FILTER_TREND_BUCKETS];
+static uint16_t oldest = 0;
+static uint16_t count = 0;
+static int64_t sum_y = 0;
+static int64_t sum_ky = 0;
+
+static uint32_t bucket_sum = 0;
+static uint16_t bucket_samples = 0;
+static uint32_t bucket_runtime = 0;
+static uint32_t last_update = 0;
+
+static float slope = 0.0;
+static uint16_t hours_left = FILTER_TREND_UNKNOWN;
+
+static void pushBucket(uint16_t y)
+{
+    if (count == FILTER_TREND_BUCKETS)
+    {
+        uint16_t old = history[oldest];
+        sum_y -= old;
+        sum_ky -= (int64_t)(count - 1) * old;
+        oldest = (oldest + 1) % FILTER_TREND_BUCKETS;
+        --count;
+    }
+    sum_ky += sum_y;
+    sum_y += y;
+    history[(oldest + count) % FILTER_TREND_BUCKETS] = y;
+    ++count;
+}
+
+static void fitTrend(int16_t zero, int16_t limit)
+{
+    hours_left = FILTER_TREND_UNKNOWN;
+    slope = 0.0;
+    if (count < FILTER_TREND_MIN_BUCKETS)
+        return;
+
+    float n = count;
+    float sum_k = n * (n - 1) / 2;
+    float sum_kk = (n - 1) * n * (2 * n - 1) / 6;
+    float b = (n * (float)sum_ky - sum_k * (float)sum_y) / (n * sum_kk - sum_k * sum_k);
+    float a = ((float)sum_y - b * sum_k) / n;
+
+    // b is per hour of age, so the rise per hour of runtime is -b
+    slope = -b;
+    float headroom = (float)(limit - zero) - a;
+    if (slope <= 0.0 || headroom <= 0.0)
+    {
+        if (headroom <= 0.0)
+            hours_left = 0;
+        return;
+    }
+    float hours = headroom / slope;
+    hours_left = hours < FILTER_TREND_UNKNOWN ? (uint16_t)hours : FILTER_TREND_UNKNOWN - 1;
+}
+
+void clearFilterTrend()
+{
+    oldest = 0;
+    count = 0;
+    sum_y = 0;
+    sum_ky = 0;
+    bucket_sum = 0;
+    bucket_samples = 0;
+    bucket_runtime = 0;
+    last_update = millis();
+    slope = 0.0;
+    hours_left = FILTER_TREND_UNKNOWN;
+}
+
+void updateFilterTrend(int16_t filter_dp, uint8_t pwm, int16_t zero, int16_t limit)
+{
+    uint32_t now = millis();
+    uint32_t elapsed = now - last_update;
+    last_update = now;
+    if (pwm == 0)
+        return; // no airflow, no information; the bucket clock only runs with the fans
+    bucket_runtime += elapsed;
+
+    if (pwm >= FILTER_TREND_MIN_PWM)
+    {
+        // pressure drop goes with the square of airflow, and airflow with PWM
+        uint32_t dp = filter_dp > zero ? filter_dp - zero : 0;
+        dp = dp * 255 * 255 / ((uint32_t)pwm * pwm);
+        bucket_sum += dp;
+        ++bucket_samples;
+    }
+
+    if (bucket_runtime >= FILTER_TREND_BUCKET_MS)
+    {
+        // an hour spent entirely at low speed leaves no bucket
+        if (bucket_samples > 0)
+        {
+            uint32_t mean = bucket_sum / bucket_samples;
+            pushBucket(mean > 0xFFFF ? 0xFFFF : mean);
+            fitTrend(zero, limit);
+        }
+        bucket_sum = 0;
+        bucket_samples = 0;
+        bucket_runtime = 0;
+    }
+}
+
+uint16_t getFilterHoursLeft()
+{
+    return hours_left;
+}
+
+float getFilterSlope()
+{
+    return slope;
+}
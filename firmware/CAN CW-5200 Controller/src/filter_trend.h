@@ -0,0 +1,16 @@
+#ifndef __CW5200_FILTER_TREND__
+#define __CW5200_FILTER_TREND__
+#include <cstdint>
+
+#define FILTER_TREND_BUCKET_MS (60UL * 60 * 1000) // one history bucket per hour of fan runtime
+#define FILTER_TREND_BUCKETS 240                  // ten days of buckets, two bytes each
+#define FILTER_TREND_MIN_BUCKETS 6                // buckets needed before the slope is trusted
+#define FILTER_TREND_MIN_PWM 128                  // slower fans are too little dP to scale up
+#define FILTER_TREND_UNKNOWN 0xFFFF               // not clogging, or not enough history
+
+void clearFilterTrend();
+void updateFilterTrend(int16_t filter_dp, uint8_t pwm, int16_t zero, int16_t limit);
+uint16_t getFilterHoursLeft(); // hours of fan runtime, not of the clock
+float getFilterSlope();
+
+#endif
@@ -0,0 +1,111 @@
+#include <fixed_point.h>
+#include "history.h"
+
+struct history_open
+{
+    int16_t min;
+    int16_t max;
+    int32_t sum; // 720 samples of any int16_t at most
+    uint16_t count;
+};
+
+// buckets of the tier below that close one of this tier's
+static const uint8_t fan_in[HISTORY_TIERS] = {1, 30, 24};
+
+static history_bucket buckets[HISTORY_CHANNELS][HISTORY_TIERS][HISTORY_BUCKETS];
+static history_open pending[HISTORY_CHANNELS][HISTORY_TIERS];
+static uint8_t head[HISTORY_TIERS];   // next bucket written
+static uint8_t length[HISTORY_TIERS]; // closed buckets held
+static uint8_t filled[HISTORY_TIERS]; // closed below since this tier's bucket opened
+
+static_assert(sizeof(buckets) + sizeof(pending) <= HISTORY_BUDGET_BYTES, "history is over its RAM budget");
+
+static void reset(history_open *bucket)
+{
+    bucket->min = INT16_MAX;
+    bucket->max = INT16_MIN;
+    bucket->sum = 0;
+    bucket->count = 0;
+}
+
+static void closeBucket(uint8_t tier)
+{
+    for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+    {
+        history_open *from = &pending[c][tier];
+        history_bucket *to = &buckets[c][tier][head[tier]];
+        to->min = from->min;
+        to->max = from->max;
+        to->avg = from->count ? divideRounded(from->sum, from->count) : 0;
+        if (tier + 1 < HISTORY_TIERS && from->count)
+        {
+            history_open *up = &pending[c][tier + 1];
+            if (from->min < up->min)
+                up->min = from->min;
+            if (from->max > up->max)
+                up->max = from->max;
+            up->sum += from->sum;
+            up->count += from->count;
+        }
+        reset(from);
+    }
+    head[tier] = (head[tier] + 1) % HISTORY_BUCKETS;
+    if (length[tier] < HISTORY_BUCKETS)
+        ++length[tier];
+}
+
+void clearHistory()
+{
+    for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+        for (uint8_t t = 0; t < HISTORY_TIERS; t++)
+            reset(&pending[c][t]);
+    for (uint8_t t = 0; t < HISTORY_TIERS; t++)
+    {
+        head[t] = 0;
+        length[t] = 0;
+        filled[t] = 0;
+    }
+}
+
+void recordHistory(const int16_t sample[HISTORY_CHANNELS])
+{
+    for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+    {
+        if (sample[c] == HISTORY_NO_SAMPLE)
+            continue;
+        history_open *bucket = &pending[c][0];
+        if (sample[c] < bucket->min)
+            bucket->min = sample[c];
+        if (sample[c] > bucket->max)
+            bucket->max = sample[c];
+        bucket->sum += sample[c];
+        ++bucket->count;
+    }
+    // tier 0 closes every cycle, each tier above once enough of the one below have
+    for (uint8_t t = 0; t < HISTORY_TIERS && ++filled[t] >= fan_in[t]; t++)
+    {
+        filled[t] = 0;
+        closeBucket(t);
+    }
+}
+
+uint32_t historyBucketCycles(uint8_t tier)
+{
+    uint32_t cycles = 1;
+    for (uint8_t t = 0; t <= tier && t < HISTORY_TIERS; t++)
+        cycles *= fan_in[t];
+    return cycles;
+}
+
+uint8_t historyLength(uint8_t tier)
+{
+    return tier < HISTORY_TIERS ? length[tier] : 0;
+}
+
+bool getHistoryBucket(history_channel channel, uint8_t tier, uint8_t age, history_bucket *bucket)
+{
+    if (channel >= HISTORY_CHANNELS || tier >= HISTORY_TIERS || age >= length[tier])
+        return false;
+    *bucket = buckets[channel][tier][(head[tier] + HISTORY_BUCKETS - 1 - age) % HISTORY_BUCKETS];
+    return bucket->min <= bucket->max;
+}
@@ -0,0 +1,56 @@
+#ifndef __CW5200_HISTORY__
+#define __CW5200_HISTORY__
+#include <cstdint>
+
+/*
+ *   Trend history of the key channels
+ *
+ *   Min/avg/max buckets at three resolutions, held in RAM:
+ *
+ *     tier 0   1 cycle buckets      2 min
+ *     tier 1   30 cycle buckets     1 h
+ *     tier 2   720 cycle buckets    1 day
+ *
+ *   with a cycle the 1 s loop period, and HISTORY_BUCKETS to a tier, one per
+ *   column of a sparkline on the display. recordHistory() takes a sample of
+ *   each channel once a cycle, in the channel's integer units, into tier 0's
+ *   open bucket. A bucket that closes rolls its min, max and sum up into the
+ *   open bucket of the tier above, so a call is a few fixed steps whatever
+ *   the tier lengths, and an average is always of the samples, not of the
+ *   averages below. A cycle with HISTORY_NO_SAMPLE still counts; a bucket
+ *   that saw no samples at all is empty, its min above its max.
+ *
+ *   Pin-free, like the control, so it builds native too.
+ */
+
+#define HISTORY_TIERS 3
+#define HISTORY_BUCKETS 120         // sparkline columns
+#define HISTORY_BUDGET_BYTES 7168   // every channel and tier, open buckets included
+#define HISTORY_NO_SAMPLE INT16_MIN // a cycle the channel had no reading
+
+enum history_channel : uint8_t
+{
+    HISTORY_RESERVOIR, // centi_c
+    HISTORY_OUTSIDE,   // centi_c
+    HISTORY_FILTER_DP, // Pa
+    HISTORY_CHANNELS
+};
+
+struct history_bucket
+{
+    int16_t min;
+    int16_t avg;
+    int16_t max;
+};
+
+// from setup() before the first sample, and to start over
+void clearHistory();
+// once a cycle, a sample of each channel
+void recordHistory(const int16_t sample[HISTORY_CHANNELS]);
+
+uint32_t historyBucketCycles(uint8_t tier);
+uint8_t historyLength(uint8_t tier); // closed buckets held, the same for every channel
+// age 0 is the newest closed bucket; false past the length or for an empty bucket
+bool getHistoryBucket(history_channel channel, uint8_t tier, uint8_t age, history_bucket *bucket);
+
+#endif
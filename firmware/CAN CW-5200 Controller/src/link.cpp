@@ -0,0 +1,112 @@
+#include <SerialTransfer.h>
+#include <device_clock.h>
+#include "link.h"
+
+static SerialTransfer telemetry;
+static uint16_t txSize = 0;
+static void (*apply_setpoint)(float) = nullptr;
+
+static struct_command command;
+static struct_ack ack = {.session = 0, .sequence = 0, .id = COMMAND_NONE, .status = ACK_UNKNOWN_COMMAND};
+static struct_remote_settings remote_settings;
+static struct_clock_exchange exchange;
+static struct_heat_load heat_load;
+static bool have_command = false;
+
+static void applyCommand(struct_control *control, const struct_settings *settings, const struct_readings *readings)
+{
+    ack.session = command.session;
+    ack.sequence = command.sequence;
+    ack.id = command.id;
+    ack.status = ACK_OK;
+    switch (command.id)
+    {
+    case COMMAND_SET_SETPOINT:
+        // a NaN fails both comparisons, so it has to be turned away by itself
+        if (!isfinite(command.value) || command.value < settings->reservoir_temp_low_limit ||
+            command.value > settings->reservoir_temp_high_limit)
+        {
+            ack.status = ACK_OUT_OF_RANGE;
+            break;
+        }
+        apply_setpoint(command.value);
+        SerialUSB.printf("Link: setpoint %.1fC\n", readings->reservoir.setpoint);
+        break;
+    case COMMAND_RUN:
+        control->running = true;
+        SerialUSB.println("Link: RUN");
+        break;
+    case COMMAND_STOP:
+        control->running = false;
+        SerialUSB.println("Link: STOP");
+        break;
+    case COMMAND_READ_SETTINGS:
+        break;
+    default:
+        ack.status = ACK_UNKNOWN_COMMAND;
+        break;
+    }
+}
+
+void beginLink(Stream &port, void (*set_setpoint)(float celsius))
+{
+    apply_setpoint = set_setpoint;
+    telemetry.begin(port);
+}
+
+void serviceLink(struct_control *control, const struct_settings *settings, const struct_readings *readings)
+{
+    while (telemetry.available())
+    {
+        if (telemetry.currentPacketID() == PACKET_PING)
+        {
+            // t2 is when this loop got to the ping, not when it arrived; the
+            // pinging side filters that out by keeping the quickest exchanges
+            telemetry.rxObj(exchange);
+            exchange.t2 = micros64();
+            exchange.t3 = micros64();
+            txSize = telemetry.txObj(exchange, 0);
+            telemetry.sendData(txSize, PACKET_PONG);
+            continue;
+        }
+        if (telemetry.currentPacketID() == PACKET_HEAT_LOAD)
+        {
+            telemetry.rxObj(heat_load);
+            setHeatLoad(control, &heat_load, millis());
+            continue;
+        }
+        if (telemetry.currentPacketID() != PACKET_COMMAND)
+            continue;
+        telemetry.rxObj(command);
+
+        // a repeated sequence number means our ack was lost; answer it again.
+        // A new session is the loop controller back from a reset, counting from 0
+        if (!have_command || command.session != ack.session || command.sequence != ack.sequence)
+        {
+            have_command = true;
+            applyCommand(control, settings, readings);
+        }
+
+        txSize = telemetry.txObj(ack, 0);
+        telemetry.sendData(txSize, PACKET_ACK);
+
+        if (ack.id == COMMAND_READ_SETTINGS)
+        {
+            remote_settings.running = control->running;
+            remote_settings.setpoint = readings->reservoir.setpoint;
+            remote_settings.hysteresis = settings->hysteresis;
+            remote_settings.reservoir_temp_high_limit = settings->reservoir_temp_high_limit;
+            remote_settings.reservoir_temp_low_limit = settings->reservoir_temp_low_limit;
+            remote_settings.valve_lockout = settings->valve_lockout;
+            remote_settings.compressor_lockout = settings->compressor_lockout;
+            txSize = telemetry.txObj(remote_settings, 0);
+            telemetry.sendData(txSize, PACKET_SETTINGS);
+        }
+    }
+}
+
+void sendReadings(const struct_readings *readings)
+{
+    txSize = telemetry.txObj(*readings, 0);
+    telemetry.sendData(txSize, PACKET_READINGS);
+}
@@ -0,0 +1,22 @@
+#ifndef __CW5200_LINK__
+#define __CW5200_LINK__
+#include <Arduino.h>
+#include "comms.h"
+#include "control.h"
+#include "settings.h"
+
+/*
+ *   Telemetry link to the loop controller
+ *
+ *   Readings go out once a cycle. In between come commands, clock pings and
+ *   heat loads. A command is applied once per session and sequence and acked
+ *   every time it arrives, so a retransmit whose ack was lost is answered
+ *   again without being applied twice. A setpoint goes through the caller's
+ *   set_setpoint, as one from the menu does.
+ */
+
+void beginLink(Stream &port, void (*set_setpoint)(float celsius));
+void serviceLink(struct_control *control, const struct_settings *settings, const struct_readings *readings); // every pass of loop()
+void sendReadings(const struct_readings *readings);
+
+#endif
@@ -3,256 +3,431 @@
 #include <Adafruit_BME280.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
-#include <RunningAverage.h>
 #include <OneWire.h>
 #include <DallasTemperature.h>
-#include <SerialTransfer.h>
+#include <boot.h>
+#include <device_clock.h>
+#include <board.h>
+#include <abp2.h>
+#include <gauge.h>
+#include <static_alloc.h>
+#include <i2c_queue.h>
+#include <queued_bme280.h>
+#include <queued_display.h>
 
 #include "error_codes.h"
 #include "settings.h"
 #include "comms.h"
+#include "measured.h"
 #include "fans.h"
-
-#define SER_RX 0          // Serial Rx
-#define SER_TX 1          // Serial Tx
-#define ONE_WIRE 2        // DS18B20 bus
-#define VALVE_RLY 8       // OUTPUT valve
-#define COMPRESSOR_RLY 9  // OUTPUT compressor
-#define FAN_PWM 10        // OUTPUT fan PWM signal
-#define BOTTOM_FAN_RPM 11 // INPUT Bottom fan tach
-#define TOP_FAN_RPM 12    // INPUT Top fan tach
-#define ALARMS_RLY 13     // OUTPUT alarms
-#define PUMP_RLY 14       // OUTPUT pump
-#define FLOW_SW 15        // INPUT PULLUP flow switch; low == OK
-#define I2C_SDA 17        // Local I2C data
-#define I2C_SCL 16        // Local I2C clock
-#define ENCODER_SWITCH 18 // Encoder push switch
-#define ENCODER_A 20      // Encoder quad channel A
-#define ENCODER_B 19      // Encoder quad channel B
-#define FILTER_P A7       // Analog input for differential pressure sensor
-#define RES_LEVEL A9      // Analog input for eTape Rsense
-#define RES_REF A8        // Analog input for eTape Rref
+#include "channels.h"
+#include "maintenance.h"
+#include "blackbox.h"
+#include "filter_trend.h"
+#include "anomaly.h"
+#include "control.h"
+#include "actuators.h"
+#include "encoder.h"
+#include "menu.h"
+#include "scope.h"
+#include "safety.h"
+#include "history.h"
+#include "link.h"
+
+typedef cw5200_board board;
 
 struct_readings readings;
+struct_measured measured; // the cycle's inputs as integers; readings is filled from it for the telemetry
+
+static_average<100> filterRA; // cPa
+static_average<100> resLvlRA;
+static_average<100> resRefRA;
+
+constexpr analog_channel analogs[] = {
+    {"Res Lvl", ANALOG_RESERVOIR_LEVEL, board::res_level, &resLvlRA},
+    {"Res Ref", ANALOG_RESERVOIR_REF, board::res_ref, &resRefRA},
+};
+
+// BME280, ABP2 and the display share Wire, through the queue
+#define LOCAL_BUS_HZ 400000
+i2c_bus local_bus(Wire, 0, board::i2c_sda, board::i2c_scl);
 
-RunningAverage filterRA(100);
+#define FILTER_SAMPLE_MS 100 // filterRA then spans 10 s
+abp2_sensor<board::filter_sensor> filter_sensor(local_bus);
+bool filter_sensor_faulted = false;
+bool bme_sampled = false; // a queued read has completed since the BME280 came up
 
 #define FAN_SAMPLING_TIME 1000
-volatile struct_fan top_fan;
-volatile struct_fan bottom_fan;
-RunningAverage topRA(10);
-RunningAverage bottomRA(10);
-
-#define BME_ADDRESS 0x76
-Adafruit_BME280 bme; // use I2C interface
-Adafruit_Sensor *bme_temp = bme.getTemperatureSensor();
-Adafruit_Sensor *bme_humidity = bme.getHumiditySensor();
-
-#define SCREEN_WIDTH 128 // OLED display width, in pixels
-#define SCREEN_HEIGHT 64 // OLED display height, in pixels
-#define FONT_X 5
-#define FONT_Y 8
-#define GAUGE_RADIUS 28
-#define PAGE_DELAY 5000
-#define OLED_RESET -1       // Reset pin # (or -1 if sharing Arduino reset pin)
-#define SCREEN_ADDRESS 0x3C ///< See datasheet for Address; 0x3D for 128x64, 0x3C for 128x32
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
-
-RunningAverage resLvlRA(100);
-RunningAverage resRefRA(100);
-
-#define TEMPERATURE_PRECISION 9
-OneWire oneWire(ONE_WIRE);
-DallasTemperature sensors(&oneWire);
-DeviceAddress outside_temp = {0x28, 0x4E, 0x6A, 0x45, 0x92, 0x17, 0x02, 0xEC};
-DeviceAddress reservoir_temp = {0x28, 0xFF, 0x02, 0x5D, 0xC1, 0x17, 0x05, 0xCB};
+constexpr fan_channel fans[] = {
+    {"Top", FAN_TOP, board::top_fan_rpm, 2, CASE_TOP_FAN_LOW_RPM},
+    {"Bottom", FAN_BOTTOM, board::bottom_fan_rpm, 2, CASE_BOTTOM_FAN_LOW_RPM},
+};
+#define FAN_COUNT (sizeof(fans) / sizeof(fans[0]))
+static_assert(FAN_COUNT <= FANS_MAX, "more fans than tach ISRs");
+uint32_t fan_time = 0;
+
+queued_bme280 bme(local_bus);
 
-uint32_t last_compressor = 0;
-uint32_t last_valve = 0;
+queued_ssd1306<board::screen::width, board::screen::height> display(local_bus, &Wire, board::screen::reset);
 
-bool running_state = true;
+OneWire oneWire(board::one_wire);
+DallasTemperature sensors(&oneWire);
+constexpr temperature_probe probes[] = {
+    {"reservoir", PROBE_RESERVOIR, cw5200_reservoir_probe, 0, 6000, RESERVOIR_NO_DS18B20_ADDRESS, RESERVOIR_NO_DS18B20_READ},
+    {"outside", PROBE_OUTSIDE, cw5200_outside_probe, -4000, 7000, CASE_NO_OUTSIDE_DS18B20_ADDRESS, CASE_NO_OUTSIDE_DS18B20_READ},
+};
+#define PROBE_COUNT (sizeof(probes) / sizeof(probes[0]))
+bool probe_found[PROBE_COUNT];
+
+constexpr scope_channel scope_channels[] = {
+    {"Res Lvl", SCOPE_ANALOG, board::res_level},
+    {"Res Ref", SCOPE_ANALOG, board::res_ref},
+    {"Top tach", SCOPE_EDGES, FAN_TOP},
+    {"Bot tach", SCOPE_EDGES, FAN_BOTTOM},
+    {"Valve", SCOPE_DIGITAL, board::valve_rly},
+    {"Compressor", SCOPE_DIGITAL, board::compressor_rly},
+    {"Pump", SCOPE_DIGITAL, board::pump_rly},
+    {"Alarms", SCOPE_DIGITAL, board::alarms_rly},
+    {"Flow", SCOPE_DIGITAL, board::flow_sw},
+};
+#define SCOPE_CHANNEL_COUNT (sizeof(scope_channels) / sizeof(scope_channels[0]))
+static_assert(SCOPE_CHANNEL_COUNT <= SCOPE_CHANNELS_MAX, "more scope channels than mask bits");
+
+bool startDisplay();
+bool discoverProbes();
+enum
+{
+    PERIPHERAL_BME = 0,
+    PERIPHERAL_DISPLAY,
+    PERIPHERAL_PROBES,
+    PERIPHERAL_FILTER,
+};
+peripheral peripherals[] = {
+    {"BME280", CASE_BME280_NO_CONNECT, [] { heap_window allow; return bme.begin(board::bme_address, &Wire); }},
+    {"display", CASE_DISPLAY_NO_CONNECT, startDisplay},
+    {"DS18B20", 0, [] { sensors.begin(); return discoverProbes(); }},
+    {"ABP2", CASE_FILTER_SENSOR_NO_CONNECT, [] { return filter_sensor.begin(FILTER_SAMPLE_MS); }},
+};
+
+struct_control control;
+timer_wheel actuator_wheel;
+IntervalTimer safety_timer;
+
+#define LOOP_PERIOD_MS CHILLER_PERIOD_MS
+uint32_t loop_time = 0;
+uint32_t first_decision_time = 0;
 uint32_t reading_time = 0;
 uint8_t reading_state = 0;
+bool menu_active = false;
 
 struct_settings *settings;
 
-SerialTransfer telemetry;
-uint16_t txSize = 0;
+void acknowledgeAlarm();
+void setSetpoint(float);
+
+#define DEG_C "\xF8" \
+              "C"
+const menu_item menu[] = {
+    {"Res T", MENU_VIEW, DEG_C, 1, 0, 0, 0, [] { return readings.reservoir.temperature; }, nullptr},
+    {"Setpoint", MENU_EDIT, DEG_C, 1, 5, 30, 0.5, [] { return readings.reservoir.setpoint; }, [](float v) { setSetpoint(constrain(v, (float)settings->reservoir_temp_low_limit, (float)settings->reservoir_temp_high_limit)); }},
+    {"Cooling on", MENU_ACTION, "", 0, 0, 0, 0, [] { return (float)control.running; }, [](float) { control.running = !control.running; }},
+    {"Alarm", MENU_ACTION, "", MENU_HEX, 0, 0, 0, [] { return (float)readings.error.code; }, [](float) { acknowledgeAlarm(); }},
+    {"Out T", MENU_VIEW, DEG_C, 1, 0, 0, 0, [] { return readings.chassis.outside_temperature; }, nullptr},
+    {"Case T", MENU_VIEW, DEG_C, 1, 0, 0, 0, [] { return readings.chassis.inside_temperature; }, nullptr},
+    {"Case RH", MENU_VIEW, "%", 0, 0, 0, 0, [] { return readings.chassis.humidity; }, nullptr},
+    {"Top fan", MENU_VIEW, "rpm", 0, 0, 0, 0, [] { return readings.chassis.fan.top_tach; }, nullptr},
+    {"Bot fan", MENU_VIEW, "rpm", 0, 0, 0, 0, [] { return readings.chassis.fan.bottom_tach; }, nullptr},
+    {"Filter dP", MENU_VIEW, "Pa", 0, 0, 0, 0, [] { return (float)readings.chassis.filter_dp; }, nullptr},
+    {"Filter left", MENU_VIEW, "fan h", 0, 0, 0, 0, [] { return getFilterHoursLeft() == FILTER_TREND_UNKNOWN ? NAN : (float)getFilterHoursLeft(); }, nullptr},
+    {"Heat load", MENU_VIEW, "W", 0, 0, 0, 0, [] { return control.have_load ? control.load_w : 0.0f; }, nullptr},
+    {"Res level", MENU_VIEW, "", 0, 0, 0, 0, [] { return readings.reservoir.level_sense; }, nullptr},
+    {"Hysteresis", MENU_EDIT, DEG_C, 1, 0.5, 5, 0.1, [] { return settings->hysteresis; }, [](float v) { settings->hysteresis = v; saveSettings(settings); }},
+    {"Res T high", MENU_EDIT, DEG_C, 0, 0, 50, 1, [] { return (float)settings->reservoir_temp_high_limit; }, [](float v) { settings->reservoir_temp_high_limit = v; saveSettings(settings); }},
+    {"Res T low", MENU_EDIT, DEG_C, 0, 0, 50, 1, [] { return (float)settings->reservoir_temp_low_limit; }, [](float v) { settings->reservoir_temp_low_limit = v; saveSettings(settings); }},
+    {"Res lvl low", MENU_EDIT, "", 0, 0, 1020, 10, [] { return (float)settings->reservoir_volume_low_limit; }, [](float v) { settings->reservoir_volume_low_limit = v; saveSettings(settings); }},
+    {"Case T high", MENU_EDIT, DEG_C, 0, 0, 100, 1, [] { return (float)settings->case_temperature_high_limit; }, [](float v) { settings->case_temperature_high_limit = v; saveSettings(settings); }},
+    {"Case T low", MENU_EDIT, DEG_C, 0, 0, 100, 1, [] { return (float)settings->case_temperature_low_limit; }, [](float v) { settings->case_temperature_low_limit = v; saveSettings(settings); }},
+    {"Case RH high", MENU_EDIT, "%", 0, 0, 100, 1, [] { return (float)settings->case_humidity_high_limit; }, [](float v) { settings->case_humidity_high_limit = v; saveSettings(settings); }},
+    {"Out T high", MENU_EDIT, DEG_C, 0, 0, 100, 1, [] { return (float)settings->outside_temp_high_limit; }, [](float v) { settings->outside_temp_high_limit = v; saveSettings(settings); }},
+    {"Out T low", MENU_EDIT, DEG_C, 0, 0, 100, 1, [] { return (float)settings->outside_temp_low_limit; }, [](float v) { settings->outside_temp_low_limit = v; saveSettings(settings); }},
+    {"Filter high", MENU_EDIT, "Pa", 0, 10, 2000, 10, [] { return (float)settings->filter_high_limit; }, [](float v) { settings->filter_high_limit = v; saveSettings(settings); }},
+    {"Filter zero", MENU_EDIT, "Pa", 0, -100, 100, 1, [] { return (float)settings->filter_zero; }, [](float v) { settings->filter_zero = v; saveSettings(settings); }},
+    {"FF horizon", MENU_EDIT, "s", 0, 0, 300, 5, [] { return (float)settings->feedforward_horizon; }, [](float v) { settings->feedforward_horizon = v; saveSettings(settings); }},
+    {"Therm mass", MENU_EDIT, "kJ/K", 0, 5, 200, 5, [] { return (float)settings->thermal_mass; }, [](float v) { settings->thermal_mass = v; saveSettings(settings); }},
+    {"Valve lock", MENU_EDIT, "s", 0, 0, 600, 5, [] { return settings->valve_lockout / 1000.0f; }, [](float v) { settings->valve_lockout = v * 1000; saveSettings(settings); }},
+    {"Comp lock", MENU_EDIT, "s", 0, 0, 600, 5, [] { return settings->compressor_lockout / 1000.0f; }, [](float v) { settings->compressor_lockout = v * 1000; saveSettings(settings); }},
+    {"Starts/h max", MENU_EDIT, "", 0, 1, 30, 1, [] { return (float)settings->compressor_starts_limit; }, [](float v) { settings->compressor_starts_limit = v; saveSettings(settings); }},
+    {"Exit", MENU_ACTION, "<", 0, 0, 0, 0, nullptr, [](float) { closeMenu(); }},
+};
+
+// the history channels as the trend pages and the h command show them
+struct trend_channel
+{
+    const char *name;
+    const char *column; // in the CSV dump
+    uint8_t decimals;   // the history's units are 10^-decimals of what is shown
+    int16_t min_span;   // of a trace's scale, in the history's units, so noise is not drawn full height
+};
+const trend_channel trend_channels[HISTORY_CHANNELS] = {
+    {"Res T", "res_t", 2, 50},
+    {"Out T", "out_t", 2, 100},
+    {"\x83 P", "filter_pa", 0, 20},
+};
+const char *const trend_tiers[HISTORY_TIERS] = {"2m", "1h", "1d"};
+
+// pages after the gauges, each one channel over one tier
+struct trend_page
+{
+    history_channel channel;
+    uint8_t tier;
+};
+const trend_page trend_pages[] = {
+    {HISTORY_RESERVOIR, 0},
+    {HISTORY_RESERVOIR, 1},
+    {HISTORY_RESERVOIR, 2},
+    {HISTORY_OUTSIDE, 1},
+    {HISTORY_FILTER_DP, 2},
+};
+#define GAUGE_PAGE_COUNT 7
+#define TREND_PAGE_COUNT (sizeof(trend_pages) / sizeof(trend_pages[0]))
+static_assert(HISTORY_BUCKETS <= board::screen::width, "more history buckets than sparkline columns");
+
+int16_t history_sample[HISTORY_CHANNELS] = {HISTORY_NO_SAMPLE, HISTORY_NO_SAMPLE, HISTORY_NO_SAMPLE};
+const trend_page *trend = nullptr; // being drawn, SPARK_COLUMNS_PER_PASS a pass
+uint8_t trend_age = 0;             // next bucket to draw
+int trend_lo = 0;                  // the trace's scale
+int trend_hi = 0;
+
+struct_maintenance *maintenance;
+
+line_buffer<32> usb_line;
+uint32_t heap_faults = 0;
 
 void handleUSBSerial();
-void measureReservoirLevel();
+void safeOutputs();
+void startPeripherals();
+void serviceFilterSensor();
+void measureAnalogChannels();
 void measureChassisTempHumid();
-void measureReservoirTemp();
-void measureOutsideTemp();
+void measureTemperatures();
 void measureFanRPM();
 void measureFilterDP();
+void measureSensorHealth();
 void runCoolingCycle();
+void applyActuator(actuator, uint8_t);
+void safetyTick();
+void serviceSafetyTrips();
+void checkReadingLimits();
+void checkHeap();
 void setError(uint16_t);
 void printAddress(DeviceAddress);
 void updateDisplay();
-void top_fan_pulse();
-void bottom_fan_pulse();
-int ringMeter(const char *, int, int, int, int, int, int, const char *);
+void startTrendPage(const trend_page *);
+void drawTrendPage();
+void dumpHistory(history_channel, uint8_t);
+
+extern "C" void startup_early_hook()
+{
+    /*
+     *   Earliest Boot
+     */
+    // runs straight out of reset, before the C runtime, clocks and USB are up
+    armWatchdog(WATCHDOG_TIMEOUT_MS);
+    enablePortClocks();
+    safeOutputs();
+}
+
+void safeOutputs()
+{
+    // set the level before switching to output, so no relay glitches
+    digitalWriteFast(board::pump_rly, LOW);
+    pinMode(board::pump_rly, OUTPUT);
+    digitalWriteFast(board::valve_rly, HIGH);
+    pinMode(board::valve_rly, OUTPUT);
+    digitalWriteFast(board::compressor_rly, LOW);
+    pinMode(board::compressor_rly, OUTPUT);
+    digitalWriteFast(board::alarms_rly, LOW);
+    pinMode(board::alarms_rly, OUTPUT);
+}
 
 void setup()
 {
     // get settings from EEPROM
     settings = loadSettings();
+    maintenance = loadMaintenance();
+    beginBlackBox(millis());
 
     // explicitly start clean
     resLvlRA.clear();
     resRefRA.clear();
     filterRA.clear();
+    clearHistory();
 
     // switch I2C to alternate pins
-    Wire.setSDA(I2C_SDA);
-    Wire.setSCL(I2C_SCL);
-
-    pinMode(PUMP_RLY, OUTPUT);
-    digitalWrite(PUMP_RLY, LOW);
-    pinMode(FLOW_SW, INPUT_PULLUP);
-    pinMode(VALVE_RLY, OUTPUT);
-    digitalWrite(VALVE_RLY, HIGH);
-    pinMode(COMPRESSOR_RLY, OUTPUT);
-    digitalWrite(COMPRESSOR_RLY, LOW);
-    pinMode(ALARMS_RLY, OUTPUT);
-    digitalWrite(ALARMS_RLY, LOW);
-
-    pinMode(TOP_FAN_RPM, INPUT);
-    attachInterrupt(TOP_FAN_RPM, top_fan_pulse, FALLING);
-    pinMode(BOTTOM_FAN_RPM, INPUT);
-    attachInterrupt(BOTTOM_FAN_RPM, bottom_fan_pulse, FALLING);
-    topRA.clear();
-    bottomRA.clear();
-    pinMode(FAN_PWM, OUTPUT);
-    analogWriteFrequency(FAN_PWM, 25000);
-    readings.chassis.fan.pwm = turnOffFans(FAN_PWM);
-
-    readings.reservoir.setpoint = 20.0;
-
+    Wire.setSDA(board::i2c_sda);
+    Wire.setSCL(board::i2c_scl);
+    local_bus.begin(LOCAL_BUS_HZ);
+
+    pinMode(board::flow_sw, INPUT_PULLUP);
+
+    beginFans(fans, FAN_COUNT);
+    beginEncoder(board::encoder_a, board::encoder_b, board::encoder_switch);
+    beginScope(scope_channels, SCOPE_CHANNEL_COUNT);
+    pinMode(board::fan_pwm, OUTPUT);
+    analogWriteFrequency(board::fan_pwm, 25000);
+    readings.chassis.fan.pwm = turnOffFans(board::fan_pwm);
+    actuator_wheel.begin(millis());
+    beginActuators(&actuator_wheel, settings, applyActuator, millis());
+    beginSafety(settings, millis());
+    safety_timer.priority(SAFETY_PRIORITY);
+    safety_timer.begin(safetyTick, SAFETY_TICK_US);
+
+    setSetpoint(20.0f);
+    clearAnomalies();
+
+    // no waiting for a serial monitor; anything printed before it attaches is lost
     SerialUSB.begin(9600);
-    while (!SerialUSB && millis() < 5000)
-    {
-        // wait up to 5 seconds for Arduino Serial Monitor
-    }
-    SerialUSB.println("RS232 CW_5200 Controller");
-
-    if (!bme.begin(BME_ADDRESS))
-    {
-        setError(CASE_BME280_NO_CONNECT);
-        SerialUSB.printf("Error %04X: No connect to BME!\n", readings.error.code);
-    }
-    else
-    {
-        bme_temp->printSensorDetails();
-        bme_humidity->printSensorDetails();
-    }
-
-    // SSD1306_SWITCHCAPVCC = generate display voltage from 3.3V internally
-    if (!display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS))
-    {
-        setError(CASE_DISPLAY_NO_CONNECT);
-        SerialUSB.printf("Error %04X: No connect to display!\n", readings.error.code);
-    }
-    else
+    SerialUSB.printf("RS232 CW_5200 Controller, %s reset\n", resetCause());
+    if (watchdogReset())
     {
-        display.setTextSize(1);              // Normal 1:1 pixel scale
-        display.setTextColor(SSD1306_WHITE); // Draw white text
-        display.setCursor(0, 0);             // Start at top-left corner
-        display.cp437(true);                 // Use full 256 char 'Code Page 437' font
-    }
-
-    sensors.begin();
-    if (!sensors.getAddress(outside_temp, 0))
-    {
-        setError(CASE_NO_OUTSIDE_DS18B20_ADDRESS);
-        SerialUSB.printf("Error %04X: Unable to find address for outside_temp\n", readings.error.code);
-    }
-    else
-    {
-        SerialUSB.print("outside_temp Address: ");
-        printAddress(outside_temp);
-        SerialUSB.println();
-        sensors.setResolution(outside_temp, TEMPERATURE_PRECISION);
-    }
-
-    if (!sensors.getAddress(reservoir_temp, 1))
-    {
-        setError(RESERVOIR_NO_DS18B20_ADDRESS);
-        SerialUSB.printf("Error %04X: Unable to find address for reservoir_temp\n", readings.error.code);
-    }
-    else
-    {
-        SerialUSB.print("reservoir_temp Address: ");
-        printAddress(reservoir_temp);
-        SerialUSB.println();
-        sensors.setResolution(reservoir_temp, TEMPERATURE_PRECISION);
+        setError(SYSTEM_WATCHDOG_RESET);
+        SerialUSB.printf("Error %04X: Reset by watchdog!\n", readings.error.code);
     }
 
     /*
      *  Set up telemetry link
      */
-    Serial1.begin(19200);
-    telemetry.begin(Serial1);
-    delay(5000);
+    Serial1.begin(LINK_BAUD);
+    beginLink(Serial1, setSetpoint);
+
+    // the BME280, display and probes come up from loop(), so run the first cycle straight away
+    loop_time = millis() - LOOP_PERIOD_MS;
+
+    // everything below runs on static storage; in the zero_heap build a malloc from here on is a fault
+    lockHeap();
 }
 
 void loop()
 {
+    feedWatchdog();
+    local_bus.service();
+    // relay sequences run to the tick, not to the 1 s loop
+    actuator_wheel.advance(millis());
+    serviceSafetyTrips();
+    startPeripherals();
     handleUSBSerial();
-    measureReservoirLevel();
+    serviceScope(SerialUSB);
+    serviceLink(&control, settings, &readings);
+    serviceFilterSensor();
+    // the display and menu run every pass, so the encoder never waits on the sensors
+    updateDisplay();
+    // a few bytes of any recording per pass; a flash erase would otherwise stall a whole cycle
+    serviceBlackBox();
+    if (millis() - loop_time < LOOP_PERIOD_MS)
+        return;
+    loop_time = millis();
+    readings.header.time_us = micros64();
+
+    measureAnalogChannels();
     measureChassisTempHumid();
-    measureReservoirTemp();
-    measureOutsideTemp();
+    measureTemperatures();
     measureFanRPM();
     measureFilterDP();
+    // the only float conversion of the cycle's inputs, for the anomaly checks, telemetry and display
+    publishMeasured(&measured, &readings);
+    measureSensorHealth();
     runCoolingCycle();
+    checkReadingLimits();
+    checkHeap();
 
     // send telemetry
-    txSize = 0;
-    txSize = telemetry.txObj(readings, txSize);
-    telemetry.sendData(txSize);
+    ++readings.header.sequence;
+    recordBlackBox(&measured, &readings);
+    recordHistory(history_sample);
+    sendReadings(&readings);
+}
 
-    updateDisplay();
-    delay(1000); // TODO: REMOVE ME
+void startPeripherals()
+{
+    /*
+     *   Deferred Peripheral Start
+     */
+    for (peripheral &device : peripherals)
+    {
+        switch (startPeripheral(&device, millis()))
+        {
+        case PERIPHERAL_STARTED:
+            SerialUSB.printf("%s up at %lums\n", device.name, millis());
+            break;
+        case PERIPHERAL_FAILED:
+            if (device.attempts == 1 && device.error != 0)
+            {
+                setError(device.error);
+                SerialUSB.printf("Error %04X: No connect to %s, retrying!\n", readings.error.code, device.name);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+bool startDisplay()
+{
+    // begin() never checks for an ACK, so look for the panel first
+    i2c_transaction probe = {};
+    probe.address = board::screen::address;
+    probe.priority = I2C_PRIORITY_DISPLAY;
+    if (!local_bus.transfer(&probe))
+        return false;
+    // SSD1306_SWITCHCAPVCC = generate display voltage from 3.3V internally
+    if (!display.begin(SSD1306_SWITCHCAPVCC, board::screen::address))
+        return false;
+    display.setTextSize(1);              // Normal 1:1 pixel scale
+    display.setTextColor(SSD1306_WHITE); // Draw white text
+    display.setCursor(0, 0);             // Start at top-left corner
+    display.cp437(true);                 // Use full 256 char 'Code Page 437' font
+    beginMenu(&display, [] { display.show(); }, menu, sizeof(menu) / sizeof(menu[0]));
+    return true;
 }
 
 void handleUSBSerial()
 {
-    if (SerialUSB.available() > 0)
+    if (usb_line.read(SerialUSB))
     {
-        String command = SerialUSB.readStringUntil('\n');
-        char cmd = command.charAt(0);
-        char scmd = command.charAt(1);
-        SerialUSB.print(command.c_str());
+        char cmd = usb_line.text[0];
+        char scmd = cmd != '\0' ? usb_line.text[1] : '\0';
+        SerialUSB.print(usb_line.text);
         switch (cmd)
         {
         case 'f':
-            /* manual fan control */
-            if (scmd == '1')
+            /* manual fan control; f? shows the filter trend */
+            if (scmd == '?')
             {
-                readings.chassis.fan.pwm = turnOnFans(FAN_PWM);
-                SerialUSB.println("Fans ON");
+                if (getFilterHoursLeft() == FILTER_TREND_UNKNOWN)
+                    SerialUSB.printf("\nFilter %d Pa, not trending towards %d Pa\n", readings.chassis.filter_dp, settings->filter_high_limit);
+                else
+                    SerialUSB.printf("\nFilter %d Pa, %.1f Pa per fan-runtime hour, %u fan-runtime hours to %d Pa\n",
+                                     readings.chassis.filter_dp, getFilterSlope(), getFilterHoursLeft(), settings->filter_high_limit);
             }
-            else if (scmd == '0')
+            else if (scmd == '1' || scmd == '0')
             {
-                readings.chassis.fan.pwm = turnOffFans(FAN_PWM);
-                SerialUSB.println("Fans OFF");
+                bool done = actuate(ACTUATOR_FANS, scmd == '1' ? FAN_PWM_ON : FAN_PWM_OFF, millis());
+                readings.chassis.fan.pwm = actuatorState()->level[ACTUATOR_FANS];
+                SerialUSB.println(!done ? "Fans stay on with the compressor running" : scmd == '1' ? "Fans ON" : "Fans OFF");
             }
             break;
 
         case 'p':
-            /* manual pump control */
+            /* manual pump control; off stops the compressor and runs the pump on a little */
             if (scmd == '1')
             {
-
-                digitalWrite(PUMP_RLY, LOW);
+                setPump(true, millis());
                 SerialUSB.println("Pump ON");
             }
             else if (scmd == '0')
             {
-
-                digitalWrite(PUMP_RLY, HIGH);
+                setPump(false, millis());
                 SerialUSB.println("Pump OFF");
             }
             break;
@@ -267,25 +442,90 @@ void handleUSBSerial()
                 break;
             case 'f': // Filter
                 filterRA.clear();
-                SerialUSB.println("Cleared filter RAs");
+                clearFilterTrend();
+                SerialUSB.println("Cleared filter RAs and trend");
                 break;
             case 't': // Tach
-                topRA.clear();
-                bottomRA.clear();
+                clearFans();
                 SerialUSB.println("Cleared tach RAs");
                 break;
             default:
                 resLvlRA.clear();
                 resRefRA.clear();
                 filterRA.clear();
-                topRA.clear();
-                bottomRA.clear();
+                clearFans();
+                clearFilterTrend();
                 SerialUSB.println("Cleared ALL RAs");
                 break;
             }
 
             break;
 
+        case 's':
+            /* scope mode: s? lists channels, s<mask hex> <period us> starts, s0 stops */
+            if (scmd == '?')
+            {
+                SerialUSB.print("\nScope channels: ");
+                for (uint8_t i = 0; i < SCOPE_CHANNEL_COUNT; i++)
+                    SerialUSB.printf(i == 0 ? "%s" : ",%s", scope_channels[i].name);
+                SerialUSB.println();
+            }
+            else
+            {
+                char *end;
+                uint32_t mask = strtoul(usb_line.text + 1, &end, 16);
+                uint32_t period = strtoul(end, nullptr, 10);
+                if (mask == 0)
+                {
+                    struct_scope_stats stats;
+                    getScopeStats(&stats);
+                    stopScope();
+                    SerialUSB.printf(" Scope stopped, %lu frames sent, %lu dropped\n", stats.sent, stats.dropped);
+                }
+                else if (period <= UINT16_MAX && startScope(mask, period))
+                    SerialUSB.println(" Scope started");
+                else
+                    SerialUSB.printf(" BAD SCOPE REQUEST, period %u us minimum\n", SCOPE_PERIOD_MIN_US);
+            }
+            break;
+
+        case 'b':
+            /* black box: b dumps the recording, bc clears it, bt records from now */
+            if (scmd == 'c')
+            {
+                clearBlackBox();
+                SerialUSB.println("Black box cleared");
+            }
+            else if (scmd == 't')
+            {
+                forceBlackBox(readings.error.code, millis());
+                SerialUSB.println(blackBoxState() == BLACKBOX_CAPTURING ? "Black box recording" : "Black box already holds a recording");
+            }
+            else if (!dumpBlackBox(SerialUSB))
+                SerialUSB.println(blackBoxState() == BLACKBOX_ARMED ? "Black box empty" : "Black box still recording");
+            break;
+
+        case 'h':
+            /* history: h lists the channels and tiers, h<channel><tier> dumps one as CSV */
+            if (scmd >= '0' && scmd < '0' + HISTORY_CHANNELS && usb_line.text[2] >= '0' &&
+                usb_line.text[2] < '0' + HISTORY_TIERS)
+            {
+                SerialUSB.println();
+                dumpHistory((history_channel)(scmd - '0'), usb_line.text[2] - '0');
+            }
+            else
+            {
+                SerialUSB.print("\nHistory channels: ");
+                for (uint8_t i = 0; i < HISTORY_CHANNELS; i++)
+                    SerialUSB.printf(i == 0 ? "%u %s" : ", %u %s", i, trend_channels[i].column);
+                SerialUSB.print("\nTiers: ");
+                for (uint8_t t = 0; t < HISTORY_TIERS; t++)
+                    SerialUSB.printf(t == 0 ? "%u %lus x %u" : ", %u %lus x %u", t,
+                                     historyBucketCycles(t) * LOOP_PERIOD_MS / 1000, HISTORY_BUCKETS);
+                SerialUSB.println();
+            }
+            break;
+
         default:
             SerialUSB.println("UNKNOWN COMMAND");
             break;
@@ -293,97 +533,168 @@ void handleUSBSerial()
     }
 }
 
-void measureReservoirLevel()
+bool discoverProbes()
 {
     /*
-     *   Reservoir Level Measurement
+     *   DS18B20 Discovery
      */
-    resLvlRA.addValue(analogRead(RES_LEVEL));
-    resRefRA.addValue(analogRead(RES_REF));
-    readings.reservoir.level_sense = resLvlRA.getAverage();
-    readings.reservoir.level_ref = resRefRA.getAverage();
-    if (readings.reservoir.level_sense < settings->reservoir_volume_low_limit)
+    // match probes by ROM code, so their order on the bus does not matter
+    DeviceAddress address;
+    for (uint8_t i = 0; i < sensors.getDeviceCount(); i++)
+    {
+        if (!sensors.getAddress(address, i))
+            continue;
+        const char *name = "Unknown";
+        for (uint8_t p = 0; p < PROBE_COUNT; p++)
+        {
+            if (memcmp(address, probes[p].rom, sizeof(DeviceAddress)) == 0)
+            {
+                probe_found[p] = true;
+                name = probes[p].name;
+            }
+        }
+        SerialUSB.printf("%s probe Address: ", name);
+        printAddress(address);
+        SerialUSB.println();
+    }
+    // every device, so an unlisted probe cannot stretch the conversion time
+    sensors.setResolution(board::temperature_precision);
+
+    bool all_found = true;
+    for (uint8_t p = 0; p < PROBE_COUNT; p++)
     {
-        setError(RESERVOIR_LEVEL_LOW);
-        SerialUSB.printf("Error %04X: Reservoir level too low! %dmL < %dmL\n", readings.error.code, (int)readings.reservoir.level_sense, settings->reservoir_volume_low_limit);
+        if (!probe_found[p])
+        {
+            all_found = false;
+            setError(probes[p].no_address_error);
+            SerialUSB.printf("Error %04X: Unable to find %s probe\n", readings.error.code, probes[p].name);
+        }
     }
+    return all_found;
 }
 
-void measureChassisTempHumid()
+void serviceFilterSensor()
 {
     /*
-     *   Case Temp and RH Measurement
+     *   Filter Delta-P Sampling
      */
-    sensors_event_t temp_event, humidity_event;
-    bme_temp->getEvent(&temp_event);
-    bme_humidity->getEvent(&humidity_event);
-    readings.chassis.inside_temperature = temp_event.temperature;
-    readings.chassis.humidity = humidity_event.relative_humidity;
-    if (readings.chassis.inside_temperature > settings->case_temperature_high_limit)
-    {
-        setError(CASE_TEMP_TOO_HIGH);
-        SerialUSB.printf("Error %04X: Case temperature too high! %dC > %dC\n", readings.error.code, readings.chassis.inside_temperature, settings->case_temperature_high_limit);
-    }
-    if (readings.chassis.inside_temperature < settings->case_temperature_low_limit)
+    // runs every pass; the sensor converts while the rest of the loop runs
+    if (!peripherals[PERIPHERAL_FILTER].up)
+        return;
+    switch (filter_sensor.service(millis()))
     {
-        setError(CASE_TEMP_TOO_LOW);
-        SerialUSB.printf("Error %04X: Case temperature too low! %dC < %dC\n", readings.error.code, readings.chassis.inside_temperature, settings->case_temperature_low_limit);
+    case ABP2_READY:
+        filterRA.addValue(filter_sensor.sample.pressure_cpa);
+        filter_sensor_faulted = false;
+        break;
+    case ABP2_FAULT:
+        if (!filter_sensor_faulted)
+        {
+            filter_sensor_faulted = true;
+            setError(CASE_FILTER_SENSOR_FAULT);
+            SerialUSB.printf("Error %04X: Filter pressure sensor fault, status %02X!\n", readings.error.code, filter_sensor.sample.status);
+        }
+        break;
+    default:
+        break;
     }
-    if (readings.chassis.humidity > settings->case_humidity_high_limit)
+}
+
+void measureAnalogChannels()
+{
+    /*
+     *   Reservoir Level Measurement
+     */
+    for (const analog_channel &channel : analogs)
     {
-        setError(CASE_HUMIDITY_TOO_HIGH);
-        SerialUSB.printf("Error %04X: Case humidity too high! %d%% > %d%%\n", readings.error.code, readings.chassis.humidity, settings->case_humidity_high_limit);
+        // while the scope runs it owns the ADC and hands out its latest sample
+        uint16_t sample;
+        if (!scopeAnalog(channel.pin, &sample))
+            sample = analogRead(channel.pin);
+        channel.average->addValue(sample);
+        // hundredths of a count keep the average's resolution without a float
+        uint32_t value = channel.average->getScaledAverage(100);
+        switch (channel.role)
+        {
+        case ANALOG_RESERVOIR_LEVEL:
+            measured.level_sense = value;
+            break;
+        case ANALOG_RESERVOIR_REF:
+            measured.level_ref = value;
+            break;
+        }
     }
 }
 
-void measureReservoirTemp()
+void measureChassisTempHumid()
 {
     /*
-     *   Reservoir Temp Measurement
+     *   Case Temp and RH Measurement
      */
-    sensors.requestTemperaturesByAddress(reservoir_temp);
-    readings.reservoir.temperature = sensors.getTempC(reservoir_temp);
-    if (readings.reservoir.temperature == DEVICE_DISCONNECTED_C)
+    // the values are from the read queued last cycle, so nothing here waits on the bus
+    if (!peripherals[PERIPHERAL_BME].up)
+        return;
+    switch (bme.status())
     {
-        setError(RESERVOIR_NO_DS18B20_READ);
-        SerialUSB.printf("Error %04X: Could not read reservoir temperature data\n", readings.error.code);
-        readings.reservoir.temperature = 0.0;
-    }
-    if (readings.reservoir.temperature > settings->reservoir_temp_high_limit)
+    case I2C_DONE:
     {
-        setError(RESERVOIR_TEMP_TOO_HIGH);
-        SerialUSB.printf("Error %04X: Reservoir temperature too high! %dC > %dC\n", readings.error.code, readings.reservoir.temperature, settings->reservoir_temp_high_limit);
+        int16_t inside = bme.centiTemperature();
+        int16_t humidity = bme.centiHumidity();
+        // a measurement the part skipped is no sample either
+        if (inside == BME280_NO_READING || humidity == BME280_NO_READING)
+            break;
+        measured.inside = inside;
+        measured.humidity = humidity;
+        bme_sampled = true;
+        break;
     }
-    if (readings.reservoir.temperature < settings->reservoir_temp_low_limit)
-    {
-        setError(RESERVOIR_TEMP_TOO_LOW);
-        SerialUSB.printf("Error %04X: Reservoir temperature too low! %dC < %dC\n", readings.error.code, readings.reservoir.temperature, settings->reservoir_temp_low_limit);
+    case I2C_NACK:
+    case I2C_TIMEOUT:
+        // back to the deferred start, which retries it
+        peripherals[PERIPHERAL_BME].up = false;
+        bme_sampled = false;
+        setError(CASE_BME280_NO_CONNECT);
+        SerialUSB.printf("Error %04X: Lost the BME280!\n", readings.error.code);
+        return;
+    default:
+        break;
     }
+    bme.request();
 }
 
-void measureOutsideTemp()
+void measureTemperatures()
 {
     /*
-     *   Outside Temp Measurement
+     *   Reservoir and Outside Temp Measurement
      */
-    sensors.requestTemperaturesByAddress(outside_temp);
-    readings.chassis.outside_temperature = sensors.getTempC(outside_temp);
-    if (readings.chassis.outside_temperature == DEVICE_DISCONNECTED_C)
+    // one conversion covers every probe on the bus
+    sensors.requestTemperatures();
+    // the raw 1/128 degC counts, not getTempC(), so nothing here is a soft-float call
+    int32_t sum[PROBE_ROLES] = {0};
+    uint8_t count[PROBE_ROLES] = {0};
+    for (uint8_t p = 0; p < PROBE_COUNT; p++)
     {
-        setError(CASE_NO_OUTSIDE_DS18B20_READ);
-        SerialUSB.printf("Error %04X: Could not read outside temperature data\n", readings.error.code);
-        readings.chassis.outside_temperature = 0.0;
-    }
-    if (readings.chassis.outside_temperature > settings->outside_temp_high_limit)
-    {
-        setError(CASE_OUTSIDE_TEMP_TOO_HIGH);
-        SerialUSB.printf("Error %04X: Outside temperature too high! %dC > %dC\n", readings.error.code, readings.chassis.outside_temperature, settings->outside_temp_high_limit);
-    }
-    if (readings.chassis.outside_temperature < settings->outside_temp_low_limit)
-    {
-        setError(CASE_OUTSIDE_TEMP_TOO_LOW);
-        SerialUSB.printf("Error %04X: Outside temperature too low! %dC < %dC\n", readings.error.code, readings.chassis.outside_temperature, settings->outside_temp_low_limit);
+        if (!probe_found[p])
+            continue;
+        centi_c value = centiFrom128ths(sensors.getTemp(probes[p].rom));
+        if (value < probes[p].min_valid || value > probes[p].max_valid)
+        {
+            setError(probes[p].no_read_error);
+            SerialUSB.printf("Error %04X: Could not read %s temperature data\n", readings.error.code, probes[p].name);
+            continue;
+        }
+        sum[probes[p].role] += value;
+        ++count[probes[p].role];
     }
+    centi_c reservoir = count[PROBE_RESERVOIR] ? divideRounded(sum[PROBE_RESERVOIR], count[PROBE_RESERVOIR]) : 0;
+    centi_c outside = count[PROBE_OUTSIDE] ? divideRounded(sum[PROBE_OUTSIDE], count[PROBE_OUTSIDE]) : 0;
+    measured.reservoir = reservoir;
+    measured.outside = outside;
+    history_sample[HISTORY_RESERVOIR] = count[PROBE_RESERVOIR] ? reservoir : HISTORY_NO_SAMPLE;
+    history_sample[HISTORY_OUTSIDE] = count[PROBE_OUTSIDE] ? outside : HISTORY_NO_SAMPLE;
+    // only a real reading renews the safety monitor's lease
+    if (count[PROBE_RESERVOIR])
+        reportSafetySnapshot(reservoir, millis());
 }
 
 void measureFilterDP()
@@ -391,12 +702,35 @@ void measureFilterDP()
     /*
      *   Filter Delta-P Measurement
      */
-    filterRA.addValue(analogRead(FILTER_P));
-    readings.chassis.filter_dp = filterRA.getAverage();
-    if (filterRA.getAverage() > settings->filter_high_limit)
+    measured.filter_dp = filterRA.getRoundedAverage(100);
+    bool sampled = peripherals[PERIPHERAL_FILTER].up && filterRA.getCount() > 0;
+    history_sample[HISTORY_FILTER_DP] = sampled ? measured.filter_dp : HISTORY_NO_SAMPLE;
+    updateFilterTrend(measured.filter_dp, readings.chassis.fan.pwm, settings->filter_zero, settings->filter_high_limit);
+    readings.maintenance.filter_hours_left = getFilterHoursLeft();
+}
+
+void measureSensorHealth()
+{
+    /*
+     *   Sensor Anomaly and Drift Detection
+     */
+    static const char *const kinds[] = {"", "stuck", "changing too fast", "outlier", "colder than outside with no cooling", "RPM does not match PWM"};
+    // until a sensor has been read its fields hold placeholders, not samples
+    uint8_t absent = 0;
+    if (history_sample[HISTORY_RESERVOIR] == HISTORY_NO_SAMPLE)
+        absent |= ANOMALY_CHANNEL(ANOMALY_RES_T);
+    if (history_sample[HISTORY_OUTSIDE] == HISTORY_NO_SAMPLE)
+        absent |= ANOMALY_CHANNEL(ANOMALY_OUT_T);
+    if (!peripherals[PERIPHERAL_BME].up || !bme_sampled)
+        absent |= ANOMALY_CHANNEL(ANOMALY_CASE_T) | ANOMALY_CHANNEL(ANOMALY_CASE_RH);
+    if (history_sample[HISTORY_FILTER_DP] == HISTORY_NO_SAMPLE)
+        absent |= ANOMALY_CHANNEL(ANOMALY_FILTER_DP);
+    anomaly_report reports[ANOMALY_REPORTS_MAX];
+    uint8_t count = updateAnomalies(&readings, absent, reports);
+    for (uint8_t i = 0; i < count; i++)
     {
-        setError(CASE_FILTERS_CLOGGED);
-        SerialUSB.printf("Error %04X: Filter delta-P too high! %d > %d\n", readings.error.code, (int)readings.chassis.filter_dp, settings->filter_high_limit);
+        setError(reports[i].code);
+        SerialUSB.printf("Error %04X: %s %s!\n", readings.error.code, reports[i].name, kinds[reports[i].kind]);
     }
 }
 
@@ -405,44 +739,25 @@ void measureFanRPM()
     /*
      *   Fan RPM Measurement
      */
-    if (top_fan.ready)
-    {
-        topRA.addValue(top_fan.pulse_len);
-        top_fan.ready = false;
-    }
-    if (bottom_fan.ready)
+    if (millis() - fan_time < FAN_SAMPLING_TIME)
+        return;
+    fan_time = millis();
+    for (uint8_t i = 0; i < FAN_COUNT; i++)
     {
-        bottomRA.addValue(bottom_fan.pulse_len);
-        bottom_fan.ready = false;
-    }
-    if (millis() - reading_time > FAN_SAMPLING_TIME)
-    {
-        if (topRA.getCount() > 0)
-        {
-            readings.chassis.fan.top_tach = convertMicrosToRPM(topRA.getAverage());
-        }
-        else
-        {
-            readings.chassis.fan.top_tach = 0;
-            if (readings.chassis.fan.pwm > 0)
-            {
-                setError(CASE_TOP_FAN_LOW_RPM);
-                SerialUSB.printf("Error %04X: Top fan RPM too low!\n", readings.error.code);
-            }
-        }
-
-        if (bottomRA.getCount() > 0)
+        deci_rpm rpm = readFanRPM(i, fans[i].pulses_per_rev);
+        switch (fans[i].role)
         {
-            readings.chassis.fan.bottom_tach = convertMicrosToRPM(bottomRA.getAverage());
+        case FAN_TOP:
+            measured.top_tach = rpm;
+            break;
+        case FAN_BOTTOM:
+            measured.bottom_tach = rpm;
+            break;
         }
-        else
+        if (rpm == 0 && readings.chassis.fan.pwm > 0)
         {
-            readings.chassis.fan.bottom_tach = 0;
-            if (readings.chassis.fan.pwm > 0)
-            {
-                setError(CASE_BOTTOM_FAN_LOW_RPM);
-                SerialUSB.printf("Error %04X: Bottom fan RPM too low!\n", readings.error.code);
-            }
+            setError(fans[i].low_rpm_error);
+            SerialUSB.printf("Error %04X: %s fan RPM too low!\n", readings.error.code, fans[i].name);
         }
     }
 }
@@ -452,57 +767,178 @@ void runCoolingCycle()
     /*
      *   Cooling Cycle
      */
-    readings.compressor.compressor_time = millis() - last_compressor;
-    readings.compressor.valve_time = millis() - last_valve;
-    readings.pump.flow_ok = (digitalRead(FLOW_SW) == LOW);
-    readings.pump.running = (digitalRead(PUMP_RLY) == LOW);
+    readings.pump.flow_ok = (digitalRead(board::flow_sw) == LOW);
 
-    if (running_state)
+    uint16_t error = runCoolingControl(&measured, &readings, settings, &control, millis());
+    if (first_decision_time == 0)
     {
-        if (readings.reservoir.temperature > readings.reservoir.setpoint + settings->hysteresis)
-        {
-            if (digitalRead(VALVE_RLY) == HIGH)
-            {
-                last_valve = millis();
-                digitalWrite(VALVE_RLY, LOW);
-                readings.compressor.valve = true;
-            }
-            if (readings.compressor.valve_time >= settings->valve_lockout && readings.compressor.compressor_time >= settings->compressor_lockout)
-            {
-                last_compressor = millis();
-                readings.chassis.fan.pwm = turnOnFans(FAN_PWM);
-                digitalWrite(COMPRESSOR_RLY, HIGH);
-                readings.compressor.running = true;
-            }
-        }
-        if (readings.reservoir.temperature <= readings.reservoir.setpoint - settings->hysteresis)
+        first_decision_time = millis();
+        SerialUSB.printf("First control decision %lums after reset\n", first_decision_time);
+    }
+    if (error != 0)
+    {
+        setError(error);
+        SerialUSB.printf("Error %04X: %s!\n", readings.error.code, controlErrorName(error));
+    }
+
+    updateMaintenance(readings.compressor.running, readings.pump.running, readings.chassis.fan.pwm > 0);
+    readings.maintenance.compressor_seconds = maintenance->compressor_seconds;
+    readings.maintenance.compressor_starts = maintenance->compressor_starts;
+    readings.maintenance.starts_per_hour = getStartsPerHour();
+    readings.maintenance.short_cycles = maintenance->short_cycles;
+    readings.maintenance.pump_seconds = maintenance->pump_seconds;
+    readings.maintenance.fan_seconds = maintenance->fan_seconds;
+}
+
+void applyActuator(actuator which, uint8_t level)
+{
+    // the only place the relay and fan pins are driven after safeOutputs(), bar safetyTick()
+    uint8_t holds = safetyHolds();
+    switch (which)
+    {
+    case ACTUATOR_VALVE:
+        digitalWrite(board::valve_rly, level ? LOW : HIGH);
+        break;
+    case ACTUATOR_COMPRESSOR:
+        // a held relay would only be forced back on the next tick, after the contactor had pulled in
+        if (level && (holds & SAFETY_HOLD_COMPRESSOR))
+            break;
+        digitalWrite(board::compressor_rly, level ? HIGH : LOW);
+        break;
+    case ACTUATOR_PUMP:
+        if (level && (holds & SAFETY_HOLD_PUMP))
+            break;
+        digitalWrite(board::pump_rly, level ? LOW : HIGH);
+        break;
+    case ACTUATOR_FANS:
+        if (level == FAN_PWM_OFF)
         {
-            if (millis() - last_compressor >= settings->compressor_lockout)
-            {
-                last_compressor = millis();
-                last_valve = millis();
-                readings.chassis.fan.pwm = turnOffFans(FAN_PWM);
-                topRA.clear();
-                bottomRA.clear();
-                digitalWrite(COMPRESSOR_RLY, LOW);
-                digitalWrite(VALVE_RLY, HIGH);
-                readings.compressor.running = false;
-                readings.compressor.valve = false;
-            }
+            turnOffFans(board::fan_pwm);
+            clearFans();
         }
-        if (readings.pump.running && !readings.pump.flow_ok)
+        else
         {
-            setError(RESERVOIR_PUMP_ON_WITH_NO_FLOW);
-            SerialUSB.printf("Error %04X: No flow with pump running!\n", readings.error.code);
+            turnOnFans(board::fan_pwm, level);
         }
+        break;
+    default:
+        break;
+    }
+}
+
+void safetyTick()
+{
+    // the timer ISR: pins read and the held relays driven here, whatever loop() is stuck in
+    uint8_t holds = serviceSafety(millis(), digitalReadFast(board::flow_sw) == LOW,
+                                  digitalReadFast(board::pump_rly) == LOW, digitalReadFast(board::compressor_rly) == HIGH);
+    if (holds & SAFETY_HOLD_COMPRESSOR)
+        digitalWriteFast(board::compressor_rly, LOW);
+    if (holds & SAFETY_HOLD_PUMP)
+        digitalWriteFast(board::pump_rly, HIGH);
+    if (holds & SAFETY_HOLD_ALARM)
+        digitalWriteFast(board::alarms_rly, LOW);
+}
+
+void serviceSafetyTrips()
+{
+    /*
+     *   Safety Monitor Trips
+     */
+    static const struct
+    {
+        safety_trip trip;
+        uint16_t code;
+    } codes[] = {
+        {SAFETY_TRIP_NO_FLOW, SAFETY_NO_FLOW},
+        {SAFETY_TRIP_UNDER_TEMP, SAFETY_UNDER_TEMP},
+        {SAFETY_TRIP_OVER_TEMP, SAFETY_OVER_TEMP},
+        {SAFETY_TRIP_STALE, SAFETY_STALE_TEMPERATURE},
+        {SAFETY_TRIP_LOCKOUT, SAFETY_COMPRESSOR_LOCKOUT},
+    };
+    noInterrupts();
+    uint8_t tripped = takeSafetyTrips();
+    interrupts();
+
+    // the monitor has switched the relays already; the actuators, and a start
+    // still pending on the wheel, only catch up with what the pins are doing
+    uint32_t now = millis();
+    uint8_t holds = safetyHolds();
+    const struct_actuators *outputs = actuatorState();
+    if ((holds & SAFETY_HOLD_COMPRESSOR) && outputs->level[ACTUATOR_COMPRESSOR])
+        seedActuator(ACTUATOR_COMPRESSOR, 0, now);
+    if ((holds & SAFETY_HOLD_PUMP) && outputs->level[ACTUATOR_PUMP])
+        seedActuator(ACTUATOR_PUMP, 0, now);
+
+    for (const auto &c : codes)
+    {
+        if (!(tripped & c.trip))
+            continue;
+        setError(c.code);
+        SerialUSB.printf("Error %04X: Safety trip, %s!\n", readings.error.code, safetyTripName(c.trip));
+    }
+}
+
+void checkReadingLimits()
+{
+    /*
+     *   Limit Checks
+     */
+    const limit_check *violations[LIMIT_VIOLATIONS_MAX];
+    uint8_t count = checkLimits(&measured, &readings, settings, violations);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const limit_check *check = violations[i];
+        setError(check->code);
+        SerialUSB.printf("Error %04X: %s! %.1f%s %c %.1f%s\n", readings.error.code, check->message,
+                         (float)check->value(&measured, &readings) / check->scale, check->units, check->high ? '>' : '<',
+                         (float)check->limit(settings) / check->scale, check->units);
     }
 }
 
+void checkHeap()
+{
+    /*
+     *   Heap Use After Setup
+     */
+    struct_heap_stats heap;
+    getHeapStats(&heap);
+    if (heap.faults != heap_faults)
+    {
+        heap_faults = heap.faults;
+        setError(SYSTEM_HEAP_ALLOCATION);
+        SerialUSB.printf("Error %04X: %lu heap allocations after setup, last %lu bytes!\n", readings.error.code,
+                         heap.faults, heap.last_fault_size);
+    }
+}
+
+void setSetpoint(float celsius)
+{
+    // from the menu and the link; control works from the integer
+    measured.setpoint = centiFromCelsius(celsius);
+    readings.reservoir.setpoint = centiToCelsius(measured.setpoint);
+}
+
 void setError(uint16_t error)
 {
+    // a fault that keeps being raised only starts the recording once
+    if (!readings.error.alert || readings.error.code != error)
+        triggerBlackBox(error, millis());
     readings.error.code = error;
     readings.error.alert = true;
-    digitalWrite(ALARMS_RLY, LOW);
+    digitalWrite(board::alarms_rly, LOW);
+}
+
+void acknowledgeAlarm()
+{
+    noInterrupts();
+    clearSafety();
+    interrupts();
+    // a safety trip whose cause is still there keeps the alarm going
+    if (safetyHolds() & SAFETY_HOLD_ALARM)
+        return;
+    // the code stays for the telemetry; only the alert and the relay clear
+    readings.error.alert = false;
+    digitalWrite(board::alarms_rly, HIGH);
 }
 
 // function to print a device address
@@ -522,154 +958,166 @@ void updateDisplay()
     /*
      *   Display Update Cycle
      */
+    if (!peripherals[PERIPHERAL_DISPLAY].up)
+        return;
+    bool was_active = menu_active;
+    menu_active = updateMenu(readEncoder(), encoderPressed());
+    if (menu_active)
+    {
+        // the menu has drawn over any trend page half done
+        trend = nullptr;
+        return;
+    }
+    if (was_active)
+    {
+        // back from the menu; put a page up straight away
+        reading_time = millis() - PAGE_DELAY;
+    }
     if (millis() - reading_time >= PAGE_DELAY)
     {
         reading_time = millis();
         ++reading_state;
-        if (reading_state >= 6)
+        if (reading_state >= GAUGE_PAGE_COUNT + TREND_PAGE_COUNT)
             reading_state = 0;
         switch (reading_state)
         {
         case 0:
             display.clearDisplay();
-            ringMeter("Case T", readings.chassis.inside_temperature, 0, 100, 0, 0, GAUGE_RADIUS, "\xF8"
+            ringMeter(display, "Case T", readings.chassis.inside_temperature, 0, 100, 0, 0, GAUGE_RADIUS, "\xF8"
                                                                                                  "C");
-            ringMeter("Case RH", readings.chassis.humidity, 0, 100, SCREEN_WIDTH - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "%");
-            display.display();
+            ringMeter(display, "Case RH", readings.chassis.humidity, 0, 100, board::screen::width - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "%");
+            display.show();
             break;
         case 1:
             display.clearDisplay();
-            ringMeter("Res T", readings.reservoir.temperature, 0, 100, 0, 0, GAUGE_RADIUS, "\xF8"
+            ringMeter(display, "Res T", readings.reservoir.temperature, 0, 100, 0, 0, GAUGE_RADIUS, "\xF8"
                                                                                            "C");
-            ringMeter("Out T", readings.chassis.outside_temperature, 0, 100, SCREEN_WIDTH - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "\xF8"
+            ringMeter(display, "Out T", readings.chassis.outside_temperature, 0, 100, board::screen::width - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "\xF8"
                                                                                                                                "C");
-            display.display();
+            display.show();
             break;
         case 2:
             display.clearDisplay();
-            ringMeter("Top Fan", readings.chassis.fan.top_tach, 0, 6000, 0, 0, GAUGE_RADIUS, "RPM");
-            ringMeter("Bot Fan", readings.chassis.fan.bottom_tach, 0, 6000, SCREEN_WIDTH - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "RPM");
-            display.display();
+            ringMeter(display, "Top Fan", readings.chassis.fan.top_tach, 0, 6000, 0, 0, GAUGE_RADIUS, "RPM");
+            ringMeter(display, "Bot Fan", readings.chassis.fan.bottom_tach, 0, 6000, board::screen::width - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "RPM");
+            display.show();
             break;
         case 3:
             display.clearDisplay();
-            ringMeter("Res Lvl", (int)readings.reservoir.level_sense, 0, 1024, 0, 0, GAUGE_RADIUS, "ADC");
-            ringMeter("Res Ref", (int)readings.reservoir.level_ref, 0, 1024, SCREEN_WIDTH - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "ADC");
-            display.display();
+            ringMeter(display, "Res Lvl", (int)readings.reservoir.level_sense, 0, 1024, 0, 0, GAUGE_RADIUS, "ADC");
+            ringMeter(display, "Res Ref", (int)readings.reservoir.level_ref, 0, 1024, board::screen::width - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "ADC");
+            display.show();
             break;
         case 4:
             display.clearDisplay();
-            ringMeter("Res Set", readings.reservoir.setpoint, 10, 30, 0, 0, GAUGE_RADIUS, "\xF8"
+            ringMeter(display, "Res Set", readings.reservoir.setpoint, 10, 30, 0, 0, GAUGE_RADIUS, "\xF8"
                                                                                           "C");
-            ringMeter("\x83 P", (int)readings.chassis.filter_dp, 0, 1024, SCREEN_WIDTH - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "ADC");
-            display.display();
+            ringMeter(display, "\x83 P", readings.chassis.filter_dp, 0, settings->filter_high_limit, board::screen::width - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "Pa");
+            display.show();
             break;
         case 5:
             display.clearDisplay();
-            ringMeter("Comp", readings.compressor.compressor_time / 1000, 0, (2 * settings->compressor_lockout) / 1000, 0, 0, GAUGE_RADIUS, "s");
-            ringMeter("Valve", readings.compressor.valve_time / 1000, 0, (2 * settings->valve_lockout) / 1000, SCREEN_WIDTH - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "s");
-            display.display();
+            ringMeter(display, "Comp", readings.compressor.compressor_time / 1000, 0, (2 * settings->compressor_lockout) / 1000, 0, 0, GAUGE_RADIUS, "s");
+            ringMeter(display, "Valve", readings.compressor.valve_time / 1000, 0, (2 * settings->valve_lockout) / 1000, board::screen::width - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "s");
+            display.show();
+            break;
+        case 6:
+            display.clearDisplay();
+            ringMeter(display, "Starts", readings.maintenance.starts_per_hour, 0, 2 * settings->compressor_starts_limit, 0, 0, GAUGE_RADIUS, "/h");
+            ringMeter(display, "Comp", readings.maintenance.compressor_seconds / 3600, 0, 20000, board::screen::width - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "h");
+            display.show();
             break;
         default:
+            startTrendPage(&trend_pages[reading_state - GAUGE_PAGE_COUNT]);
             break;
         }
     }
+    drawTrendPage();
 }
 
-void top_fan_pulse()
+void startTrendPage(const trend_page *page)
 {
-    top_fan.current_pulse = micros();
-    top_fan.pulse_len = top_fan.current_pulse - top_fan.last_pulse;
-    top_fan.last_pulse = top_fan.current_pulse;
-    top_fan.ready = true;
+    /*
+     *   Trend Page: title and scale
+     */
+    const trend_channel *channel = &trend_channels[page->channel];
+    history_bucket bucket;
+    int lo = INT16_MAX;
+    int hi = INT16_MIN;
+    for (uint8_t age = 0; age < historyLength(page->tier); age++)
+    {
+        if (!getHistoryBucket(page->channel, page->tier, age, &bucket))
+            continue;
+        lo = min(lo, bucket.min);
+        hi = max(hi, bucket.max);
+    }
+    display.clearDisplay();
+    display.setTextSize(1);
+    display.setTextColor(SSD1306_WHITE, SSD1306_BLACK);
+    display.setCursor(0, 0);
+    if (lo > hi)
+    {
+        display.printf("%s %s: no history", channel->name, trend_tiers[page->tier]);
+        display.show();
+        trend = nullptr;
+        return;
+    }
+    // a flat trace is widened about its middle to the channel's minimum span
+    if (hi - lo < channel->min_span)
+    {
+        lo = (lo + hi - channel->min_span) / 2;
+        hi = lo + channel->min_span;
+    }
+    float scale = powf(10, channel->decimals);
+    display.printf("%s %s %.*f-%.*f", channel->name, trend_tiers[page->tier], channel->decimals, lo / scale,
+                   channel->decimals, hi / scale);
+    trend = page;
+    trend_age = 0;
+    trend_lo = lo;
+    trend_hi = hi;
 }
 
-void bottom_fan_pulse()
+void drawTrendPage()
 {
-    bottom_fan.current_pulse = micros();
-    bottom_fan.pulse_len = bottom_fan.current_pulse - bottom_fan.last_pulse;
-    bottom_fan.last_pulse = bottom_fan.current_pulse;
-    bottom_fan.ready = true;
+    /*
+     *   Trend Page: a few sparkline columns a pass, newest on the right
+     */
+    if (trend == nullptr)
+        return;
+    // a bucket closing part way through shifts the rest a column; the next time round puts it right
+    history_bucket bucket;
+    uint8_t length = historyLength(trend->tier);
+    for (uint8_t n = 0; n < SPARK_COLUMNS_PER_PASS && trend_age < length; n++, trend_age++)
+    {
+        if (getHistoryBucket(trend->channel, trend->tier, trend_age, &bucket))
+            sparkColumn(display, board::screen::width - 1 - trend_age, board::screen::height - 1,
+                        board::screen::height - FONT_Y - 2, trend_lo, trend_hi, bucket.min, bucket.avg, bucket.max);
+    }
+    if (trend_age >= length)
+    {
+        display.show();
+        trend = nullptr;
+    }
 }
 
-// #########################################################################
-//  Draw the meter on the screen, returns x coord of righthand side
-// #########################################################################
-int ringMeter(const char *reading, int value, int vmin, int vmax, int orig_x, int orig_y, int r, const char *units)
+void dumpHistory(history_channel channel, uint8_t tier)
 {
-    int x = orig_x + r;
-    int y = orig_y + r + FONT_Y; // Calculate coords of centre of ring
-
-    int w = r / 4; // Width of outer ring is 1/4 of radius
-
-    int angle = 150; // Half the sweep angle of meter (300 degrees)
-
-    int v = map(value, vmin, vmax, -angle, angle); // Map the value to an angle v
-
-    byte seg = 5; // Segments are 5 degrees wide = 60 segments for 300 degrees
-    byte inc = 5; // Draw segments every 5 degrees, increase to 10 for segmented ring
-
-    // Draw colour blocks every inc degrees
-    for (int i = -angle; i < angle; i += inc)
+    /*
+     *   History Dump, oldest bucket first, each by its start in seconds before now
+     */
+    const trend_channel *view = &trend_channels[channel];
+    uint32_t seconds = historyBucketCycles(tier) * LOOP_PERIOD_MS / 1000;
+    float scale = powf(10, view->decimals);
+    SerialUSB.printf("History %s, %lus buckets, %u held\n", view->column, seconds, historyLength(tier));
+    SerialUSB.println("start_s,min,avg,max");
+    history_bucket bucket;
+    for (int age = historyLength(tier) - 1; age >= 0; age--)
     {
-        // Calculate pair of coordinates for segment start
-        float sx = cos((i - 90) * 0.0174532925);
-        float sy = sin((i - 90) * 0.0174532925);
-        uint16_t x0 = sx * (r - w) + x;
-        uint16_t y0 = sy * (r - w) + y;
-        uint16_t x1 = sx * r + x;
-        uint16_t y1 = sy * r + y;
-
-        // Calculate pair of coordinates for segment end
-        float sx2 = cos((i + seg - 90) * 0.0174532925);
-        float sy2 = sin((i + seg - 90) * 0.0174532925);
-        int x2 = sx2 * (r - w) + x;
-        int y2 = sy2 * (r - w) + y;
-        int x3 = sx2 * r + x;
-        int y3 = sy2 * r + y;
-
-        if (i < v)
-        { // Fill in coloured segments with 2 triangles
-            display.fillTriangle(x0, y0, x1, y1, x2, y2, SSD1306_WHITE);
-            display.fillTriangle(x1, y1, x2, y2, x3, y3, SSD1306_WHITE);
-        }
-        else // Fill in blank segments
-        {
-            display.fillTriangle(x0, y0, x1, y1, x2, y2, SSD1306_BLACK);
-            display.fillTriangle(x1, y1, x2, y2, x3, y3, SSD1306_BLACK);
-        }
+        int32_t start = -(int32_t)((age + 1) * seconds);
+        if (getHistoryBucket(channel, tier, age, &bucket))
+            SerialUSB.printf("%ld,%.*f,%.*f,%.*f\n", start, view->decimals, bucket.min / scale, view->decimals,
+                             bucket.avg / scale, view->decimals, bucket.max / scale);
+        else
+            SerialUSB.printf("%ld,,,\n", start);
     }
-
-    // Convert value to a string
-    char buf[10];
-    byte len = 1;
-    if (value > 9)
-        len = 2;
-    if (value > 99)
-        len = 3;
-    if (value > 999)
-        len = 4;
-    dtostrf(value, len, 0, buf);
-
-    // Set the text colour to default
-    display.setTextColor(SSD1306_WHITE, SSD1306_BLACK);
-
-    // Print reading
-    display.setTextSize(1);
-    display.setCursor(x - ((FONT_X * strlen(reading)) / 2), orig_y);
-    display.print(reading);
-
-    // Print value
-    display.setTextSize(2);
-    display.setCursor(x - (FONT_X * 2 * len / 2), y - FONT_Y); // Value in middle
-    display.print(buf);
-
-    // Print units
-
-    display.setTextSize(1);
-    display.setCursor(x - ((FONT_X * strlen(units)) / 2), y + FONT_Y); // Units display
-    display.print(units);
-
-    // Calculate and return right hand side x coordinate
-    return x + r;
-}
\ No newline at end of file
+}
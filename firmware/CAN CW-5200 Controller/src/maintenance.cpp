@@ -0,0 +1,107 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "maintenance.h"
+#include "settings.h"
+
+static_assert(sizeof(struct_settings) <= MAINTENANCE_ADDRESS, "settings overlap the maintenance counters");
+
+static struct_maintenance maintenance = {
+    .version = MAINTENANCE_VERSION,
+    .compressor_seconds = 0,
+    .compressor_starts = 0,
+    .short_cycles = 0,
+    .pump_seconds = 0,
+    .fan_seconds = 0,
+};
+
+// start times of the most recent compressor starts, oldest overwritten first
+static uint32_t starts[STARTS_TRACKED];
+static uint8_t starts_next = 0;
+static uint8_t starts_count = 0;
+
+static bool compressor_was_running = false;
+static bool pump_was_running = false;
+static bool fans_were_running = false;
+static uint32_t compressor_started = 0;
+static uint32_t last_update = 0;
+static uint32_t last_checkpoint = 0;
+
+// milliseconds not yet rolled into the whole-second counters
+static uint16_t compressor_ms = 0;
+static uint16_t pump_ms = 0;
+static uint16_t fan_ms = 0;
+
+static void accumulate(uint32_t *seconds, uint16_t *ms, uint32_t elapsed)
+{
+    elapsed += *ms;
+    *seconds += elapsed / 1000;
+    *ms = elapsed % 1000;
+}
+
+struct_maintenance *loadMaintenance()
+{
+    if (EEPROM.read(MAINTENANCE_ADDRESS) != MAINTENANCE_VERSION)
+    {
+        saveMaintenance();
+    }
+    else
+    {
+        EEPROM.get(MAINTENANCE_ADDRESS, maintenance);
+    }
+    last_update = millis();
+    last_checkpoint = last_update;
+    return &maintenance;
+}
+
+void saveMaintenance()
+{
+    EEPROM.put(MAINTENANCE_ADDRESS, maintenance);
+    last_checkpoint = millis();
+}
+
+void updateMaintenance(bool compressor, bool pump, bool fans)
+{
+    uint32_t now = millis();
+    uint32_t elapsed = now - last_update;
+    last_update = now;
+
+    if (compressor_was_running)
+        accumulate(&maintenance.compressor_seconds, &compressor_ms, elapsed);
+    if (pump_was_running)
+        accumulate(&maintenance.pump_seconds, &pump_ms, elapsed);
+    if (fans_were_running)
+        accumulate(&maintenance.fan_seconds, &fan_ms, elapsed);
+
+    if (compressor && !compressor_was_running)
+    {
+        compressor_started = now;
+        ++maintenance.compressor_starts;
+        starts[starts_next] = now;
+        starts_next = (starts_next + 1) % STARTS_TRACKED;
+        if (starts_count < STARTS_TRACKED)
+            ++starts_count;
+    }
+    else if (!compressor && compressor_was_running)
+    {
+        if (now - compressor_started < SHORT_CYCLE_MS)
+            ++maintenance.short_cycles;
+    }
+    compressor_was_running = compressor;
+    pump_was_running = pump;
+    fans_were_running = fans;
+
+    if (now - last_checkpoint >= MAINTENANCE_CHECKPOINT_MS)
+        saveMaintenance();
+}
+
+uint8_t getStartsPerHour()
+{
+    uint32_t now = millis();
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < starts_count; i++)
+    {
+        if (now - starts[i] < STARTS_WINDOW_MS)
+            ++count;
+    }
+    return count;
+}
@@ -0,0 +1,27 @@
+#ifndef __CW5200_MAINTENANCE__
+#define __CW5200_MAINTENANCE__
+#include <cstdint>
+
+#define MAINTENANCE_VERSION 1
+#define MAINTENANCE_ADDRESS 64                        // EEPROM offset, after struct_settings
+#define MAINTENANCE_CHECKPOINT_MS (15UL * 60 * 1000)  // at most one EEPROM write per 15 minutes
+#define SHORT_CYCLE_MS (5UL * 60 * 1000)              // compressor runs shorter than this are short cycles
+#define STARTS_WINDOW_MS (60UL * 60 * 1000)           // sliding window for starts per hour
+#define STARTS_TRACKED 16                             // more starts than this per window saturates
+
+struct struct_maintenance
+{
+    uint8_t version;
+    uint32_t compressor_seconds;
+    uint32_t compressor_starts;
+    uint32_t short_cycles;
+    uint32_t pump_seconds;
+    uint32_t fan_seconds;
+};
+
+struct_maintenance *loadMaintenance();
+void saveMaintenance();
+void updateMaintenance(bool compressor, bool pump, bool fans);
+uint8_t getStartsPerHour();
+
+#endif
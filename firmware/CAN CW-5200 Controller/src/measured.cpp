@@ -0,0 +1,29 @@
+#include "measured.h"
+
+void publishMeasured(const struct_measured *measured, struct_readings *readings)
+{
+    readings->reservoir.temperature = centiToCelsius(measured->reservoir);
+    readings->reservoir.setpoint = centiToCelsius(measured->setpoint);
+    readings->chassis.inside_temperature = centiToCelsius(measured->inside);
+    readings->chassis.outside_temperature = centiToCelsius(measured->outside);
+    readings->chassis.humidity = measured->humidity / 100.0f;
+    readings->reservoir.level_sense = measured->level_sense / 100.0f;
+    readings->reservoir.level_ref = measured->level_ref / 100.0f;
+    readings->chassis.filter_dp = measured->filter_dp;
+    readings->chassis.fan.top_tach = measured->top_tach / 10.0f;
+    readings->chassis.fan.bottom_tach = measured->bottom_tach / 10.0f;
+}
+
+void measuredFromReadings(const struct_readings *readings, struct_measured *measured)
+{
+    measured->reservoir = centiFromCelsius(readings->reservoir.temperature);
+    measured->setpoint = centiFromCelsius(readings->reservoir.setpoint);
+    measured->inside = centiFromCelsius(readings->chassis.inside_temperature);
+    measured->outside = centiFromCelsius(readings->chassis.outside_temperature);
+    measured->humidity = readings->chassis.humidity > 0 ? readings->chassis.humidity * 100.0f + 0.5f : 0;
+    measured->filter_dp = readings->chassis.filter_dp;
+    measured->level_sense = readings->reservoir.level_sense > 0 ? readings->reservoir.level_sense * 100.0f + 0.5f : 0;
+    measured->level_ref = readings->reservoir.level_ref > 0 ? readings->reservoir.level_ref * 100.0f + 0.5f : 0;
+    measured->top_tach = readings->chassis.fan.top_tach > 0 ? readings->chassis.fan.top_tach * 10.0f + 0.5f : 0;
+    measured->bottom_tach = readings->chassis.fan.bottom_tach > 0 ? readings->chassis.fan.bottom_tach * 10.0f + 0.5f : 0;
+}
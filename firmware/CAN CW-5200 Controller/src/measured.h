@@ -0,0 +1,39 @@
+#ifndef __CW5200_MEASURED__
+#define __CW5200_MEASURED__
+#include <cstdint>
+#include <fixed_point.h>
+#include "comms.h"
+
+/*
+ *   One cycle's measurements, in the sensors' own integer units
+ *
+ *   Control, the limit checks, the history and the black box work from
+ *   these, so a cycle's decisions take no soft-float calls. The float
+ *   fields of struct_readings are filled from them once a cycle by
+ *   publishMeasured(), for the telemetry, the CAN frames and the display.
+ *   The anomaly checks still read those floats: an EWMA variance and its
+ *   square root are float maths whatever units they start from.
+ *
+ *   The replay and plant builds begin from logged or simulated floats, and
+ *   come in through measuredFromReadings(); publishing that again gives
+ *   back the same floats to the last centidegree.
+ */
+
+struct struct_measured
+{
+    centi_c reservoir; // 0.01 degC
+    centi_c setpoint;
+    centi_c inside;
+    centi_c outside;
+    uint16_t humidity;    // 0.01 %RH
+    int16_t filter_dp;    // Pa
+    uint32_t level_sense; // 0.01 ADC count, as averaged
+    uint32_t level_ref;
+    deci_rpm top_tach;
+    deci_rpm bottom_tach;
+};
+
+void publishMeasured(const struct_measured *measured, struct_readings *readings);
+void measuredFromReadings(const struct_readings *readings, struct_measured *measured);
+
+#endif
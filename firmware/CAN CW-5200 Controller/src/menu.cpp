@@ -0,0 +1,177 @@
+#include <Arduino.h>
+#include <Adafruit_SSD1306.h>
+#include "menu.h"
+
+/*
+ *   On-device menu
+ *
+ *   A scrolling list of items, one per text row. Every row remembers the text
+ *   and highlight it was last drawn with, and only rows whose text changed are
+ *   cleared and redrawn; the display is only flushed when a row was. Moving
+ *   the cursor therefore costs two rows, and a live value ticking over costs
+ *   one, instead of a full-screen redraw.
+ */
+
+struct menu_row
+{
+    char text[MENU_COLUMNS + 1];
+    bool highlighted;
+};
+
+static Adafruit_SSD1306 *display = nullptr;
+static void (*show)() = nullptr;
+static const menu_item *items = nullptr;
+static uint8_t item_count = 0;
+
+static bool active = false;
+static bool editing = false;
+static uint8_t cursor = 0;
+static uint8_t top = 0;
+static float edit_value = 0.0;
+static uint32_t last_input = 0;
+static uint32_t last_refresh = 0;
+static menu_row rows[MENU_ROWS];
+
+static void invalidateRows()
+{
+    for (menu_row &row : rows)
+    {
+        row.text[0] = '\0';
+        row.highlighted = false;
+    }
+}
+
+static void formatItem(uint8_t index, char *text)
+{
+    const menu_item &item = items[index];
+    char value[MENU_COLUMNS + 1] = "";
+    bool edit = editing && index == cursor;
+    if (item.get == nullptr)
+        snprintf(value, sizeof(value), "%s", item.units);
+    else if (item.decimals == MENU_HEX)
+        snprintf(value, sizeof(value), "%04X%s", (unsigned)item.get(), item.units);
+    else
+        snprintf(value, sizeof(value), edit ? "[%.*f]%s" : "%.*f%s", item.decimals, edit ? edit_value : item.get(), item.units);
+    // label on the left, padded so the value ends at the right edge
+    int width = MENU_COLUMNS - (int)strlen(value);
+    snprintf(text, MENU_COLUMNS + 1, "%-*.*s%s", width, width, item.label, value);
+}
+
+static bool renderRows()
+{
+    bool dirty = false;
+    for (uint8_t row = 0; row < MENU_ROWS; row++)
+    {
+        char text[MENU_COLUMNS + 1] = "";
+        uint8_t index = top + row;
+        if (index < item_count)
+            formatItem(index, text);
+        bool highlighted = (index == cursor);
+        if (highlighted == rows[row].highlighted && strcmp(text, rows[row].text) == 0)
+            continue;
+        strcpy(rows[row].text, text);
+        rows[row].highlighted = highlighted;
+        uint16_t fg = highlighted ? SSD1306_BLACK : SSD1306_WHITE;
+        uint16_t bg = highlighted ? SSD1306_WHITE : SSD1306_BLACK;
+        display->fillRect(0, row * 8, display->width(), 8, bg);
+        display->setTextColor(fg, bg);
+        display->setCursor(0, row * 8);
+        display->print(text);
+        dirty = true;
+    }
+    display->setTextColor(SSD1306_WHITE);
+    return dirty;
+}
+
+static void moveCursor(int8_t turns)
+{
+    int16_t next = constrain(cursor + turns, 0, item_count - 1);
+    cursor = next;
+    if (cursor < top)
+        top = cursor;
+    else if (cursor >= top + MENU_ROWS)
+        top = cursor - MENU_ROWS + 1;
+}
+
+static void press()
+{
+    const menu_item &item = items[cursor];
+    switch (item.kind)
+    {
+    case MENU_EDIT:
+        if (editing)
+            item.set(edit_value);
+        else
+            edit_value = item.get();
+        editing = !editing;
+        break;
+    case MENU_ACTION:
+        item.set(0.0);
+        break;
+    default:
+        break;
+    }
+}
+
+void beginMenu(Adafruit_SSD1306 *screen, void (*flush)(), const menu_item *menu, uint8_t count)
+{
+    display = screen;
+    show = flush;
+    items = menu;
+    item_count = count;
+}
+
+bool updateMenu(int8_t turns, bool pressed)
+{
+    uint32_t now = millis();
+    bool input = (turns != 0 || pressed);
+    if (!active)
+    {
+        if (!input || display == nullptr || item_count == 0)
+            return false;
+        // the first touch only wakes the menu up
+        active = true;
+        editing = false;
+        last_input = now;
+        last_refresh = 0;
+        invalidateRows();
+        display->clearDisplay();
+    }
+    else if (input)
+    {
+        last_input = now;
+        if (editing)
+        {
+            const menu_item &item = items[cursor];
+            edit_value = constrain(edit_value + turns * item.step, item.min, item.max);
+        }
+        else
+        {
+            moveCursor(turns);
+        }
+        if (pressed)
+            press();
+        if (!active)
+            return false;
+    }
+    else if (now - last_input >= MENU_TIMEOUT_MS)
+    {
+        // an unfinished edit is dropped
+        closeMenu();
+        return false;
+    }
+
+    if (input || now - last_refresh >= MENU_REFRESH_MS)
+    {
+        last_refresh = now;
+        if (renderRows())
+            show();
+    }
+    return active;
+}
+
+void closeMenu()
+{
+    active = false;
+    editing = false;
+}
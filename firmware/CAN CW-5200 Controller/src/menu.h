@@ -0,0 +1,38 @@
+#ifndef __CW5200_MENU__
+#define __CW5200_MENU__
+#include <cstdint>
+
+class Adafruit_SSD1306;
+
+#define MENU_TIMEOUT_MS 30000  // back to the rotating pages after this long untouched
+#define MENU_REFRESH_MS 250    // live values are re-checked at most this often
+#define MENU_ROWS 8            // 64 px of 8 px text
+#define MENU_COLUMNS 21        // 128 px of 6 px characters
+#define MENU_HEX 0xFF          // decimals value that shows an item as 4 hex digits
+
+enum menu_kind : uint8_t
+{
+    MENU_VIEW = 0, // live value, read only
+    MENU_EDIT,     // press to edit, turn to change, press to commit
+    MENU_ACTION,   // press to run; shows get() if there is one, else units
+};
+
+struct menu_item
+{
+    const char *label;
+    menu_kind kind;
+    const char *units;
+    uint8_t decimals;
+    float min;
+    float max;
+    float step;
+    float (*get)();
+    void (*set)(float);
+};
+
+// show flushes the frame buffer to the panel
+void beginMenu(Adafruit_SSD1306 *display, void (*show)(), const menu_item *items, uint8_t count);
+bool updateMenu(int8_t turns, bool pressed);
+void closeMenu();
+
+#endif
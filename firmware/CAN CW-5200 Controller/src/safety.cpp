@@ -0,0 +1,138 @@
+#include "safety.h"
+
+static const struct_settings *settings = nullptr;
+static volatile struct_safety state;
+
+// written by loop(), read by the ISR; the temperature goes first, so a read
+// between the two pairs a new reading with the old time, never the reverse.
+// In integers, so the ISR makes no soft-float calls.
+static volatile centi_c snapshot = 0;
+static volatile uint32_t snapshot_ms = 0;
+static volatile bool have_snapshot = false;
+
+static uint8_t holdsFor(uint8_t trips)
+{
+    uint8_t holds = trips ? SAFETY_HOLD_ALARM : 0;
+    if (trips & (SAFETY_TRIP_NO_FLOW | SAFETY_TRIP_UNDER_TEMP | SAFETY_TRIP_STALE | SAFETY_TRIP_LOCKOUT))
+        holds |= SAFETY_HOLD_COMPRESSOR;
+    if (trips & SAFETY_TRIP_NO_FLOW)
+        holds |= SAFETY_HOLD_PUMP;
+    return holds;
+}
+
+void beginSafety(const struct_settings *s, uint32_t now)
+{
+    settings = s;
+    state.pump_started = now;
+    state.compressor_stopped = now - s->compressor_lockout;
+    state.flow_seen = now;
+}
+
+void reportSafetySnapshot(centi_c reservoir_temperature, uint32_t now)
+{
+    snapshot = reservoir_temperature;
+    snapshot_ms = now;
+    have_snapshot = true;
+}
+
+uint8_t serviceSafety(uint32_t now, bool flow_ok, bool pump_on, bool compressor_on)
+{
+    ++state.ticks;
+    uint8_t active = 0;
+
+    if (pump_on && !state.pump_on)
+        state.pump_started = now;
+    if (flow_ok || !pump_on)
+        state.flow_seen = now;
+    if (pump_on && now - state.pump_started >= SAFETY_FLOW_GRACE_MS && now - state.flow_seen >= SAFETY_NO_FLOW_MS)
+        active |= SAFETY_TRIP_NO_FLOW;
+
+    // the actuators hold the lockout to the ms; this only catches a restart well inside it
+    if (compressor_on && !state.compressor_on && settings->compressor_lockout > SAFETY_LOCKOUT_SLACK_MS &&
+        now - state.compressor_stopped < settings->compressor_lockout - SAFETY_LOCKOUT_SLACK_MS)
+        active |= SAFETY_TRIP_LOCKOUT;
+    if (!compressor_on && state.compressor_on)
+        state.compressor_stopped = now;
+    state.pump_on = pump_on;
+    state.compressor_on = compressor_on;
+
+    if (have_snapshot)
+    {
+        uint32_t taken = snapshot_ms;
+        centi_c temperature = snapshot;
+        if (now - taken >= SAFETY_SNAPSHOT_LEASE_MS)
+            active |= SAFETY_TRIP_STALE;
+        else if (temperature < settings->reservoir_temp_low_limit * 100)
+            active |= SAFETY_TRIP_UNDER_TEMP;
+        else if (temperature > settings->reservoir_temp_high_limit * 100)
+            active |= SAFETY_TRIP_OVER_TEMP;
+    }
+
+    uint8_t tripped = active & ~state.latched;
+    if (tripped)
+    {
+        state.latched |= tripped;
+        state.unread |= tripped;
+        state.holds = holdsFor(state.latched);
+        state.tripped_ms = now;
+        ++state.trips;
+    }
+    state.active = active;
+    return safetyHolds();
+}
+
+uint8_t takeSafetyTrips()
+{
+    uint8_t unread = state.unread;
+    state.unread = 0;
+    return unread;
+}
+
+void clearSafety()
+{
+    // a lockout breach is over once the compressor is held off; the rest stay while their cause does
+    state.latched &= state.active & ~SAFETY_TRIP_LOCKOUT;
+    state.unread &= state.latched;
+    state.holds = holdsFor(state.latched);
+}
+
+void getSafety(struct_safety *copy)
+{
+    copy->latched = state.latched;
+    copy->active = state.active;
+    copy->holds = state.holds;
+    copy->unread = state.unread;
+    copy->pump_on = state.pump_on;
+    copy->compressor_on = state.compressor_on;
+    copy->pump_started = state.pump_started;
+    copy->compressor_stopped = state.compressor_stopped;
+    copy->flow_seen = state.flow_seen;
+    copy->ticks = state.ticks;
+    copy->trips = state.trips;
+    copy->tripped_ms = state.tripped_ms;
+}
+
+uint8_t safetyHolds()
+{
+    // until the first reading the compressor is held too, untripped, as the control has nothing to start it on
+    return state.holds | (have_snapshot ? 0 : SAFETY_HOLD_COMPRESSOR);
+}
+
+const char *safetyTripName(safety_trip trip)
+{
+    switch (trip)
+    {
+    case SAFETY_TRIP_NO_FLOW:
+        return "No flow with pump on";
+    case SAFETY_TRIP_UNDER_TEMP:
+        return "Reservoir below low limit";
+    case SAFETY_TRIP_OVER_TEMP:
+        return "Reservoir above high limit";
+    case SAFETY_TRIP_STALE:
+        return "No reservoir temperature from the loop";
+    case SAFETY_TRIP_LOCKOUT:
+        return "Compressor restarted inside its lockout";
+    default:
+        return "Unknown";
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef __CW5200_SAFETY__
+#define __CW5200_SAFETY__
+#include <cstdint>
+#include <fixed_point.h>
+#include "settings.h"
+
+/*
+ *   Safety monitor, run from a timer interrupt rather than loop()
+ *
+ *   The interlocks in actuators.cpp only hold while loop() keeps coming
+ *   round; a stuck sensor read, a flash erase or a blocked Serial write
+ *   puts the next decision off by as long as it takes. serviceSafety() is
+ *   called every SAFETY_TICK_US from an IntervalTimer that preempts all of
+ *   that, with the flow switch and the relay pins read there and then, and
+ *   the reservoir temperature loop() last handed it. It trips on:
+ *
+ *     - the pump on with the flow switch open for SAFETY_NO_FLOW_MS, once
+ *       the pump has had SAFETY_FLOW_GRACE_MS to prime: compressor and pump off
+ *     - the reservoir below its low limit: compressor off
+ *     - the reservoir above its high limit: alarm only
+ *     - no temperature from loop() for SAFETY_SNAPSHOT_LEASE_MS: compressor
+ *       off, as the loop is stalled or blind
+ *     - the compressor restarting inside its compressor_lockout: compressor off
+ *
+ *   A trip is latched, and the outputs it holds are forced back every tick
+ *   until acknowledged, however often anything else drives them. loop() is
+ *   only told afterwards, to raise the error and bring the actuator state
+ *   into line; clearSafety() drops the trips whose cause has gone.
+ *
+ *   No pin I/O happens here, as in actuators.cpp: the board reads the pins
+ *   and drives the held outputs, the native builds pass in their own.
+ */
+
+#define SAFETY_TICK_US 2000           // serviceSafety() period
+#define SAFETY_PRIORITY 64            // NVIC priority, above the I2C queue, tachs and scope
+#define SAFETY_NO_FLOW_MS 500         // flow switch open this long with the pump on
+#define SAFETY_FLOW_GRACE_MS 3000     // after the pump starts, for the flow to come up
+#define SAFETY_SNAPSHOT_LEASE_MS 5000 // reservoir temperature goes stale if not reported this often
+#define SAFETY_LOCKOUT_SLACK_MS 100   // a relay edge is seen up to a tick late
+// worst case from the flow stopping to the compressor and pump relays off
+#define SAFETY_REACTION_MS (SAFETY_NO_FLOW_MS + 2 * SAFETY_TICK_US / 1000)
+
+enum safety_trip : uint8_t
+{
+    SAFETY_TRIP_NO_FLOW = 0x01,
+    SAFETY_TRIP_UNDER_TEMP = 0x02,
+    SAFETY_TRIP_OVER_TEMP = 0x04,
+    SAFETY_TRIP_STALE = 0x08,
+    SAFETY_TRIP_LOCKOUT = 0x10,
+};
+
+// outputs a latched trip holds
+#define SAFETY_HOLD_COMPRESSOR 0x01 // off
+#define SAFETY_HOLD_PUMP 0x02       // off
+#define SAFETY_HOLD_ALARM 0x04      // on
+
+struct struct_safety
+{
+    uint8_t latched = 0; // SAFETY_TRIP_*
+    uint8_t active = 0;  // conditions present at the last tick
+    uint8_t holds = 0;   // SAFETY_HOLD_*
+    uint8_t unread = 0;  // trips loop() has not taken yet
+    bool pump_on = false;
+    bool compressor_on = false;
+    uint32_t pump_started = 0;
+    uint32_t compressor_stopped = 0;
+    uint32_t flow_seen = 0;
+    uint32_t ticks = 0;
+    uint32_t trips = 0;
+    uint32_t tripped_ms = 0; // millis() of the last trip
+};
+
+void beginSafety(const struct_settings *settings, uint32_t now);
+// from loop(), with each good reservoir reading
+void reportSafetySnapshot(centi_c reservoir_temperature, uint32_t now);
+// from the timer ISR, with the pins as they are; returns SAFETY_HOLD_* to force
+uint8_t serviceSafety(uint32_t now, bool flow_ok, bool pump_on, bool compressor_on);
+
+// these three from loop(), with the timer interrupt masked
+uint8_t takeSafetyTrips(); // latched since the last call
+void clearSafety();
+void getSafety(struct_safety *);
+
+uint8_t safetyHolds(); // SAFETY_HOLD_*, safe from anywhere
+const char *safetyTripName(safety_trip);
+
+#endif
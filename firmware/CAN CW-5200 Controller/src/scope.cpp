@@ -0,0 +1,170 @@
+#include <Arduino.h>
+#include "scope.h"
+#include "fans.h"
+
+struct __attribute__((packed)) scope_frame
+{
+    struct_scope_header header;
+    uint8_t data[SCOPE_FRAME_BYTES - sizeof(struct_scope_header)];
+};
+
+static IntervalTimer scope_timer;
+static const scope_channel *channels = nullptr;
+static uint8_t channel_count = 0;
+
+static scope_frame frames[2];
+static uint16_t lengths[2];
+static volatile bool ready[2];
+static volatile uint8_t filling = 0;
+static volatile uint16_t latest[SCOPE_CHANNELS_MAX];
+static volatile bool running = false;
+static volatile struct_scope_stats stats;
+
+static uint32_t mask = 0;
+static uint16_t period = 0;
+static uint16_t sequence = 0;
+static uint16_t set_bytes = 0;
+
+static void openFrame(uint8_t index)
+{
+    frames[index].header.sync = SCOPE_SYNC;
+    frames[index].header.sequence = sequence++;
+    frames[index].header.period_us = period;
+    frames[index].header.channels = mask;
+    frames[index].header.samples = 0;
+    lengths[index] = 0;
+}
+
+static void scopeSample()
+{
+    uint32_t now = micros();
+    for (uint8_t i = 0; i < channel_count; i++)
+    {
+        switch (channels[i].kind)
+        {
+        case SCOPE_ANALOG:
+            latest[i] = analogRead(channels[i].source);
+            break;
+        case SCOPE_EDGES:
+            latest[i] = fanEdges(channels[i].source);
+            break;
+        case SCOPE_DIGITAL:
+            latest[i] = digitalReadFast(channels[i].source);
+            break;
+        }
+    }
+
+    scope_frame &frame = frames[filling];
+    uint8_t *out = frame.data + lengths[filling];
+    memcpy(out, &now, sizeof(now));
+    out += sizeof(now);
+    for (uint8_t i = 0; i < channel_count; i++)
+    {
+        if (mask & (1UL << i))
+        {
+            uint16_t value = latest[i];
+            memcpy(out, &value, sizeof(value));
+            out += sizeof(value);
+        }
+    }
+    lengths[filling] += set_bytes;
+    ++frame.header.samples;
+    if (lengths[filling] + set_bytes <= sizeof(frame.data))
+        return;
+
+    // full: hand it over, or drop it whole if the last one is still queued
+    uint8_t other = 1 - filling;
+    if (!ready[other])
+    {
+        ready[filling] = true;
+        filling = other;
+    }
+    else
+    {
+        ++stats.dropped;
+    }
+    openFrame(filling);
+}
+
+void beginScope(const scope_channel *list, uint8_t count)
+{
+    channels = list;
+    channel_count = min(count, (uint8_t)SCOPE_CHANNELS_MAX);
+}
+
+bool startScope(uint32_t channel_mask, uint16_t period_us)
+{
+    channel_mask &= (1UL << channel_count) - 1;
+    if (channel_mask == 0 || period_us < SCOPE_PERIOD_MIN_US)
+        return false;
+    stopScope();
+    mask = channel_mask;
+    period = period_us;
+    set_bytes = sizeof(uint32_t) + sizeof(uint16_t) * __builtin_popcount(mask);
+    ready[0] = ready[1] = false;
+    filling = 0;
+    openFrame(0);
+    stats.sent = 0;
+    stats.dropped = 0;
+    // seed the readings scopeAnalog() hands out before the first tick
+    for (uint8_t i = 0; i < channel_count; i++)
+    {
+        if (channels[i].kind == SCOPE_ANALOG)
+            latest[i] = analogRead(channels[i].source);
+    }
+    scope_timer.priority(SCOPE_PRIORITY);
+    running = scope_timer.begin(scopeSample, period);
+    return running;
+}
+
+void stopScope()
+{
+    if (!running)
+        return;
+    scope_timer.end();
+    running = false;
+    ready[0] = ready[1] = false;
+}
+
+bool scopeRunning()
+{
+    return running;
+}
+
+void serviceScope(Print &out)
+{
+    if (!running)
+        return;
+    uint8_t sending = 1 - filling;
+    if (!ready[sending])
+        return;
+    size_t size = sizeof(struct_scope_header) + lengths[sending];
+    if ((size_t)out.availableForWrite() < size)
+        return; // try again next pass; meanwhile the ISR drops rather than waits
+    out.write((const uint8_t *)&frames[sending], size);
+    ++stats.sent;
+    ready[sending] = false;
+}
+
+bool scopeAnalog(uint8_t pin, uint16_t *value)
+{
+    if (!running)
+        return false;
+    for (uint8_t i = 0; i < channel_count; i++)
+    {
+        if (channels[i].kind == SCOPE_ANALOG && channels[i].source == pin)
+        {
+            *value = latest[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+void getScopeStats(struct_scope_stats *out)
+{
+    noInterrupts();
+    out->sent = stats.sent;
+    out->dropped = stats.dropped;
+    interrupts();
+}
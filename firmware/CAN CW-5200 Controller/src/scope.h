@@ -0,0 +1,70 @@
+#ifndef __CW5200_SCOPE__
+#define __CW5200_SCOPE__
+#include <cstdint>
+
+class Print;
+
+#define SCOPE_CHANNELS_MAX 16    // bits in the channel mask that may be set
+#define SCOPE_FRAME_BYTES 480    // under the 512 bytes the USB serial buffers take in one write
+#define SCOPE_PERIOD_MIN_US 250  // three analogRead()s must fit well inside a period
+#define SCOPE_PRIORITY 192       // below the tach, encoder and USB interrupts
+#define SCOPE_SYNC 0x504F4353    // "SCOP"
+
+/*
+ *   Binary sample stream over USB ("scope mode")
+ *
+ *   An IntervalTimer samples the chosen channels every period_us and packs
+ *   timestamped sample sets into one of two frames. When a frame fills it is
+ *   handed to the loop and the ISR carries on in the other one; if the loop has
+ *   not sent the previous frame yet, the new one is thrown away whole and its
+ *   sequence number skipped, so a slow host loses frames, never stalls the
+ *   firmware and never sees a torn frame. serviceScope() only writes a frame
+ *   when the USB buffers can take all of it, so text printed between frames
+ *   cannot land inside one; the host resynchronises on SCOP.
+ *
+ *   Frame: struct_scope_header, then samples sets of
+ *     uint32_t time_us, uint16_t value per channel bit set, lowest bit first
+ *
+ *   The ISR reads every analog channel each tick, not just the streamed ones,
+ *   and the loop takes its readings from scopeAnalog() while it runs, so the
+ *   ADC is never used from both sides at once.
+ */
+
+enum scope_kind : uint8_t
+{
+    SCOPE_ANALOG = 0, // source: analog pin, value: raw ADC count
+    SCOPE_EDGES,      // source: fan index, value: tach edge count (wraps)
+    SCOPE_DIGITAL,    // source: pin, value: 0 or 1
+};
+
+struct scope_channel
+{
+    const char *name;
+    scope_kind kind;
+    uint8_t source;
+};
+
+struct __attribute__((packed)) struct_scope_header
+{
+    uint32_t sync;     // SCOPE_SYNC
+    uint16_t sequence; // one per frame filled, sent or dropped
+    uint16_t period_us;
+    uint32_t channels; // mask of the channels in each sample set
+    uint16_t samples;  // sample sets in this frame
+};
+
+struct struct_scope_stats
+{
+    uint32_t sent;
+    uint32_t dropped;
+};
+
+void beginScope(const scope_channel *channels, uint8_t count);
+bool startScope(uint32_t mask, uint16_t period_us);
+void stopScope();
+bool scopeRunning();
+void serviceScope(Print &out);
+bool scopeAnalog(uint8_t pin, uint16_t *value);
+void getScopeStats(struct_scope_stats *out);
+
+#endif
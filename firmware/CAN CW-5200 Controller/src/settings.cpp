@@ -1,9 +1,9 @@
 #include "settings.h"
 
 static struct_settings settings = {
-    .version = 3,
-    .filter_high_limit = 500,
-    .filter_zero = 100,
+    .version = 6,
+    .filter_high_limit = 250,
+    .filter_zero = 0,
     .case_temperature_high_limit = 100,
     .case_temperature_low_limit = 0,
     .case_humidity_high_limit = 80,
@@ -15,7 +15,10 @@ static struct_settings settings = {
     .outside_temp_low_limit = 0,
     .valve_lockout = 30 * 1000,
     .compressor_lockout = 60 * 1000,
+    .compressor_starts_limit = 6,
     .hysteresis = 2.0,
+    .feedforward_horizon = 30,
+    .thermal_mass = 30,
 };
 
 void saveSettings(struct_settings *new_settings)
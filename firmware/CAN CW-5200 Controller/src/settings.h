@@ -6,8 +6,8 @@
 struct struct_settings
 {
     uint8_t version;
-    uint16_t filter_high_limit;
-    uint16_t filter_zero;
+    int16_t filter_high_limit; // Pa
+    int16_t filter_zero;       // Pa, subtracted before the trend
     uint8_t case_temperature_high_limit;
     uint8_t case_temperature_low_limit;
     uint8_t case_humidity_high_limit;
@@ -21,11 +21,14 @@ struct struct_settings
 
     uint32_t valve_lockout;
     uint32_t compressor_lockout;
+    uint8_t compressor_starts_limit;
 
     float hysteresis;
+    uint16_t feedforward_horizon; // s to look ahead on the loop's heat load, 0 for none
+    uint16_t thermal_mass;        // kJ/K of the reservoir and its water
 };
 
-void saveSettings(struct_settings);
+void saveSettings(struct_settings *);
 
 struct_settings *loadSettings();
 
@@ -0,0 +1,224 @@
+#include <cstdio>
+#include <timer_wheel.h>
+
+/*
+ *   Timer wheel across the millis() wrap
+ *
+ *   The wheel is driven directly, a millisecond at a time as loop() would,
+ *   with delays from nothing to several turns of the wheel: a one-shot
+ *   timer for each, a periodic one that reschedules itself from its
+ *   callback, one cancelled before it is due, one moved while armed, a
+ *   callback that cancels another due in the same tick, and an advance()
+ *   that comes seconds late. Each timer must fire once, never before its
+ *   deadline and within one tick after it. Everything is run once from just
+ *   after a reset and again from WRAP_LEAD_MS short of 2^32 ms, so every
+ *   deadline but the shortest lies across the wrap, and the exit status is
+ *   1 if any check fails:
+ *
+ *     wheel
+ */
+
+#define WRAP_LEAD_MS 3000   // the second pass starts this far short of 2^32 ms
+#define PERIODIC_MS 100     // the self-rescheduling timer's period
+#define RUN_MS 12000        // long enough for the longest delay, from either start
+#define LATE_MS 5000        // how long advance() is not called for in the late scenario
+#define MAX_FIRES 200
+
+struct probe
+{
+    wheel_timer timer;
+    uint32_t delay = 0;
+    uint32_t scheduled_at = 0;
+    uint32_t fires = 0;
+    uint32_t fired_at[MAX_FIRES];
+};
+
+static timer_wheel wheel;
+static uint32_t failures = 0;
+static uint32_t checks = 0;
+static const char *scenario = "";
+static uint32_t start = 0;
+
+static void check(bool ok, const char *what)
+{
+    ++checks;
+    if (ok)
+        return;
+    ++failures;
+    printf("  %s: FAILED %s\n", scenario, what);
+}
+
+static void record(wheel_timer *timer, uint32_t now)
+{
+    probe *p = (probe *)timer->context;
+    if (p->fires < MAX_FIRES)
+        p->fired_at[p->fires] = now;
+    ++p->fires;
+}
+
+static void periodic(wheel_timer *timer, uint32_t now)
+{
+    record(timer, now);
+    wheel.schedule(timer, now, PERIODIC_MS);
+}
+
+static void arm(probe *p, uint32_t now, uint32_t delay, void (*fire)(wheel_timer *, uint32_t) = record)
+{
+    p->timer.fire = fire;
+    p->timer.context = p;
+    p->delay = delay;
+    p->scheduled_at = now;
+    wheel.schedule(&p->timer, now, delay);
+}
+
+static void run(uint32_t from, uint32_t ms)
+{
+    for (uint32_t now = from; now != from + ms; now++)
+        wheel.advance(now);
+}
+
+// fired once, at or after its deadline and inside the tick after it
+static void checkFired(const probe &p)
+{
+    char what[96];
+    uint32_t deadline = p.scheduled_at + p.delay;
+    uint32_t after = p.fires ? p.fired_at[0] - deadline : 0;
+    snprintf(what, sizeof(what), "%lu ms timer fired %lu times, %ld ms after its deadline", (unsigned long)p.delay,
+             (unsigned long)p.fires, (long)(int32_t)after);
+    check(p.fires == 1 && (int32_t)after >= 0 && after < TIMER_WHEEL_TICK_MS, what);
+}
+
+// one-shots from 0 ms to several turns of the wheel
+static void oneShots()
+{
+    scenario = "one-shots";
+    static const uint32_t delays[] = {0,    1,    TIMER_WHEEL_TICK_MS - 1, TIMER_WHEEL_TICK_MS,
+                                      17,   1000, TIMER_WHEEL_SLOTS * TIMER_WHEEL_TICK_MS, 1025,
+                                      2999, 3000, 3001, 5000, 10000};
+    static probe probes[sizeof(delays) / sizeof(delays[0])];
+    wheel.begin(start);
+    // a few scheduled off a tick boundary, as loop() rarely lands on one
+    for (uint32_t i = 0; i < sizeof(delays) / sizeof(delays[0]); i++)
+    {
+        probes[i] = probe();
+        arm(&probes[i], start + (i % 3) * 5, delays[i]);
+    }
+    run(start, RUN_MS);
+    for (const probe &p : probes)
+        checkFired(p);
+}
+
+// rescheduled from its own callback: every period, without drifting or doubling up at the wrap
+static void periodicTimer()
+{
+    scenario = "periodic";
+    static probe p;
+    wheel.begin(start);
+    p = probe();
+    arm(&p, start, PERIODIC_MS, periodic);
+    run(start, RUN_MS);
+    // each period runs from the last fire, as the actuators' fan ramp schedules it, so up to a tick longer
+    uint32_t fewest = RUN_MS / (PERIODIC_MS + TIMER_WHEEL_TICK_MS);
+    uint32_t most = RUN_MS / PERIODIC_MS;
+    char what[96];
+    snprintf(what, sizeof(what), "%lu fires, expected %lu to %lu", (unsigned long)p.fires, (unsigned long)fewest,
+             (unsigned long)most);
+    check(p.fires >= fewest && p.fires <= most, what);
+    uint32_t last = start;
+    for (uint32_t i = 0; i < p.fires && i < MAX_FIRES; i++)
+    {
+        uint32_t after = p.fired_at[i] - (last + PERIODIC_MS);
+        snprintf(what, sizeof(what), "fire %lu %ld ms after its deadline", (unsigned long)i, (long)(int32_t)after);
+        check((int32_t)after >= 0 && after < TIMER_WHEEL_TICK_MS, what);
+        last = p.fired_at[i];
+    }
+}
+
+// cancelled before its deadline never fires; moved while armed fires only at the new deadline
+static void cancelAndMove()
+{
+    scenario = "cancel and move";
+    static probe cancelled, moved;
+    wheel.begin(start);
+    cancelled = probe();
+    moved = probe();
+    arm(&cancelled, start, WRAP_LEAD_MS + 500);
+    arm(&moved, start, 1000);
+    run(start, 500);
+    wheel.cancel(&cancelled.timer);
+    wheel.cancel(&cancelled.timer); // a second cancel is a no-op
+    arm(&moved, start + 500, WRAP_LEAD_MS);
+    char what[64];
+    snprintf(what, sizeof(what), "%lu ms left", (unsigned long)wheel.remaining(&moved.timer, start + 500));
+    check(wheel.remaining(&moved.timer, start + 500) == WRAP_LEAD_MS, what);
+    run(start + 500, RUN_MS);
+    check(cancelled.fires == 0 && !cancelled.timer.armed, "cancelled timer fired");
+    checkFired(moved);
+    check(wheel.remaining(&moved.timer, start + RUN_MS) == 0, "time left on a fired timer");
+}
+
+static probe victim;
+
+static void cancelVictim(wheel_timer *timer, uint32_t now)
+{
+    record(timer, now);
+    wheel.cancel(&victim.timer);
+}
+
+// a callback cancels another timer already found due in the same tick
+static void cancelFromCallback()
+{
+    scenario = "cancel from a callback";
+    static probe killer;
+    wheel.begin(start);
+    killer = probe();
+    victim = probe();
+    arm(&killer, start, WRAP_LEAD_MS, cancelVictim);
+    arm(&victim, start, WRAP_LEAD_MS);
+    run(start, RUN_MS);
+    checkFired(killer);
+    check(victim.fires == 0, "cancelled timer fired after the callback cancelled it");
+}
+
+// advance() is not called for LATE_MS: everything due fires on the next call, nothing early
+static void lateAdvance()
+{
+    scenario = "late advance";
+    static probe due[3], later;
+    wheel.begin(start);
+    for (probe &p : due)
+        p = probe();
+    later = probe();
+    arm(&due[0], start, 100);
+    arm(&due[1], start, WRAP_LEAD_MS);
+    arm(&due[2], start, LATE_MS - 1);
+    arm(&later, start, LATE_MS + 2000);
+    run(start, 10);
+    uint32_t resumed = start + LATE_MS;
+    run(resumed, 1);
+    for (const probe &p : due)
+        check(p.fires == 1 && p.fired_at[0] == resumed, "due timer not fired on the late call");
+    check(later.fires == 0, "timer fired early on the late call");
+    run(resumed + 1, RUN_MS - LATE_MS);
+    checkFired(later);
+}
+
+int main()
+{
+    void (*const scenarios[])() = {oneShots, periodicTimer, cancelAndMove, cancelFromCallback, lateAdvance};
+    const uint32_t starts[] = {1000, (uint32_t)(0 - WRAP_LEAD_MS)};
+    uint32_t runs = 0;
+    for (uint32_t from : starts)
+    {
+        start = from;
+        printf("from %lums\n", (unsigned long)start);
+        for (auto run_scenario : scenarios)
+        {
+            run_scenario();
+            ++runs;
+        }
+    }
+    printf("%lu scenarios run, %lu checks, %lu failed\n", (unsigned long)runs, (unsigned long)checks,
+           (unsigned long)failures);
+    return failures ? 1 : 0;
+}
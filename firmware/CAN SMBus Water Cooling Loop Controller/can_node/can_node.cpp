@@ -0,0 +1,75 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <FlexCAN_T4.h>
+#include <cstdio>
+#include <cstdlib>
+#include <poll.h>
+
+#include "canbus.h"
+#include "link.h"
+
+/*
+ *   The loop controller's CAN node, natively
+ *
+ *   canbus.cpp and link.cpp as they are: readings from the chiller's end on
+ *   the pty are republished on the bus through can_frames.cpp, its faults
+ *   raised as alarms, and the host's commands passed on to it and acked.
+ *   The interlock is left with the host on and both loops flowing. The bus
+ *   is a SocketCAN interface, or fd:N for one end of a socketpair; it runs
+ *   until the pty or the bus hangs up, then prints the counters:
+ *
+ *     can_node PORT BUS [SPEEDUP]
+ *
+ *   tools/can_test.py runs it between the chiller's link_end and can_host.
+ */
+
+#define CAN_NODE_STANDBY_PIN 2
+#define CAN_NODE_POLL_MS 1
+
+double link_speedup = 1;
+EEPROMClass EEPROM;
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s PORT BUS [SPEEDUP]\n", argv[0]);
+        return 2;
+    }
+    if (argc > 3)
+        link_speedup = atof(argv[3]);
+    Stream port;
+    if (!port.open(argv[1]))
+    {
+        perror(argv[1]);
+        return 2;
+    }
+    if (!openCANBus(argv[2]))
+    {
+        perror(argv[2]);
+        return 2;
+    }
+    beginLink(port);
+    beginCAN(CAN_NODE_STANDBY_PIN);
+
+    struct_interlock interlock;
+    interlock.state = INTERLOCK_HOST_ON;
+    interlock.host_on = true;
+    interlock.int_flow_ok = true;
+    interlock.ext_flow_ok = true;
+    interlock.temps_ok = true;
+    while (!port.hungUp() && !canBusClosed())
+    {
+        serviceLink();
+        serviceCAN(&interlock);
+        pollfd wait[] = {{port.descriptor(), POLLIN, 0}, {canBusDescriptor(), POLLIN, 0}};
+        poll(wait, 2, CAN_NODE_POLL_MS);
+    }
+
+    const struct_can_stats *stats = canStats();
+    printf("stats sent %lu received %lu overruns %lu commands %lu acks %lu alarms %lu readings %lu\n",
+           (unsigned long)stats->sent, (unsigned long)stats->received, (unsigned long)stats->overruns,
+           (unsigned long)stats->commands, (unsigned long)stats->acks, (unsigned long)stats->alarms,
+           (unsigned long)stats->readings);
+    return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef __LOOP_FAULT_REPLAY_ARDUINO__
+#define __LOOP_FAULT_REPLAY_ARDUINO__
+#include <cstdint>
+
+/*
+ *   Just enough of the Arduino core for interlock.cpp to build natively.
+ *   Pins are an array the replay sets and reads, time is the replay's clock,
+ *   and the timer never fires: the replay calls the tick itself.
+ */
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define REPLAY_PINS 64
+
+extern uint32_t replay_millis;
+extern uint8_t replay_pins[REPLAY_PINS];
+
+inline uint32_t millis() { return replay_millis; }
+inline void pinMode(uint8_t, uint8_t) {}
+inline uint8_t digitalRead(uint8_t pin) { return replay_pins[pin]; }
+inline uint8_t digitalReadFast(uint8_t pin) { return replay_pins[pin]; }
+inline void digitalWrite(uint8_t pin, uint8_t level) { replay_pins[pin] = level; }
+inline void digitalWriteFast(uint8_t pin, uint8_t level) { replay_pins[pin] = level; }
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+class IntervalTimer
+{
+public:
+    void priority(uint8_t) {}
+    bool begin(void (*)(), uint32_t) { return true; }
+};
+
+#endif
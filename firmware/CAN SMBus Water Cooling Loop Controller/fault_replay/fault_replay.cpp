@@ -0,0 +1,327 @@
+#include <Arduino.h>
+#include <cstdio>
+#include <cstring>
+
+#include "interlock.h"
+
+/*
+ *   Fault replay of the front panel interlock
+ *
+ *   Scripted host, button, flow and health inputs are stepped through
+ *   serviceInterlock() a tick at a time, as its timer would. A small model
+ *   of the motherboard stands in for the host: a short press turns it on,
+ *   or starts the OS shutting down; a press held for ATX_FORCE_MS cuts the
+ *   supply. Each scenario checks the FP_PWR_OUT pulses and the states and
+ *   faults it ends in. Everything is run once from just after a reset and
+ *   again across the millis() wrap, and the exit status is 1 if any check
+ *   fails:
+ *
+ *     fault_replay
+ */
+
+#define PIN_PWR_IN 2
+#define PIN_PWR_OUT 3
+#define PIN_PERST 4
+#define PIN_INT_FLOW 5
+#define PIN_EXT_FLOW 6
+#define FLOW_EDGE_MS 20       // flow sensor pulses while flowing
+#define REPORT_MS 500         // the loop's health reports
+#define ATX_FORCE_MS 4000     // a press this long turns the supply off
+#define OS_SHUTDOWN_MS 2000   // from a short press to the host powering down
+#define WRAP_LEAD_MS 5000     // the second pass starts this far short of 2^32 ms
+#define MAX_PULSES 8
+
+uint32_t replay_millis = 0;
+uint8_t replay_pins[REPLAY_PINS];
+
+struct pulse
+{
+    uint32_t start; // ms into the scenario
+    uint32_t length;
+};
+
+struct rig
+{
+    uint32_t started = 0;
+    // inputs
+    bool button = false;
+    bool int_flow = true;
+    bool ext_flow = true;
+    bool temps_ok = true;
+    bool reporting = true;
+    bool os_hung = false; // ignores short presses
+    // the host
+    bool host_on = false;
+    bool shutting_down = false;
+    uint32_t shutdown_at = 0;
+    // what the interlock did
+    pulse pulses[MAX_PULSES];
+    uint8_t pulse_count = 0;
+    bool was_pressed = false;
+    uint32_t pressed_at = 0;
+    uint32_t failures = 0;
+    const char *name = "";
+
+    void begin(const char *scenario, uint32_t start, bool host)
+    {
+        name = scenario;
+        started = start;
+        replay_millis = start;
+        host_on = host;
+        setPins();
+        beginInterlock(PIN_PWR_IN, PIN_PWR_OUT, PIN_PERST, PIN_INT_FLOW, PIN_EXT_FLOW);
+    }
+
+    uint32_t elapsed() const { return replay_millis - started; }
+
+    void setPins()
+    {
+        replay_pins[PIN_PERST] = host_on ? HIGH : LOW;
+        replay_pins[PIN_PWR_IN] = button ? LOW : HIGH;
+        // the internal pump runs off the host's supply
+        bool int_flowing = int_flow && host_on;
+        if (int_flowing && replay_millis % FLOW_EDGE_MS == 0)
+            replay_pins[PIN_INT_FLOW] = !replay_pins[PIN_INT_FLOW];
+        if (ext_flow && replay_millis % FLOW_EDGE_MS == 0)
+            replay_pins[PIN_EXT_FLOW] = !replay_pins[PIN_EXT_FLOW];
+    }
+
+    void host(bool pressed)
+    {
+        uint32_t now = elapsed();
+        if (pressed && !was_pressed)
+            pressed_at = now;
+        if (pressed && host_on && now - pressed_at >= ATX_FORCE_MS)
+        {
+            host_on = false;
+            shutting_down = false;
+        }
+        if (!pressed && was_pressed)
+        {
+            if (pulse_count < MAX_PULSES)
+                pulses[pulse_count] = {pressed_at, now - pressed_at};
+            ++pulse_count;
+            if (now - pressed_at < ATX_FORCE_MS)
+            {
+                if (!host_on)
+                    host_on = true;
+                else if (!os_hung && !shutting_down)
+                {
+                    shutting_down = true;
+                    shutdown_at = now + OS_SHUTDOWN_MS;
+                }
+            }
+        }
+        was_pressed = pressed;
+        if (shutting_down && now >= shutdown_at)
+        {
+            host_on = false;
+            shutting_down = false;
+        }
+    }
+
+    void run(uint32_t ms)
+    {
+        for (uint32_t i = 0; i < ms; i++)
+        {
+            ++replay_millis;
+            setPins();
+            if (reporting && elapsed() % REPORT_MS == 0)
+                reportLoopTemperatures(temps_ok);
+            serviceInterlock();
+            host(replay_pins[PIN_PWR_OUT] == FP_PRESSED);
+        }
+    }
+
+    void check(bool ok, const char *what)
+    {
+        if (ok)
+            return;
+        ++failures;
+        printf("  %s: FAILED %s at +%lums\n", name, what, (unsigned long)elapsed());
+    }
+
+    void checkState(interlock_state state, interlock_fault fault)
+    {
+        struct_interlock interlock;
+        getInterlock(&interlock);
+        char what[64];
+        snprintf(what, sizeof(what), "state %s fault %d, expected %s fault %d", interlockStateName(interlock.state),
+                 interlock.fault, interlockStateName(state), fault);
+        check(interlock.state == state && interlock.fault == fault, what);
+    }
+
+    void checkPulse(uint8_t index, uint32_t earliest, uint32_t latest, uint32_t min_length, uint32_t max_length)
+    {
+        char what[80];
+        if (index >= pulse_count)
+        {
+            snprintf(what, sizeof(what), "no press %u", index);
+            check(false, what);
+            return;
+        }
+        const pulse &p = pulses[index];
+        snprintf(what, sizeof(what), "press %u at +%lums for %lums", index, (unsigned long)p.start,
+                 (unsigned long)p.length);
+        check(p.start >= earliest && p.start <= latest && p.length >= min_length && p.length <= max_length, what);
+    }
+};
+
+// a reset under a running host, healthy loop: nothing may be pressed
+static uint32_t resetUnderRunningHost(uint32_t start)
+{
+    rig r;
+    r.begin("reset under running host", start, true);
+    r.run(30000);
+    r.check(r.pulse_count == 0, "no presses");
+    r.check(r.host_on, "host still on");
+    r.checkState(INTERLOCK_HOST_ON, INTERLOCK_FAULT_NONE);
+    return r.failures;
+}
+
+// a reset with the loop never reporting: shut down once BOOT_REPORT_MS is up
+static uint32_t resetWithoutReports(uint32_t start)
+{
+    rig r;
+    r.reporting = false;
+    r.begin("reset, loop silent", start, true);
+    r.run(BOOT_REPORT_MS - 10);
+    r.check(r.pulse_count == 0 && !r.was_pressed, "no press inside the boot grace");
+    r.run(20000);
+    r.checkPulse(0, BOOT_REPORT_MS, BOOT_REPORT_MS + 2, ORDERLY_PULSE_MS, ORDERLY_PULSE_MS + 2);
+    r.check(!r.host_on, "host off");
+    r.checkState(INTERLOCK_HOST_OFF, INTERLOCK_FAULT_STALE_HEALTH);
+    return r.failures;
+}
+
+// the user turns the host on, and off again
+static uint32_t buttonPassesThrough(uint32_t start)
+{
+    rig r;
+    r.begin("button passes through", start, false);
+    r.run(2000);
+    r.button = true;
+    r.run(200);
+    r.button = false;
+    r.run(10000);
+    r.check(r.host_on, "host on");
+    r.checkState(INTERLOCK_HOST_ON, INTERLOCK_FAULT_NONE);
+    r.button = true;
+    r.run(300);
+    r.button = false;
+    r.run(5000);
+    r.checkPulse(0, 2000, 2002, 198, 202);
+    r.checkPulse(1, 12200, 12202, 298, 302);
+    r.check(!r.host_on, "host off");
+    r.checkState(INTERLOCK_HOST_OFF, INTERLOCK_FAULT_NONE);
+    return r.failures;
+}
+
+// no external flow: the power button is refused
+static uint32_t pressBlockedWithoutFlow(uint32_t start)
+{
+    rig r;
+    r.ext_flow = false;
+    r.begin("press blocked, no flow", start, false);
+    struct_interlock before;
+    getInterlock(&before);
+    r.run(3000);
+    r.button = true;
+    r.run(200);
+    r.button = false;
+    r.run(3000);
+    struct_interlock after;
+    getInterlock(&after);
+    r.check(r.pulse_count == 0 && !r.host_on, "host kept off");
+    r.check(after.blocked_presses == before.blocked_presses + 1, "one press counted as blocked");
+    r.checkState(INTERLOCK_HOST_OFF, INTERLOCK_FAULT_EXT_FLOW);
+    return r.failures;
+}
+
+// the external loop stops while the host runs: orderly shutdown
+static uint32_t externalFlowLost(uint32_t start)
+{
+    rig r;
+    r.begin("external flow lost", start, true);
+    r.run(20000);
+    r.ext_flow = false;
+    r.run(10000);
+    r.checkPulse(0, 20000 + FLOW_TIMEOUT_MS - FLOW_EDGE_MS, 20000 + FLOW_TIMEOUT_MS + 2, ORDERLY_PULSE_MS,
+                 ORDERLY_PULSE_MS + 2);
+    r.check(r.pulse_count == 1, "one press");
+    r.check(!r.host_on, "host off");
+    r.checkState(INTERLOCK_HOST_OFF, INTERLOCK_FAULT_EXT_FLOW);
+    return r.failures;
+}
+
+// the internal pump stops: forced off without waiting for the OS
+static uint32_t internalFlowLost(uint32_t start)
+{
+    rig r;
+    r.begin("internal flow lost", start, true);
+    r.run(20000);
+    r.int_flow = false;
+    r.run(FLOW_TIMEOUT_MS + 100);
+    r.checkState(INTERLOCK_FORCED_SHUTDOWN, INTERLOCK_FAULT_INT_FLOW);
+    r.run(10000);
+    // the supply drops after ATX_FORCE_MS of the press, which ends it
+    r.checkPulse(0, 20000 + FLOW_TIMEOUT_MS - FLOW_EDGE_MS, 20000 + FLOW_TIMEOUT_MS + 2, ATX_FORCE_MS,
+                 ATX_FORCE_MS + 2);
+    r.check(!r.host_on, "host off");
+    // with the host off its pump is not expected to run, so the fault clears
+    r.checkState(INTERLOCK_HOST_OFF, INTERLOCK_FAULT_NONE);
+    return r.failures;
+}
+
+// the coolant overheats: orderly shutdown
+static uint32_t overTemperature(uint32_t start)
+{
+    rig r;
+    r.begin("over temperature", start, true);
+    r.run(20000);
+    r.temps_ok = false;
+    r.run(10000);
+    r.checkPulse(0, 20000, 20000 + REPORT_MS + 2, ORDERLY_PULSE_MS, ORDERLY_PULSE_MS + 2);
+    r.check(!r.host_on, "host off");
+    r.checkState(INTERLOCK_HOST_OFF, INTERLOCK_FAULT_TEMPERATURE);
+    return r.failures;
+}
+
+// the OS ignores the short press: forced off after ORDERLY_TIMEOUT_MS
+static uint32_t orderlyTimeout(uint32_t start)
+{
+    rig r;
+    r.os_hung = true;
+    r.begin("orderly timeout", start, true);
+    r.run(20000);
+    r.temps_ok = false;
+    r.run(ORDERLY_TIMEOUT_MS + 10000);
+    r.checkPulse(0, 20000, 20000 + REPORT_MS + 2, ORDERLY_PULSE_MS, ORDERLY_PULSE_MS + 2);
+    uint32_t forced = r.pulse_count > 0 ? r.pulses[0].start + ORDERLY_TIMEOUT_MS : 0;
+    r.checkPulse(1, forced, forced + 2, ATX_FORCE_MS, ATX_FORCE_MS + 2);
+    r.check(!r.host_on, "host off");
+    r.checkState(INTERLOCK_HOST_OFF, INTERLOCK_FAULT_TEMPERATURE);
+    return r.failures;
+}
+
+int main()
+{
+    uint32_t (*const scenarios[])(uint32_t) = {
+        resetUnderRunningHost, resetWithoutReports, buttonPassesThrough, pressBlockedWithoutFlow,
+        externalFlowLost,      internalFlowLost,    overTemperature,     orderlyTimeout,
+    };
+    const uint32_t starts[] = {1000, (uint32_t)(0 - WRAP_LEAD_MS)};
+    uint32_t failures = 0;
+    uint32_t runs = 0;
+    for (uint32_t start : starts)
+    {
+        printf("from %lums\n", (unsigned long)start);
+        for (auto scenario : scenarios)
+        {
+            failures += scenario(start);
+            ++runs;
+        }
+    }
+    printf("%lu scenarios run, %lu checks failed\n", (unsigned long)runs, (unsigned long)failures);
+    return failures ? 1 : 0;
+}
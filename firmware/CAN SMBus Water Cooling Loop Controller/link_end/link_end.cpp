@@ -0,0 +1,96 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <cstdio>
+#include <cstdlib>
+#include <poll.h>
+
+#include "link.h"
+
+/*
+ *   The loop controller's end of the link, natively over a pty
+ *
+ *   link.cpp as it is, its session count in an EEPROM file so that each run
+ *   is the next boot. COUNT setpoint commands are queued as fast as the
+ *   queue takes them, from the FIRST'th on, and a heat load goes out every
+ *   chiller period. Every LINK_END_REJECT_EVERY'th setpoint is out of range,
+ *   to be turned away. It runs until every command has been acked, rejected
+ *   or given up on and the chiller's readings and clock are coming through,
+ *   then prints a line per command and the link's counters:
+ *
+ *     link_end PORT EEPROM FIRST COUNT [SPEEDUP]
+ *
+ *   tools/link_test.py runs it, and the chiller's end, through a relay that
+ *   loses bytes.
+ */
+
+#define LINK_END_SETPOINT_BASE 10.0f  // degC, in range for the chiller's default limits
+#define LINK_END_SETPOINT_STEP 0.01f  // so every command's value is its own
+#define LINK_END_REJECT_EVERY 16
+#define LINK_END_REJECT_BASE 100.0f   // above any reservoir limit
+#define LINK_END_POLL_MS 1
+
+double link_speedup = 1;
+EEPROMClass EEPROM;
+
+static uint32_t finished = 0;
+
+static void commandDone(uint8_t, const struct_command *command, ack_status status)
+{
+    printf("result %.2f %d\n", command->value, status);
+    ++finished;
+}
+
+static float setpointFor(uint32_t index)
+{
+    if (index % LINK_END_REJECT_EVERY == LINK_END_REJECT_EVERY - 1)
+        return LINK_END_REJECT_BASE + index;
+    return LINK_END_SETPOINT_BASE + index * LINK_END_SETPOINT_STEP;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 5)
+    {
+        fprintf(stderr, "usage: %s PORT EEPROM FIRST COUNT [SPEEDUP]\n", argv[0]);
+        return 2;
+    }
+    uint32_t first = strtoul(argv[3], nullptr, 0);
+    uint32_t count = strtoul(argv[4], nullptr, 0);
+    if (argc > 5)
+        link_speedup = atof(argv[5]);
+    Stream port;
+    if (!port.open(argv[1]))
+    {
+        perror(argv[1]);
+        return 2;
+    }
+    EEPROM.attach(argv[2]);
+    beginLink(port);
+
+    struct_heat_load heat_load = {};
+    uint32_t last_heat_load = millis();
+    uint32_t issued = 0;
+    while (!port.hungUp() && (finished < count || !chillerOnline() || !chillerClock()->valid))
+    {
+        if (issued < count && sendCommand(COMMAND_SET_SETPOINT, setpointFor(first + issued), commandDone))
+            ++issued;
+        if (millis() - last_heat_load >= CHILLER_PERIOD_MS)
+        {
+            last_heat_load = millis();
+            heat_load.internal_w = 100.0f + issued;
+            sendHeatLoad(&heat_load);
+        }
+        serviceLink();
+        pollfd wait = {port.descriptor(), POLLIN, 0};
+        poll(&wait, 1, LINK_END_POLL_MS);
+    }
+
+    const struct_link_stats *stats = linkStats();
+    printf("stats sent %lu retransmits %lu acked %lu rejected %lu dropped %lu readings %lu lost %lu pings %lu "
+           "pongs %lu heat_loads %lu\n",
+           (unsigned long)stats->sent, (unsigned long)stats->retransmits, (unsigned long)stats->acked,
+           (unsigned long)stats->rejected, (unsigned long)stats->dropped, (unsigned long)stats->readings,
+           (unsigned long)stats->lost, (unsigned long)stats->pings, (unsigned long)stats->pongs,
+           (unsigned long)stats->heat_loads);
+    return port.hungUp() ? 1 : 0;
+}
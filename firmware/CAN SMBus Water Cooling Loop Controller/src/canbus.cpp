@@ -0,0 +1,260 @@
+#include <Arduino.h>
+#include <FlexCAN_T4.h>
+#include <can_frames.h>
+#include "canbus.h"
+#include "link.h"
+
+enum can_priority : uint8_t
+{
+    CAN_PRIORITY_ALARM = 0,
+    CAN_PRIORITY_COMMAND, // acks
+    CAN_PRIORITY_TELEMETRY,
+    CAN_PRIORITIES,
+};
+
+// MB0-MB7 receive, MB8 up transmit in priority order
+#define CAN_MAILBOXES 16
+#define CAN_MB_COMMAND MB0
+#define CAN_MB_HEARTBEAT MB1
+#define CAN_TX_FIRST_MB 8
+
+struct frame_queue
+{
+    can_frame *frames;
+    uint8_t length;
+    uint8_t first_mb;
+    uint8_t mailboxes;
+    uint8_t head;
+    uint8_t count;
+};
+
+struct alarm_state
+{
+    bool alert;
+    uint16_t code;
+    uint32_t sent;
+};
+
+static FlexCAN_T4<CAN0, RX_SIZE_16, TX_SIZE_16> can;
+
+static can_frame alarm_frames[CAN_ALARM_QUEUE_LENGTH];
+static can_frame command_frames[CAN_COMMAND_QUEUE_LENGTH];
+static can_frame telemetry_frames[CAN_TELEMETRY_QUEUE_LENGTH];
+static frame_queue queues[CAN_PRIORITIES] = {
+    {alarm_frames, CAN_ALARM_QUEUE_LENGTH, CAN_TX_FIRST_MB, 1, 0, 0},
+    {command_frames, CAN_COMMAND_QUEUE_LENGTH, CAN_TX_FIRST_MB + 1, 1, 0, 0},
+    {telemetry_frames, CAN_TELEMETRY_QUEUE_LENGTH, CAN_TX_FIRST_MB + 2, CAN_MAILBOXES - CAN_TX_FIRST_MB - 2, 0, 0},
+};
+
+static struct_can_stats stats;
+static can_frame scratch[CAN_READINGS_FRAMES];
+static uint32_t published_readings = 0;
+static uint32_t published_settings = 0;
+static alarm_state chiller_alarm;
+static alarm_state loop_alarm;
+static struct_can_heartbeat heartbeat;
+static uint32_t heartbeat_time = 0;
+static uint32_t host_seen = 0;
+static bool have_host = false;
+
+// the host's last command, answered again if it retransmits
+static struct_ack host_ack;
+static bool have_host_command = false;
+static bool host_pending = false;
+static uint8_t host_tag = 0; // +1 per host command passed on to the chiller
+
+static bool queueFrame(can_priority priority, const can_frame &frame)
+{
+    frame_queue &queue = queues[priority];
+    if (queue.count >= queue.length)
+    {
+        ++stats.overruns;
+        return false;
+    }
+    queue.frames[(queue.head + queue.count) % queue.length] = frame;
+    ++queue.count;
+    return true;
+}
+
+template <typename T>
+static bool queuePayload(can_priority priority, uint16_t id, const T &payload)
+{
+    can_frame frame;
+    packFrame(id, payload, &frame);
+    return queueFrame(priority, frame);
+}
+
+static void fillMailboxes()
+{
+    for (frame_queue &queue : queues)
+    {
+        for (uint8_t mb = queue.first_mb; mb < queue.first_mb + queue.mailboxes && queue.count > 0; mb++)
+        {
+            const can_frame &frame = queue.frames[queue.head];
+            CAN_message_t msg;
+            msg.id = frame.id;
+            msg.len = frame.length;
+            memcpy(msg.buf, frame.data, frame.length);
+            // 0 while the mailbox still holds a frame waiting for the bus
+            if (can.write((FLEXCAN_MAILBOX)mb, msg) <= 0)
+                continue;
+            queue.head = (queue.head + 1) % queue.length;
+            --queue.count;
+            ++stats.sent;
+        }
+    }
+}
+
+static void sendAck()
+{
+    if (queuePayload(CAN_PRIORITY_COMMAND, CAN_ID_ACK, host_ack))
+        ++stats.acks;
+}
+
+static void commandDone(uint8_t tag, const struct_command *, ack_status status)
+{
+    // a newer host command has taken over; its own ack will follow
+    if (tag != host_tag)
+        return;
+    host_ack.status = status;
+    host_pending = false;
+    sendAck();
+}
+
+static void receiveCommand(const CAN_message_t &msg)
+{
+    ++stats.received;
+    struct_command command;
+    if (msg.len < sizeof(command))
+        return;
+    memcpy(&command, msg.buf, sizeof(command));
+    ++stats.commands;
+
+    // a repeated sequence number means our ack was lost, or is still on its way;
+    // from a new session it is a restarted host counting from 0 again
+    if (have_host_command && command.session == host_ack.session && command.sequence == host_ack.sequence)
+    {
+        if (!host_pending)
+            sendAck();
+        return;
+    }
+    have_host_command = true;
+    host_ack.session = command.session;
+    host_ack.sequence = command.sequence;
+    host_ack.id = command.id;
+
+    switch (command.id)
+    {
+    case COMMAND_SET_SETPOINT:
+    case COMMAND_RUN:
+    case COMMAND_STOP:
+    case COMMAND_READ_SETTINGS:
+        host_pending = sendCommand((command_id)command.id, command.value, commandDone, ++host_tag);
+        if (!host_pending)
+        {
+            host_ack.status = ACK_BUSY;
+            sendAck();
+        }
+        break;
+    default:
+        host_ack.status = ACK_UNKNOWN_COMMAND;
+        sendAck();
+        break;
+    }
+}
+
+static void receiveHeartbeat(const CAN_message_t &msg)
+{
+    ++stats.received;
+    if (msg.id == CAN_ID_HEARTBEAT + CAN_NODE_HOST)
+    {
+        host_seen = millis();
+        have_host = true;
+        ++stats.host_heartbeats;
+    }
+}
+
+static void updateAlarm(alarm_state &state, uint8_t node, bool alert, uint16_t code, uint32_t now)
+{
+    bool changed = alert != state.alert || (alert && code != state.code);
+    if (!changed && !(alert && now - state.sent >= CAN_ALARM_REPEAT_MS))
+        return;
+    struct_can_alarm alarm = {node, alert, code, chillerReadings()->header.sequence};
+    if (!queuePayload(CAN_PRIORITY_ALARM, CAN_ID_ALARM, alarm))
+        return; // tried again next pass
+    state.alert = alert;
+    state.code = code;
+    state.sent = now;
+    ++stats.alarms;
+}
+
+void beginCAN(uint8_t standby)
+{
+    // the MCP2561 listens only with STBY low
+    digitalWrite(standby, LOW);
+    can.begin();
+    can.setBaudRate(CAN_BITRATE);
+    can.setMaxMB(CAN_MAILBOXES);
+    for (uint8_t mb = 0; mb < CAN_MAILBOXES; mb++)
+        can.setMB((FLEXCAN_MAILBOX)mb, mb < CAN_TX_FIRST_MB ? RX : TX, STD);
+    can.setMBFilter(REJECT_ALL);
+    can.setMBFilter(CAN_MB_COMMAND, CAN_ID_COMMAND);
+    can.setMBFilterRange(CAN_MB_HEARTBEAT, CAN_ID_HEARTBEAT, CAN_ID_HEARTBEAT + 0x7F);
+    can.enableMBInterrupts();
+    can.onReceive(CAN_MB_COMMAND, receiveCommand);
+    can.onReceive(CAN_MB_HEARTBEAT, receiveHeartbeat);
+}
+
+void serviceCAN(const struct_interlock *interlock)
+{
+    uint32_t now = millis();
+    // runs the receive callbacks for whatever the interrupt has queued
+    can.events();
+
+    // alarms first, so they are queued ahead of the readings that carry the same news
+    const struct_readings *readings = chillerReadings();
+    bool online = chillerOnline();
+    updateAlarm(chiller_alarm, CAN_NODE_CHILLER, online && readings->error.alert, readings->error.code, now);
+    updateAlarm(loop_alarm, CAN_NODE_LOOP, interlock->fault != INTERLOCK_FAULT_NONE, interlock->fault, now);
+
+    const struct_link_stats *link = linkStats();
+    if (link->readings != published_readings)
+    {
+        published_readings = link->readings;
+        uint8_t count = packReadings(readings, scratch);
+        for (uint8_t i = 0; i < count; i++)
+            queueFrame(CAN_PRIORITY_TELEMETRY, scratch[i]);
+        ++stats.readings;
+    }
+    if (link->settings != published_settings)
+    {
+        published_settings = link->settings;
+        uint8_t count = packSettings(chillerSettings(), scratch);
+        for (uint8_t i = 0; i < count; i++)
+            queueFrame(CAN_PRIORITY_TELEMETRY, scratch[i]);
+    }
+
+    if (now - heartbeat_time >= CAN_HEARTBEAT_MS)
+    {
+        heartbeat_time = now;
+        heartbeat.uptime_ms = now;
+        ++heartbeat.counter;
+        heartbeat.state = interlock->state;
+        heartbeat.flags = (online ? CAN_HEARTBEAT_CHILLER_ONLINE : 0) |
+                          (interlock->int_flow_ok ? CAN_HEARTBEAT_INT_FLOW_OK : 0) |
+                          (interlock->ext_flow_ok ? CAN_HEARTBEAT_EXT_FLOW_OK : 0);
+        queuePayload(CAN_PRIORITY_TELEMETRY, CAN_ID_HEARTBEAT + CAN_NODE_LOOP, heartbeat);
+    }
+
+    fillMailboxes();
+}
+
+bool hostOnline()
+{
+    return have_host && millis() - host_seen < CAN_HEARTBEAT_STALE_MS;
+}
+
+const struct_can_stats *canStats()
+{
+    return &stats;
+}
@@ -0,0 +1,46 @@
+#ifndef __LOOP_CANBUS__
+#define __LOOP_CANBUS__
+#include <cstdint>
+#include "interlock.h"
+
+/*
+ *   CAN node for the host, on the card's MCP2561 (pins 3/4, standby on 2)
+ *
+ *   The chiller stays on its RS232 link; this side republishes each readings
+ *   set it gets from there as the CAN frames in can_frames.h, raises alarms
+ *   for chiller errors and interlock faults, and passes the host's commands
+ *   on to the link, acking them on the bus with the chiller's answer.
+ *
+ *   Receive is FlexCAN mailboxes behind hardware acceptance filters: one for
+ *   commands, one for the other nodes' heartbeats, nothing else gets in. The
+ *   RX interrupt queues frames that serviceCAN() hands out from loop().
+ *
+ *   Transmit has a queue per priority, each with its own mailboxes, lower
+ *   numbered for the more urgent: alarms, then acks, then telemetry. Whether
+ *   the FlexCAN picks by ID or by mailbox number, an alarm queued behind a
+ *   full telemetry backlog is the next frame out, and bus arbitration by ID
+ *   does the same between nodes.
+ */
+
+#define CAN_ALARM_QUEUE_LENGTH 4
+#define CAN_COMMAND_QUEUE_LENGTH 4
+#define CAN_TELEMETRY_QUEUE_LENGTH 24 // two readings sets, settings and a heartbeat
+
+struct struct_can_stats
+{
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    uint32_t overruns = 0; // frames dropped with their queue full
+    uint32_t commands = 0;
+    uint32_t acks = 0;
+    uint32_t alarms = 0;
+    uint32_t readings = 0; // sets published
+    uint32_t host_heartbeats = 0;
+};
+
+void beginCAN(uint8_t standby);
+void serviceCAN(const struct_interlock *interlock); // every pass of loop()
+bool hostOnline();
+const struct_can_stats *canStats();
+
+#endif
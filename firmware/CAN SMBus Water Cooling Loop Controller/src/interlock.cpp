@@ -0,0 +1,265 @@
+#include <Arduino.h>
+#include "interlock.h"
+
+/*
+ *   Front panel power interlock
+ *
+ *   Everything here runs from one periodic tick, which passes the power button
+ *   through, samples #PERST and the flow sensors and runs the timeouts. It is
+ *   the only caller of serviceInterlock(), so nothing preempts it part way.
+ *   The main loop only reports temperature health and reads back the state,
+ *   so a slow display flush or 1-Wire conversion can never delay a shutdown
+ *   by more than INTERLOCK_TICK_US.
+ *
+ *   A reset with the host running comes up in HOST_ON with nothing known
+ *   yet: no shutdown is started until the loop's first health report is in
+ *   (or BOOT_REPORT_MS passes without one) and the flow sensors have been
+ *   sampled for a whole FLOW_TIMEOUT_MS.
+ */
+
+static IntervalTimer interlock_timer;
+static volatile struct_interlock interlock;
+
+static uint8_t pin_pwr_in;
+static uint8_t pin_pwr_out;
+static uint8_t pin_perst;
+static uint8_t pin_int_flow;
+static uint8_t pin_ext_flow;
+
+static uint8_t last_int_level = 0;
+static uint8_t last_ext_level = 0;
+static uint32_t last_int_edge = 0;
+static uint32_t last_ext_edge = 0;
+static uint32_t host_on_time = 0;
+static volatile uint32_t temps_reported = 0;
+static volatile bool reported = false;
+static uint32_t boot_time = 0;
+static bool settled = false;
+static bool pressed = false;
+
+static void setOutput(bool press)
+{
+    if (interlock.output != press)
+    {
+        interlock.output = press;
+        digitalWriteFast(pin_pwr_out, press ? FP_PRESSED : !FP_PRESSED);
+    }
+}
+
+static void enterState(interlock_state state, uint32_t now)
+{
+    interlock.state = state;
+    interlock.state_time = now;
+}
+
+static void sampleFlow(uint32_t now)
+{
+    uint8_t level = digitalReadFast(pin_int_flow);
+    if (level != last_int_level)
+    {
+        last_int_level = level;
+        last_int_edge = now;
+    }
+    level = digitalReadFast(pin_ext_flow);
+    if (level != last_ext_level)
+    {
+        last_ext_level = level;
+        last_ext_edge = now;
+    }
+    interlock.int_flow_ok = (now - last_int_edge) < FLOW_TIMEOUT_MS;
+    interlock.ext_flow_ok = (now - last_ext_edge) < FLOW_TIMEOUT_MS;
+}
+
+static interlock_fault checkHealth(uint32_t now)
+{
+    if ((now - temps_reported) >= HEALTH_LEASE_MS)
+    {
+        interlock.temps_ok = false;
+        return INTERLOCK_FAULT_STALE_HEALTH;
+    }
+    if (!interlock.temps_ok)
+        return INTERLOCK_FAULT_TEMPERATURE;
+    if (!interlock.ext_flow_ok)
+        return INTERLOCK_FAULT_EXT_FLOW;
+    // the internal pump runs off the host supply, so give it time to start
+    if (interlock.host_on && (now - host_on_time) >= FLOW_GRACE_MS && !interlock.int_flow_ok)
+        return INTERLOCK_FAULT_INT_FLOW;
+    return INTERLOCK_FAULT_NONE;
+}
+
+void serviceInterlock()
+{
+    uint32_t now = millis();
+    sampleFlow(now);
+
+    bool host_on = (digitalReadFast(pin_perst) == HIGH);
+    if (host_on && !interlock.host_on)
+        host_on_time = now;
+    interlock.host_on = host_on;
+
+    bool button = (digitalReadFast(pin_pwr_in) == LOW);
+    bool new_press = button && !pressed;
+    pressed = button;
+
+    // latched, so the millis() wrap cannot bring the boot grace back
+    if (!settled)
+        settled = (now - boot_time) >= (reported ? FLOW_TIMEOUT_MS : BOOT_REPORT_MS);
+    interlock_fault fault = checkHealth(now);
+    // a running host's faults only count once the boot grace is over
+    if (fault != INTERLOCK_FAULT_NONE && (settled || interlock.state != INTERLOCK_HOST_ON))
+        interlock.fault = fault;
+
+    switch (interlock.state)
+    {
+    case INTERLOCK_HOST_OFF:
+        if (host_on)
+        {
+            enterState(INTERLOCK_HOST_ON, now);
+            break;
+        }
+        if (fault != INTERLOCK_FAULT_NONE)
+        {
+            // refuse to boot into a loop that is not cooling
+            if (new_press)
+                ++interlock.blocked_presses;
+            setOutput(false);
+        }
+        else
+        {
+            interlock.fault = INTERLOCK_FAULT_NONE;
+            setOutput(button);
+        }
+        break;
+
+    case INTERLOCK_HOST_ON:
+        if (!host_on)
+        {
+            setOutput(false);
+            enterState(INTERLOCK_HOST_OFF, now);
+            break;
+        }
+        if (!settled)
+        {
+            // just reset under a running host; the faults are not to be trusted yet
+            setOutput(button);
+        }
+        else if (fault == INTERLOCK_FAULT_INT_FLOW)
+        {
+            // nothing is cooling the CPU/GPU blocks; do not wait for the OS
+            setOutput(true);
+            enterState(INTERLOCK_FORCED_SHUTDOWN, now);
+        }
+        else if (fault != INTERLOCK_FAULT_NONE)
+        {
+            setOutput(true);
+            enterState(INTERLOCK_ORDERLY_SHUTDOWN, now);
+        }
+        else
+        {
+            // the user may always turn a running host off
+            setOutput(button);
+        }
+        break;
+
+    case INTERLOCK_ORDERLY_SHUTDOWN:
+        if (now - interlock.state_time >= ORDERLY_PULSE_MS)
+            setOutput(false);
+        if (!host_on)
+        {
+            setOutput(false);
+            enterState(INTERLOCK_HOST_OFF, now);
+        }
+        else if (now - interlock.state_time >= ORDERLY_TIMEOUT_MS || fault == INTERLOCK_FAULT_INT_FLOW)
+        {
+            setOutput(true);
+            enterState(INTERLOCK_FORCED_SHUTDOWN, now);
+        }
+        break;
+
+    case INTERLOCK_FORCED_SHUTDOWN:
+        // hold the switch until the supply drops, bounded by FORCED_PULSE_MS
+        if (!host_on || now - interlock.state_time >= FORCED_PULSE_MS)
+        {
+            setOutput(false);
+            enterState(host_on ? INTERLOCK_HOST_ON : INTERLOCK_HOST_OFF, now);
+        }
+        break;
+
+    default:
+        setOutput(false);
+        enterState(INTERLOCK_HOST_OFF, now);
+        break;
+    }
+}
+
+void beginInterlock(uint8_t pwr_in, uint8_t pwr_out, uint8_t perst, uint8_t int_flow, uint8_t ext_flow)
+{
+    pin_pwr_in = pwr_in;
+    pin_pwr_out = pwr_out;
+    pin_perst = perst;
+    pin_int_flow = int_flow;
+    pin_ext_flow = ext_flow;
+
+    pinMode(pin_pwr_out, OUTPUT);
+    digitalWrite(pin_pwr_out, !FP_PRESSED);
+    interlock.output = false;
+
+    uint32_t now = millis();
+    last_int_level = digitalRead(pin_int_flow);
+    last_ext_level = digitalRead(pin_ext_flow);
+    // start with the flow considered stopped until the sensors prove otherwise
+    last_int_edge = now - FLOW_TIMEOUT_MS;
+    last_ext_edge = now - FLOW_TIMEOUT_MS;
+    temps_reported = now - HEALTH_LEASE_MS;
+    interlock.host_on = (digitalRead(pin_perst) == HIGH);
+    host_on_time = now;
+    boot_time = now;
+    reported = false;
+    settled = false;
+    interlock.fault = INTERLOCK_FAULT_NONE;
+    enterState(interlock.host_on ? INTERLOCK_HOST_ON : INTERLOCK_HOST_OFF, now);
+
+    interlock_timer.priority(INTERLOCK_PRIORITY);
+    interlock_timer.begin(serviceInterlock, INTERLOCK_TICK_US);
+}
+
+void reportLoopTemperatures(bool ok)
+{
+    noInterrupts();
+    interlock.temps_ok = ok;
+    temps_reported = millis();
+    reported = true;
+    interrupts();
+}
+
+void getInterlock(struct_interlock *out)
+{
+    noInterrupts();
+    out->state = interlock.state;
+    out->fault = interlock.fault;
+    out->host_on = interlock.host_on;
+    out->int_flow_ok = interlock.int_flow_ok;
+    out->ext_flow_ok = interlock.ext_flow_ok;
+    out->temps_ok = interlock.temps_ok;
+    out->output = interlock.output;
+    out->blocked_presses = interlock.blocked_presses;
+    out->state_time = interlock.state_time;
+    interrupts();
+}
+
+const char *interlockStateName(interlock_state state)
+{
+    switch (state)
+    {
+    case INTERLOCK_HOST_OFF:
+        return "Host off";
+    case INTERLOCK_HOST_ON:
+        return "Host on";
+    case INTERLOCK_ORDERLY_SHUTDOWN:
+        return "Shutdown";
+    case INTERLOCK_FORCED_SHUTDOWN:
+        return "Forced off";
+    default:
+        return "?";
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef __LOOP_INTERLOCK__
+#define __LOOP_INTERLOCK__
+#include <cstdint>
+
+#define INTERLOCK_TICK_US 1000      // interlock service period; worst-case reaction time
+#define INTERLOCK_PRIORITY 64       // NVIC priority of the tick
+#define FP_PRESSED HIGH             // FP_PWR_OUT level that presses the motherboard switch
+#define FLOW_TIMEOUT_MS 1500        // no flow sensor edges for this long == no flow
+#define FLOW_GRACE_MS 5000          // internal pump spin-up time after #PERST releases
+#define HEALTH_LEASE_MS 3000        // temperature health goes stale if not reported this often
+#define BOOT_REPORT_MS 10000        // after a reset, longest wait for the loop's first health report
+#define ORDERLY_PULSE_MS 500        // short press asks the OS to shut down
+#define ORDERLY_TIMEOUT_MS 60000    // time the OS gets before the power is forced off
+#define FORCED_PULSE_MS 6000        // long press forces the ATX supply off
+
+enum interlock_state : uint8_t
+{
+    INTERLOCK_HOST_OFF = 0,
+    INTERLOCK_HOST_ON,
+    INTERLOCK_ORDERLY_SHUTDOWN,
+    INTERLOCK_FORCED_SHUTDOWN,
+};
+
+enum interlock_fault : uint8_t
+{
+    INTERLOCK_FAULT_NONE = 0,
+    INTERLOCK_FAULT_EXT_FLOW,
+    INTERLOCK_FAULT_INT_FLOW,
+    INTERLOCK_FAULT_TEMPERATURE,
+    INTERLOCK_FAULT_STALE_HEALTH,
+};
+
+struct struct_interlock
+{
+    interlock_state state = INTERLOCK_HOST_OFF;
+    interlock_fault fault = INTERLOCK_FAULT_NONE;
+    bool host_on = false;
+    bool int_flow_ok = false;
+    bool ext_flow_ok = false;
+    bool temps_ok = false;
+    bool output = false;
+    uint16_t blocked_presses = 0;
+    uint32_t state_time = 0;
+};
+
+void beginInterlock(uint8_t pwr_in, uint8_t pwr_out, uint8_t perst, uint8_t int_flow, uint8_t ext_flow);
+void reportLoopTemperatures(bool ok);
+void serviceInterlock();
+void getInterlock(struct_interlock *);
+const char *interlockStateName(interlock_state);
+
+#endif
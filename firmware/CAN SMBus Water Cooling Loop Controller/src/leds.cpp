@@ -0,0 +1,126 @@
+#include <Arduino.h>
+#include <SPI.h>
+#include <EventResponder.h>
+#include "leds.h"
+
+/*
+ *   WS2811B status LEDs
+ *
+ *   The LED data line is on the alternate SPI0 MOSI pin, so the waveform is
+ *   produced by the SPI peripheral fed from DMA: every WS2811 bit becomes four
+ *   SPI bits (1000 for a zero, 1100 for a one). Interrupts stay enabled the
+ *   whole time, so the flow and tach counters keep their edges.
+ *
+ *   SPI0 also takes pin 13 as SCK (its only other SCK pin, 14, is an NTC), so
+ *   the built-in LED flickers with every frame and cannot be an indicator of
+ *   its own. A missing peripheral is shown on the chain instead: the last
+ *   phase of every LED goes LED_DEGRADED.
+ */
+
+#ifndef SPI_HAS_TRANSFER_ASYNC
+#error "WS2811 driver needs the asynchronous (DMA) SPI transfer"
+#endif
+
+// first match wins, so put per-LED overrides ahead of the LED_ANY rules
+static const led_rule rules[] = {
+    {LED_INT_FLOW, HEALTH_FAULT, 0xFF0000, BLINK_FAST},
+    {LED_ANY, HEALTH_OK, 0x00FF00, BLINK_SOLID},
+    {LED_ANY, HEALTH_WARN, 0xFF8000, BLINK_SOLID},
+    {LED_ANY, HEALTH_FAULT, 0xFF0000, BLINK_SLOW},
+    {LED_ANY, HEALTH_UNKNOWN, 0x0000FF, BLINK_FLASH},
+};
+
+static const SPISettings led_spi(LED_SPI_CLOCK, MSBFIRST, SPI_MODE0);
+static EventResponder led_event;
+static uint8_t frame[LED_COUNT * 12 + LED_LATCH_BYTES];
+static uint32_t shown[LED_COUNT];
+static volatile bool busy = false;
+static bool valid = false;
+static uint8_t scale = 64;
+
+static void transferDone(EventResponderRef)
+{
+    SPI.endTransaction();
+    busy = false;
+}
+
+static const led_rule *findRule(uint8_t led, led_health health)
+{
+    for (const led_rule &rule : rules)
+    {
+        if ((rule.led == led || rule.led == LED_ANY) && rule.health == health)
+            return &rule;
+    }
+    return nullptr;
+}
+
+static uint8_t *encodeByte(uint8_t *out, uint8_t value)
+{
+    // two WS2811 bits per SPI byte
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        uint8_t hi = (value & 0x80) ? 0xC0 : 0x80;
+        uint8_t lo = (value & 0x40) ? 0x0C : 0x08;
+        *out++ = hi | lo;
+        value <<= 2;
+    }
+    return out;
+}
+
+static void encodeFrame(const uint32_t *colours)
+{
+    uint8_t *out = frame;
+    for (uint8_t i = 0; i < LED_COUNT; i++)
+    {
+        uint8_t r = ((colours[i] >> 16) & 0xFF) * scale / 255;
+        uint8_t g = ((colours[i] >> 8) & 0xFF) * scale / 255;
+        uint8_t b = (colours[i] & 0xFF) * scale / 255;
+        // WS2811B wants green first
+        out = encodeByte(out, g);
+        out = encodeByte(out, r);
+        out = encodeByte(out, b);
+    }
+    // the latch bytes were zeroed once and are never touched again
+}
+
+void beginLEDs(uint8_t pin, uint8_t brightness)
+{
+    scale = brightness;
+    memset(frame, 0, sizeof(frame));
+    led_event.attachImmediate(transferDone);
+    SPI.setMOSI(pin);
+    SPI.begin();
+}
+
+bool ledsBusy()
+{
+    return busy;
+}
+
+void updateLEDs(const struct_led_status *status)
+{
+    uint8_t phase = (millis() / LED_PHASE_MS) & 0x07;
+    uint32_t colours[LED_COUNT];
+    for (uint8_t i = 0; i < LED_COUNT; i++)
+    {
+        const led_rule *rule = findRule(i, status->health[i]);
+        if (rule && (rule->pattern & (0x80 >> phase)))
+            colours[i] = rule->colour;
+        else
+            colours[i] = 0;
+        if (status->degraded && phase == 7)
+            colours[i] = LED_DEGRADED;
+    }
+
+    if (valid && memcmp(colours, shown, sizeof(shown)) == 0)
+        return; // nothing changed, leave the bus alone
+    if (busy)
+        return; // picked up again on the next call
+
+    encodeFrame(colours);
+    memcpy(shown, colours, sizeof(shown));
+    valid = true;
+    busy = true;
+    SPI.beginTransaction(led_spi);
+    SPI.transfer(frame, nullptr, sizeof(frame), led_event);
+}
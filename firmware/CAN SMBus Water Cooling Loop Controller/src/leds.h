@@ -0,0 +1,53 @@
+#ifndef __LOOP_LEDS__
+#define __LOOP_LEDS__
+#include <cstdint>
+
+#define LED_COUNT 4
+#define LED_SPI_CLOCK 3200000 // 4 SPI bits per 1.25us WS2811 bit
+#define LED_LATCH_BYTES 120   // >300us of low line to latch the frame
+#define LED_PHASE_MS 125      // blink patterns are 8 phases of this long
+#define LED_DEGRADED 0xFF00FF // last phase of every LED while a peripheral is missing
+
+// order of the LEDs on the WS2811B chain
+enum led_index : uint8_t
+{
+    LED_EXT_TEMP = 0,
+    LED_EXT_FLOW,
+    LED_INT_TEMP,
+    LED_INT_FLOW,
+};
+
+enum led_health : uint8_t
+{
+    HEALTH_UNKNOWN = 0,
+    HEALTH_OK,
+    HEALTH_WARN,
+    HEALTH_FAULT,
+};
+
+// blink patterns, one bit per LED_PHASE_MS phase, MSB first
+#define BLINK_SOLID 0xFF
+#define BLINK_SLOW 0xF0
+#define BLINK_FAST 0xCC
+#define BLINK_FLASH 0x80
+
+struct led_rule
+{
+    uint8_t led; // led_index, or LED_ANY
+    led_health health;
+    uint32_t colour; // 0xRRGGBB
+    uint8_t pattern;
+};
+#define LED_ANY 0xFF
+
+struct struct_led_status
+{
+    led_health health[LED_COUNT];
+    bool degraded; // a local peripheral is missing
+};
+
+void beginLEDs(uint8_t pin, uint8_t brightness = 64);
+void updateLEDs(const struct_led_status *status);
+bool ledsBusy();
+
+#endif
@@ -0,0 +1,208 @@
+#include <EEPROM.h>
+#include <SerialTransfer.h>
+#include "link.h"
+
+/*
+ *   Command/ack link to the chiller
+ *
+ *   Commands are queued and sent one at a time (stop-and-wait). The head of
+ *   the queue is retransmitted every LINK_ACK_TIMEOUT_MS until its ack comes
+ *   back or LINK_RETRIES runs out. Received packets are unpacked straight into
+ *   the static message structs below, so nothing is allocated per frame.
+ *   Every boot takes the next session from a count in EEPROM, so the chiller
+ *   does not take our first commands for retransmits of the last boot's.
+ *
+ *   The chiller is pinged every LINK_PING_INTERVAL_MS to track its clock, so
+ *   the sample time stamped in each readings frame can be put on our own
+ *   timeline and the link latency measured.
+ *
+ *   Heat load frames go out as they are made, without an ack: a lost one is
+ *   replaced by the next a second later.
+ */
+
+static SerialTransfer link;
+static uint16_t txSize = 0;
+
+static struct_command queue[LINK_QUEUE_LENGTH];
+static command_done callbacks[LINK_QUEUE_LENGTH];
+static uint8_t tags[LINK_QUEUE_LENGTH];
+static uint8_t queue_head = 0;
+static uint8_t queue_count = 0;
+static uint8_t session = 0;
+static uint8_t next_sequence = 0;
+static uint8_t attempts = 0;
+static uint32_t last_sent = 0;
+static uint32_t last_ping = 0;
+
+static struct_readings readings;
+static struct_remote_settings remote_settings;
+static struct_ack ack;
+static struct_clock_exchange exchange;
+static struct_clock_sync clock_sync;
+static uint32_t last_readings = 0;
+static bool have_readings = false;
+static struct_link_stats stats;
+
+static void transmitHead()
+{
+    txSize = link.txObj(queue[queue_head], 0);
+    link.sendData(txSize, PACKET_COMMAND);
+    last_sent = millis();
+    if (attempts++ == 0)
+        ++stats.sent;
+    else
+        ++stats.retransmits;
+}
+
+static void sendPing()
+{
+    exchange.id = stats.pings++;
+    exchange.t2 = 0;
+    exchange.t3 = 0;
+    exchange.t1 = micros64();
+    txSize = link.txObj(exchange, 0);
+    link.sendData(txSize, PACKET_PING);
+    last_ping = millis();
+}
+
+static void receiveReadings(uint64_t received)
+{
+    uint32_t previous = readings.header.sequence;
+    link.rxObj(readings);
+    // a sequence going backwards is a chiller reset, not lost frames
+    if (have_readings && readings.header.sequence > previous)
+        stats.lost += readings.header.sequence - previous - 1;
+    if (clock_sync.valid)
+    {
+        int64_t latency = (int64_t)(received - remoteToLocal(clock_sync, readings.header.time_us));
+        stats.latency_us = latency > 0 ? latency : 0;
+        stats.latency_max_us = max(stats.latency_max_us, stats.latency_us);
+    }
+    last_readings = millis();
+    have_readings = true;
+    ++stats.readings;
+}
+
+static void popHead(ack_status status)
+{
+    if (callbacks[queue_head] != nullptr)
+        callbacks[queue_head](tags[queue_head], &queue[queue_head], status);
+    queue_head = (queue_head + 1) % LINK_QUEUE_LENGTH;
+    --queue_count;
+    attempts = 0;
+    if (queue_count > 0)
+        transmitHead();
+}
+
+void beginLink(Stream &port)
+{
+    session = EEPROM.read(LINK_SESSION_ADDRESS) + 1;
+    EEPROM.write(LINK_SESSION_ADDRESS, session);
+    link.begin(port);
+}
+
+bool sendCommand(command_id id, float value, command_done done, uint8_t tag)
+{
+    if (queue_count >= LINK_QUEUE_LENGTH)
+        return false;
+    uint8_t slot = (queue_head + queue_count) % LINK_QUEUE_LENGTH;
+    struct_command &command = queue[slot];
+    command.session = session;
+    command.sequence = next_sequence++;
+    command.id = id;
+    command.value = value;
+    callbacks[slot] = done;
+    tags[slot] = tag;
+    if (queue_count++ == 0)
+        transmitHead();
+    return true;
+}
+
+void sendHeatLoad(struct_heat_load *heat_load)
+{
+    heat_load->sequence = ++stats.heat_loads;
+    txSize = link.txObj(*heat_load, 0);
+    link.sendData(txSize, PACKET_HEAT_LOAD);
+}
+
+void serviceLink()
+{
+    while (link.available())
+    {
+        uint64_t received = micros64();
+        switch (link.currentPacketID())
+        {
+        case PACKET_READINGS:
+            receiveReadings(received);
+            break;
+        case PACKET_ACK:
+            link.rxObj(ack);
+            // late acks for commands already given up on are ignored
+            if (queue_count > 0 && ack.session == session && ack.sequence == queue[queue_head].sequence)
+            {
+                if (ack.status == ACK_OK)
+                    ++stats.acked;
+                else
+                    ++stats.rejected;
+                popHead((ack_status)ack.status);
+            }
+            break;
+        case PACKET_SETTINGS:
+            link.rxObj(remote_settings);
+            ++stats.settings;
+            break;
+        case PACKET_PONG:
+            link.rxObj(exchange);
+            // only the latest ping counts; a pong that took longer is no use anyway
+            if (exchange.id + 1 == stats.pings)
+            {
+                addClockExchange(clock_sync, exchange.t1, exchange.t2, exchange.t3, received);
+                ++stats.pongs;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (queue_count > 0 && millis() - last_sent >= LINK_ACK_TIMEOUT_MS)
+    {
+        if (attempts > LINK_RETRIES)
+        {
+            ++stats.dropped;
+            popHead(ACK_NO_ANSWER);
+        }
+        else
+        {
+            transmitHead();
+        }
+    }
+
+    if (millis() - last_ping >= LINK_PING_INTERVAL_MS)
+        sendPing();
+}
+
+bool chillerOnline()
+{
+    return have_readings && millis() - last_readings < LINK_READINGS_STALE_MS;
+}
+
+const struct_readings *chillerReadings()
+{
+    return &readings;
+}
+
+const struct_remote_settings *chillerSettings()
+{
+    return &remote_settings;
+}
+
+const struct_link_stats *linkStats()
+{
+    return &stats;
+}
+
+const struct_clock_sync *chillerClock()
+{
+    return &clock_sync;
+}
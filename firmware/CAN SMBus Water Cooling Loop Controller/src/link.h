@@ -0,0 +1,44 @@
+#ifndef __LOOP_LINK__
+#define __LOOP_LINK__
+#include <Arduino.h>
+#include <device_clock.h>
+#include "comms.h"
+
+#define LINK_ACK_TIMEOUT_MS (2 * CHILLER_PERIOD_MS + 500) // a command can wait out a whole chiller cycle
+#define LINK_RETRIES 3                                     // retransmissions before a command is dropped
+#define LINK_SESSION_ADDRESS 0                             // EEPROM byte counting boots, the command session
+#define LINK_QUEUE_LENGTH 4
+#define LINK_READINGS_STALE_MS 5000
+#define LINK_PING_INTERVAL_MS 2000 // clock sync exchanges with the chiller
+
+struct struct_link_stats
+{
+    uint32_t sent = 0;
+    uint32_t retransmits = 0;
+    uint32_t acked = 0;
+    uint32_t rejected = 0;
+    uint32_t dropped = 0;
+    uint32_t readings = 0;
+    uint32_t settings = 0;
+    uint32_t lost = 0;           // readings missing from the sequence
+    uint32_t pings = 0;
+    uint32_t pongs = 0;
+    uint32_t heat_loads = 0;
+    uint32_t latency_us = 0;     // chiller sample to our receive, last readings
+    uint32_t latency_max_us = 0;
+};
+
+// once a command is acked, rejected or given up on; tag is the caller's, from sendCommand()
+typedef void (*command_done)(uint8_t tag, const struct_command *command, ack_status status);
+
+void beginLink(Stream &port);
+void serviceLink();
+bool sendCommand(command_id id, float value = 0.0, command_done done = nullptr, uint8_t tag = 0);
+void sendHeatLoad(struct_heat_load *heat_load);
+bool chillerOnline();
+const struct_readings *chillerReadings();
+const struct_remote_settings *chillerSettings();
+const struct_link_stats *linkStats();
+const struct_clock_sync *chillerClock();
+
+#endif
@@ -4,183 +4,236 @@
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 
-#include <Thermistor.h>
-#include <NTC_Thermistor.h>
-
-#define INT_FLOW 0      // INPUT Internal loop flow sensor
-#define EXT_FLOW 1      // INPUT External loop flow sensor
-#define LS_OE 5         // OUTPUT Level shifter output enable, active low
-#define PERST 6         // INPUT PCIe #PERST status
-#define FP_PWR_OUT 22   // OUTPUT Front panel power switch output
-#define FP_PWR_IN 23    // INPUT Front panel power switch input
-#define EXT_OUT_TEMP A0 // External loop outflow temperature, 10k NTC
-#define EXT_IN_TEMP A1  // External loop inflow temperature, 10k NTC
-#define INT_IN_TEMP A2  // Internal loop inflow temperature, 10k NTC
-#define INT_OUT_TEMP A3 // Internal loop outflow temperature, 10k NTC
-#define WS2811B 7       // OUTPUT WS2811B data
-#define SMBUS_SDA 18    // SMBus I2C data
-#define SMBUS_SCL 19    // SMBus I2C clock
-#define I2C_SDA 30      // Local I2C data
-#define I2C_SCL 29      // Local I2C clock
-#define CAN_STDBY 2     // OUTPUT CAN standby, active high
-#define CAN_TX 3        // CAN transmit
-#define CAN_RX 4        // CAN receive
+#include <boot.h>
+#include <board.h>
+#include <ntc.h>
+#include <fixed_point.h>
+#include <heat_load.h>
+#include <gauge.h>
+#include <static_alloc.h>
+#include <i2c_queue.h>
+#include <queued_bme280.h>
+#include <queued_display.h>
+
+#include "interlock.h"
+#include "leds.h"
+#include "link.h"
+#include "canbus.h"
+#include "smbus.h"
+
+typedef loop_controller_board board;
 
 #define SENSOR_THRESHOLD 1000
-FanController int_flow(INT_FLOW, SENSOR_THRESHOLD);
-FanController ext_flow(EXT_FLOW, SENSOR_THRESHOLD);
-unsigned int int_flow_reading = 0;
-unsigned int ext_flow_reading = 0;
-const double flow_coeff = 0.181;
-const double flow_intercept = -9.75;
-
-#define BME_ADDRESS 0x76
-Adafruit_BME280 bme; // use I2C interface
-Adafruit_Sensor *bme_temp = bme.getTemperatureSensor();
-Adafruit_Sensor *bme_humidity = bme.getHumiditySensor();
-
-#define SCREEN_WIDTH 128 // OLED display width, in pixels
-#define SCREEN_HEIGHT 64 // OLED display height, in pixels
-#define FONT_X 5
-#define FONT_Y 8
-#define GAUGE_RADIUS 28
-#define PAGE_DELAY 5000
-#define OLED_RESET -1       // Reset pin # (or -1 if sharing Arduino reset pin)
-#define SCREEN_ADDRESS 0x3C ///< See datasheet for Address; 0x3D for 128x64, 0x3C for 128x32
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
-
-#define REFERENCE_RESISTANCE 100000
-#define NOMINAL_RESISTANCE 100000
-#define NOMINAL_TEMPERATURE 25
-#define B_VALUE 3950
-Thermistor *ext_out_temp;
-Thermistor *ext_in_temp;
-Thermistor *int_out_temp;
-Thermistor *int_in_temp;
-
-double ext_out_temp_reading;
-double ext_in_temp_reading;
-double int_out_temp_reading;
-double int_in_temp_reading;
+FanController int_flow(board::int_flow, SENSOR_THRESHOLD);
+FanController ext_flow(board::ext_flow, SENSOR_THRESHOLD);
+lph int_flow_reading = 0;
+lph ext_flow_reading = 0;
+
+// BME280 and display are on Wire1; Wire's pins are the SMBus
+#define LOCAL_BUS_HZ 400000
+i2c_bus local_bus(Wire1, 1, board::i2c_sda, board::i2c_scl);
+
+#define BME_SAMPLE_MS 500
+queued_bme280 bme(local_bus);
+float case_temperature = 0;
+float case_humidity = 0;
+uint32_t bme_time = 0;
+
+queued_ssd1306<board::screen::width, board::screen::height> display(local_bus, &Wire1, board::screen::reset);
+
+ntc_thermistor<board::ext_out_temp, board::ntc> ext_out_temp;
+ntc_thermistor<board::ext_in_temp, board::ntc> ext_in_temp;
+ntc_thermistor<board::int_out_temp, board::ntc> int_out_temp;
+ntc_thermistor<board::int_in_temp, board::ntc> int_in_temp;
+
+centi_c ext_out_temp_reading;
+centi_c ext_in_temp_reading;
+centi_c int_out_temp_reading;
+centi_c int_in_temp_reading;
+
+#define HEAT_SAMPLE_MS 500     // heat load and trend, and the SMBus registers
+#define HEAT_LOAD_SEND_MS 1000 // to the chiller, for its feed-forward
+struct_heat_trend heat_trend;
+struct_heat_load heat_load;
+uint32_t heat_time = 0;
+uint32_t heat_sent = 0;
+
+#define LOOP_TEMP_HIGH_LIMIT 45 // hottest coolant the interlock will allow, degC
+#define LOOP_TEMP_LOW_LIMIT 2   // colder than this is an open or shorted NTC, degC
+#define LOOP_TEMP_WARN_MARGIN 5 // warn this close to LOOP_TEMP_HIGH_LIMIT, degC
+#define BENCH_PASSES 16         // sensor passes the 'c' benchmark averages over
+interlock_state last_interlock_state = INTERLOCK_HOST_OFF;
 
 uint32_t reading_time = 0;
 uint8_t reading_state = 0;
 bool led_state = 1;
+uint32_t first_decision_time = 0;
+
+bool startDisplay();
+enum
+{
+    PERIPHERAL_BME = 0,
+    PERIPHERAL_DISPLAY,
+};
+peripheral peripherals[] = {
+    {"BME280", 0, [] { heap_window allow; return bme.begin(board::bme_address, &Wire1); }},
+    {"display", 0, startDisplay},
+};
+
+struct_led_status led_status;
+line_buffer<32> usb_line;
+uint32_t heap_faults = 0;
 
-int ringMeter(const char *, int, int, int, int, int, int, const char *);
+led_health loopTempHealth(centi_c, centi_c);
+bool loopTempValid(centi_c);
+void benchmarkSensors();
+void handleUSBSerial();
+void startPeripherals();
+void readCaseSensor();
+void updateHeatLoad(const struct_interlock *interlock);
+
+extern "C" void startup_early_hook()
+{
+    // runs straight out of reset, before the C runtime, clocks and USB are up
+    armWatchdog(WATCHDOG_TIMEOUT_MS);
+    enablePortClocks();
+    // never hold the motherboard power switch through a reset
+    digitalWriteFast(board::fp_pwr_out, !FP_PRESSED);
+    pinMode(board::fp_pwr_out, OUTPUT);
+}
 
 void setup()
 {
-    pinMode(FP_PWR_IN, INPUT_PULLUP);
-    pinMode(PERST, INPUT_PULLUP);
-    pinMode(LS_OE, OUTPUT);
-    pinMode(CAN_STDBY, OUTPUT);
-    pinMode(13, OUTPUT);
+    pinMode(board::fp_pwr_in, INPUT_PULLUP);
+    pinMode(board::perst, INPUT_PULLUP);
+    pinMode(board::ls_oe, OUTPUT);
+    pinMode(board::can_stdby, OUTPUT);
+
+    // the interlock runs from interrupts, so arm it before anything can block
+    beginInterlock(board::fp_pwr_in, board::fp_pwr_out, board::perst, board::int_flow, board::ext_flow);
+
+    // WS2811B data goes through the level shifter
+    digitalWrite(board::ls_oe, LOW);
+    beginLEDs(board::ws2811b);
 
     int_flow.begin();
     ext_flow.begin();
 
+    // no waiting for a serial monitor; anything printed before it attaches is lost
     Serial.begin(9600);
-    while (!Serial && millis() < 5000)
+    Serial.printf("CAN SMBus Water Cooling Loop Controller, %s reset\n", resetCause());
+    Wire1.setSDA(board::i2c_sda);
+    Wire1.setSCL(board::i2c_scl);
+    local_bus.begin(LOCAL_BUS_HZ);
+
+    /*
+     *  Set up chiller link
+     */
+    Serial1.begin(LINK_BAUD);
+    beginLink(Serial1);
+
+    /*
+     *  Republish it to the host on CAN
+     */
+    beginCAN(board::can_stdby);
+
+    /*
+     *  Answer the host on SMBus
+     */
+    beginSMBus(SMBUS_ADDRESS);
+
+    // everything below runs on static storage; in the zero_heap build a malloc from here on is a fault
+    lockHeap();
+}
+
+void loop()
+{
+    feedWatchdog();
+    local_bus.service();
+    startPeripherals();
+    handleUSBSerial();
+    serviceLink();
+    readCaseSensor();
+    // every pass, so in integers: a soft-float log() per NTC cost more than the rest of the loop
+    int_flow_reading = flowFromSpeed<board::flow>(int_flow.getSpeed());
+    ext_flow_reading = flowFromSpeed<board::flow>(ext_flow.getSpeed());
+    int_out_temp_reading = int_out_temp.readCentiCelsius();
+    int_in_temp_reading = int_in_temp.readCentiCelsius();
+    ext_out_temp_reading = ext_out_temp.readCentiCelsius();
+    ext_in_temp_reading = ext_in_temp.readCentiCelsius();
+    reportLoopTemperatures(loopTempValid(int_out_temp_reading) && loopTempValid(int_in_temp_reading) &&
+                           loopTempValid(ext_out_temp_reading) && loopTempValid(ext_in_temp_reading));
+    if (first_decision_time == 0)
     {
-        // wait up to 5 seconds for Arduino Serial Monitor
+        first_decision_time = millis();
+        Serial.printf("First interlock health report %lums after reset\n", first_decision_time);
     }
-    Serial.println("CAN SMBus Water Cooling Loop Controller");
 
-    while (!bme.begin(BME_ADDRESS))
+    struct_heap_stats heap;
+    getHeapStats(&heap);
+    if (heap.faults != heap_faults)
     {
-        Serial.println("No connect to BME!");
-        digitalWrite(LED_BUILTIN, HIGH);
-        delay(100);
-        digitalWrite(LED_BUILTIN, LOW);
-        delay(100);
+        heap_faults = heap.faults;
+        Serial.printf("%lu heap allocations after setup, last %lu bytes\n", heap.faults, heap.last_fault_size);
     }
-    bme_temp->printSensorDetails();
-    bme_humidity->printSensorDetails();
 
-    // SSD1306_SWITCHCAPVCC = generate display voltage from 3.3V internally
-    while (!display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS))
+    struct_interlock interlock;
+    getInterlock(&interlock);
+    if (interlock.state != last_interlock_state)
     {
-        Serial.println("No connect to display!");
-        digitalWrite(LED_BUILTIN, HIGH);
-        delay(250);
-        digitalWrite(LED_BUILTIN, LOW);
-        delay(250);
+        last_interlock_state = interlock.state;
+        Serial.printf("Interlock: %s (fault %d, %d presses blocked)\n",
+                      interlockStateName(interlock.state), interlock.fault, interlock.blocked_presses);
     }
-    display.setTextSize(1);              // Normal 1:1 pixel scale
-    display.setTextColor(SSD1306_WHITE); // Draw white text
-    display.setCursor(0, 0);             // Start at top-left corner
-    display.cp437(true);                 // Use full 256 char 'Code Page 437' font
-
-    ext_out_temp = new NTC_Thermistor(
-        EXT_OUT_TEMP,
-        REFERENCE_RESISTANCE,
-        NOMINAL_RESISTANCE,
-        NOMINAL_TEMPERATURE,
-        B_VALUE);
-    ext_in_temp = new NTC_Thermistor(
-        EXT_IN_TEMP,
-        REFERENCE_RESISTANCE,
-        NOMINAL_RESISTANCE,
-        NOMINAL_TEMPERATURE,
-        B_VALUE);
-    int_out_temp = new NTC_Thermistor(
-        INT_OUT_TEMP,
-        REFERENCE_RESISTANCE,
-        NOMINAL_RESISTANCE,
-        NOMINAL_TEMPERATURE,
-        B_VALUE);
-    int_in_temp = new NTC_Thermistor(
-        INT_IN_TEMP,
-        REFERENCE_RESISTANCE,
-        NOMINAL_RESISTANCE,
-        NOMINAL_TEMPERATURE,
-        B_VALUE);
-}
+    serviceCAN(&interlock);
 
-void loop()
-{
-    digitalWrite(13, LOW);
-    sensors_event_t temp_event, humidity_event;
-    bme_temp->getEvent(&temp_event);
-    bme_humidity->getEvent(&humidity_event);
-    int_flow_reading = flow_coeff * int_flow.getSpeed() + flow_intercept;
-    ext_flow_reading = flow_coeff * ext_flow.getSpeed() + flow_intercept;
-    int_out_temp_reading = int_out_temp->readCelsius();
-    int_in_temp_reading = int_in_temp->readCelsius();
-    ext_out_temp_reading = ext_out_temp->readCelsius();
-    ext_in_temp_reading = ext_in_temp->readCelsius();
-    if (millis() - reading_time >= PAGE_DELAY)
+    led_status.health[LED_EXT_TEMP] = loopTempHealth(ext_in_temp_reading, ext_out_temp_reading);
+    led_status.health[LED_EXT_FLOW] = interlock.ext_flow_ok ? HEALTH_OK : HEALTH_FAULT;
+    led_status.health[LED_INT_TEMP] = loopTempHealth(int_in_temp_reading, int_out_temp_reading);
+    if (!interlock.host_on)
+        led_status.health[LED_INT_FLOW] = HEALTH_UNKNOWN; // internal pump is off with the host
+    else
+        led_status.health[LED_INT_FLOW] = interlock.int_flow_ok ? HEALTH_OK : HEALTH_FAULT;
+    led_status.degraded = !(peripherals[PERIPHERAL_BME].up && peripherals[PERIPHERAL_DISPLAY].up);
+    updateLEDs(&led_status);
+    updateHeatLoad(&interlock);
+    if (peripherals[PERIPHERAL_DISPLAY].up && millis() - reading_time >= PAGE_DELAY)
     {
         reading_time = millis();
         ++reading_state;
-        if (reading_state >= 4)
+        if (reading_state >= 5)
             reading_state = 0;
         switch (reading_state)
         {
         case 0:
             display.clearDisplay();
-            ringMeter("Case T", temp_event.temperature, 0, 100, 0, 0, GAUGE_RADIUS, "\xF8""C");
-            ringMeter("Case RH", humidity_event.relative_humidity, 0, 100, SCREEN_WIDTH - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "%");
-            display.display();
+            ringMeter(display, "Case T", case_temperature, 0, 100, 0, 0, GAUGE_RADIUS, "\xF8""C");
+            ringMeter(display, "Case RH", case_humidity, 0, 100, board::screen::width - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "%");
+            display.show();
             break;
         case 1:
             display.clearDisplay();
-            ringMeter("Int Flow", int_flow_reading, 0, 300, 0, 0, GAUGE_RADIUS, "L/h");
-            ringMeter("Ext Flow", ext_flow_reading, 0, 300, SCREEN_WIDTH - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "L/h");
-            display.display();
+            ringMeter(display, "Int Flow", int_flow_reading, 0, 300, 0, 0, GAUGE_RADIUS, "L/h");
+            ringMeter(display, "Ext Flow", ext_flow_reading, 0, 300, board::screen::width - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "L/h");
+            display.show();
             break;
         case 2:
             display.clearDisplay();
-            ringMeter("Int In", int_in_temp_reading, 0, 100, 0, 0, GAUGE_RADIUS, "\xF8""C");
-            ringMeter("Int Out", int_out_temp_reading, 0, 100, SCREEN_WIDTH - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "\xF8""C");
-            display.display();
+            ringMeter(display, "Int In", wholeCelsius(int_in_temp_reading), 0, 100, 0, 0, GAUGE_RADIUS, "\xF8""C");
+            ringMeter(display, "Int Out", wholeCelsius(int_out_temp_reading), 0, 100, board::screen::width - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "\xF8""C");
+            display.show();
             break;
         case 3:
             display.clearDisplay();
-            ringMeter("Ext In", ext_in_temp_reading, 0, 100, 0, 0, GAUGE_RADIUS, "\xF8""C");
-            ringMeter("Ext Out", ext_out_temp_reading, 0, 100, SCREEN_WIDTH - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "\xF8""C");
-            display.display();
+            ringMeter(display, "Ext In", wholeCelsius(ext_in_temp_reading), 0, 100, 0, 0, GAUGE_RADIUS, "\xF8""C");
+            ringMeter(display, "Ext Out", wholeCelsius(ext_out_temp_reading), 0, 100, board::screen::width - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "\xF8""C");
+            display.show();
+            break;
+        case 4:
+            display.clearDisplay();
+            ringMeter(display, "Int Load", heat_load.internal_w, 0, 1000, 0, 0, GAUGE_RADIUS, "W");
+            ringMeter(display, "HX Eff", heat_load.effectiveness * 100, 0, 100, board::screen::width - 2 * GAUGE_RADIUS, 0, GAUGE_RADIUS, "%");
+            display.show();
             break;
         default:
             break;
@@ -188,84 +241,239 @@ void loop()
     }
 }
 
-// #########################################################################
-//  Draw the meter on the screen, returns x coord of righthand side
-// #########################################################################
-int ringMeter(const char *reading, int value, int vmin, int vmax, int orig_x, int orig_y, int r, const char *units)
+void startPeripherals()
 {
-    int x = orig_x + r;
-    int y = orig_y + r + FONT_Y; // Calculate coords of centre of ring
+    /*
+     *   Deferred Peripheral Start
+     */
+    for (peripheral &device : peripherals)
+    {
+        switch (startPeripheral(&device, millis()))
+        {
+        case PERIPHERAL_STARTED:
+            Serial.printf("%s up at %lums\n", device.name, millis());
+            break;
+        case PERIPHERAL_FAILED:
+            if (device.attempts == 1)
+                Serial.printf("No connect to %s, retrying\n", device.name);
+            break;
+        default:
+            break;
+        }
+    }
+}
 
-    int w = r / 4; // Width of outer ring is 1/4 of radius
+bool startDisplay()
+{
+    // begin() never checks for an ACK, so look for the panel first
+    i2c_transaction probe = {};
+    probe.address = board::screen::address;
+    probe.priority = I2C_PRIORITY_DISPLAY;
+    if (!local_bus.transfer(&probe))
+        return false;
+    // SSD1306_SWITCHCAPVCC = generate display voltage from 3.3V internally
+    if (!display.begin(SSD1306_SWITCHCAPVCC, board::screen::address))
+        return false;
+    display.setTextSize(1);              // Normal 1:1 pixel scale
+    display.setTextColor(SSD1306_WHITE); // Draw white text
+    display.setCursor(0, 0);             // Start at top-left corner
+    display.cp437(true);                 // Use full 256 char 'Code Page 437' font
+    return true;
+}
 
-    int angle = 150; // Half the sweep angle of meter (300 degrees)
+void readCaseSensor()
+{
+    // takes the read queued last time, then queues the next
+    if (!peripherals[PERIPHERAL_BME].up || millis() - bme_time < BME_SAMPLE_MS)
+        return;
+    bme_time = millis();
+    switch (bme.status())
+    {
+    case I2C_DONE:
+        case_temperature = bme.temperature();
+        case_humidity = bme.humidity();
+        break;
+    case I2C_NACK:
+    case I2C_TIMEOUT:
+        // back to the deferred start, which retries it
+        peripherals[PERIPHERAL_BME].up = false;
+        Serial.println("Lost the BME280!");
+        return;
+    default:
+        break;
+    }
+    bme.request();
+}
 
-    int v = map(value, vmin, vmax, -angle, angle); // Map the value to an angle v
+void updateHeatLoad(const struct_interlock *interlock)
+{
+    /*
+     *   Heat Load Estimation
+     */
+    if (millis() - heat_time < HEAT_SAMPLE_MS)
+        return;
+    heat_time = millis();
+    // the heat load model is float, shared with the chiller's plant simulation; it runs at 2 Hz, not every pass
+    float int_in = centiToCelsius(int_in_temp_reading);
+    float int_out = centiToCelsius(int_out_temp_reading);
+    float ext_in = centiToCelsius(ext_in_temp_reading);
+    float ext_out = centiToCelsius(ext_out_temp_reading);
+    heat_load.internal_w = loopHeatLoad(int_flow_reading, int_in, int_out);
+    heat_load.external_w = loopHeatLoad(ext_flow_reading, ext_in, ext_out);
+    heat_load.effectiveness = exchangerEffectiveness(int_flow_reading, int_in, int_out, ext_flow_reading, ext_in, ext_out);
+    addHeatSample(heat_trend, heat_time, heat_load.internal_w);
+    heat_load.trend_w_per_s = heatTrend(heat_trend);
+    if (heat_time - heat_sent >= HEAT_LOAD_SEND_MS)
+    {
+        heat_sent = heat_time;
+        sendHeatLoad(&heat_load);
+    }
 
-    byte seg = 5; // Segments are 5 degrees wide = 60 segments for 300 degrees
-    byte inc = 5; // Draw segments every 5 degrees, increase to 10 for segmented ring
+    struct_smbus_registers registers = {};
+    registers.int_in_temp = int_in_temp_reading;
+    registers.int_out_temp = int_out_temp_reading;
+    registers.ext_in_temp = ext_in_temp_reading;
+    registers.ext_out_temp = ext_out_temp_reading;
+    registers.int_flow = int_flow_reading;
+    registers.ext_flow = ext_flow_reading;
+    registers.internal_w = heat_load.internal_w;
+    registers.external_w = heat_load.external_w;
+    registers.effectiveness = heat_load.effectiveness * 1000;
+    registers.trend = constrain(heat_load.trend_w_per_s * 10, -32768.0f, 32767.0f);
+    registers.case_temp = case_temperature * 100;
+    registers.case_humidity = case_humidity * 100;
+    registers.interlock_state = interlock->state;
+    if (chillerOnline())
+    {
+        registers.reservoir_temp = chillerReadings()->reservoir.temperature * 100;
+        registers.flags |= SMBUS_FLAG_CHILLER_ONLINE;
+        if (chillerReadings()->compressor.running)
+            registers.flags |= SMBUS_FLAG_CHILLER_RUNNING;
+    }
+    if (interlock->int_flow_ok)
+        registers.flags |= SMBUS_FLAG_INT_FLOW_OK;
+    if (interlock->ext_flow_ok)
+        registers.flags |= SMBUS_FLAG_EXT_FLOW_OK;
+    publishSMBus(&registers);
+}
 
-    // Draw colour blocks every inc degrees
-    for (int i = -angle; i < angle; i += inc)
+void handleUSBSerial()
+{
+    if (usb_line.read(Serial))
     {
-        // Calculate pair of coordinates for segment start
-        float sx = cos((i - 90) * 0.0174532925);
-        float sy = sin((i - 90) * 0.0174532925);
-        uint16_t x0 = sx * (r - w) + x;
-        uint16_t y0 = sy * (r - w) + y;
-        uint16_t x1 = sx * r + x;
-        uint16_t y1 = sy * r + y;
-
-        // Calculate pair of coordinates for segment end
-        float sx2 = cos((i + seg - 90) * 0.0174532925);
-        float sy2 = sin((i + seg - 90) * 0.0174532925);
-        int x2 = sx2 * (r - w) + x;
-        int y2 = sy2 * (r - w) + y;
-        int x3 = sx2 * r + x;
-        int y3 = sy2 * r + y;
-
-        if (i < v)
-        { // Fill in coloured segments with 2 triangles
-            display.fillTriangle(x0, y0, x1, y1, x2, y2, SSD1306_WHITE);
-            display.fillTriangle(x1, y1, x2, y2, x3, y3, SSD1306_WHITE);
-        }
-        else // Fill in blank segments
+        char cmd = usb_line.text[0];
+        Serial.print(usb_line.text);
+        switch (cmd)
+        {
+        case 's':
+            /* chiller setpoint */
+            if (sendCommand(COMMAND_SET_SETPOINT, atof(usb_line.text + 1)))
+                Serial.println(" queued");
+            else
+                Serial.println(" LINK BUSY");
+            break;
+        case 'r':
+            /* chiller run */
+            Serial.println(sendCommand(COMMAND_RUN) ? " queued" : " LINK BUSY");
+            break;
+        case 'x':
+            /* chiller stop */
+            Serial.println(sendCommand(COMMAND_STOP) ? " queued" : " LINK BUSY");
+            break;
+        case 'g':
         {
-            display.fillTriangle(x0, y0, x1, y1, x2, y2, SSD1306_BLACK);
-            display.fillTriangle(x1, y1, x2, y2, x3, y3, SSD1306_BLACK);
+            /* chiller settings and link statistics */
+            sendCommand(COMMAND_READ_SETTINGS);
+            const struct_remote_settings *remote = chillerSettings();
+            const struct_link_stats *stats = linkStats();
+            Serial.printf("\nChiller %s, %s, setpoint %.1fC +/-%.1fC\n",
+                          chillerOnline() ? "online" : "OFFLINE", remote->running ? "running" : "stopped",
+                          remote->setpoint, remote->hysteresis);
+            Serial.printf("Link: %lu sent, %lu retransmits, %lu acked, %lu rejected, %lu dropped, %lu readings\n",
+                          stats->sent, stats->retransmits, stats->acked, stats->rejected, stats->dropped, stats->readings);
+            const struct_clock_sync *clock = chillerClock();
+            Serial.printf("Clock: %lu/%lu pongs, offset %lldus, delay %luus, drift %.2fppm; latency %luus, max %luus, %lu lost\n",
+                          stats->pongs, stats->pings, clock->offset_us, clock->delay_us, clock->drift_ppm,
+                          stats->latency_us, stats->latency_max_us, stats->lost);
+            Serial.printf("Heat: internal %.0fW, external %.0fW, exchanger %.0f%%, trend %+.1fW/s, %lu sent\n",
+                          heat_load.internal_w, heat_load.external_w, heat_load.effectiveness * 100,
+                          heat_load.trend_w_per_s, stats->heat_loads);
+            const struct_can_stats *can = canStats();
+            Serial.printf("CAN: host %s, %lu sent, %lu received, %lu overruns, %lu commands, %lu alarms, %lu readings\n",
+                          hostOnline() ? "online" : "OFFLINE", can->sent, can->received, can->overruns, can->commands,
+                          can->alarms, can->readings);
+            const struct_i2c_stats *bus = local_bus.stats();
+            Serial.printf("I2C: %lu done, %lu NACKs, %lu timeouts, %lu lost, %lu recoveries\n",
+                          bus->completed, bus->nacks, bus->timeouts, bus->lost, bus->recoveries);
+            break;
+        }
+        case 'c':
+            /* cycles per pass of the sensor conversions, against the float maths they replaced */
+            benchmarkSensors();
+            break;
+        default:
+            Serial.println("UNKNOWN COMMAND");
+            break;
         }
     }
+}
+
+void benchmarkSensors()
+{
+    /*
+     *   Sensor Conversion Benchmark
+     */
+    // one set of readings through both, so only the maths differs
+    const int adc[] = {analogRead(board::int_out_temp), analogRead(board::int_in_temp),
+                       analogRead(board::ext_out_temp), analogRead(board::ext_in_temp)};
+    const unsigned int speed[] = {int_flow.getSpeed(), ext_flow.getSpeed()};
+    const double flow_coeff = board::flow::slope_mlph / 1000.0;
+    const double flow_intercept = board::flow::offset_mlph / 1000.0;
+    volatile double float_sink = 0;
+    volatile int32_t fixed_sink = 0;
+
+    startCycleCounter();
+    uint32_t start = cycleCount();
+    for (uint8_t pass = 0; pass < BENCH_PASSES; pass++)
+    {
+        for (int a : adc)
+            float_sink = ntc_thermistor<board::int_in_temp, board::ntc>::celsiusFromADC(a);
+        for (unsigned int s : speed)
+            float_sink = (unsigned int)(flow_coeff * s + flow_intercept);
+    }
+    uint32_t float_cycles = (cycleCount() - start) / BENCH_PASSES;
+
+    start = cycleCount();
+    for (uint8_t pass = 0; pass < BENCH_PASSES; pass++)
+    {
+        for (int a : adc)
+            fixed_sink = ntcCentiCelsius<board::ntc>(a);
+        for (unsigned int s : speed)
+            fixed_sink = flowFromSpeed<board::flow>(s);
+    }
+    uint32_t fixed_cycles = (cycleCount() - start) / BENCH_PASSES;
+
+    Serial.printf("\nSensor pass: %lu cycles in float, %lu in fixed point, %lu saved per loop() at %lu MHz\n",
+                  float_cycles, fixed_cycles, float_cycles - fixed_cycles, F_CPU / 1000000);
+    Serial.printf("Int in: %.2fC from the table, %.2fC from the equation\n", centiToCelsius(ntcCentiCelsius<board::ntc>(adc[1])),
+                  ntc_thermistor<board::int_in_temp, board::ntc>::celsiusFromADC(adc[1]));
+    // the sinks are only there so neither loop is optimised away
+    (void)float_sink;
+    (void)fixed_sink;
+}
 
-    // Convert value to a string
-    char buf[10];
-    byte len = 1;
-    if (value > 9)
-        len = 2;
-    if (value > 99)
-        len = 3;
-    if (value > 999)
-        len = 4;
-    dtostrf(value, len, 0, buf);
-
-    // Set the text colour to default
-    display.setTextColor(SSD1306_WHITE, SSD1306_BLACK);
-
-    // Print reading
-    display.setTextSize(1);
-    display.setCursor(x - ((FONT_X * strlen(reading)) / 2), orig_y);
-    display.print(reading);
-
-    // Print value
-    display.setTextSize(2);
-    display.setCursor(x - (FONT_X * 2 * len / 2), y - FONT_Y); // Value in middle
-    display.print(buf);
-
-    // Print units
-
-    display.setTextSize(1);
-    display.setCursor(x - ((FONT_X * strlen(units)) / 2), y + FONT_Y); // Units display
-    display.print(units);
-
-    // Calculate and return right hand side x coordinate
-    return x + r;
-}
\ No newline at end of file
+bool loopTempValid(centi_c temperature)
+{
+    return temperature < LOOP_TEMP_HIGH_LIMIT * 100 && temperature > LOOP_TEMP_LOW_LIMIT * 100;
+}
+
+led_health loopTempHealth(centi_c inflow, centi_c outflow)
+{
+    centi_c hottest = max(inflow, outflow);
+    centi_c coldest = min(inflow, outflow);
+    if (hottest >= LOOP_TEMP_HIGH_LIMIT * 100 || coldest <= LOOP_TEMP_LOW_LIMIT * 100)
+        return HEALTH_FAULT;
+    if (hottest >= (LOOP_TEMP_HIGH_LIMIT - LOOP_TEMP_WARN_MARGIN) * 100)
+        return HEALTH_WARN;
+    return HEALTH_OK;
+}
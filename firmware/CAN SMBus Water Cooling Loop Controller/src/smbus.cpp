@@ -0,0 +1,45 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include "smbus.h"
+
+static struct_smbus_registers registers;
+static volatile uint8_t pointer = 0;
+
+static void onReceive(int count)
+{
+    // the first byte is the command code, i.e. the register
+    if (count > 0)
+        pointer = Wire.read();
+    while (Wire.available())
+        Wire.read();
+}
+
+static void onRequest()
+{
+    uint8_t at = pointer;
+    if (at >= sizeof(registers))
+    {
+        // past the end reads as 0xFF, as an unimplemented register does on most chips
+        Wire.write(0xFF);
+        return;
+    }
+    Wire.write((const uint8_t *)&registers + at, min(sizeof(registers) - at, SMBUS_REPLY_MAX));
+}
+
+void beginSMBus(uint8_t address)
+{
+    registers.chip_id = SMBUS_CHIP_ID;
+    registers.revision = SMBUS_REVISION;
+    Wire.begin(address);
+    Wire.onReceive(onReceive);
+    Wire.onRequest(onRequest);
+}
+
+void publishSMBus(const struct_smbus_registers *values)
+{
+    noInterrupts();
+    registers = *values;
+    registers.chip_id = SMBUS_CHIP_ID;
+    registers.revision = SMBUS_REVISION;
+    interrupts();
+}
@@ -0,0 +1,52 @@
+#ifndef __LOOP_SMBUS__
+#define __LOOP_SMBUS__
+#include <cstdint>
+
+/*
+ *   SMBus slave register map for the host
+ *
+ *   The card answers on the motherboard's SMBus (Wire, pins 18/19) the way a
+ *   hardware monitor chip does: a write of one byte sets the register
+ *   pointer, and reads return bytes from there on, so both SMBus "read byte"
+ *   and "read word" work, as does i2cdump. Words are little endian, as SMBus
+ *   sends them. Registers are read only; written data bytes are ignored.
+ *
+ *   loop() fills a copy and publishes it with interrupts off, so a read
+ *   never sees half of an update.
+ */
+
+#define SMBUS_ADDRESS 0x2E // a free hardware monitor address on most boards
+#define SMBUS_CHIP_ID 0xC5
+#define SMBUS_REVISION 1
+#define SMBUS_REPLY_MAX 32u // Wire's buffer
+
+struct __attribute__((packed)) struct_smbus_registers
+{
+    uint8_t chip_id;         // 0x00
+    uint8_t revision;        // 0x01
+    int16_t int_in_temp;     // 0x02, centidegrees C
+    int16_t int_out_temp;    // 0x04
+    int16_t ext_in_temp;     // 0x06
+    int16_t ext_out_temp;    // 0x08
+    uint16_t int_flow;       // 0x0A, L/h
+    uint16_t ext_flow;       // 0x0C
+    uint16_t internal_w;     // 0x0E, W
+    uint16_t external_w;     // 0x10
+    uint16_t effectiveness;  // 0x12, per mille
+    int16_t trend;           // 0x14, 0.1 W/s
+    int16_t case_temp;       // 0x16, centidegrees C
+    uint16_t case_humidity;  // 0x18, 0.01 %RH
+    int16_t reservoir_temp;  // 0x1A, centidegrees C, from the chiller
+    uint8_t interlock_state; // 0x1C, interlock_state
+    uint8_t flags;           // 0x1D, SMBUS_FLAG_*
+};
+
+#define SMBUS_FLAG_CHILLER_ONLINE 0x01
+#define SMBUS_FLAG_CHILLER_RUNNING 0x02
+#define SMBUS_FLAG_INT_FLOW_OK 0x04
+#define SMBUS_FLAG_EXT_FLOW_OK 0x08
+
+void beginSMBus(uint8_t address);
+void publishSMBus(const struct_smbus_registers *values);
+
+#endif
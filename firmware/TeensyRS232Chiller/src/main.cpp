@@ -2,19 +2,18 @@
 #include <RunningAverage.h>
 #include <OneWire.h>
 #include <DallasTemperature.h>
+#include <board.h>
 
-#define ONE_WIRE 2   // DS18B20 bus
-#define RES_LEVEL A9 // Analog input for eTape Rsense
-#define RES_REF A8   // Analog input for eTape Rref
+// same chiller wiring as the CW-5200 controller
+typedef cw5200_board board;
 
 RunningAverage resLvlRA(100);
 RunningAverage resRefRA(100);
 
-#define TEMPERATURE_PRECISION 9
-OneWire oneWire(ONE_WIRE);
+OneWire oneWire(board::one_wire);
 DallasTemperature sensors(&oneWire);
-DeviceAddress outside_temp = {0x28, 0x4E, 0x6A, 0x45, 0x92, 0x17, 0x02, 0xEC};
-DeviceAddress reservoir_temp = {0x28, 0xFF, 0x02, 0x5D, 0xC1, 0x17, 0x05, 0xCB};
+const uint8_t *outside_temp = cw5200_outside_probe;
+const uint8_t *reservoir_temp = cw5200_reservoir_probe;
 float reservoir_temp_reading = 0.0;
 float outside_temp_reading = 0.0;
 
@@ -38,22 +37,22 @@ void setup(void)
   resRefRA.clear();
 
   sensors.begin();
-  if (!sensors.getAddress(outside_temp, 0))
+  if (!sensors.isConnected(outside_temp))
   {
     Serial.println("Error: Unable to find address for outside_temp");
   }
   else
   {
-    sensors.setResolution(outside_temp, TEMPERATURE_PRECISION);
+    sensors.setResolution(outside_temp, board::temperature_precision);
   }
 
-  if (!sensors.getAddress(reservoir_temp, 1))
+  if (!sensors.isConnected(reservoir_temp))
   {
     Serial.println("Error: Unable to find address for reservoir_temp");
   }
   else
   {
-    sensors.setResolution(reservoir_temp, TEMPERATURE_PRECISION);
+    sensors.setResolution(reservoir_temp, board::temperature_precision);
   }
   pause = true;
 }
@@ -118,8 +117,8 @@ void loop()
     if (millis() - timeout >= 10)
     {
       timeout = millis();
-      resLvlRA.addValue(analogRead(RES_LEVEL));
-      resRefRA.addValue(analogRead(RES_REF));
+      resLvlRA.addValue(analogRead(board::res_level));
+      resRefRA.addValue(analogRead(board::res_ref));
       ++samples;
     }
     if (samples >= 100)
@@ -0,0 +1,191 @@
+#ifndef __FIRMWARE_ABP2__
+#define __FIRMWARE_ABP2__
+#include <Arduino.h>
+#include <i2c_queue.h>
+
+/*
+ *   Honeywell ABP2 digital pressure sensor on I2C
+ *
+ *   A measurement is started with the 0xAA command and read back as a status
+ *   byte followed by 24 bit pressure and temperature. service() is called
+ *   every pass of loop(): it queues the command on the I2C bus, comes back
+ *   once ABP2_CONVERSION_MS have passed and queues the 7 byte read. If the
+ *   part still reports busy it reads again ABP2_BUSY_RETRY_MS later rather
+ *   than spinning on the status byte. Nothing here waits for the bus.
+ *
+ *   The transfer function is integer maths on the limits in the part
+ *   descriptor, giving centipascals and centidegrees:
+ *
+ *     abp2_sensor<board::filter_sensor> filter_sensor(local_bus);
+ *     if (filter_sensor.service(millis()) == ABP2_READY)
+ *         use(filter_sensor.sample.pressure_cpa);
+ */
+
+#define ABP2_COMMAND 0xAA
+#define ABP2_FRAME_BYTES 7
+#define ABP2_STATUS_POWER 0x40           // set when the part is powered
+#define ABP2_STATUS_BUSY 0x20            // conversion still running
+#define ABP2_STATUS_MEMORY_ERROR 0x04    // calibration memory failed its checksum
+#define ABP2_STATUS_MATH_SATURATION 0x01 // reading outside the compensated range
+#define ABP2_CONVERSION_MS 5             // command to data ready
+#define ABP2_BUSY_RETRY_MS 1
+
+enum abp2_event : uint8_t
+{
+    ABP2_WAITING = 0, // conversion running, or not yet time for the next one
+    ABP2_READY,       // sample holds a new reading
+    ABP2_FAULT,       // no answer, or the status byte reports an error
+};
+
+struct struct_abp2_sample
+{
+    uint8_t status;
+    int32_t pressure_cpa;      // centipascals
+    int32_t temperature_cdegc; // centidegrees C
+};
+
+template <typename PART>
+struct abp2_transfer
+{
+    static int32_t pressure(uint32_t raw)
+    {
+        return PART::pressure_min_cpa + (int32_t)((int64_t)((int32_t)raw - (int32_t)PART::output_min) *
+                                                  (PART::pressure_max_cpa - PART::pressure_min_cpa) /
+                                                  (int32_t)(PART::output_max - PART::output_min));
+    }
+
+    static int32_t temperature(uint32_t raw)
+    {
+        return PART::temperature_min_cdegc +
+               (int32_t)((int64_t)raw * (PART::temperature_max_cdegc - PART::temperature_min_cdegc) / 0xFFFFFF);
+    }
+
+    // a busy frame is ABP2_WAITING and leaves sample untouched
+    static abp2_event parse(const uint8_t *frame, struct_abp2_sample *sample)
+    {
+        uint8_t status = frame[0];
+        if (status & ABP2_STATUS_BUSY)
+            return ABP2_WAITING;
+        sample->status = status;
+        if (!(status & ABP2_STATUS_POWER) || (status & (ABP2_STATUS_MEMORY_ERROR | ABP2_STATUS_MATH_SATURATION)))
+            return ABP2_FAULT;
+        sample->pressure_cpa = pressure((uint32_t)frame[1] << 16 | (uint32_t)frame[2] << 8 | frame[3]);
+        sample->temperature_cdegc = temperature((uint32_t)frame[4] << 16 | (uint32_t)frame[5] << 8 | frame[6]);
+        return ABP2_READY;
+    }
+};
+
+template <typename PART>
+class abp2_sensor
+{
+public:
+    explicit abp2_sensor(i2c_bus &bus) : bus(bus)
+    {
+        command.address = PART::address;
+        command.priority = I2C_PRIORITY_SENSOR;
+        command.command[0] = ABP2_COMMAND;
+        command.command_length = 3; // the command and two zero bytes
+        result.address = PART::address;
+        result.priority = I2C_PRIORITY_SENSOR;
+        result.rx = frame;
+        result.rx_length = ABP2_FRAME_BYTES;
+    }
+
+    // the part only ACKs its address; period_ms is from one conversion start to the next
+    bool begin(uint32_t period_ms)
+    {
+        period = period_ms;
+        state = ABP2_STATE_IDLE;
+        i2c_transaction probe = {};
+        probe.address = PART::address;
+        probe.priority = I2C_PRIORITY_SENSOR;
+        return bus.transfer(&probe);
+    }
+
+    abp2_event service(uint32_t now)
+    {
+        switch (state)
+        {
+        case ABP2_STATE_IDLE:
+            if ((int32_t)(now - due) < 0 || !bus.submit(&command))
+                return ABP2_WAITING;
+            started = now;
+            state = ABP2_STATE_STARTING;
+            return ABP2_WAITING;
+
+        case ABP2_STATE_STARTING:
+            if (i2cPending(command))
+                return ABP2_WAITING;
+            if (command.status != I2C_DONE)
+                return fault(now);
+            due = now + ABP2_CONVERSION_MS;
+            state = ABP2_STATE_CONVERTING;
+            return ABP2_WAITING;
+
+        case ABP2_STATE_CONVERTING:
+            if ((int32_t)(now - due) < 0 || !bus.submit(&result))
+                return ABP2_WAITING;
+            state = ABP2_STATE_READING;
+            return ABP2_WAITING;
+
+        case ABP2_STATE_READING:
+        default:
+            if (i2cPending(result))
+                return ABP2_WAITING;
+            if (result.status != I2C_DONE)
+                return fault(now);
+            break;
+        }
+
+        abp2_event event = abp2_transfer<PART>::parse(frame, &sample);
+        if (event == ABP2_WAITING)
+        {
+            ++busy_polls;
+            due = now + ABP2_BUSY_RETRY_MS;
+            state = ABP2_STATE_CONVERTING;
+            return ABP2_WAITING;
+        }
+        state = ABP2_STATE_IDLE;
+        due = started + period;
+        if (event == ABP2_FAULT)
+            ++faults;
+        else
+            ++samples;
+        return event;
+    }
+
+    struct_abp2_sample sample = {};
+    uint32_t samples = 0;
+    uint32_t busy_polls = 0; // reads that found the conversion still running
+    uint32_t faults = 0;
+
+private:
+    enum abp2_state : uint8_t
+    {
+        ABP2_STATE_IDLE = 0,   // until the next period starts
+        ABP2_STATE_STARTING,   // command queued
+        ABP2_STATE_CONVERTING, // until the conversion should be done
+        ABP2_STATE_READING,    // read queued
+    };
+
+    // a part that does not answer reads as status 0, power bit clear
+    abp2_event fault(uint32_t now)
+    {
+        sample.status = 0;
+        ++faults;
+        state = ABP2_STATE_IDLE;
+        due = now + period;
+        return ABP2_FAULT;
+    }
+
+    i2c_bus &bus;
+    i2c_transaction command = {};
+    i2c_transaction result = {};
+    uint8_t frame[ABP2_FRAME_BYTES] = {};
+    abp2_state state = ABP2_STATE_IDLE;
+    uint32_t period = 100;
+    uint32_t started = 0;
+    uint32_t due = 0;
+};
+
+#endif
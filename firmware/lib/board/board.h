@@ -0,0 +1,116 @@
+#ifndef __FIRMWARE_BOARD__
+#define __FIRMWARE_BOARD__
+#include <Arduino.h>
+
+/*
+ *   Compile-time descriptions of the boards
+ *
+ *   Every pin, bus address and sensor constant lives here once, as static
+ *   constexpr members, so the sketches and the templated drivers in this
+ *   library fold them into immediates: digitalWriteFast() takes its fast path,
+ *   and there is no object to construct or look up at run time. Each sketch
+ *   picks its board with a typedef.
+ */
+
+struct oled_128x64
+{
+    static constexpr uint8_t width = 128;   // pixels
+    static constexpr uint8_t height = 64;   // pixels
+    static constexpr uint8_t address = 0x3C; // 0x3D on some 128x64 panels
+    static constexpr int8_t reset = -1;     // sharing the Teensy reset
+};
+
+struct ntc_100k_3950
+{
+    static constexpr double reference_resistance = 100000; // divider resistor, ohms
+    static constexpr double nominal_resistance = 100000;   // at nominal_temperature, ohms
+    static constexpr double nominal_temperature = 25;      // degC
+    static constexpr double b_value = 3950;
+    static constexpr double adc_full_scale = 1023;
+};
+
+// Flow sensors on the loop controller: L/h is linear in the rotor speed FanController reports
+struct flow_sensor_linear
+{
+    static constexpr int32_t slope_mlph = 181;    // mL/h per rpm
+    static constexpr int32_t offset_mlph = -9750; // mL/h; below 54 rpm there is no flow
+};
+
+// Honeywell ABP2, +/-2 psi differential, I2C, with the 30%..70% transfer function
+struct abp2_002pd
+{
+    static constexpr uint8_t address = 0x28;
+    static constexpr int32_t pressure_min_cpa = -1378951; // -2 psi in centipascals
+    static constexpr int32_t pressure_max_cpa = 1378951;  // +2 psi
+    static constexpr uint32_t output_min = 5033165;       // 30% of 2^24 counts
+    static constexpr uint32_t output_max = 11744051;      // 70% of 2^24 counts
+    static constexpr int32_t temperature_min_cdegc = -5000;
+    static constexpr int32_t temperature_max_cdegc = 15000;
+};
+
+/*
+ *   CW-5200 chiller board (also the TeensyRS232Chiller prototype)
+ */
+struct cw5200_board
+{
+    static constexpr uint8_t ser_rx = 0;          // Serial Rx
+    static constexpr uint8_t ser_tx = 1;          // Serial Tx
+    static constexpr uint8_t one_wire = 2;        // DS18B20 bus
+    static constexpr uint8_t valve_rly = 8;       // OUTPUT valve
+    static constexpr uint8_t compressor_rly = 9;  // OUTPUT compressor
+    static constexpr uint8_t fan_pwm = 10;        // OUTPUT fan PWM signal
+    static constexpr uint8_t bottom_fan_rpm = 11; // INPUT Bottom fan tach
+    static constexpr uint8_t top_fan_rpm = 12;    // INPUT Top fan tach
+    static constexpr uint8_t alarms_rly = 13;     // OUTPUT alarms
+    static constexpr uint8_t pump_rly = 14;       // OUTPUT pump
+    static constexpr uint8_t flow_sw = 15;        // INPUT PULLUP flow switch; low == OK
+    static constexpr uint8_t i2c_sda = 17;        // Local I2C data
+    static constexpr uint8_t i2c_scl = 16;        // Local I2C clock
+    static constexpr uint8_t encoder_switch = 18; // Encoder push switch
+    static constexpr uint8_t encoder_a = 20;      // Encoder quad channel A
+    static constexpr uint8_t encoder_b = 19;      // Encoder quad channel B
+    static constexpr uint8_t filter_p = A7;       // Analog input for differential pressure sensor (prototype)
+    static constexpr uint8_t res_level = A9;      // Analog input for eTape Rsense
+    static constexpr uint8_t res_ref = A8;        // Analog input for eTape Rref
+
+    static constexpr uint8_t bme_address = 0x76;
+    static constexpr uint8_t temperature_precision = 9; // DS18B20 bits
+    typedef oled_128x64 screen;
+    typedef abp2_002pd filter_sensor; // filter delta-P, on the local I2C bus
+};
+
+// DS18B20 ROM codes of the probes fitted to the CW-5200
+constexpr uint8_t cw5200_reservoir_probe[8] = {0x28, 0xFF, 0x02, 0x5D, 0xC1, 0x17, 0x05, 0xCB};
+constexpr uint8_t cw5200_outside_probe[8] = {0x28, 0x4E, 0x6A, 0x45, 0x92, 0x17, 0x02, 0xEC};
+
+/*
+ *   CAN SMBus water cooling loop controller (PCIe card)
+ */
+struct loop_controller_board
+{
+    static constexpr uint8_t int_flow = 0;      // INPUT Internal loop flow sensor
+    static constexpr uint8_t ext_flow = 1;      // INPUT External loop flow sensor
+    static constexpr uint8_t can_stdby = 2;     // OUTPUT CAN standby, active high
+    static constexpr uint8_t can_tx = 3;        // CAN transmit
+    static constexpr uint8_t can_rx = 4;        // CAN receive
+    static constexpr uint8_t ls_oe = 5;         // OUTPUT Level shifter output enable, active low
+    static constexpr uint8_t perst = 6;         // INPUT PCIe #PERST status
+    static constexpr uint8_t ws2811b = 7;       // OUTPUT WS2811B data
+    static constexpr uint8_t smbus_sda = 18;    // SMBus I2C data
+    static constexpr uint8_t smbus_scl = 19;    // SMBus I2C clock
+    static constexpr uint8_t fp_pwr_out = 22;   // OUTPUT Front panel power switch output
+    static constexpr uint8_t fp_pwr_in = 23;    // INPUT Front panel power switch input
+    static constexpr uint8_t i2c_sda = 30;      // Local I2C data
+    static constexpr uint8_t i2c_scl = 29;      // Local I2C clock
+    static constexpr uint8_t ext_out_temp = A0; // External loop outflow temperature, NTC
+    static constexpr uint8_t ext_in_temp = A1;  // External loop inflow temperature, NTC
+    static constexpr uint8_t int_in_temp = A2;  // Internal loop inflow temperature, NTC
+    static constexpr uint8_t int_out_temp = A3; // Internal loop outflow temperature, NTC
+
+    static constexpr uint8_t bme_address = 0x76;
+    typedef oled_128x64 screen;
+    typedef ntc_100k_3950 ntc;
+    typedef flow_sensor_linear flow;
+};
+
+#endif
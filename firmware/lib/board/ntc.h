@@ -0,0 +1,51 @@
+#ifndef __FIRMWARE_NTC__
+#define __FIRMWARE_NTC__
+#include <Arduino.h>
+#include <math.h>
+#include <fixed_point.h>
+
+/*
+ *   NTC thermistor on an analog pin, below a fixed divider resistor
+ *
+ *   The same maths as NTC_Thermistor (B-parameter equation, 10 bit reading),
+ *   but with the pin and part as template arguments taken from the board
+ *   descriptor: no heap object, no virtual call, and the constants fold at
+ *   compile time.
+ *
+ *     ntc_thermistor<board::ext_in_temp, board::ntc> ext_in_temp;
+ *     centi_c temperature = ext_in_temp.readCentiCelsius();
+ *
+ *   readCentiCelsius() looks the reading up in the table fixed_point.h
+ *   builds from the same equation; readCelsius() is the equation itself,
+ *   a soft-float double log() per call, kept as the reference it is
+ *   benchmarked against.
+ */
+
+template <uint8_t PIN, typename NTC>
+struct ntc_thermistor
+{
+    static double readResistance()
+    {
+        return NTC::reference_resistance / (NTC::adc_full_scale / analogRead(PIN) - 1);
+    }
+
+    static centi_c readCentiCelsius()
+    {
+        return ntcCentiCelsius<NTC>(analogRead(PIN));
+    }
+
+    static double readCelsius()
+    {
+        return celsiusFromADC(analogRead(PIN));
+    }
+
+    static double celsiusFromADC(uint16_t adc)
+    {
+        double resistance = NTC::reference_resistance / (NTC::adc_full_scale / adc - 1);
+        double inverse_kelvin = 1.0 / (NTC::nominal_temperature + 273.15) +
+                                log(resistance / NTC::nominal_resistance) / NTC::b_value;
+        return 1.0 / inverse_kelvin - 273.15;
+    }
+};
+
+#endif
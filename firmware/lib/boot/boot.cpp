@@ -0,0 +1,81 @@
+#include <Arduino.h>
+#include "boot.h"
+
+void armWatchdog(uint32_t timeout_ms)
+{
+    // the unlock sequence opens a short window for the configuration writes;
+    // nothing may interrupt it, which holds in startup_early_hook()
+    WDOG_UNLOCK = WDOG_UNLOCK_SEQ1;
+    WDOG_UNLOCK = WDOG_UNLOCK_SEQ2;
+    __asm__ volatile("nop");
+    __asm__ volatile("nop");
+    // clocked from the 1 kHz LPO, so the timeout counts milliseconds
+    WDOG_TOVALH = timeout_ms >> 16;
+    WDOG_TOVALL = timeout_ms & 0xFFFF;
+    WDOG_PRESC = 0;
+    WDOG_STCTRLH = WDOG_STCTRLH_ALLOWUPDATE | WDOG_STCTRLH_WDOGEN | WDOG_STCTRLH_STOPEN | WDOG_STCTRLH_WAITEN;
+}
+
+void feedWatchdog()
+{
+    // the two refresh writes must land within 20 bus clocks of each other
+    __disable_irq();
+    WDOG_REFRESH = 0xA602;
+    WDOG_REFRESH = 0xB480;
+    __enable_irq();
+}
+
+void enablePortClocks()
+{
+    SIM_SCGC5 |= SIM_SCGC5_PORTA | SIM_SCGC5_PORTB | SIM_SCGC5_PORTC | SIM_SCGC5_PORTD | SIM_SCGC5_PORTE;
+}
+
+void startCycleCounter()
+{
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+}
+
+uint32_t cycleCount()
+{
+    return ARM_DWT_CYCCNT;
+}
+
+bool watchdogReset()
+{
+    return RCM_SRS0 & RCM_SRS0_WDOG;
+}
+
+const char *resetCause()
+{
+    if (RCM_SRS0 & RCM_SRS0_WDOG)
+        return "watchdog";
+    if (RCM_SRS0 & RCM_SRS0_LVD)
+        return "brownout";
+    if (RCM_SRS0 & RCM_SRS0_POR)
+        return "power on";
+    if (RCM_SRS0 & RCM_SRS0_PIN)
+        return "reset pin";
+    if (RCM_SRS0 & (RCM_SRS0_LOL | RCM_SRS0_LOC))
+        return "clock loss";
+    if (RCM_SRS1 & RCM_SRS1_SW)
+        return "software";
+    if (RCM_SRS1 & RCM_SRS1_LOCKUP)
+        return "core lockup";
+    return "unknown";
+}
+
+peripheral_event startPeripheral(peripheral *device, uint32_t now)
+{
+    if (device->up || (device->attempts > 0 && (int32_t)(now - device->next_attempt) < 0))
+        return PERIPHERAL_IDLE;
+    ++device->attempts;
+    if (device->begin())
+    {
+        device->up = true;
+        return PERIPHERAL_STARTED;
+    }
+    device->backoff = device->backoff == 0 ? PERIPHERAL_RETRY_MS : min(device->backoff * 2, PERIPHERAL_RETRY_MAX_MS);
+    device->next_attempt = now + device->backoff;
+    return PERIPHERAL_FAILED;
+}
@@ -0,0 +1,48 @@
+#ifndef __FIRMWARE_BOOT__
+#define __FIRMWARE_BOOT__
+#include <cstdint>
+
+/*
+ *   Staged boot helpers shared by the Teensy 3.2 boards
+ *
+ *   armWatchdog() and enablePortClocks() only touch registers, so they are
+ *   safe to call from startup_early_hook(), before the C runtime is set up,
+ *   which is where each board drives its outputs to a safe state. Slow or
+ *   optional peripherals are then brought up from loop() with startPeripheral(),
+ *   which retries with exponential backoff instead of blocking.
+ */
+
+#define WATCHDOG_TIMEOUT_MS 2000          // loop() must feed the watchdog at least this often
+#define PERIPHERAL_RETRY_MS 250           // first retry delay after a failed begin()
+#define PERIPHERAL_RETRY_MAX_MS 60000UL   // backoff stops doubling here
+
+enum peripheral_event : uint8_t
+{
+    PERIPHERAL_IDLE = 0, // up already, or waiting for the next attempt
+    PERIPHERAL_STARTED,  // begin() just succeeded
+    PERIPHERAL_FAILED,   // begin() just failed; attempts says how many times
+};
+
+struct peripheral
+{
+    const char *name;
+    uint16_t error;     // for the caller to raise on the first failure, 0 for none
+    bool (*begin)();
+    bool up = false;
+    uint16_t attempts = 0;
+    uint32_t next_attempt = 0;
+    uint32_t backoff = 0;
+};
+
+void armWatchdog(uint32_t timeout_ms);
+void feedWatchdog();
+void enablePortClocks();
+bool watchdogReset();
+const char *resetCause();
+// DWT core clock cycle count, for timing code on the board; wraps every ~60 s at 72 MHz
+void startCycleCounter();
+uint32_t cycleCount();
+
+peripheral_event startPeripheral(peripheral *device, uint32_t now);
+
+#endif
@@ -0,0 +1,179 @@
+#include "can_frames.h"
+
+uint8_t packReadings(const struct_readings *readings, can_frame *frames)
+{
+    can_frame *frame = frames;
+
+    struct_can_readings start = {readings->header.sequence, readings->error.code, readings->error.alert, CAN_READINGS_FRAMES};
+    packFrame(CAN_ID_READINGS, start, frame++);
+    struct_can_readings_time time = {readings->header.time_us};
+    packFrame(CAN_ID_READINGS_TIME, time, frame++);
+
+    struct_can_reservoir reservoir = {readings->reservoir.temperature, readings->reservoir.setpoint};
+    packFrame(CAN_ID_RESERVOIR, reservoir, frame++);
+    struct_can_level level = {readings->reservoir.level_sense, readings->reservoir.level_ref};
+    packFrame(CAN_ID_LEVEL, level, frame++);
+
+    struct_can_chassis_temps temps = {readings->chassis.inside_temperature, readings->chassis.outside_temperature};
+    packFrame(CAN_ID_CHASSIS_TEMPS, temps, frame++);
+    struct_can_chassis chassis = {readings->chassis.humidity, readings->chassis.filter_dp, readings->chassis.fan.pwm, 0};
+    if (readings->compressor.running)
+        chassis.flags |= CAN_CHASSIS_COMPRESSOR;
+    if (readings->compressor.valve)
+        chassis.flags |= CAN_CHASSIS_VALVE;
+    if (readings->pump.running)
+        chassis.flags |= CAN_CHASSIS_PUMP;
+    if (readings->pump.flow_ok)
+        chassis.flags |= CAN_CHASSIS_FLOW_OK;
+    packFrame(CAN_ID_CHASSIS, chassis, frame++);
+    struct_can_tachs tachs = {readings->chassis.fan.top_tach, readings->chassis.fan.bottom_tach};
+    packFrame(CAN_ID_TACHS, tachs, frame++);
+
+    struct_can_cycle_times cycle = {readings->compressor.compressor_time, readings->compressor.valve_time};
+    packFrame(CAN_ID_CYCLE_TIMES, cycle, frame++);
+    struct_can_maintenance maintenance = {readings->maintenance.compressor_seconds, readings->maintenance.compressor_starts};
+    packFrame(CAN_ID_MAINTENANCE, maintenance, frame++);
+    struct_can_maintenance_wear wear = {readings->maintenance.short_cycles, readings->maintenance.pump_seconds};
+    packFrame(CAN_ID_MAINTENANCE_WEAR, wear, frame++);
+    struct_can_maintenance_hours hours = {readings->maintenance.fan_seconds, readings->maintenance.filter_hours_left,
+                                          readings->maintenance.starts_per_hour, 0};
+    packFrame(CAN_ID_MAINTENANCE_HOURS, hours, frame++);
+
+    return frame - frames;
+}
+
+bool unpackReadings(const can_frame *frame, struct_readings *readings)
+{
+    switch (frame->id)
+    {
+    case CAN_ID_READINGS:
+    {
+        struct_can_readings start;
+        if (unpackFrame(frame, &start))
+        {
+            readings->header.sequence = start.sequence;
+            readings->error.code = start.error_code;
+            readings->error.alert = start.alert;
+        }
+        break;
+    }
+    case CAN_ID_READINGS_TIME:
+    {
+        struct_can_readings_time time;
+        if (unpackFrame(frame, &time))
+            readings->header.time_us = time.time_us;
+        break;
+    }
+    case CAN_ID_RESERVOIR:
+    {
+        struct_can_reservoir reservoir;
+        if (unpackFrame(frame, &reservoir))
+        {
+            readings->reservoir.temperature = reservoir.temperature;
+            readings->reservoir.setpoint = reservoir.setpoint;
+        }
+        break;
+    }
+    case CAN_ID_LEVEL:
+    {
+        struct_can_level level;
+        if (unpackFrame(frame, &level))
+        {
+            readings->reservoir.level_sense = level.level_sense;
+            readings->reservoir.level_ref = level.level_ref;
+        }
+        break;
+    }
+    case CAN_ID_CHASSIS_TEMPS:
+    {
+        struct_can_chassis_temps temps;
+        if (unpackFrame(frame, &temps))
+        {
+            readings->chassis.inside_temperature = temps.inside_temperature;
+            readings->chassis.outside_temperature = temps.outside_temperature;
+        }
+        break;
+    }
+    case CAN_ID_CHASSIS:
+    {
+        struct_can_chassis chassis;
+        if (unpackFrame(frame, &chassis))
+        {
+            readings->chassis.humidity = chassis.humidity;
+            readings->chassis.filter_dp = chassis.filter_dp;
+            readings->chassis.fan.pwm = chassis.fan_pwm;
+            readings->compressor.running = chassis.flags & CAN_CHASSIS_COMPRESSOR;
+            readings->compressor.valve = chassis.flags & CAN_CHASSIS_VALVE;
+            readings->pump.running = chassis.flags & CAN_CHASSIS_PUMP;
+            readings->pump.flow_ok = chassis.flags & CAN_CHASSIS_FLOW_OK;
+        }
+        break;
+    }
+    case CAN_ID_TACHS:
+    {
+        struct_can_tachs tachs;
+        if (unpackFrame(frame, &tachs))
+        {
+            readings->chassis.fan.top_tach = tachs.top_tach;
+            readings->chassis.fan.bottom_tach = tachs.bottom_tach;
+        }
+        break;
+    }
+    case CAN_ID_CYCLE_TIMES:
+    {
+        struct_can_cycle_times cycle;
+        if (unpackFrame(frame, &cycle))
+        {
+            readings->compressor.compressor_time = cycle.compressor_time;
+            readings->compressor.valve_time = cycle.valve_time;
+        }
+        break;
+    }
+    case CAN_ID_MAINTENANCE:
+    {
+        struct_can_maintenance maintenance;
+        if (unpackFrame(frame, &maintenance))
+        {
+            readings->maintenance.compressor_seconds = maintenance.compressor_seconds;
+            readings->maintenance.compressor_starts = maintenance.compressor_starts;
+        }
+        break;
+    }
+    case CAN_ID_MAINTENANCE_WEAR:
+    {
+        struct_can_maintenance_wear wear;
+        if (unpackFrame(frame, &wear))
+        {
+            readings->maintenance.short_cycles = wear.short_cycles;
+            readings->maintenance.pump_seconds = wear.pump_seconds;
+        }
+        break;
+    }
+    case CAN_ID_MAINTENANCE_HOURS:
+    {
+        struct_can_maintenance_hours hours;
+        if (unpackFrame(frame, &hours))
+        {
+            readings->maintenance.fan_seconds = hours.fan_seconds;
+            readings->maintenance.filter_hours_left = hours.filter_hours_left;
+            readings->maintenance.starts_per_hour = hours.starts_per_hour;
+        }
+        break;
+    }
+    default:
+        return false;
+    }
+    return frame->id == CAN_ID_READINGS_LAST;
+}
+
+uint8_t packSettings(const struct_remote_settings *settings, can_frame *frames)
+{
+    struct_can_settings setpoint = {settings->setpoint, settings->hysteresis};
+    packFrame(CAN_ID_SETTINGS, setpoint, &frames[0]);
+    struct_can_settings_limits limits = {settings->running, settings->reservoir_temp_high_limit,
+                                         settings->reservoir_temp_low_limit, 0, settings->valve_lockout};
+    packFrame(CAN_ID_SETTINGS_LIMITS, limits, &frames[1]);
+    struct_can_settings_lockout lockout = {settings->compressor_lockout};
+    packFrame(CAN_ID_SETTINGS_LOCKOUT, lockout, &frames[2]);
+    return CAN_SETTINGS_FRAMES;
+}
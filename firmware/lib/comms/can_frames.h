@@ -0,0 +1,206 @@
+#ifndef __CW5200_CAN_FRAMES__
+#define __CW5200_CAN_FRAMES__
+#include <cstdint>
+#include <cstring>
+#include "comms.h"
+
+/*
+ *   CAN bus between the loop controller and the host
+ *
+ *   Standard 11 bit identifiers, fixed per message: the ID is the priority in
+ *   arbitration, lowest first, so alarms beat commands and commands beat the
+ *   routine telemetry. Heartbeats go last, as in CANopen.
+ *
+ *     0x080        alarm, on a change and again every CAN_ALARM_REPEAT_MS while raised
+ *     0x100/0x101  command and ack, the RS232 link's structs as they are
+ *     0x200-0x20A  one chiller readings set, split into 8 byte frames
+ *     0x280-0x282  chiller settings, after each COMMAND_READ_SETTINGS
+ *     0x700+node   heartbeat, every CAN_HEARTBEAT_MS
+ *
+ *   A readings set starts with CAN_ID_READINGS and ends with
+ *   CAN_ID_READINGS_LAST; the frames in between carry no sequence of their
+ *   own and belong to the set most recently started. The frame structs below
+ *   are the wire format, parsed by tools/can_host.py the way tools/comms.py
+ *   parses comms.h.
+ */
+
+#define CAN_BITRATE 500000
+#define CAN_HEARTBEAT_MS 1000
+#define CAN_HEARTBEAT_STALE_MS 3000 // a node missing this many ms of heartbeats is offline
+#define CAN_ALARM_REPEAT_MS 1000
+
+#define CAN_ID_ALARM 0x080
+#define CAN_ID_COMMAND 0x100        // struct_command, host to loop controller
+#define CAN_ID_ACK 0x101            // struct_ack, loop controller to host
+#define CAN_ID_READINGS 0x200       // first frame of a set
+#define CAN_ID_READINGS_TIME 0x201
+#define CAN_ID_RESERVOIR 0x202
+#define CAN_ID_LEVEL 0x203
+#define CAN_ID_CHASSIS_TEMPS 0x204
+#define CAN_ID_CHASSIS 0x205
+#define CAN_ID_TACHS 0x206
+#define CAN_ID_CYCLE_TIMES 0x207
+#define CAN_ID_MAINTENANCE 0x208
+#define CAN_ID_MAINTENANCE_WEAR 0x209
+#define CAN_ID_MAINTENANCE_HOURS 0x20A
+#define CAN_ID_READINGS_LAST CAN_ID_MAINTENANCE_HOURS
+#define CAN_READINGS_FRAMES (CAN_ID_READINGS_LAST - CAN_ID_READINGS + 1)
+#define CAN_ID_SETTINGS 0x280
+#define CAN_ID_SETTINGS_LIMITS 0x281
+#define CAN_ID_SETTINGS_LOCKOUT 0x282
+#define CAN_SETTINGS_FRAMES 3
+#define CAN_ID_HEARTBEAT 0x700      // plus the sender's node
+
+#define CAN_NODE_LOOP 0x01
+#define CAN_NODE_HOST 0x02
+#define CAN_NODE_CHILLER 0x03 // alarms only; the chiller is not on the bus itself
+
+#define CAN_CHASSIS_COMPRESSOR 0x01
+#define CAN_CHASSIS_VALVE 0x02
+#define CAN_CHASSIS_PUMP 0x04
+#define CAN_CHASSIS_FLOW_OK 0x08
+
+struct can_frame
+{
+    uint16_t id;
+    uint8_t length;
+    uint8_t data[8];
+};
+
+struct __attribute__((packed)) struct_can_alarm
+{
+    uint8_t node;      // CAN_NODE_*: where the fault is
+    uint8_t alert;     // 0 once cleared
+    uint16_t code;     // the chiller's error code, or the loop controller's interlock fault
+    uint32_t sequence; // readings sequence it was raised in
+};
+
+struct __attribute__((packed)) struct_can_heartbeat
+{
+    uint32_t uptime_ms;
+    uint8_t counter; // +1 per heartbeat
+    uint8_t state;   // the loop controller's interlock state
+    uint16_t flags;  // CAN_HEARTBEAT_*
+};
+
+#define CAN_HEARTBEAT_CHILLER_ONLINE 0x0001
+#define CAN_HEARTBEAT_INT_FLOW_OK 0x0002
+#define CAN_HEARTBEAT_EXT_FLOW_OK 0x0004
+
+struct __attribute__((packed)) struct_can_readings
+{
+    uint32_t sequence;
+    uint16_t error_code;
+    uint8_t alert;
+    uint8_t frames; // in the set, this one included
+};
+
+struct __attribute__((packed)) struct_can_readings_time
+{
+    uint64_t time_us;
+};
+
+struct __attribute__((packed)) struct_can_reservoir
+{
+    float temperature;
+    float setpoint;
+};
+
+struct __attribute__((packed)) struct_can_level
+{
+    float level_sense;
+    float level_ref;
+};
+
+struct __attribute__((packed)) struct_can_chassis_temps
+{
+    float inside_temperature;
+    float outside_temperature;
+};
+
+struct __attribute__((packed)) struct_can_chassis
+{
+    float humidity;
+    int16_t filter_dp;
+    uint8_t fan_pwm;
+    uint8_t flags; // CAN_CHASSIS_*
+};
+
+struct __attribute__((packed)) struct_can_tachs
+{
+    float top_tach;
+    float bottom_tach;
+};
+
+struct __attribute__((packed)) struct_can_cycle_times
+{
+    uint32_t compressor_time;
+    uint32_t valve_time;
+};
+
+struct __attribute__((packed)) struct_can_maintenance
+{
+    uint32_t compressor_seconds;
+    uint32_t compressor_starts;
+};
+
+struct __attribute__((packed)) struct_can_maintenance_wear
+{
+    uint32_t short_cycles;
+    uint32_t pump_seconds;
+};
+
+struct __attribute__((packed)) struct_can_maintenance_hours
+{
+    uint32_t fan_seconds;
+    uint16_t filter_hours_left; // fan-runtime hours
+    uint8_t starts_per_hour;
+    uint8_t reserved;
+};
+
+struct __attribute__((packed)) struct_can_settings
+{
+    float setpoint;
+    float hysteresis;
+};
+
+struct __attribute__((packed)) struct_can_settings_limits
+{
+    uint8_t running;
+    uint8_t reservoir_temp_high_limit;
+    uint8_t reservoir_temp_low_limit;
+    uint8_t reserved;
+    uint32_t valve_lockout;
+};
+
+struct __attribute__((packed)) struct_can_settings_lockout
+{
+    uint32_t compressor_lockout;
+};
+
+// fills frames[CAN_READINGS_FRAMES] in ID order; returns the count
+uint8_t packReadings(const struct_readings *readings, can_frame *frames);
+// merges one readings frame; true when it completes the set started by CAN_ID_READINGS
+bool unpackReadings(const can_frame *frame, struct_readings *readings);
+// fills frames[CAN_SETTINGS_FRAMES]; returns the count
+uint8_t packSettings(const struct_remote_settings *settings, can_frame *frames);
+
+template <typename T>
+void packFrame(uint16_t id, const T &payload, can_frame *frame)
+{
+    static_assert(sizeof(T) <= 8, "CAN frame payloads are 8 bytes at most");
+    frame->id = id;
+    frame->length = sizeof(T);
+    memcpy(frame->data, &payload, sizeof(T));
+}
+
+template <typename T>
+bool unpackFrame(const can_frame *frame, T *payload)
+{
+    if (frame->length < sizeof(T))
+        return false;
+    memcpy(payload, frame->data, sizeof(T));
+    return true;
+}
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef __CW5200_COMMS__
+#define __CW5200_COMMS__
+#include <cstdint>
+
+/*
+ *   RS232 link between the loop controller (PCIe card) and the CW-5200 board
+ *
+ *   Both ends frame with SerialTransfer and use its packet ID to tell the
+ *   message types apart. The chiller streams PACKET_READINGS on its own; every
+ *   PACKET_COMMAND from the loop controller is answered with a PACKET_ACK
+ *   carrying the same sequence number, followed by PACKET_SETTINGS for
+ *   COMMAND_READ_SETTINGS. Commands are retransmitted until acknowledged, so
+ *   the chiller applies a sequence number only once. The sender restarts its
+ *   sequence at 0 whenever it resets, so every command also carries the
+ *   sender's session, a byte that changes from one boot to the next: a
+ *   command from a new session is always applied, whatever its sequence.
+ *
+ *   The chiller only services the link between the steps of its cycle, and
+ *   one step can hold it for most of CHILLER_PERIOD_MS, so a sender's ack
+ *   timeout must cover a whole period.
+ *
+ *   Every readings frame carries a sequence number and the chiller's
+ *   micros64() at the time it was sampled. A PACKET_PING from either side is
+ *   answered with a PACKET_PONG for the clock sync in device_clock.h.
+ *
+ *   The loop controller streams PACKET_HEAT_LOAD, unacknowledged like the
+ *   readings: only the latest one matters, for the chiller's feed-forward.
+ */
+#define LINK_BAUD 19200
+#define CHILLER_PERIOD_MS 1000 // the chiller's cycle, one readings frame each
+#define PACKET_READINGS 0
+#define PACKET_COMMAND 1
+#define PACKET_ACK 2
+#define PACKET_SETTINGS 3
+#define PACKET_PING 4
+#define PACKET_PONG 5
+#define PACKET_HEAT_LOAD 6
+
+enum command_id : uint8_t
+{
+    COMMAND_NONE = 0,
+    COMMAND_SET_SETPOINT, // value: reservoir setpoint, degC
+    COMMAND_RUN,          // start cooling
+    COMMAND_STOP,         // stop cooling
+    COMMAND_READ_SETTINGS,
+};
+
+enum ack_status : uint8_t
+{
+    ACK_OK = 0,
+    ACK_UNKNOWN_COMMAND,
+    ACK_OUT_OF_RANGE,
+    ACK_BUSY,      // the loop controller's command queue was full; CAN only
+    ACK_NO_ANSWER, // the chiller never acked it; CAN only
+};
+
+struct __attribute__((packed)) struct_command
+{
+    uint8_t session; // the sender's boot
+    uint8_t sequence;
+    uint8_t id;
+    float value;
+};
+
+struct __attribute__((packed)) struct_ack
+{
+    uint8_t session; // the command's, echoed
+    uint8_t sequence;
+    uint8_t id;
+    uint8_t status;
+};
+
+struct __attribute__((packed)) struct_remote_settings
+{
+    bool running;
+    float setpoint;
+    float hysteresis;
+    uint8_t reservoir_temp_high_limit;
+    uint8_t reservoir_temp_low_limit;
+    uint32_t valve_lockout;
+    uint32_t compressor_lockout;
+};
+
+// ping and pong are the same struct, so both directions spend the same time on the wire
+struct __attribute__((packed)) struct_clock_exchange
+{
+    uint32_t id;
+    uint64_t t1; // ping sent, pinging side's clock; echoed back as is
+    uint64_t t2; // ping received, answering side's clock, us
+    uint64_t t3; // pong sent, answering side's clock, us
+};
+
+struct __attribute__((packed)) struct_heat_load
+{
+    uint32_t sequence;
+    float internal_w;    // heat the PC is putting into the internal loop
+    float external_w;    // heat the external loop is carrying to the reservoir
+    float effectiveness; // heat exchanger, 0 to 1
+    float trend_w_per_s; // of internal_w, over the last few seconds
+};
+
+struct __attribute__((packed)) struct_readings
+{
+    struct __attribute__((packed))
+    {
+        uint32_t sequence; // +1 per frame since reset, so the receiver can count lost frames
+        uint64_t time_us;  // chiller micros64() when this set was sampled
+    } header;
+    struct __attribute__((packed))
+    {
+        float temperature;
+        float setpoint;
+        float level_sense;
+        float level_ref;
+    } reservoir;
+    struct __attribute__((packed))
+    {
+        float inside_temperature;
+        float outside_temperature;
+        float humidity;
+        int16_t filter_dp; // Pa
+        struct __attribute__((packed))
+        {
+            float top_tach;
+            float bottom_tach;
+            uint8_t pwm;
+        } fan;
+    } chassis;
+    struct __attribute__((packed))
+    {
+        bool running;
+        bool valve;
+        uint32_t compressor_time;
+        uint32_t valve_time;
+    } compressor;
+    struct __attribute__((packed))
+    {
+        bool running;
+        bool flow_ok;
+    } pump;
+    struct __attribute__((packed))
+    {
+        bool alert;
+        uint16_t code;
+    } error;
+    struct __attribute__((packed))
+    {
+        uint32_t compressor_seconds;
+        uint32_t compressor_starts;
+        uint8_t starts_per_hour;
+        uint32_t short_cycles;
+        uint32_t pump_seconds;
+        uint32_t fan_seconds;
+        uint16_t filter_hours_left; // fan-runtime hours to the limit; 0xFFFF when not trending towards it
+    } maintenance;
+};
+
+#endif
\ No newline at end of file
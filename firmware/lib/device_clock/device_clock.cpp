@@ -0,0 +1,62 @@
+#include <Arduino.h>
+#include "device_clock.h"
+
+uint64_t micros64()
+{
+    static uint32_t last = 0;
+    static uint32_t high = 0;
+    uint32_t now = micros();
+    if (now < last)
+        ++high;
+    last = now;
+    return ((uint64_t)high << 32) | now;
+}
+
+void addClockExchange(struct_clock_sync &sync, uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4)
+{
+    int64_t delay = (int64_t)(t4 - t1) - (int64_t)(t3 - t2);
+    int64_t offset = ((int64_t)(t2 - t1) + (int64_t)(t3 - t4)) / 2;
+    uint64_t midpoint = t1 + (t4 - t1) / 2;
+    if (delay < 0)
+        delay = 0; // the clocks drifted apart by more than the wire time; still the best we have
+    ++sync.exchanges;
+
+    if ((uint64_t)delay < sync.window_delay_us)
+    {
+        sync.window_delay_us = delay;
+        sync.window_offset_us = offset;
+        sync.window_time_us = midpoint;
+    }
+    // the very first exchange is used straight away, so there is an estimate from the start
+    if (sync.valid && ++sync.window_count < CLOCK_SYNC_WINDOW)
+        return;
+
+    if (sync.windows > 0 && sync.window_time_us > sync.reference_us)
+    {
+        float drift = 1e6f * (sync.window_offset_us - sync.offset_us) / (float)(sync.window_time_us - sync.reference_us);
+        if (sync.windows == 1)
+            sync.drift_ppm = drift;
+        else
+            sync.drift_ppm += CLOCK_SYNC_DRIFT_WEIGHT * (drift - sync.drift_ppm);
+    }
+    sync.offset_us = sync.window_offset_us;
+    sync.reference_us = sync.window_time_us;
+    sync.delay_us = sync.window_delay_us;
+    sync.valid = true;
+    ++sync.windows;
+
+    sync.window_count = 0;
+    sync.window_delay_us = UINT32_MAX;
+}
+
+int64_t clockOffset(const struct_clock_sync &sync, uint64_t local_us)
+{
+    return sync.offset_us + (int64_t)(1e-6f * sync.drift_ppm * (int64_t)(local_us - sync.reference_us));
+}
+
+uint64_t remoteToLocal(const struct_clock_sync &sync, uint64_t remote_us)
+{
+    // the offset changes by parts per million, so evaluating it at the
+    // uncorrected time is well inside a microsecond
+    return remote_us - clockOffset(sync, remote_us - sync.offset_us);
+}
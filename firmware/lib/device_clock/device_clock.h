@@ -0,0 +1,50 @@
+#ifndef __FIRMWARE_DEVICE_CLOCK__
+#define __FIRMWARE_DEVICE_CLOCK__
+#include <cstdint>
+
+/*
+ *   Monotonic microsecond clock and link clock synchronisation
+ *
+ *   micros64() extends micros() to 64 bits, so frame timestamps never wrap
+ *   (micros() alone does every 71 minutes). It must be called from loop()
+ *   context at least once per wrap, which any running loop() does.
+ *
+ *   The clock sync is the NTP exchange over the link: the pinging side
+ *   stamps t1 when it sends, the other end t2 on receipt and t3 on reply, and
+ *   the pinging side t4 when the pong arrives. Each exchange gives
+ *
+ *     offset = ((t2 - t1) + (t3 - t4)) / 2      remote minus local
+ *     delay  = (t4 - t1) - (t3 - t2)            round trip on the wire
+ *
+ *   Queueing only ever adds delay and skews the offset by up to half of it,
+ *   so the estimate keeps the lowest-delay exchange of every
+ *   CLOCK_SYNC_WINDOW and fits the drift from successive window minima.
+ */
+
+#define CLOCK_SYNC_WINDOW 8          // exchanges per minimum-delay pick
+#define CLOCK_SYNC_DRIFT_WEIGHT 0.25 // smoothing of the drift between window minima
+
+struct struct_clock_sync
+{
+    bool valid = false;
+    int64_t offset_us = 0;     // remote minus local, at local time reference_us
+    uint64_t reference_us = 0;
+    uint32_t delay_us = 0;     // round trip of the exchange the offset came from
+    float drift_ppm = 0.0;     // remote clock rate minus ours
+    uint32_t exchanges = 0;
+    uint16_t windows = 0;
+
+    // best exchange of the window being filled
+    uint8_t window_count = 0;
+    int64_t window_offset_us = 0;
+    uint64_t window_time_us = 0;
+    uint32_t window_delay_us = UINT32_MAX;
+};
+
+uint64_t micros64();
+
+void addClockExchange(struct_clock_sync &sync, uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4);
+int64_t clockOffset(const struct_clock_sync &sync, uint64_t local_us);
+uint64_t remoteToLocal(const struct_clock_sync &sync, uint64_t remote_us);
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef __FIRMWARE_FIXED_POINT__
+#define __FIRMWARE_FIXED_POINT__
+#include <cstdint>
+
+/*
+ *   Scaled integers for the measurement path
+ *
+ *   The Teensy 3.2's Cortex-M4 has no FPU: every float sum is a library
+ *   call of tens of cycles, and a double log() thousands. Readings are
+ *   carried as integers in fixed units from the sensor up, through the
+ *   chiller's control, limit checks, history and black box, and only become
+ *   floats where they leave the board (struct_readings, the CAN frames, the
+ *   Serial printouts), go on the display, or feed the chiller's anomaly
+ *   statistics and heat load model, which are float maths by nature:
+ *
+ *     centi_c     0.01 degC
+ *     deci_rpm    0.1 rpm
+ *     lph         L/h
+ *     Pa          the ABP2 is read in centipascals already
+ *
+ *   The NTC curve is a table of NTC_TABLE_POINTS built at compile time from
+ *   the board's thermistor constants, with a constexpr log so it cannot
+ *   drift from board.h, and read by linear interpolation. Plain C++, so the
+ *   native equivalence check runs it against the float maths it replaces.
+ */
+
+#define NTC_TABLE_SHIFT 3 // one point every 8 ADC counts
+#define NTC_TABLE_STEP (1 << NTC_TABLE_SHIFT)
+#define NTC_TABLE_POINTS (1024 / NTC_TABLE_STEP + 1)
+#define CENTI_C_ZERO_KELVIN -27315 // what the B equation gives an open or shorted NTC
+
+typedef int16_t centi_c;
+typedef uint32_t deci_rpm;
+typedef uint16_t lph;
+
+inline float centiToCelsius(centi_c t) { return t / 100.0f; }
+// for floats coming in from the edge: link commands, the menu, logged telemetry
+inline centi_c centiFromCelsius(float t)
+{
+    float centi = t * 100.0f;
+    if (!(centi > CENTI_C_ZERO_KELVIN))
+        return CENTI_C_ZERO_KELVIN; // and NaN
+    if (centi >= INT16_MAX)
+        return INT16_MAX;
+    return (int32_t)(centi < 0 ? centi - 0.5f : centi + 0.5f);
+}
+inline int16_t wholeCelsius(centi_c t) { return t / 100; } // for the gauges
+
+// half away from zero, as lroundf(); divisor > 0
+inline int32_t divideRounded(int32_t value, int32_t divisor)
+{
+    return (value + (value < 0 ? -divisor / 2 : divisor / 2)) / divisor;
+}
+
+// DS18B20 counts are 1/128 degC
+inline centi_c centiFrom128ths(int32_t raw)
+{
+    return divideRounded(raw * 25, 32);
+}
+
+// mean tach period to speed
+inline deci_rpm deciRPMFromPeriod(uint32_t period_us, uint8_t pulses_per_rev)
+{
+    if (period_us == 0 || pulses_per_rev == 0)
+        return 0;
+    uint32_t per_rev = period_us * pulses_per_rev;
+    return (600000000UL + per_rev / 2) / per_rev;
+}
+
+// flow sensor speed to L/h, with no flow below its offset
+template <typename FLOW>
+inline lph flowFromSpeed(uint32_t rpm)
+{
+    int32_t mlph = FLOW::slope_mlph * (int32_t)rpm + FLOW::offset_mlph;
+    return mlph > 0 ? mlph / 1000 : 0;
+}
+
+constexpr double constexprLog(double x)
+{
+    // x = m 2^k with m in [1, 2), then ln m = 2 atanh((m - 1) / (m + 1))
+    int k = 0;
+    while (x >= 2)
+    {
+        x /= 2;
+        ++k;
+    }
+    while (x < 1)
+    {
+        x *= 2;
+        --k;
+    }
+    double y = (x - 1) / (x + 1);
+    double term = y;
+    double sum = 0;
+    for (int n = 1; n < 40; n += 2)
+    {
+        sum += term / n;
+        term *= y * y;
+    }
+    return 2 * sum + k * 0.69314718055994530942;
+}
+
+template <typename NTC>
+struct ntc_table
+{
+    centi_c centi[NTC_TABLE_POINTS];
+
+    constexpr ntc_table() : centi()
+    {
+        for (uint16_t i = 0; i < NTC_TABLE_POINTS; i++)
+            centi[i] = point(i * NTC_TABLE_STEP);
+    }
+
+    // the B equation, as ntc_thermistor::readCelsius() has it, clamped to centi_c
+    static constexpr centi_c point(uint16_t adc)
+    {
+        if (adc == 0 || adc >= NTC::adc_full_scale)
+            return CENTI_C_ZERO_KELVIN;
+        double resistance = NTC::reference_resistance / (NTC::adc_full_scale / adc - 1);
+        double inverse_kelvin = 1.0 / (NTC::nominal_temperature + 273.15) +
+                                constexprLog(resistance / NTC::nominal_resistance) / NTC::b_value;
+        double centi = (1.0 / inverse_kelvin - 273.15) * 100;
+        if (centi >= INT16_MAX)
+            return INT16_MAX;
+        if (centi <= CENTI_C_ZERO_KELVIN)
+            return CENTI_C_ZERO_KELVIN;
+        return centi < 0 ? centi - 0.5 : centi + 0.5;
+    }
+};
+
+template <typename NTC>
+constexpr ntc_table<NTC> ntc_points{};
+
+// within 0.02 degC of the B equation over 0..60 degC and 0.1 degC over -20..100, well inside
+// one ADC count; towards the ends, where the reading means nothing anyway, it is further out
+template <typename NTC>
+inline centi_c ntcCentiCelsius(uint16_t adc)
+{
+    if (adc == 0 || adc >= NTC::adc_full_scale)
+        return CENTI_C_ZERO_KELVIN;
+    const centi_c *centi = ntc_points<NTC>.centi + (adc >> NTC_TABLE_SHIFT);
+    int32_t step = centi[1] - centi[0];
+    return centi[0] + step * (adc & (NTC_TABLE_STEP - 1)) / NTC_TABLE_STEP;
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include <Arduino.h>
+#include <Adafruit_SSD1306.h>
+#include "gauge.h"
+
+// #########################################################################
+//  Draw the meter on the screen, returns x coord of righthand side
+// #########################################################################
+int ringMeter(Adafruit_SSD1306 &display, const char *reading, int value, int vmin, int vmax, int orig_x, int orig_y, int r, const char *units)
+{
+    int x = orig_x + r;
+    int y = orig_y + r + FONT_Y; // Calculate coords of centre of ring
+
+    int w = r / 4; // Width of outer ring is 1/4 of radius
+
+    int angle = 150; // Half the sweep angle of meter (300 degrees)
+
+    int v = map(value, vmin, vmax, -angle, angle); // Map the value to an angle v
+
+    byte seg = 5; // Segments are 5 degrees wide = 60 segments for 300 degrees
+    byte inc = 5; // Draw segments every 5 degrees, increase to 10 for segmented ring
+
+    // Draw colour blocks every inc degrees
+    for (int i = -angle; i < angle; i += inc)
+    {
+        // Calculate pair of coordinates for segment start
+        float sx = cos((i - 90) * 0.0174532925);
+        float sy = sin((i - 90) * 0.0174532925);
+        uint16_t x0 = sx * (r - w) + x;
+        uint16_t y0 = sy * (r - w) + y;
+        uint16_t x1 = sx * r + x;
+        uint16_t y1 = sy * r + y;
+
+        // Calculate pair of coordinates for segment end
+        float sx2 = cos((i + seg - 90) * 0.0174532925);
+        float sy2 = sin((i + seg - 90) * 0.0174532925);
+        int x2 = sx2 * (r - w) + x;
+        int y2 = sy2 * (r - w) + y;
+        int x3 = sx2 * r + x;
+        int y3 = sy2 * r + y;
+
+        if (i < v)
+        { // Fill in coloured segments with 2 triangles
+            display.fillTriangle(x0, y0, x1, y1, x2, y2, SSD1306_WHITE);
+            display.fillTriangle(x1, y1, x2, y2, x3, y3, SSD1306_WHITE);
+        }
+        else // Fill in blank segments
+        {
+            display.fillTriangle(x0, y0, x1, y1, x2, y2, SSD1306_BLACK);
+            display.fillTriangle(x1, y1, x2, y2, x3, y3, SSD1306_BLACK);
+        }
+    }
+
+    // Convert value to a string
+    char buf[10];
+    byte len = 1;
+    if (value > 9)
+        len = 2;
+    if (value > 99)
+        len = 3;
+    if (value > 999)
+        len = 4;
+    dtostrf(value, len, 0, buf);
+
+    // Set the text colour to default
+    display.setTextColor(SSD1306_WHITE, SSD1306_BLACK);
+
+    // Print reading
+    display.setTextSize(1);
+    display.setCursor(x - ((FONT_X * strlen(reading)) / 2), orig_y);
+    display.print(reading);
+
+    // Print value
+    display.setTextSize(2);
+    display.setCursor(x - (FONT_X * 2 * len / 2), y - FONT_Y); // Value in middle
+    display.print(buf);
+
+    // Print units
+
+    display.setTextSize(1);
+    display.setCursor(x - ((FONT_X * strlen(units)) / 2), y + FONT_Y); // Units display
+    display.print(units);
+
+    // Calculate and return right hand side x coordinate
+    return x + r;
+}
+// #########################################################################
+//  Draw one column of a min/avg/max sparkline: a bar from min to max with
+//  the average cut out of it, vmin..vmax scaled onto h pixels up from bottom
+// #########################################################################
+void sparkColumn(Adafruit_SSD1306 &display, int x, int bottom, int h, int vmin, int vmax, int lo, int avg, int hi)
+{
+    int y_lo = bottom - map(constrain(lo, vmin, vmax), vmin, vmax, 0, h - 1);
+    int y_hi = bottom - map(constrain(hi, vmin, vmax), vmin, vmax, 0, h - 1);
+    int y_avg = bottom - map(constrain(avg, vmin, vmax), vmin, vmax, 0, h - 1);
+
+    display.drawFastVLine(x, y_hi, y_lo - y_hi + 1, SSD1306_WHITE);
+
+    // Only a bar of three pixels or more has room for the cut
+    if (y_lo - y_hi >= 2 && y_avg != y_lo && y_avg != y_hi)
+        display.drawPixel(x, y_avg, SSD1306_BLACK);
+}
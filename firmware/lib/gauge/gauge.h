@@ -0,0 +1,16 @@
+#ifndef __FIRMWARE_GAUGE__
+#define __FIRMWARE_GAUGE__
+#include <cstdint>
+
+class Adafruit_SSD1306;
+
+#define FONT_X 5
+#define FONT_Y 8
+#define GAUGE_RADIUS 28
+#define PAGE_DELAY 5000
+#define SPARK_COLUMNS_PER_PASS 16 // a sparkline is drawn over several loop passes
+
+int ringMeter(Adafruit_SSD1306 &display, const char *reading, int value, int vmin, int vmax, int orig_x, int orig_y, int r, const char *units);
+void sparkColumn(Adafruit_SSD1306 &display, int x, int bottom, int h, int vmin, int vmax, int lo, int avg, int hi);
+
+#endif
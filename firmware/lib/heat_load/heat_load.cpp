@@ -0,0 +1,61 @@
+#include <cmath>
+#include "heat_load.h"
+
+static float heatCapacityRate(float flow_lph)
+{
+    // W/K
+    return flow_lph / 3600.0f * (float)COOLANT_HEAT_CAPACITY;
+}
+
+float loopHeatLoad(float flow_lph, float in_temp, float out_temp)
+{
+    if (!(flow_lph >= HEAT_MIN_FLOW))
+        return 0.0;
+    return heatCapacityRate(flow_lph) * fabsf(out_temp - in_temp);
+}
+
+float exchangerEffectiveness(float int_flow_lph, float int_in_temp, float int_out_temp,
+                             float ext_flow_lph, float ext_in_temp, float ext_out_temp)
+{
+    if (!(int_flow_lph >= HEAT_MIN_FLOW) || !(ext_flow_lph >= HEAT_MIN_FLOW))
+        return 0.0;
+    // the hot side enters from the blocks at the internal loop's warmer end,
+    // the cold side from the reservoir at the external loop's cooler end
+    float span = fmaxf(int_in_temp, int_out_temp) - fminf(ext_in_temp, ext_out_temp);
+    if (!(span > 0.0f))
+        return 0.0;
+    float most = fminf(heatCapacityRate(int_flow_lph), heatCapacityRate(ext_flow_lph)) * span;
+    float moved = loopHeatLoad(int_flow_lph, int_in_temp, int_out_temp);
+    return fminf(moved / most, 1.0f);
+}
+
+void addHeatSample(struct_heat_trend &trend, uint32_t now, float watts)
+{
+    trend.time_ms[trend.head] = now;
+    trend.watts[trend.head] = watts;
+    trend.head = (trend.head + 1) % HEAT_TREND_SAMPLES;
+    if (trend.count < HEAT_TREND_SAMPLES)
+        ++trend.count;
+}
+
+float heatTrend(const struct_heat_trend &trend)
+{
+    if (trend.count < 3)
+        return 0.0;
+    // times relative to the newest sample keep the sums small enough for floats
+    uint32_t newest = trend.time_ms[(trend.head + HEAT_TREND_SAMPLES - 1) % HEAT_TREND_SAMPLES];
+    float st = 0, sw = 0, stt = 0, stw = 0;
+    for (uint8_t i = 0; i < trend.count; i++)
+    {
+        float t = -(float)(newest - trend.time_ms[i]) / 1000.0f;
+        st += t;
+        sw += trend.watts[i];
+        stt += t * t;
+        stw += t * trend.watts[i];
+    }
+    float n = trend.count;
+    float spread = n * stt - st * st;
+    if (spread <= 0.0f)
+        return 0.0;
+    return (n * stw - st * sw) / spread;
+}
@@ -0,0 +1,44 @@
+#ifndef __FIRMWARE_HEAT_LOAD__
+#define __FIRMWARE_HEAT_LOAD__
+#include <cstdint>
+
+/*
+ *   Heat load of the two coolant loops
+ *
+ *   Each loop carries flow x volumetric heat capacity x delta-T watts. The
+ *   internal loop runs from the CPU/GPU blocks to the heat exchanger, the
+ *   external one from the heat exchanger to the chiller's reservoir, so the
+ *   internal load is the heat the PC is making now and the external load is
+ *   what reaches the reservoir a loop transit later.
+ *
+ *   The exchanger effectiveness is the heat moved over the most the colder
+ *   of the two flows could have taken up across the inlet temperatures.
+ *
+ *   The trend is a least-squares slope over the last HEAT_TREND_SAMPLES of
+ *   the internal load: it is what lets the chiller start before the
+ *   reservoir has warmed up. Plain C++, so the native plant simulation uses
+ *   the same code as the loop controller.
+ */
+
+#define COOLANT_HEAT_CAPACITY 4180.0 // J/(L K), water; a glycol mix is nearer 3900
+#define HEAT_TREND_SAMPLES 20        // at HEAT_SAMPLE_MS, the trend's horizon
+#define HEAT_MIN_FLOW 10.0           // L/h; below this the loop is stopped, not cool
+
+struct struct_heat_trend
+{
+    uint32_t time_ms[HEAT_TREND_SAMPLES];
+    float watts[HEAT_TREND_SAMPLES];
+    uint8_t head = 0;
+    uint8_t count = 0;
+};
+
+// flow in L/h, temperatures in degC; the sign of the difference does not matter
+float loopHeatLoad(float flow_lph, float in_temp, float out_temp);
+// 0 to 1; 0 with either loop stopped
+float exchangerEffectiveness(float int_flow_lph, float int_in_temp, float int_out_temp,
+                             float ext_flow_lph, float ext_in_temp, float ext_out_temp);
+
+void addHeatSample(struct_heat_trend &trend, uint32_t now, float watts);
+float heatTrend(const struct_heat_trend &trend); // W/s, 0 until there are 3 samples
+
+#endif
@@ -0,0 +1,309 @@
+#include "i2c_queue.h"
+
+enum i2c_phase : uint8_t
+{
+    PHASE_WRITE = 0,    // address then command and tx bytes
+    PHASE_READ_ADDRESS, // address with the read bit, after a (repeated) start
+    PHASE_READ,
+};
+
+#define I2C_SPIN_LIMIT 200 // polls of BUSY around START and STOP, a few microseconds
+
+static i2c_bus *buses[2] = {nullptr, nullptr};
+
+static void i2c0Handler()
+{
+    buses[0]->isr();
+}
+
+static void i2c1Handler()
+{
+    buses[1]->isr();
+}
+
+// submit() is also called from done callbacks, inside the ISR
+static inline uint32_t enterCritical()
+{
+    uint32_t primask;
+    __asm__ volatile("mrs %0, primask" : "=r"(primask));
+    __disable_irq();
+    return primask;
+}
+
+static inline void exitCritical(uint32_t primask)
+{
+    if (!primask)
+        __enable_irq();
+}
+
+i2c_bus::i2c_bus(TwoWire &wire, uint8_t number, uint8_t sda, uint8_t scl)
+    : wire(wire), port(number ? KINETIS_I2C1 : KINETIS_I2C0), irq(number ? IRQ_I2C1 : IRQ_I2C0), number(number), sda(sda), scl(scl)
+{
+}
+
+void i2c_bus::begin(uint32_t frequency)
+{
+    this->frequency = frequency;
+    wire.begin();
+    wire.setClock(frequency);
+    buses[number] = this;
+    attachInterruptVector(irq, number ? i2c1Handler : i2c0Handler);
+    NVIC_SET_PRIORITY(irq, I2C_QUEUE_IRQ_PRIORITY);
+    NVIC_ENABLE_IRQ(irq);
+}
+
+bool i2c_bus::submit(i2c_transaction *t)
+{
+    if (i2cPending(*t))
+        return false;
+    t->status = I2C_QUEUED;
+    t->next = nullptr;
+    uint32_t primask = enterCritical();
+    if (tail[t->priority])
+        tail[t->priority]->next = t;
+    else
+        head[t->priority] = t;
+    tail[t->priority] = t;
+    if (!current && !held)
+        dispatch();
+    exitCritical(primask);
+    return true;
+}
+
+bool i2c_bus::transfer(i2c_transaction *t)
+{
+    // not from inside an i2c_lock: the transaction would never start
+    if (!submit(t))
+        return false;
+    while (i2cPending(*t))
+        service();
+    return t->status == I2C_DONE;
+}
+
+void i2c_bus::service()
+{
+    uint32_t primask = enterCritical();
+    i2c_transaction *t = current;
+    if (t == nullptr || micros() - started <= timeout)
+    {
+        exitCritical(primask);
+        return;
+    }
+    port.C1 = 0; // no more interrupts from this one
+    current = nullptr;
+    exitCritical(primask);
+
+    ++counters.timeouts;
+    recover();
+    t->status = I2C_TIMEOUT;
+    if (t->done)
+        t->done(t);
+
+    primask = enterCritical();
+    if (!current && !held)
+        dispatch();
+    exitCritical(primask);
+}
+
+bool i2c_bus::idle() const
+{
+    if (current)
+        return false;
+    for (uint8_t p = 0; p < I2C_PRIORITIES; p++)
+        if (head[p])
+            return false;
+    return true;
+}
+
+const struct_i2c_stats *i2c_bus::stats() const
+{
+    return &counters;
+}
+
+void i2c_bus::lock()
+{
+    held = true;
+    // bounded by the transaction's timeout
+    while (current)
+        service();
+}
+
+void i2c_bus::unlock()
+{
+    // drivers' begin() tends to call wire.begin(), which resets the clock
+    wire.setClock(frequency);
+    uint32_t primask = enterCritical();
+    held = false;
+    if (!current)
+        dispatch();
+    exitCritical(primask);
+}
+
+// with interrupts off
+void i2c_bus::dispatch()
+{
+    for (uint8_t p = 0; p < I2C_PRIORITIES; p++)
+    {
+        i2c_transaction *t = head[p];
+        if (t == nullptr)
+            continue;
+        head[p] = t->next;
+        if (head[p] == nullptr)
+            tail[p] = nullptr;
+        start(t);
+        return;
+    }
+}
+
+void i2c_bus::start(i2c_transaction *t)
+{
+    current = t;
+    t->status = I2C_ACTIVE;
+    position = 0;
+    started = micros();
+    uint32_t bits = 9 * (t->command_length + t->tx_length + t->rx_length + 2);
+    timeout = t->timeout_us ? t->timeout_us : I2C_TIMEOUT_SLACK_US + 2 * bits * 1000000ULL / frequency;
+
+    port.S = I2C_S_IICIF | I2C_S_ARBL;
+    // a slave holding the bus; left to time out, which recovers it
+    if (port.S & I2C_S_BUSY)
+        return;
+    port.C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX; // START
+    for (uint16_t n = 0; n < I2C_SPIN_LIMIT && !(port.S & I2C_S_BUSY); n++)
+        ;
+    bool write = t->command_length + t->tx_length > 0 || t->rx_length == 0;
+    phase = write ? PHASE_WRITE : PHASE_READ_ADDRESS;
+    port.D = t->address << 1 | (write ? 0 : 1);
+}
+
+void i2c_bus::stop()
+{
+    port.C1 = I2C_C1_IICEN; // dropping MST sends the STOP
+    for (uint16_t n = 0; n < I2C_SPIN_LIMIT && (port.S & I2C_S_BUSY); n++)
+        ;
+}
+
+void i2c_bus::finish(i2c_status status)
+{
+    i2c_transaction *t = current;
+    current = nullptr;
+    t->status = status;
+    if (t->done)
+        t->done(t);
+    // the callback may have submitted, and so started, the next one already
+    if (!current && !held)
+        dispatch();
+}
+
+void i2c_bus::isr()
+{
+    uint8_t status = port.S;
+    port.S = I2C_S_IICIF | (status & I2C_S_ARBL);
+    i2c_transaction *t = current;
+    if (t == nullptr)
+        return;
+
+    if (status & I2C_S_ARBL)
+    {
+        // the hardware has already let go of the bus
+        port.C1 = I2C_C1_IICEN;
+        ++counters.lost;
+        finish(I2C_LOST);
+        return;
+    }
+
+    switch (phase)
+    {
+    case PHASE_WRITE:
+        if (status & I2C_S_RXAK)
+            break;
+        if (position < t->command_length)
+        {
+            port.D = t->command[position++];
+        }
+        else if (position < t->command_length + t->tx_length)
+        {
+            port.D = t->tx[position - t->command_length];
+            ++position;
+        }
+        else if (t->rx_length > 0)
+        {
+            phase = PHASE_READ_ADDRESS;
+            port.C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX | I2C_C1_RSTA;
+            port.D = t->address << 1 | 1;
+        }
+        else
+        {
+            stop();
+            ++counters.completed;
+            finish(I2C_DONE);
+        }
+        return;
+
+    case PHASE_READ_ADDRESS:
+        if (status & I2C_S_RXAK)
+            break;
+        phase = PHASE_READ;
+        position = 0;
+        // a single byte read is NACKed straight away
+        port.C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | (t->rx_length == 1 ? I2C_C1_TXAK : 0);
+        (void)port.D; // the dummy read clocks in the first byte
+        return;
+
+    case PHASE_READ:
+        if (position + 1 >= t->rx_length)
+        {
+            // back to transmit first, so reading D does not clock in another byte
+            port.C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX;
+            t->rx[position] = port.D;
+            ++position;
+            stop();
+            ++counters.completed;
+            finish(I2C_DONE);
+            return;
+        }
+        // NACK the last byte, so the slave releases SDA for the STOP
+        if (position + 2 == t->rx_length)
+            port.C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TXAK;
+        t->rx[position] = port.D;
+        ++position;
+        return;
+
+    default:
+        return;
+    }
+
+    // address or data not acknowledged
+    stop();
+    ++counters.nacks;
+    finish(I2C_NACK);
+}
+
+void i2c_bus::recover()
+{
+    // the port is off, so the pins can be driven as GPIO
+    port.C1 = 0;
+    pinMode(sda, INPUT);
+    pinMode(scl, OUTPUT_OPENDRAIN);
+    digitalWrite(scl, HIGH);
+    for (uint8_t i = 0; i < I2C_RECOVERY_CLOCKS && !digitalRead(sda); i++)
+    {
+        digitalWrite(scl, LOW);
+        delayMicroseconds(5);
+        digitalWrite(scl, HIGH);
+        delayMicroseconds(5);
+    }
+    // STOP: SDA rises while SCL is high
+    pinMode(sda, OUTPUT_OPENDRAIN);
+    digitalWrite(scl, LOW);
+    digitalWrite(sda, LOW);
+    delayMicroseconds(5);
+    digitalWrite(scl, HIGH);
+    delayMicroseconds(5);
+    digitalWrite(sda, HIGH);
+    delayMicroseconds(5);
+    // back to the I2C pin mux and a clean port
+    wire.begin();
+    wire.setClock(frequency);
+    ++counters.recoveries;
+}
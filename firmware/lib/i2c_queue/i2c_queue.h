@@ -0,0 +1,141 @@
+#ifndef __FIRMWARE_I2C_QUEUE__
+#define __FIRMWARE_I2C_QUEUE__
+#include <Arduino.h>
+#include <Wire.h>
+
+/*
+ *   Queued, interrupt-driven I2C master for the Teensy 3.2
+ *
+ *   Transactions are caller-owned static structs, linked into one FIFO per
+ *   priority and run back to back from the I2C interrupt: loop() only
+ *   submits them and later polls status (or gets the done callback, which
+ *   runs in the interrupt). A transaction is one write of command then tx,
+ *   optionally followed by a repeated start read into rx.
+ *
+ *   Preemption happens between transactions, so a long job such as a
+ *   display flush is queued as one transaction per page: a sensor read
+ *   submitted meanwhile waits for at most the page on the wire (about 3 ms
+ *   at 400 kHz), not for the whole frame.
+ *
+ *   service() is called from loop(). It aborts a transaction that overruns
+ *   its timeout and recovers the bus: with the port off it clocks SCL by hand
+ *   while a slave stuck mid-byte holds SDA low, then sends a STOP.
+ *
+ *   Arduino drivers that only speak Wire (for their begin()) still work:
+ *   an i2c_lock waits out the transaction on the wire and holds the queue
+ *   until it goes out of scope.
+ *
+ *   The ISR takes over the port's interrupt vector; Wire only needs it for
+ *   slave mode, which these buses do not use.
+ */
+
+#define I2C_QUEUE_IRQ_PRIORITY 128 // above the scope timer; the ISR is short
+#define I2C_TIMEOUT_SLACK_US 1000  // on top of twice the time the bytes take on the wire
+#define I2C_RECOVERY_CLOCKS 9      // enough to finish any byte a slave is stuck in
+
+enum i2c_priority : uint8_t
+{
+    I2C_PRIORITY_SENSOR = 0, // sampling; goes first
+    I2C_PRIORITY_DISPLAY,    // bulk transfers
+    I2C_PRIORITIES,
+};
+
+enum i2c_status : uint8_t
+{
+    I2C_IDLE = 0, // never submitted
+    I2C_QUEUED,
+    I2C_ACTIVE,
+    I2C_DONE,
+    I2C_NACK,    // address or a data byte not acknowledged
+    I2C_TIMEOUT, // aborted by service(); the bus was recovered
+    I2C_LOST,    // arbitration lost, e.g. to noise on SDA
+};
+
+struct i2c_transaction
+{
+    uint8_t address;
+    i2c_priority priority;
+    uint8_t command[4];              // written first: a register, control byte or command
+    uint8_t command_length;
+    const uint8_t *tx;               // then these bytes
+    uint16_t tx_length;
+    uint8_t *rx;                     // then a repeated start and a read into here
+    uint16_t rx_length;
+    uint16_t timeout_us;             // 0 to work it out from the length
+    void (*done)(i2c_transaction *); // once status is final, from the ISR (service() for a timeout); may submit
+    void *context;
+
+    volatile i2c_status status;
+    i2c_transaction *next; // owned by the bus while queued
+};
+
+struct struct_i2c_stats
+{
+    uint32_t completed = 0;
+    uint32_t nacks = 0;
+    uint32_t timeouts = 0;
+    uint32_t lost = 0;
+    uint32_t recoveries = 0;
+};
+
+inline bool i2cPending(const i2c_transaction &t)
+{
+    return t.status == I2C_QUEUED || t.status == I2C_ACTIVE;
+}
+
+class i2c_bus
+{
+public:
+    // number is 0 for Wire, 1 for Wire1; sda and scl are the pins the Wire object was given
+    i2c_bus(TwoWire &wire, uint8_t number, uint8_t sda, uint8_t scl);
+
+    void begin(uint32_t frequency); // calls wire.begin() first
+    bool submit(i2c_transaction *t); // false while t is still queued or active
+    bool transfer(i2c_transaction *t); // submit and wait; for begin() paths only
+    void service();
+    bool idle() const;
+    const struct_i2c_stats *stats() const;
+
+    void lock();
+    void unlock();
+
+    void isr();
+
+private:
+    void dispatch();
+    void start(i2c_transaction *t);
+    void stop();
+    void finish(i2c_status status);
+    void recover();
+
+    TwoWire &wire;
+    KINETIS_I2C_t &port;
+    IRQ_NUMBER_t irq;
+    uint8_t number;
+    uint8_t sda;
+    uint8_t scl;
+    uint32_t frequency = 100000;
+
+    i2c_transaction *head[I2C_PRIORITIES] = {};
+    i2c_transaction *tail[I2C_PRIORITIES] = {};
+    i2c_transaction *volatile current = nullptr;
+    volatile uint8_t phase = 0;
+    volatile uint16_t position = 0;
+    volatile uint32_t started = 0;
+    uint32_t timeout = 0;
+    volatile bool held = false;
+    struct_i2c_stats counters;
+};
+
+// holds the queue for blocking Wire calls, e.g. an Adafruit driver's begin()
+class i2c_lock
+{
+public:
+    explicit i2c_lock(i2c_bus &bus) : bus(bus) { bus.lock(); }
+    ~i2c_lock() { bus.unlock(); }
+
+private:
+    i2c_bus &bus;
+};
+
+#endif
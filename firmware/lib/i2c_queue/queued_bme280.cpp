@@ -0,0 +1,83 @@
+#include "queued_bme280.h"
+
+queued_bme280::queued_bme280(i2c_bus &bus) : bus(bus), read(), data()
+{
+    read.priority = I2C_PRIORITY_SENSOR;
+    read.command[0] = BME280_DATA_REGISTER;
+    read.command_length = 1;
+    read.rx = data;
+    read.rx_length = BME280_DATA_BYTES;
+}
+
+bool queued_bme280::begin(uint8_t address, TwoWire *wire)
+{
+    read.address = address;
+    read.status = I2C_IDLE;
+    i2c_lock hold(bus);
+    return Adafruit_BME280::begin(address, wire);
+}
+
+bool queued_bme280::request()
+{
+    return bus.submit(&read);
+}
+
+i2c_status queued_bme280::status() const
+{
+    return read.status;
+}
+
+float queued_bme280::temperature()
+{
+    int16_t centi = centiTemperature();
+    return centi == BME280_NO_READING ? NAN : centi / 100.0f;
+}
+
+float queued_bme280::humidity()
+{
+    int32_t h = humidity1024();
+    return h < 0 ? NAN : h / 1024.0f;
+}
+
+int16_t queued_bme280::centiTemperature()
+{
+    if (read.status != I2C_DONE)
+        return BME280_NO_READING;
+    int32_t adc_T = (int32_t)data[3] << 12 | (int32_t)data[4] << 4 | data[5] >> 4;
+    if (adc_T == 0x80000)
+        return BME280_NO_READING; // temperature measurement skipped
+    int32_t var1 = ((adc_T / 8) - ((int32_t)_bme280_calib.dig_T1 * 2)) * (int32_t)_bme280_calib.dig_T2 / 2048;
+    int32_t var2 = (adc_T / 16) - (int32_t)_bme280_calib.dig_T1;
+    var2 = (var2 * var2 / 4096) * (int32_t)_bme280_calib.dig_T3 / 16384;
+    t_fine = var1 + var2 + t_fine_adjust;
+    return (t_fine * 5 + 128) / 256;
+}
+
+int16_t queued_bme280::centiHumidity()
+{
+    int32_t h = humidity1024();
+    return h < 0 ? BME280_NO_READING : (h * 100 + 512) / 1024;
+}
+
+int32_t queued_bme280::humidity1024()
+{
+    if (read.status != I2C_DONE)
+        return -1;
+    int32_t adc_H = (int32_t)data[6] << 8 | data[7];
+    if (adc_H == 0x8000)
+        return -1; // humidity measurement skipped
+    int32_t var1 = t_fine - 76800;
+    int32_t var2 = adc_H * 16384;
+    int32_t var3 = (int32_t)_bme280_calib.dig_H4 * 1048576;
+    int32_t var4 = (int32_t)_bme280_calib.dig_H5 * var1;
+    int32_t var5 = (var2 - var3 - var4 + 16384) / 32768;
+    var2 = var1 * (int32_t)_bme280_calib.dig_H6 / 1024;
+    var3 = var1 * (int32_t)_bme280_calib.dig_H3 / 2048;
+    var4 = var2 * (var3 + 32768) / 1024 + 2097152;
+    var2 = (var4 * (int32_t)_bme280_calib.dig_H2 + 8192) / 16384;
+    var3 = var5 * var2;
+    var4 = (var3 / 32768) * (var3 / 32768) / 128;
+    var5 = var3 - var4 * (int32_t)_bme280_calib.dig_H1 / 16;
+    var5 = constrain(var5, 0, 419430400);
+    return var5 / 4096;
+}
@@ -0,0 +1,42 @@
+#ifndef __FIRMWARE_QUEUED_BME280__
+#define __FIRMWARE_QUEUED_BME280__
+#include <Adafruit_BME280.h>
+#include "i2c_queue.h"
+
+/*
+ *   BME280 read through the I2C queue
+ *
+ *   Adafruit's begin() still sets the part up (under an i2c_lock), after
+ *   which it free-runs in normal mode. request() queues one burst read of the
+ *   data registers; once it has completed, temperature() and humidity() run
+ *   Bosch's integer compensation on those bytes with the calibration the
+ *   library read at begin(). The centi versions hand its integers on as
+ *   they are, for a caller with no FPU.
+ */
+
+#define BME280_DATA_REGISTER 0xF7 // press_msb, then pressure, temperature, humidity
+#define BME280_DATA_BYTES 8
+#define BME280_NO_READING INT16_MIN // from the centi versions without a completed read
+
+class queued_bme280 : public Adafruit_BME280
+{
+public:
+    explicit queued_bme280(i2c_bus &bus);
+
+    bool begin(uint8_t address, TwoWire *wire);
+    bool request(); // false while the previous read is still queued
+    i2c_status status() const;
+    float temperature(); // degC, NAN without a completed read
+    float humidity();    // %RH, after temperature(), which it depends on
+    int16_t centiTemperature(); // 0.01 degC
+    int16_t centiHumidity();    // 0.01 %RH, after centiTemperature()
+
+private:
+    i2c_bus &bus;
+    i2c_transaction read;
+    uint8_t data[BME280_DATA_BYTES];
+
+    int32_t humidity1024(); // 1/1024 %RH, or -1
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef __FIRMWARE_QUEUED_DISPLAY__
+#define __FIRMWARE_QUEUED_DISPLAY__
+#include <static_display.h>
+#include "i2c_queue.h"
+
+/*
+ *   SSD1306 flushed through the I2C queue
+ *
+ *   show() queues the addressing commands and then one transaction per page
+ *   of the frame buffer at display priority, so sensor reads overtake the
+ *   flush at page boundaries. Drawing carries on while it runs; a show()
+ *   during a flush is remembered and the frame goes out again as soon as
+ *   the last page is done, so the panel always ends up with the latest frame.
+ */
+
+#define SSD1306_CONTROL_COMMANDS 0x00
+#define SSD1306_CONTROL_DATA 0x40
+
+template <uint8_t WIDTH, uint8_t HEIGHT>
+class queued_ssd1306 : public static_ssd1306<WIDTH, HEIGHT>
+{
+public:
+    queued_ssd1306(i2c_bus &bus, TwoWire *wire, int8_t reset) : static_ssd1306<WIDTH, HEIGHT>(wire, reset), bus(bus) {}
+
+    // Adafruit's begin(), without it restarting the Wire port under the queue
+    bool begin(uint8_t vcc, uint8_t address)
+    {
+        i2c_lock hold(bus);
+        if (!Adafruit_SSD1306::begin(vcc, address, true, false))
+            return false;
+        window.address = address;
+        window.priority = I2C_PRIORITY_DISPLAY;
+        window.command[0] = SSD1306_CONTROL_COMMANDS;
+        window.command_length = 1;
+        window.tx = addressing;
+        window.tx_length = sizeof(addressing);
+        for (uint8_t p = 0; p < PAGES; p++)
+        {
+            pages[p].address = address;
+            pages[p].priority = I2C_PRIORITY_DISPLAY;
+            pages[p].command[0] = SSD1306_CONTROL_DATA;
+            pages[p].command_length = 1;
+            pages[p].tx = this->getBuffer() + p * WIDTH;
+            pages[p].tx_length = WIDTH;
+            pages[p].done = nullptr;
+        }
+        pages[PAGES - 1].done = flushed;
+        pages[PAGES - 1].context = this;
+        return true;
+    }
+
+    // false if a flush was already under way; this frame follows it
+    bool show()
+    {
+        again = true;
+        if (i2cPending(window) || i2cPending(pages[PAGES - 1]))
+            return false;
+        again = false;
+        submit();
+        return true;
+    }
+
+private:
+    static constexpr uint8_t PAGES = (HEIGHT + 7) / 8;
+
+    void submit()
+    {
+        bus.submit(&window);
+        for (uint8_t p = 0; p < PAGES; p++)
+            bus.submit(&pages[p]);
+    }
+
+    static void flushed(i2c_transaction *t)
+    {
+        queued_ssd1306 *self = (queued_ssd1306 *)t->context;
+        if (self->again)
+        {
+            self->again = false;
+            self->submit();
+        }
+    }
+
+    i2c_bus &bus;
+    // page 0 to 0xFF (wraps), column 0 to WIDTH - 1, as Adafruit's display() does
+    const uint8_t addressing[6] = {SSD1306_PAGEADDR, 0, 0xFF, SSD1306_COLUMNADDR, 0, WIDTH - 1};
+    i2c_transaction window = {};
+    i2c_transaction pages[PAGES] = {};
+    volatile bool again = false;
+};
+
+#endif
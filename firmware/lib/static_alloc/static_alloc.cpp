@@ -0,0 +1,113 @@
+#include <Arduino.h>
+#include <math.h>
+#include "static_alloc.h"
+
+/*
+ *   Running average
+ */
+
+void running_average::clear()
+{
+    count = 0;
+    index = 0;
+    sum = 0;
+}
+
+void running_average::addValue(int32_t value)
+{
+    // an integer sum does not drift, so it never needs rebuilding
+    if (count == size)
+        sum -= values[index];
+    else
+        ++count;
+    values[index] = value;
+    sum += value;
+    if (++index == size)
+        index = 0;
+}
+
+int32_t running_average::getRoundedAverage(int32_t divisor) const
+{
+    if (count == 0)
+        return 0;
+    return divideRounded(sum, count * divisor);
+}
+
+int32_t running_average::getScaledAverage(int32_t multiplier) const
+{
+    if (count == 0)
+        return 0;
+    return divideRounded(sum * multiplier, count);
+}
+
+float running_average::getAverage() const
+{
+    if (count == 0)
+        return NAN;
+    return (float)sum / count;
+}
+
+float running_average::getStandardDeviation() const
+{
+    if (count < 2)
+        return NAN;
+    float average = getAverage();
+    float squares = 0;
+    for (uint16_t i = 0; i < count; i++)
+        squares += (values[i] - average) * (values[i] - average);
+    return sqrtf(squares / (count - 1));
+}
+
+/*
+ *   Heap guard
+ */
+
+static volatile bool locked = false;
+static volatile uint8_t windows = 0;
+static volatile struct_heap_stats stats;
+
+void lockHeap()
+{
+    locked = true;
+}
+
+bool heapLocked()
+{
+    return locked;
+}
+
+void getHeapStats(struct_heap_stats *out)
+{
+    noInterrupts();
+    out->allocations = stats.allocations;
+    out->faults = stats.faults;
+    out->last_fault_size = stats.last_fault_size;
+    interrupts();
+}
+
+heap_window::heap_window()
+{
+    ++windows;
+}
+
+heap_window::~heap_window()
+{
+    --windows;
+}
+
+#ifdef ZERO_HEAP
+struct _reent;
+
+extern "C" void *__real__malloc_r(struct _reent *reent, size_t size);
+
+extern "C" void *__wrap__malloc_r(struct _reent *reent, size_t size)
+{
+    ++stats.allocations;
+    if (locked && windows == 0)
+    {
+        ++stats.faults;
+        stats.last_fault_size = size;
+    }
+    return __real__malloc_r(reent, size);
+}
+#endif
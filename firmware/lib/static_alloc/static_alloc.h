@@ -0,0 +1,94 @@
+#ifndef __FIRMWARE_STATIC_ALLOC__
+#define __FIRMWARE_STATIC_ALLOC__
+#include <Arduino.h>
+#include <fixed_point.h>
+
+/*
+ *   Static replacements for the heap users on the Teensy 3.2
+ *
+ *   static_average<N> stands in for RunningAverage with its samples in the
+ *   object, kept as integers in whatever unit the sensor reads (ADC counts,
+ *   centipascals) so adding one is an exact integer sum with no soft-float
+ *   call; line_buffer<N> for Stream::readStringUntil() into a String. The
+ *   heap guard backs the zero_heap build: it is linked with
+ *   -Wl,--wrap=_malloc_r, so every malloc, calloc, realloc and operator new
+ *   passes through it, and once lockHeap() has been called each allocation is
+ *   counted as a fault. Allocations the libraries cannot avoid (the BME280
+ *   creates its I2C device in begin()) go inside a heap_window.
+ */
+
+class running_average
+{
+public:
+    void clear();
+    void addValue(int32_t value);
+    int32_t getRoundedAverage(int32_t divisor = 1) const; // mean / divisor, 0 until the first sample
+    int32_t getScaledAverage(int32_t multiplier) const;   // mean * multiplier, 0 until the first sample
+    float getAverage() const;                             // NAN until the first sample
+    float getStandardDeviation() const;
+    uint16_t getCount() const { return count; } // samples held, up to the size
+
+protected:
+    running_average(int32_t *buffer, uint16_t size) : values(buffer), size(size) {}
+
+private:
+    int32_t *values;
+    uint16_t size;
+    uint16_t count = 0;
+    uint16_t index = 0;
+    int32_t sum = 0;
+};
+
+template <uint16_t N>
+class static_average : public running_average
+{
+public:
+    static_average() : running_average(samples, N) {}
+
+private:
+    int32_t samples[N];
+};
+
+template <size_t N>
+struct line_buffer
+{
+    char text[N];
+    size_t length = 0;
+
+    // takes what has arrived without waiting; true once a whole line is in text
+    bool read(Stream &in)
+    {
+        while (in.available() > 0)
+        {
+            char c = in.read();
+            if (c == '\n')
+            {
+                text[length] = '\0';
+                length = 0;
+                return true;
+            }
+            if (length < N - 1)
+                text[length++] = c;
+        }
+        return false;
+    }
+};
+
+struct struct_heap_stats
+{
+    uint32_t allocations;  // every call since reset
+    uint32_t faults;       // calls after lockHeap() outside a heap_window
+    uint32_t last_fault_size;
+};
+
+void lockHeap();
+bool heapLocked();
+void getHeapStats(struct_heap_stats *out);
+
+struct heap_window
+{
+    heap_window();
+    ~heap_window();
+};
+
+#endif
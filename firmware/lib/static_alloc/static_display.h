@@ -0,0 +1,30 @@
+#ifndef __FIRMWARE_STATIC_DISPLAY__
+#define __FIRMWARE_STATIC_DISPLAY__
+#include <Adafruit_SSD1306.h>
+
+/*
+ *   SSD1306 with its frame buffer in the object
+ *
+ *   Adafruit_SSD1306::begin() only mallocs the buffer when it has none, so
+ *   handing it one here keeps the display off the heap. The destructor clears
+ *   the pointer again so the base class never frees static storage.
+ */
+
+template <uint8_t WIDTH, uint8_t HEIGHT>
+class static_ssd1306 : public Adafruit_SSD1306
+{
+public:
+    static_ssd1306(TwoWire *wire, int8_t reset) : Adafruit_SSD1306(WIDTH, HEIGHT, wire, reset)
+    {
+        buffer = frame;
+    }
+    ~static_ssd1306()
+    {
+        buffer = nullptr;
+    }
+
+private:
+    uint8_t frame[WIDTH * ((HEIGHT + 7) / 8)];
+};
+
+#endif
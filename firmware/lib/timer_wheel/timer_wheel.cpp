@@ -0,0 +1,100 @@
+#include "timer_wheel.h"
+
+#define TICK_MASK (~(TIMER_WHEEL_TICK_MS - 1))
+#define SLOT_OF(ms) (((ms) >> TIMER_WHEEL_TICK_SHIFT) & (TIMER_WHEEL_SLOTS - 1))
+
+timer_wheel::timer_wheel()
+{
+    for (wheel_timer &head : slots)
+        head.prev = head.next = &head;
+}
+
+void timer_wheel::begin(uint32_t now)
+{
+    for (wheel_timer &head : slots)
+    {
+        while (head.next != &head)
+            cancel(head.next);
+    }
+    current = now & TICK_MASK;
+}
+
+void timer_wheel::link(wheel_timer *head, wheel_timer *timer)
+{
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+void timer_wheel::unlink(wheel_timer *timer)
+{
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = timer->next = nullptr;
+}
+
+void timer_wheel::schedule(wheel_timer *timer, uint32_t now, uint32_t delay_ms)
+{
+    cancel(timer);
+    timer->deadline = now + delay_ms;
+    // the slot of the first tick that starts at or after the deadline, so the
+    // timer is always due by the time its slot is walked; wraps with millis()
+    uint32_t at = (timer->deadline + TIMER_WHEEL_TICK_MS - 1) & TICK_MASK;
+    if ((int32_t)(at - current) <= 0)
+        at = current + TIMER_WHEEL_TICK_MS;
+    link(&slots[SLOT_OF(at)], timer);
+    timer->armed = true;
+}
+
+void timer_wheel::cancel(wheel_timer *timer)
+{
+    if (!timer->armed)
+        return;
+    unlink(timer);
+    timer->armed = false;
+}
+
+void timer_wheel::advance(uint32_t now)
+{
+    uint32_t target = now & TICK_MASK;
+    int32_t behind = (int32_t)(target - current);
+    if (behind <= 0)
+        return;
+    // called late: one walk of every slot still finds everything that is due
+    if ((uint32_t)behind > TIMER_WHEEL_SLOTS * TIMER_WHEEL_TICK_MS)
+        current = target - TIMER_WHEEL_SLOTS * TIMER_WHEEL_TICK_MS;
+
+    while (current != target)
+    {
+        // move the tick on first, so a callback scheduling "now" lands in the next slot
+        current += TIMER_WHEEL_TICK_MS;
+        wheel_timer *head = &slots[SLOT_OF(current)];
+        wheel_timer expired;
+        expired.prev = expired.next = &expired;
+        for (wheel_timer *timer = head->next; timer != head;)
+        {
+            wheel_timer *next = timer->next;
+            if ((int32_t)(now - timer->deadline) >= 0)
+            {
+                unlink(timer);
+                link(&expired, timer);
+            }
+            timer = next;
+        }
+        // a callback may cancel one still waiting here, which unlinks it from this list
+        while (expired.next != &expired)
+        {
+            wheel_timer *timer = expired.next;
+            unlink(timer);
+            timer->armed = false;
+            timer->fire(timer, now);
+        }
+    }
+}
+
+uint32_t timer_wheel::remaining(const wheel_timer *timer, uint32_t now) const
+{
+    int32_t left = (int32_t)(timer->deadline - now);
+    return timer->armed && left > 0 ? left : 0;
+}
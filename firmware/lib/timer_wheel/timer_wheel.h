@@ -0,0 +1,59 @@
+#ifndef __FIRMWARE_TIMER_WHEEL__
+#define __FIRMWARE_TIMER_WHEEL__
+#include <cstdint>
+
+/*
+ *   Hashed timer wheel of deferred actions
+ *
+ *   Timers are caller-owned static structs, linked into one of
+ *   TIMER_WHEEL_SLOTS lists by the tick their deadline falls in, so schedule()
+ *   and cancel() are O(1) whatever else is pending. advance() is called every
+ *   pass of loop() and walks only the slots of the ticks that have gone by,
+ *   firing the timers in them that are due; a timer more than one turn of the
+ *   wheel out is simply passed over until its turn comes round.
+ *
+ *   Deadlines are kept as millis() values and only ever compared by signed
+ *   difference, and the tick and slot count are powers of two, so 2^32 ms
+ *   is a whole number of turns and the wheel runs straight through the
+ *   49-day millis() wrap. The cost is that a delay must stay under 2^31 ms.
+ *
+ *   A timer fires within one tick after its deadline. Its callback runs in
+ *   advance()'s caller and may schedule or cancel any timer, itself included.
+ */
+
+#define TIMER_WHEEL_TICK_SHIFT 4 // 16 ms ticks
+#define TIMER_WHEEL_SLOTS 64     // power of two; one turn is about a second
+#define TIMER_WHEEL_TICK_MS (1UL << TIMER_WHEEL_TICK_SHIFT)
+
+struct wheel_timer
+{
+    void (*fire)(wheel_timer *timer, uint32_t now);
+    void *context;
+
+    // owned by the wheel
+    wheel_timer *prev = nullptr;
+    wheel_timer *next = nullptr;
+    uint32_t deadline = 0;
+    bool armed = false;
+};
+
+class timer_wheel
+{
+public:
+    timer_wheel();
+
+    void begin(uint32_t now);
+    void schedule(wheel_timer *timer, uint32_t now, uint32_t delay_ms); // moves it if already armed
+    void cancel(wheel_timer *timer);                                     // no-op if not armed
+    void advance(uint32_t now);
+    uint32_t remaining(const wheel_timer *timer, uint32_t now) const;   // ms, 0 if due or not armed
+
+private:
+    void link(wheel_timer *head, wheel_timer *timer);
+    void unlink(wheel_timer *timer);
+
+    wheel_timer slots[TIMER_WHEEL_SLOTS]; // list heads
+    uint32_t current = 0;                 // start of the last tick walked
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef __FIRMWARE_LINK_HOST_ARDUINO__
+#define __FIRMWARE_LINK_HOST_ARDUINO__
+#include <cstdint>
+#include <cstring>
+#include <math.h>
+#include <cstddef>
+#include <chrono>
+
+/*
+ *   Just enough of the Arduino core for either end of the link to run
+ *   natively, each over its own pty, and for the host tools in
+ *   tools/telemetry to run the same link code over a serial port. Time is the host's monotonic clock run
+ *   link_speedup times faster, so ack timeouts and pings that take seconds
+ *   on the boards take milliseconds here. A Stream is the pty, opened raw;
+ *   writing to a full one waits, as the UART's transmit buffer would, and
+ *   a read that finds the other side gone marks it hung up. Pins go
+ *   nowhere, and anything printed to SerialUSB is thrown away.
+ */
+
+#define LINK_HOST_READ_BYTES 256
+#define LINK_HOST_WRITE_WAIT_US 100
+
+extern double link_speedup;
+
+inline uint64_t hostMicros()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return (uint64_t)(elapsed.count() * link_speedup);
+}
+
+inline uint32_t micros() { return (uint32_t)hostMicros(); }
+inline uint32_t millis() { return (uint32_t)(hostMicros() / 1000); }
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+
+template <typename T>
+inline T max(T a, T b) { return a > b ? a : b; }
+
+// opened, read and written in stream.cpp, so unistd.h stays out of the firmware's sources
+class Stream
+{
+public:
+    // a device such as a pty, or fd:N for one already open; a baud of 0 leaves the speed alone, as a pty has none
+    bool open(const char *path, uint32_t baud = 0);
+    int available();
+    int read();
+    size_t write(const uint8_t *data, size_t length);
+    bool hungUp() const { return hung_up; }
+    int descriptor() const { return fd; }
+
+private:
+    void fill();
+
+    int fd = -1;
+    uint8_t buffer[LINK_HOST_READ_BYTES];
+    int count = 0;
+    int next = 0;
+    bool hung_up = false;
+};
+
+class HostSerialUSB
+{
+public:
+    void begin(uint32_t) {}
+    int printf(const char *, ...) { return 0; }
+    size_t println(const char *) { return 0; }
+};
+
+extern HostSerialUSB SerialUSB;
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef __FIRMWARE_LINK_HOST_EEPROM__
+#define __FIRMWARE_LINK_HOST_EEPROM__
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+/*
+ *   The Teensy 3.2's 2KB emulated EEPROM, kept in a file so it lasts from
+ *   one run of an end to the next as it would across a reset. It starts
+ *   erased if the file is missing or no file is given.
+ */
+
+#define E2END 0x7FF
+
+class EEPROMClass
+{
+public:
+    EEPROMClass() { memset(data, 0xFF, sizeof(data)); }
+
+    void attach(const char *file)
+    {
+        path = file;
+        FILE *f = fopen(path, "rb");
+        if (!f)
+            return;
+        if (fread(data, 1, sizeof(data), f) != sizeof(data))
+            memset(data, 0xFF, sizeof(data));
+        fclose(f);
+    }
+
+    uint8_t read(int address) { return data[address]; }
+    void write(int address, uint8_t value)
+    {
+        data[address] = value;
+        save();
+    }
+    void update(int address, uint8_t value)
+    {
+        if (data[address] != value)
+            write(address, value);
+    }
+    uint16_t length() { return E2END + 1; }
+
+    template <typename T>
+    T &get(int address, T &value)
+    {
+        memcpy(&value, &data[address], sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    const T &put(int address, const T &value)
+    {
+        memcpy(&data[address], &value, sizeof(T));
+        save();
+        return value;
+    }
+
+private:
+    void save()
+    {
+        if (!path)
+            return;
+        FILE *f = fopen(path, "wb");
+        if (!f)
+            return;
+        fwrite(data, 1, sizeof(data), f);
+        fclose(f);
+    }
+
+    const char *path = nullptr;
+    uint8_t data[E2END + 1];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef __FIRMWARE_LINK_HOST_FLEXCAN_T4__
+#define __FIRMWARE_LINK_HOST_FLEXCAN_T4__
+#include <Arduino.h>
+
+/*
+ *   FlexCAN_T4, as canbus.cpp uses it, on a host CAN socket
+ *
+ *   The bus is a SocketCAN interface such as vcan0, or fd:N for a socket
+ *   already open that carries the same 16 byte struct can_frame, such as
+ *   one end of a socketpair. openCANBus() picks it before begin().
+ *
+ *   Mailboxes keep the part's rules: a received standard frame goes to the
+ *   first RX mailbox whose filter takes it, or is dropped as the acceptance
+ *   filters would, and its callback runs from events(). A TX mailbox sends
+ *   straight away; write() returns 0, the mailbox still full, only while the
+ *   socket will not take the frame.
+ */
+
+#define FLEXCAN_HOST_MAILBOXES 64
+
+enum CAN_DEV_TABLE
+{
+    CAN0 = 0,
+    CAN1,
+    CAN2,
+    CAN3,
+};
+
+enum FLEXCAN_RXQUEUE_TABLE
+{
+    RX_SIZE_2 = 2,
+    RX_SIZE_4 = 4,
+    RX_SIZE_8 = 8,
+    RX_SIZE_16 = 16,
+    RX_SIZE_32 = 32,
+    RX_SIZE_64 = 64,
+    RX_SIZE_128 = 128,
+    RX_SIZE_256 = 256,
+};
+
+enum FLEXCAN_TXQUEUE_TABLE
+{
+    TX_SIZE_2 = 2,
+    TX_SIZE_4 = 4,
+    TX_SIZE_8 = 8,
+    TX_SIZE_16 = 16,
+    TX_SIZE_32 = 32,
+    TX_SIZE_64 = 64,
+    TX_SIZE_128 = 128,
+    TX_SIZE_256 = 256,
+};
+
+enum FLEXCAN_MAILBOX
+{
+    MB0 = 0, MB1, MB2, MB3, MB4, MB5, MB6, MB7, MB8, MB9, MB10, MB11, MB12, MB13, MB14, MB15,
+    MB16, MB17, MB18, MB19, MB20, MB21, MB22, MB23, MB24, MB25, MB26, MB27, MB28, MB29, MB30, MB31,
+    MB32, MB33, MB34, MB35, MB36, MB37, MB38, MB39, MB40, MB41, MB42, MB43, MB44, MB45, MB46, MB47,
+    MB48, MB49, MB50, MB51, MB52, MB53, MB54, MB55, MB56, MB57, MB58, MB59, MB60, MB61, MB62, MB63,
+    FIFO = 99,
+};
+
+enum FLEXCAN_RXTX
+{
+    TX,
+    RX,
+    LISTEN_ONLY,
+};
+
+enum FLEXCAN_IDE
+{
+    NONE = 0,
+    EXT = 1,
+    RTR = 2,
+    STD = 3,
+    INACTIVE,
+};
+
+enum FLEXCAN_FLTEN
+{
+    ACCEPT_ALL = 0,
+    REJECT_ALL = 1,
+};
+
+struct CAN_message_t
+{
+    uint32_t id = 0;
+    uint16_t timestamp = 0;
+    uint8_t idhit = 0;
+    struct
+    {
+        bool extended = false;
+        bool remote = false;
+        bool overrun = false;
+        bool reserved = false;
+    } flags;
+    uint8_t len = 8;
+    uint8_t buf[8] = {};
+    int8_t mb = 0;
+    uint8_t bus = 0;
+    bool seq = false;
+};
+
+typedef void (*_MB_ptr)(const CAN_message_t &msg);
+
+bool openCANBus(const char *name); // a SocketCAN interface, or fd:N
+int canBusDescriptor();
+bool canBusClosed();
+
+class FlexCANHost
+{
+public:
+    void begin();
+    void setBaudRate(uint32_t) {}
+    void setMaxMB(uint8_t count) { mailboxes = count < FLEXCAN_HOST_MAILBOXES ? count : FLEXCAN_HOST_MAILBOXES; }
+    void setMB(FLEXCAN_MAILBOX mb, FLEXCAN_RXTX mode, FLEXCAN_IDE ide = STD);
+    void setMBFilter(FLEXCAN_FLTEN filter);
+    bool setMBFilter(FLEXCAN_MAILBOX mb, uint32_t id);
+    bool setMBFilterRange(FLEXCAN_MAILBOX mb, uint32_t first, uint32_t last);
+    void enableMBInterrupts() {}
+    void onReceive(FLEXCAN_MAILBOX mb, _MB_ptr handler);
+    int write(FLEXCAN_MAILBOX mb, const CAN_message_t &msg);
+    int events();
+
+private:
+    struct mailbox
+    {
+        bool receive = false;
+        bool accept_all = true;
+        uint32_t first = 0;
+        uint32_t last = 0;
+        _MB_ptr handler = nullptr;
+    };
+
+    mailbox boxes[FLEXCAN_HOST_MAILBOXES];
+    uint8_t mailboxes = 16;
+};
+
+template <CAN_DEV_TABLE bus, FLEXCAN_RXQUEUE_TABLE rx_size = RX_SIZE_16, FLEXCAN_TXQUEUE_TABLE tx_size = TX_SIZE_16>
+class FlexCAN_T4 : public FlexCANHost
+{
+};
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef __FIRMWARE_LINK_HOST_SERIAL_TRANSFER__
+#define __FIRMWARE_LINK_HOST_SERIAL_TRANSFER__
+#include <Arduino.h>
+
+/*
+ *   SerialTransfer, as the boards run it, over a host Stream
+ *
+ *   The same frame as the library's: start byte, packet id, overhead byte,
+ *   length, the payload with each start byte in it replaced by the distance
+ *   to the next, a CRC-8 of that, and the stop byte. Received bytes go
+ *   through the library's state machine one at a time, so a dropped length
+ *   or CRC byte throws away a frame here exactly as it does on the board,
+ *   and a part frame is abandoned once it is older than the timeout.
+ *   tools/comms.py frames the same way for the host tools.
+ */
+
+#define ST_START_BYTE 0x7E
+#define ST_STOP_BYTE 0x81
+#define ST_MAX_PACKET_SIZE 0xFE
+#define ST_CRC_POLY 0x9B
+#define ST_DEFAULT_TIMEOUT 50 // ms, the library's
+
+const int8_t CONTINUE = 3;
+const int8_t NEW_DATA = 2;
+const int8_t NO_DATA = 1;
+const int8_t CRC_ERROR = 0;
+const int8_t PAYLOAD_ERROR = -1;
+const int8_t STOP_BYTE_ERROR = -2;
+const int8_t STALE_PACKET_ERROR = -3;
+
+struct Packet
+{
+    uint8_t txBuff[ST_MAX_PACKET_SIZE];
+    uint8_t rxBuff[ST_MAX_PACKET_SIZE];
+};
+
+class SerialTransfer
+{
+public:
+    Packet packet;
+    uint8_t bytesRead = 0;
+    int8_t status = 0;
+
+    void begin(Stream &port, uint32_t timeout = ST_DEFAULT_TIMEOUT)
+    {
+        this->port = &port;
+        this->timeout = timeout;
+        for (int i = 0; i < 256; i++)
+        {
+            uint8_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc & 0x80) ? (crc << 1) ^ ST_CRC_POLY : crc << 1;
+            crc_table[i] = crc;
+        }
+    }
+
+    template <typename T>
+    uint16_t txObj(const T &value, uint16_t index = 0, uint16_t length = sizeof(T))
+    {
+        memcpy(&packet.txBuff[index], &value, length);
+        return index + length;
+    }
+
+    template <typename T>
+    uint16_t rxObj(T &value, uint16_t index = 0, uint16_t length = sizeof(T))
+    {
+        memcpy(&value, &packet.rxBuff[index], length);
+        return index + length;
+    }
+
+    uint8_t sendData(uint16_t length, uint8_t packet_id = 0)
+    {
+        uint8_t frame[ST_MAX_PACKET_SIZE + 6];
+        uint8_t overhead = 0xFF;
+        int last = -1;
+        for (int i = length - 1; i >= 0; i--)
+        {
+            if (packet.txBuff[i] != ST_START_BYTE)
+                continue;
+            overhead = i;
+            packet.txBuff[i] = last < 0 ? 0 : last - i;
+            last = i;
+        }
+        frame[0] = ST_START_BYTE;
+        frame[1] = packet_id;
+        frame[2] = overhead;
+        frame[3] = length;
+        memcpy(&frame[4], packet.txBuff, length);
+        frame[4 + length] = crc8(packet.txBuff, length);
+        frame[5 + length] = ST_STOP_BYTE;
+        port->write(frame, length + 6);
+        return length;
+    }
+
+    uint8_t available()
+    {
+        bytesRead = 0;
+        status = NO_DATA;
+        if (!port->available())
+        {
+            stale();
+            return 0;
+        }
+        while (port->available())
+        {
+            parse(port->read());
+            if (status != CONTINUE)
+                break;
+        }
+        return bytesRead;
+    }
+
+    uint8_t currentPacketID() { return id; }
+
+private:
+    enum parse_state
+    {
+        FIND_START,
+        FIND_ID,
+        FIND_OVERHEAD,
+        FIND_LENGTH,
+        FIND_PAYLOAD,
+        FIND_CRC,
+        FIND_STOP,
+    };
+
+    uint8_t crc8(const uint8_t *data, uint8_t length) const
+    {
+        uint8_t crc = 0;
+        for (uint8_t i = 0; i < length; i++)
+            crc = crc_table[crc ^ data[i]];
+        return crc;
+    }
+
+    bool stale()
+    {
+        if (state == FIND_START || millis() - started < timeout)
+            return false;
+        state = FIND_START;
+        status = STALE_PACKET_ERROR;
+        return true;
+    }
+
+    void fail(int8_t error)
+    {
+        state = FIND_START;
+        status = error;
+    }
+
+    void parse(uint8_t byte)
+    {
+        status = CONTINUE;
+        // the byte that finds a part frame stale is lost with it, as in the library
+        if (stale())
+            return;
+        switch (state)
+        {
+        case FIND_START:
+            if (byte == ST_START_BYTE)
+            {
+                state = FIND_ID;
+                started = millis();
+            }
+            break;
+        case FIND_ID:
+            next_id = byte;
+            state = FIND_OVERHEAD;
+            break;
+        case FIND_OVERHEAD:
+            overhead = byte;
+            state = FIND_LENGTH;
+            break;
+        case FIND_LENGTH:
+            if (byte == 0 || byte > ST_MAX_PACKET_SIZE)
+                return fail(PAYLOAD_ERROR);
+            length = byte;
+            received = 0;
+            state = FIND_PAYLOAD;
+            break;
+        case FIND_PAYLOAD:
+            packet.rxBuff[received++] = byte;
+            if (received == length)
+                state = FIND_CRC;
+            break;
+        case FIND_CRC:
+            if (byte != crc8(packet.rxBuff, length))
+                return fail(CRC_ERROR);
+            state = FIND_STOP;
+            break;
+        case FIND_STOP:
+            if (byte != ST_STOP_BYTE)
+                return fail(STOP_BYTE_ERROR);
+            state = FIND_START;
+            unstuff();
+            id = next_id;
+            bytesRead = length;
+            status = NEW_DATA;
+            break;
+        }
+    }
+
+    void unstuff()
+    {
+        uint16_t index = overhead;
+        while (index < length)
+        {
+            uint8_t delta = packet.rxBuff[index];
+            packet.rxBuff[index] = ST_START_BYTE;
+            if (delta == 0)
+                break;
+            index += delta;
+        }
+    }
+
+    Stream *port = nullptr;
+    uint32_t timeout = ST_DEFAULT_TIMEOUT;
+    uint8_t crc_table[256];
+    parse_state state = FIND_START;
+    uint32_t started = 0;
+    uint8_t next_id = 0;
+    uint8_t id = 0;
+    uint8_t overhead = 0xFF;
+    uint8_t length = 0;
+    uint8_t received = 0;
+};
+
+#endif
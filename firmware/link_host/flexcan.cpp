@@ -0,0 +1,132 @@
+#include <FlexCAN_T4.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <linux/can.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int bus = -1;
+static bool closed = false;
+
+bool openCANBus(const char *name)
+{
+    if (strncmp(name, "fd:", 3) == 0)
+    {
+        bus = atoi(name + 3);
+        return bus >= 0;
+    }
+    bus = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (bus < 0)
+        return false;
+    sockaddr_can address = {};
+    address.can_family = AF_CAN;
+    address.can_ifindex = if_nametoindex(name);
+    if (address.can_ifindex == 0 || bind(bus, (sockaddr *)&address, sizeof(address)) < 0)
+    {
+        close(bus);
+        bus = -1;
+        return false;
+    }
+    return true;
+}
+
+int canBusDescriptor()
+{
+    return bus;
+}
+
+bool canBusClosed()
+{
+    return closed;
+}
+
+void FlexCANHost::begin()
+{
+    for (mailbox &box : boxes)
+        box = mailbox();
+}
+
+void FlexCANHost::setMB(FLEXCAN_MAILBOX mb, FLEXCAN_RXTX mode, FLEXCAN_IDE)
+{
+    if (mb < mailboxes)
+        boxes[mb].receive = mode == RX;
+}
+
+void FlexCANHost::setMBFilter(FLEXCAN_FLTEN filter)
+{
+    for (mailbox &box : boxes)
+    {
+        box.accept_all = filter == ACCEPT_ALL;
+        box.first = box.last = 0;
+    }
+}
+
+bool FlexCANHost::setMBFilter(FLEXCAN_MAILBOX mb, uint32_t id)
+{
+    return setMBFilterRange(mb, id, id);
+}
+
+bool FlexCANHost::setMBFilterRange(FLEXCAN_MAILBOX mb, uint32_t first, uint32_t last)
+{
+    if (mb >= mailboxes || !boxes[mb].receive || first > last)
+        return false;
+    boxes[mb].accept_all = false;
+    boxes[mb].first = first;
+    boxes[mb].last = last;
+    return true;
+}
+
+void FlexCANHost::onReceive(FLEXCAN_MAILBOX mb, _MB_ptr handler)
+{
+    if (mb < mailboxes)
+        boxes[mb].handler = handler;
+}
+
+int FlexCANHost::write(FLEXCAN_MAILBOX mb, const CAN_message_t &msg)
+{
+    if (mb >= mailboxes || boxes[mb].receive || closed)
+        return 0;
+    can_frame frame = {};
+    frame.can_id = msg.id & CAN_SFF_MASK;
+    frame.can_dlc = msg.len;
+    memcpy(frame.data, msg.buf, msg.len);
+    ssize_t n = send(bus, &frame, sizeof(frame), MSG_DONTWAIT);
+    if (n == sizeof(frame))
+        return 1;
+    if (n < 0 && errno != EAGAIN && errno != ENOBUFS)
+        closed = true;
+    return 0;
+}
+
+int FlexCANHost::events()
+{
+    int handled = 0;
+    can_frame frame;
+    ssize_t n;
+    while ((n = recv(bus, &frame, sizeof(frame), MSG_DONTWAIT)) == sizeof(frame))
+    {
+        if (frame.can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG))
+            continue;
+        CAN_message_t msg;
+        msg.id = frame.can_id;
+        msg.len = frame.can_dlc > 8 ? 8 : frame.can_dlc;
+        memcpy(msg.buf, frame.data, msg.len);
+        for (uint8_t mb = 0; mb < mailboxes; mb++)
+        {
+            mailbox &box = boxes[mb];
+            if (!box.receive || !(box.accept_all || (msg.id >= box.first && msg.id <= box.last)))
+                continue;
+            msg.mb = mb;
+            if (box.handler)
+                box.handler(msg);
+            ++handled;
+            break;
+        }
+    }
+    // a socketpair whose other end has gone reads as nothing at all
+    if (n == 0 || (n < 0 && errno != EAGAIN))
+        closed = true;
+    return handled;
+}
@@ -0,0 +1,101 @@
+#include <Arduino.h>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+HostSerialUSB SerialUSB;
+
+static speed_t speed(uint32_t baud)
+{
+    switch (baud)
+    {
+    case 9600:
+        return B9600;
+    case 19200:
+        return B19200;
+    case 38400:
+        return B38400;
+    case 57600:
+        return B57600;
+    case 115200:
+        return B115200;
+    case 230400:
+        return B230400;
+    case 460800:
+        return B460800;
+    case 921600:
+        return B921600;
+    default:
+        return B0;
+    }
+}
+
+bool Stream::open(const char *path, uint32_t baud)
+{
+    if (baud && speed(baud) == B0)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    if (strncmp(path, "fd:", 3) == 0)
+    {
+        fd = atoi(path + 3);
+        if (fd < 0 || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)
+            return false;
+    }
+    else
+        fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0)
+        return false;
+    termios settings;
+    if (tcgetattr(fd, &settings) == 0)
+    {
+        cfmakeraw(&settings);
+        if (baud)
+            cfsetspeed(&settings, speed(baud));
+        tcsetattr(fd, TCSANOW, &settings);
+    }
+    return true;
+}
+
+int Stream::available()
+{
+    fill();
+    return count - next;
+}
+
+int Stream::read()
+{
+    fill();
+    return next < count ? buffer[next++] : -1;
+}
+
+size_t Stream::write(const uint8_t *data, size_t length)
+{
+    size_t written = 0;
+    while (written < length && !hung_up)
+    {
+        ssize_t n = ::write(fd, data + written, length - written);
+        if (n > 0)
+            written += n;
+        else if (n < 0 && errno == EAGAIN)
+            usleep(LINK_HOST_WRITE_WAIT_US);
+        else
+            hung_up = true;
+    }
+    return written;
+}
+
+void Stream::fill()
+{
+    if (next < count || hung_up)
+        return;
+    next = count = 0;
+    ssize_t n = ::read(fd, buffer, sizeof(buffer));
+    if (n > 0)
+        count = n;
+    else if (n == 0 || errno != EAGAIN)
+        hung_up = true;
+}
@@ -0,0 +1,371 @@
+"""Host end of the loop controller's CAN bus, over Linux SocketCAN.
+
+    python can_host.py monitor --interface can0
+    python can_host.py command --interface can0 setpoint 18.5
+    python can_host.py command --interface can0 run|stop|settings
+
+monitor prints alarms as they arrive and each readings set once it is
+complete, and sends the host heartbeat the loop controller watches for.
+command sends one command, retransmitting until it is acked the way the
+loop controller does to the chiller. Every run is a session of its own, so
+a sequence number repeated from an earlier run is not taken for a retransmit.
+
+emulate stands in for the loop controller and its chiller, so the rest can
+be tried on a virtual bus with no hardware:
+
+    sudo ip link add dev vcan0 type vcan && sudo ip link set up vcan0
+    python can_host.py emulate --interface vcan0 --fault-every 30 &
+    python can_host.py monitor --interface vcan0
+
+can_test.py runs the loop controller's own canbus.cpp and can_frames.cpp,
+built natively, and decodes what they put on the bus with this module.
+
+The IDs and frame layouts are read from the firmware's can_frames.h, the
+way comms.py reads comms.h: CAN_ID_<NAME> carries struct_can_<name>.
+"""
+
+import argparse
+import math
+import random
+import re
+import select
+import socket
+import struct
+import sys
+import time
+from pathlib import Path
+
+import numpy as np
+
+import comms
+
+CAN_FRAMES_H = comms.COMMS_H.with_name("can_frames.h")
+SOCKETCAN_FRAME = struct.Struct("=IB3x8s")  # struct can_frame in linux/can.h
+CAN_EFF_FLAG = 0x80000000
+
+_DEFINE = re.compile(r"^#define\s+(CAN_\w+)\s+(\w+)", re.M)
+
+
+def load_defines(path: Path = CAN_FRAMES_H) -> dict[str, int]:
+    """Numeric #defines of the header, with one level of aliases resolved."""
+    raw = dict(_DEFINE.findall(path.read_text(encoding="utf-8")))
+    values = {}
+    for name, value in raw.items():
+        value = raw.get(value, value)
+        try:
+            values[name] = int(value, 0)
+        except ValueError:
+            pass
+    return values
+
+
+DEFINES = load_defines()
+STRUCTS = comms.load_structs(CAN_FRAMES_H) | comms.STRUCTS
+IDS = {name[len("CAN_ID_"):].lower(): value for name, value in DEFINES.items() if name.startswith("CAN_ID_")}
+IDS.pop("readings_last")
+LAYOUTS = {value: STRUCTS.get(f"struct_can_{name}") for name, value in IDS.items()}
+LAYOUTS[IDS["command"]] = STRUCTS["struct_command"]
+LAYOUTS[IDS["ack"]] = STRUCTS["struct_ack"]
+
+NODE_LOOP = DEFINES["CAN_NODE_LOOP"]
+NODE_HOST = DEFINES["CAN_NODE_HOST"]
+NODE_CHILLER = DEFINES["CAN_NODE_CHILLER"]
+NODE_NAMES = {NODE_LOOP: "loop", NODE_HOST: "host", NODE_CHILLER: "chiller"}
+READINGS_FIRST = DEFINES["CAN_ID_READINGS"]
+READINGS_LAST = DEFINES["CAN_ID_READINGS_LAST"]
+HEARTBEAT_S = DEFINES["CAN_HEARTBEAT_MS"] / 1000
+
+COMMANDS = {"setpoint": 1, "run": 2, "stop": 3, "settings": 4}  # command_id in comms.h
+ACK_STATUS = ["OK", "unknown command", "out of range", "loop controller busy", "no answer from the chiller"]
+# the loop controller acks once the chiller has, after up to 4 x LINK_ACK_TIMEOUT_MS (2.5 s)
+ACK_TIMEOUT_S = 3.0
+RETRIES = 3
+
+
+class Bus:
+    """A raw SocketCAN socket, standard frames only, or any socket already
+    open that carries the same struct can_frame, such as can_test.py's
+    socketpair with the loop controller's native build."""
+
+    def __init__(self, interface: str | None = None, sock: socket.socket | None = None):
+        if sock is None:
+            sock = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+            sock.bind((interface,))
+        self.sock = sock
+
+    def send(self, can_id: int, payload: bytes):
+        self.sock.send(SOCKETCAN_FRAME.pack(can_id, len(payload), payload.ljust(8, b"\0")))
+
+    def receive(self, timeout: float):
+        """(id, payload), or None once timeout seconds pass with nothing."""
+        if not select.select([self.sock], [], [], max(timeout, 0))[0]:
+            return None
+        can_id, length, data = SOCKETCAN_FRAME.unpack(self.sock.recv(SOCKETCAN_FRAME.size))
+        if can_id & CAN_EFF_FLAG:
+            return None  # extended IDs are never ours
+        return can_id, data[:length]
+
+
+def decode(can_id: int, payload: bytes) -> dict:
+    layout = LAYOUTS.get(can_id)
+    if layout is None or len(payload) < layout.itemsize:
+        return {}
+    return comms.to_nested(comms.decode(payload, layout))
+
+
+def encode(can_id: int, **fields) -> bytes:
+    record = np.zeros(1, dtype=LAYOUTS[can_id])
+    for name, value in fields.items():
+        record[name] = value
+    return record.tobytes()
+
+
+def heartbeat_id(node: int) -> int:
+    return IDS["heartbeat"] + node
+
+
+class Heartbeat:
+    def __init__(self, node: int):
+        self.node = node
+        self.counter = 0
+        self.started = time.monotonic()
+        self.last = 0.0
+
+    def due(self, bus: Bus, state: int = 0, flags: int = 0):
+        now = time.monotonic()
+        if now - self.last < HEARTBEAT_S:
+            return
+        self.last = now
+        self.counter = (self.counter + 1) & 0xFF
+        bus.send(heartbeat_id(self.node), encode(IDS["heartbeat"], uptime_ms=int((now - self.started) * 1000) & 0xFFFFFFFF,
+                                                 counter=self.counter, state=state, flags=flags))
+
+
+class ReadingsAssembler:
+    """Collects the frames of a readings set, as unpackReadings() does."""
+
+    def __init__(self):
+        self.fields = None
+        self.sets = 0
+        self.partial = 0  # sets started again before they were complete
+        self.last_sequence = None
+        self.lost = 0
+
+    def add(self, can_id: int, payload: bytes):
+        """The whole set once can_id completes it, else None."""
+        if can_id == READINGS_FIRST:
+            if self.fields is not None:
+                self.partial += 1
+            self.fields = {}
+        if self.fields is None:
+            return None  # joined part way through a set
+        self.fields.update(decode(can_id, payload))
+        if can_id != READINGS_LAST:
+            return None
+        fields, self.fields = self.fields, None
+        sequence = fields.get("sequence")
+        if self.last_sequence is not None and sequence is not None and sequence > self.last_sequence:
+            self.lost += sequence - self.last_sequence - 1
+        self.last_sequence = sequence
+        self.sets += 1
+        return fields
+
+
+def monitor(args):
+    bus = Bus(args.interface)
+    beat = Heartbeat(NODE_HOST)
+    readings = ReadingsAssembler()
+    loop_seen = None
+    try:
+        while True:
+            beat.due(bus)
+            frame = bus.receive(HEARTBEAT_S / 4)
+            if loop_seen is not None and time.monotonic() - loop_seen > DEFINES["CAN_HEARTBEAT_STALE_MS"] / 1000:
+                print("loop controller OFFLINE")
+                loop_seen = None
+            if frame is None:
+                continue
+            can_id, payload = frame
+            if READINGS_FIRST <= can_id <= READINGS_LAST:
+                fields = readings.add(can_id, payload)
+                if fields is not None:
+                    print(f"readings {fields['sequence']}: reservoir {fields['temperature']:.2f}C "
+                          f"(setpoint {fields['setpoint']:.1f}C), case {fields['inside_temperature']:.1f}C "
+                          f"{fields['humidity']:.0f}%RH, filter {fields['filter_dp']}Pa, "
+                          f"flags {fields['flags']:02X}, error {fields['error_code']:04X}")
+            elif can_id == IDS["alarm"]:
+                alarm = decode(can_id, payload)
+                node = NODE_NAMES.get(alarm["node"], alarm["node"])
+                state = "ALARM" if alarm["alert"] else "cleared"
+                print(f"{state} {node} {alarm['code']:04X} at readings {alarm['sequence']}")
+            elif can_id == heartbeat_id(NODE_LOOP):
+                if loop_seen is None:
+                    print("loop controller online")
+                loop_seen = time.monotonic()
+            elif can_id in (IDS["settings"], IDS["settings_limits"], IDS["settings_lockout"]):
+                print(f"settings: {decode(can_id, payload)}")
+    except KeyboardInterrupt:
+        pass
+    print(f"{readings.sets} readings sets, {readings.lost} lost, {readings.partial} incomplete", file=sys.stderr)
+
+
+def command(args):
+    bus = Bus(args.interface)
+    payload = encode(IDS["command"], session=args.session, sequence=args.sequence, id=COMMANDS[args.name],
+                     value=args.value or 0.0)
+    for attempt in range(RETRIES + 1):
+        bus.send(IDS["command"], payload)
+        deadline = time.monotonic() + ACK_TIMEOUT_S
+        while (frame := bus.receive(deadline - time.monotonic())) is not None:
+            can_id, data = frame
+            if can_id != IDS["ack"]:
+                continue
+            ack = decode(can_id, data)
+            if ack["session"] != args.session or ack["sequence"] != args.sequence:
+                continue  # an ack for somebody else's command
+            status = ACK_STATUS[ack["status"]] if ack["status"] < len(ACK_STATUS) else ack["status"]
+            print(f"{args.name}: {status}" + (f" after {attempt} retransmits" if attempt else ""))
+            if args.name == "settings" and ack["status"] == 0:
+                wait_for_settings(bus)
+            return 0 if ack["status"] == 0 else 1
+    print(f"{args.name}: no ack from the loop controller", file=sys.stderr)
+    return 2
+
+
+def wait_for_settings(bus: Bus, timeout: float = 2.0):
+    wanted = {IDS["settings"], IDS["settings_limits"], IDS["settings_lockout"]}
+    settings = {}
+    deadline = time.monotonic() + timeout
+    while wanted and (frame := bus.receive(deadline - time.monotonic())) is not None:
+        if frame[0] in wanted:
+            wanted.discard(frame[0])
+            settings.update(decode(*frame))
+    print(settings if not wanted else "settings did not arrive")
+
+
+class Chiller:
+    """Just enough of a chiller to drive the frames: the reservoir drifts up
+    with the compressor off and is pulled down while it runs."""
+
+    def __init__(self, fault_every: float):
+        self.sequence = 0
+        self.started = time.monotonic()
+        self.setpoint = 20.0
+        self.hysteresis = 0.5
+        self.high_limit, self.low_limit = 30, 10
+        self.running = True
+        self.compressor = False
+        self.reservoir = 22.0
+        self.fault_every = fault_every
+        self.error = 0
+        self.alert = False
+
+    def step(self):
+        self.sequence += 1
+        self.reservoir += -0.08 if self.compressor else 0.03
+        if self.running and self.reservoir > self.setpoint + self.hysteresis:
+            self.compressor = True
+        elif not self.running or self.reservoir < self.setpoint - self.hysteresis:
+            self.compressor = False
+        if self.fault_every:
+            # a fault for the last five seconds of every period
+            uptime = time.monotonic() - self.started
+            self.alert = uptime % self.fault_every > self.fault_every - 5
+            self.error = 0x2201 if self.alert else self.error
+
+    def frames(self):
+        t = time.monotonic() - self.started
+        flags = (0x01 | 0x02 if self.compressor else 0) | 0x04 | 0x08
+        yield IDS["readings"], dict(sequence=self.sequence, error_code=self.error, alert=self.alert,
+                                    frames=READINGS_LAST - READINGS_FIRST + 1)
+        yield IDS["readings_time"], dict(time_us=int(t * 1e6))
+        yield IDS["reservoir"], dict(temperature=self.reservoir, setpoint=self.setpoint)
+        yield IDS["level"], dict(level_sense=1200.0, level_ref=2000.0)
+        yield IDS["chassis_temps"], dict(inside_temperature=27.0 + math.sin(t / 60), outside_temperature=24.0)
+        yield IDS["chassis"], dict(humidity=45.0, filter_dp=120, fan_pwm=255 if self.compressor else 0, flags=flags)
+        yield IDS["tachs"], dict(top_tach=1500.0 if self.compressor else 0.0, bottom_tach=1500.0 if self.compressor else 0.0)
+        yield IDS["cycle_times"], dict(compressor_time=0, valve_time=0)
+        yield IDS["maintenance"], dict(compressor_seconds=int(t), compressor_starts=1)
+        yield IDS["maintenance_wear"], dict(short_cycles=0, pump_seconds=int(t))
+        yield IDS["maintenance_hours"], dict(fan_seconds=int(t), filter_hours_left=0xFFFF, starts_per_hour=1)
+
+    def settings(self):
+        yield IDS["settings"], dict(setpoint=self.setpoint, hysteresis=self.hysteresis)
+        yield IDS["settings_limits"], dict(running=self.running, reservoir_temp_high_limit=self.high_limit,
+                                           reservoir_temp_low_limit=self.low_limit, valve_lockout=300000)
+        yield IDS["settings_lockout"], dict(compressor_lockout=180000)
+
+    def apply(self, command_id: int, value: float) -> int:
+        """ack_status, as the chiller's applyCommand() answers."""
+        if command_id == COMMANDS["setpoint"]:
+            if not self.low_limit <= value <= self.high_limit:
+                return 2
+            self.setpoint = value
+        elif command_id == COMMANDS["run"]:
+            self.running = True
+        elif command_id == COMMANDS["stop"]:
+            self.running = False
+        elif command_id != COMMANDS["settings"]:
+            return 1
+        return 0
+
+
+def emulate(args):
+    bus = Bus(args.interface)
+    chiller = Chiller(args.fault_every)
+    beat = Heartbeat(NODE_LOOP)
+    last_alarm = (False, 0)
+    alarm_sent = 0.0
+    next_readings = time.monotonic()
+    acked = {}  # (session, sequence) -> ack payload, for retransmits
+    try:
+        while True:
+            beat.due(bus, state=1, flags=0x07)
+            now = time.monotonic()
+            stepped = now >= next_readings
+            if stepped:
+                next_readings += 1.0
+                chiller.step()
+            # as the loop controller does, the alarm goes ahead of the readings that carry it
+            alarm = (chiller.alert, chiller.error)
+            if alarm != last_alarm and (alarm[0] or last_alarm[0]) or (alarm[0] and now - alarm_sent >= 1.0):
+                bus.send(IDS["alarm"], encode(IDS["alarm"], node=NODE_CHILLER, alert=alarm[0], code=alarm[1],
+                                              sequence=chiller.sequence))
+                last_alarm, alarm_sent = alarm, now
+            if stepped:
+                for can_id, fields in chiller.frames():
+                    bus.send(can_id, encode(can_id, **fields))
+            frame = bus.receive(min(next_readings - time.monotonic(), 0.1))
+            if frame is None or frame[0] != IDS["command"]:
+                continue
+            request = decode(*frame)
+            key = (request["session"], request["sequence"])
+            if key not in acked:
+                status = chiller.apply(request["id"], request["value"])
+                acked = {key: encode(IDS["ack"], session=key[0], sequence=key[1], id=request["id"], status=status)}
+                print(f"command {request['id']} {request['value']:.2f}: {ACK_STATUS[status]}")
+            bus.send(IDS["ack"], acked[key])
+            if request["id"] == COMMANDS["settings"]:
+                for can_id, fields in chiller.settings():
+                    bus.send(can_id, encode(can_id, **fields))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    common = argparse.ArgumentParser(add_help=False)
+    common.add_argument("--interface", default="can0", help="SocketCAN interface, e.g. can0 or vcan0")
+    commands = parser.add_subparsers(dest="mode", required=True)
+    commands.add_parser("monitor", parents=[common], help="print alarms and readings, send the host heartbeat")
+    p = commands.add_parser("command", parents=[common], help="send one command and wait for its ack")
+    p.add_argument("name", choices=COMMANDS)
+    p.add_argument("value", nargs="?", type=float, help="degC, for setpoint")
+    p.add_argument("--sequence", type=int, default=int(time.time()) & 0xFF, help="default: from the clock")
+    p.add_argument("--session", type=int, default=random.getrandbits(8), help="default: random")
+    p = commands.add_parser("emulate", parents=[common], help="play the loop controller and chiller, for a vcan bus")
+    p.add_argument("--fault-every", type=float, default=0, help="seconds between emulated chiller faults, 0 for none")
+    args = parser.parse_args()
+    if args.mode == "command" and args.name == "setpoint" and args.value is None:
+        parser.error("setpoint needs a value")
+    sys.exit({"monitor": monitor, "command": command, "emulate": emulate}[args.mode](args))
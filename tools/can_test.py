@@ -0,0 +1,248 @@
+"""The loop controller's CAN node, firmware end to end, decoded by can_host.
+
+The loop controller's canbus.cpp, can_frames.cpp and link.cpp run natively
+as its can_node build, between the chiller's link_end build on a pty and a
+bus this test listens on with can_host.py. Without --interface the bus is
+a socketpair carrying SocketCAN frames, so nothing needs setting up:
+
+    (cd "firmware/CAN SMBus Water Cooling Loop Controller" && pio run -e can_node)
+    (cd "firmware/CAN CW-5200 Controller" && pio run -e link_end)
+    python can_test.py
+    python can_test.py --interface vcan0
+
+The chiller's end prints every readings set it sends, and each set that
+comes off the bus is checked against it field by field, through what
+packReadings() should have made of it. The host's commands go the whole
+way to the chiller and back. The checks:
+
+    - every readings set on the bus is the chiller's, field for field,
+      and none is left incomplete
+    - the chiller's trip is raised as an alarm and cleared again
+    - the loop controller's heartbeat reports the chiller online
+    - a setpoint is acked and applied once, its retransmit acked again
+      without being applied, an out of range one and an unknown command
+      turned away, and the settings read back carry the new setpoint
+
+Time runs --speedup times faster than on the boards. The exit status is 1
+if any check fails.
+"""
+
+import argparse
+import os
+import random
+import select
+import socket
+import subprocess
+import sys
+import time
+from collections import Counter
+from pathlib import Path
+
+import comms
+import can_host
+from link_test import CHILLER_PROGRAM, FIRMWARE, Relay, pty_pair
+
+NODE_PROGRAM = FIRMWARE / "CAN SMBus Water Cooling Loop Controller" / ".pio" / "build" / "can_node" / "program"
+FAULT_FROM = 5  # LINK_END_FAULT_FROM
+FAULT_SETS = 3  # LINK_END_FAULT_SETS
+FAULT_CODE = 0x0603  # SAFETY_OVER_TEMP, the trip link_end raises
+SETPOINT = 12.5
+OUT_OF_RANGE = 99.0
+UNKNOWN_COMMAND = 9
+CHASSIS_FLAGS = [("compressor", "running", "CAN_CHASSIS_COMPRESSOR"), ("compressor", "valve", "CAN_CHASSIS_VALVE"),
+                 ("pump", "running", "CAN_CHASSIS_PUMP"), ("pump", "flow_ok", "CAN_CHASSIS_FLOW_OK")]
+HEARTBEAT_ONLINE = 0x0007  # CAN_HEARTBEAT_CHILLER_ONLINE | INT_FLOW_OK | EXT_FLOW_OK
+
+
+def expected_fields(readings: dict) -> dict:
+    """The CAN fields of a readings set, as packReadings() should fill them."""
+    header, reservoir, chassis = readings["header"], readings["reservoir"], readings["chassis"]
+    compressor, error, maintenance = readings["compressor"], readings["error"], readings["maintenance"]
+    flags = 0
+    for group, field, define in CHASSIS_FLAGS:
+        if readings[group][field]:
+            flags |= can_host.DEFINES[define]
+    return {
+        "sequence": header["sequence"], "error_code": error["code"], "alert": int(error["alert"]),
+        "frames": can_host.READINGS_LAST - can_host.READINGS_FIRST + 1, "time_us": header["time_us"],
+        "temperature": reservoir["temperature"], "setpoint": reservoir["setpoint"],
+        "level_sense": reservoir["level_sense"], "level_ref": reservoir["level_ref"],
+        "inside_temperature": chassis["inside_temperature"], "outside_temperature": chassis["outside_temperature"],
+        "humidity": chassis["humidity"], "filter_dp": chassis["filter_dp"], "fan_pwm": chassis["fan"]["pwm"],
+        "flags": flags, "top_tach": chassis["fan"]["top_tach"], "bottom_tach": chassis["fan"]["bottom_tach"],
+        "compressor_time": compressor["compressor_time"], "valve_time": compressor["valve_time"],
+        "compressor_seconds": maintenance["compressor_seconds"], "compressor_starts": maintenance["compressor_starts"],
+        "short_cycles": maintenance["short_cycles"], "pump_seconds": maintenance["pump_seconds"],
+        "fan_seconds": maintenance["fan_seconds"], "filter_hours_left": maintenance["filter_hours_left"],
+        "starts_per_hour": maintenance["starts_per_hour"],
+    }
+
+
+class Rig:
+    """The chiller's end and the loop controller's node, and the host's side of the bus."""
+
+    def __init__(self, args):
+        self.speedup = args.speedup
+        node_fd, node_relay = pty_pair()
+        chiller_fd, chiller_relay = pty_pair()
+        self.fds = [node_fd, node_relay, chiller_fd, chiller_relay]
+        self.relay = Relay(node_relay, chiller_relay, 0.0, 0.0, random.Random())
+        pass_fds = ()
+        if args.interface:
+            self.bus = can_host.Bus(args.interface)
+            bus_name = args.interface
+        else:
+            host, node = socket.socketpair(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+            self.bus = can_host.Bus(sock=host)
+            bus_name = f"fd:{node.fileno()}"
+            pass_fds = (node.fileno(),)
+        self.chiller = subprocess.Popen([str(args.chiller), os.ttyname(chiller_fd), str(args.speedup), "--readings"],
+                                        stdout=subprocess.PIPE, text=True)
+        self.node = subprocess.Popen([str(args.node), os.ttyname(node_fd), bus_name, str(args.speedup)],
+                                     stdout=subprocess.PIPE, text=True, pass_fds=pass_fds)
+        if not args.interface:
+            node.close()
+        self.assembler = can_host.ReadingsAssembler()
+        self.sets = []
+        self.alarms = []
+        self.heartbeat_flags = Counter()
+        self.acks = []
+        self.settings = {}
+
+    def pump(self, seconds: float, until=lambda: False):
+        """Runs the relay and takes in the bus for as many board seconds, or until until() holds."""
+        deadline = time.monotonic() + seconds / self.speedup
+        while time.monotonic() < deadline and not until():
+            select.select([self.fds[1], self.fds[3], self.bus.sock], [], [], 0.001)
+            self.relay.pump()
+            while (frame := self.bus.receive(0)) is not None:
+                self.take(*frame)
+
+    def take(self, can_id: int, payload: bytes):
+        if can_host.READINGS_FIRST <= can_id <= can_host.READINGS_LAST:
+            fields = self.assembler.add(can_id, payload)
+            if fields is not None:
+                self.sets.append(fields)
+        elif can_id == can_host.IDS["alarm"]:
+            self.alarms.append(can_host.decode(can_id, payload))
+        elif can_id == can_host.heartbeat_id(can_host.NODE_LOOP):
+            self.heartbeat_flags[can_host.decode(can_host.IDS["heartbeat"], payload)["flags"]] += 1
+        elif can_id == can_host.IDS["ack"]:
+            self.acks.append(can_host.decode(can_id, payload))
+        elif can_id in (can_host.IDS["settings"], can_host.IDS["settings_limits"], can_host.IDS["settings_lockout"]):
+            self.settings.update(can_host.decode(can_id, payload))
+
+    def command(self, session: int, sequence: int, command_id: int, value: float = 0.0):
+        """The ack's status, or None if none came within the loop controller's longest wait."""
+        acks = len(self.acks)
+        self.bus.send(can_host.IDS["command"], can_host.encode(can_host.IDS["command"], session=session,
+                                                               sequence=sequence, id=command_id, value=value))
+        self.pump(can_host.ACK_TIMEOUT_S * (can_host.RETRIES + 1), lambda: len(self.acks) > acks)
+        for ack in self.acks[acks:]:
+            if ack["session"] == session and ack["sequence"] == sequence:
+                return ack["status"]
+        return None
+
+    def finish(self) -> tuple[list[str], list[str]]:
+        """Hangs up the pty and the bus, which ends both, and returns what each printed."""
+        self.bus.sock.close()
+        for fd in self.fds:
+            os.close(fd)
+        outputs = []
+        for process in (self.chiller, self.node):
+            try:
+                outputs.append(process.communicate(timeout=10)[0].splitlines())
+            except subprocess.TimeoutExpired:
+                process.kill()
+                outputs.append(process.communicate()[0].splitlines() + ["timed out"])
+        return outputs[0], outputs[1]
+
+
+def run(args) -> int:
+    rng = random.Random(args.seed)
+    rig = Rig(args)
+    failures = []
+    session = rng.getrandbits(8)
+    expected_statuses = []
+
+    # the chiller online and its readings coming through before the host says anything
+    rig.pump(10, lambda: len(rig.sets) >= 3)
+    steps = [
+        ("setpoint", 0, can_host.COMMANDS["setpoint"], SETPOINT, 0),
+        ("setpoint retransmitted", 0, can_host.COMMANDS["setpoint"], SETPOINT, 0),
+        ("setpoint out of range", 1, can_host.COMMANDS["setpoint"], OUT_OF_RANGE, 2),
+        ("unknown command", 2, UNKNOWN_COMMAND, 0.0, 1),
+        ("read settings", 3, can_host.COMMANDS["settings"], 0.0, 0),
+    ]
+    for name, sequence, command_id, value, expected in steps:
+        status = rig.command(session, sequence, command_id, value)
+        expected_statuses.append((name, status, expected))
+    rig.pump(2, lambda: len(rig.settings) >= 8)
+    # on past the trip and its clearing
+    rig.pump(FAULT_FROM + FAULT_SETS + 30, lambda: bool(rig.sets) and rig.sets[-1]["sequence"] > FAULT_FROM + FAULT_SETS + 5)
+    chiller_lines, node_lines = rig.finish()
+
+    for name, status, expected in expected_statuses:
+        if status != expected:
+            failures.append(f"{name}: ack {status}, expected {expected}")
+    applied = Counter(line.split()[1] for line in chiller_lines if line.startswith("applied "))
+    if applied[f"{SETPOINT:.2f}"] != 1:
+        failures.append(f"setpoint applied {applied[f'{SETPOINT:.2f}']} times")
+    if applied[f"{OUT_OF_RANGE:.2f}"]:
+        failures.append("out of range setpoint applied")
+    if rig.settings.get("setpoint") != SETPOINT:
+        failures.append(f"settings read back {rig.settings or 'nothing'}")
+
+    sent = {}
+    for line in chiller_lines:
+        if line.startswith("readings "):
+            readings = comms.to_nested(comms.decode(bytes.fromhex(line.split()[1]), comms.READINGS))
+            sent[readings["header"]["sequence"]] = expected_fields(readings)
+    mismatched = 0
+    for fields in rig.sets:
+        expected = sent.get(fields.get("sequence"))
+        if expected is None:
+            failures.append(f"readings set {fields.get('sequence')} was never sent")
+            continue
+        wrong = {name: (fields.get(name), value) for name, value in expected.items() if fields.get(name) != value}
+        if wrong:
+            mismatched += 1
+            if mismatched <= 5:
+                failures.append(f"readings set {fields['sequence']}: (bus, sent) {wrong}")
+    if mismatched > 5:
+        failures.append(f"{mismatched - 5} more readings sets wrong")
+    if len(rig.sets) < FAULT_FROM + FAULT_SETS + 5 or rig.assembler.partial:
+        failures.append(f"{len(rig.sets)} readings sets, {rig.assembler.partial} incomplete")
+
+    chiller_alarms = [alarm for alarm in rig.alarms if alarm["node"] == can_host.NODE_CHILLER]
+    raised = [alarm for alarm in chiller_alarms if alarm["alert"]]
+    if not raised or raised[0]["code"] != FAULT_CODE or raised[0]["sequence"] != FAULT_FROM:
+        failures.append(f"trip raised as {raised[:1] or 'no alarm'}")
+    if not chiller_alarms or chiller_alarms[-1]["alert"]:
+        failures.append("trip never cleared")
+    if not rig.heartbeat_flags[HEARTBEAT_ONLINE]:
+        failures.append(f"heartbeat flags {dict(rig.heartbeat_flags)}, never the chiller online with both loops flowing")
+
+    stats = next((line for line in node_lines if line.startswith("stats ")), "no stats")
+    print(f"{len(rig.sets)} readings sets checked, {len(sent)} sent; {len(rig.alarms)} alarms, "
+          f"{sum(rig.heartbeat_flags.values())} heartbeats, {len(rig.acks)} acks; node {stats}")
+    for failure in failures[:20]:
+        print(f"  FAILED {failure}")
+    return len(failures)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--node", type=Path, default=NODE_PROGRAM, help="the loop controller's can_node build")
+    parser.add_argument("--chiller", type=Path, default=CHILLER_PROGRAM, help="the chiller's link_end build")
+    parser.add_argument("--interface", default=None, help="a SocketCAN interface such as vcan0; a socketpair if not given")
+    parser.add_argument("--speedup", type=float, default=50, help="times faster than the boards' clocks")
+    parser.add_argument("--seed", type=int, default=None, help="for the host's session")
+    args = parser.parse_args()
+    failures = run(args)
+    print(f"{failures} checks failed")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
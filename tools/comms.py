@@ -0,0 +1,308 @@
+"""Packed message layouts read straight from the firmware's comms.h.
+
+The firmware structs are the single source of truth for the wire format, so
+instead of repeating every field here the header is parsed into numpy
+structured dtypes. Nested structs are flattened into dotted column names,
+e.g. ``chassis.fan.pwm``.
+"""
+
+import re
+import time
+from collections import deque
+from pathlib import Path
+
+import numpy as np
+
+COMMS_H = Path(__file__).resolve().parent.parent / "firmware" / "lib" / "comms" / "comms.h"
+
+C_TYPES = {
+    "bool": "?",
+    "uint8_t": "u1",
+    "int8_t": "i1",
+    "uint16_t": "<u2",
+    "int16_t": "<i2",
+    "uint32_t": "<u4",
+    "int32_t": "<i4",
+    "uint64_t": "<u8",
+    "int64_t": "<i8",
+    "float": "<f4",
+    "double": "<f8",
+}
+
+_TOKEN = re.compile(r"//[^\n]*|/\*.*?\*/|#[^\n]*|__attribute__\s*\(\(\s*\w+\s*\)\)|[{};]|[^\s{};]+", re.S)
+
+
+def _tokens(text: str) -> list[str]:
+    return [
+        t
+        for t in _TOKEN.findall(text)
+        if not t.startswith(("//", "/*", "#", "__attribute__"))
+    ]
+
+
+def _parse_body(tokens: list[str], pos: int, prefix: str, fields: list) -> int:
+    """Parse struct members from just after '{' up to the matching '}'."""
+    while tokens[pos] != "}":
+        if tokens[pos] == "struct" and tokens[pos + 1] == "{":
+            inner: list = []
+            pos = _parse_body(tokens, pos + 2, "", inner)
+            name = tokens[pos]
+            for field, kind in inner:
+                fields.append((f"{prefix}{name}.{field}", kind))
+            pos += 2  # name ;
+            continue
+        kind, name = tokens[pos], tokens[pos + 1]
+        if kind not in C_TYPES:
+            raise ValueError(f"unsupported type {kind} for {name} in comms.h")
+        fields.append((f"{prefix}{name}", C_TYPES[kind]))
+        pos += 3  # type name ;
+    return pos + 1
+
+
+def load_structs(path: Path = COMMS_H) -> dict[str, np.dtype]:
+    """Return every ``struct name { ... };`` in the header as a packed dtype."""
+    tokens = _tokens(path.read_text(encoding="utf-8"))
+    structs = {}
+    pos = 0
+    while pos < len(tokens):
+        if tokens[pos] == "struct" and pos + 2 < len(tokens) and tokens[pos + 2] == "{":
+            fields: list = []
+            name = tokens[pos + 1]
+            pos = _parse_body(tokens, pos + 3, "", fields)
+            structs[name] = np.dtype(fields)  # numpy dtypes from a list are packed
+        else:
+            pos += 1
+    return structs
+
+
+STRUCTS = load_structs()
+READINGS = STRUCTS["struct_readings"]
+EXCHANGE = STRUCTS["struct_clock_exchange"]
+
+
+def decode(payload: bytes, dtype: np.dtype = READINGS) -> np.void:
+    """Decode one packed struct from the front of a received payload."""
+    return np.frombuffer(payload, dtype=dtype, count=1)[0]
+
+
+def to_nested(record: np.void) -> dict:
+    """Turn a flat record back into the nested dict layout of the C struct."""
+    nested: dict = {}
+    for name in record.dtype.names:
+        node = nested
+        *path, leaf = name.split(".")
+        for part in path:
+            node = node.setdefault(part, {})
+        node[leaf] = record[name].item()
+    return nested
+
+
+# SerialTransfer framing, so the host tools can parse the link in bulk
+# rather than one byte per call through pySerialTransfer.
+START_BYTE = 0x7E
+STOP_BYTE = 0x81
+MAX_PACKET_SIZE = 0xFE
+CRC_POLY = 0x9B
+
+PACKET_READINGS = 0
+PACKET_COMMAND = 1
+PACKET_ACK = 2
+PACKET_SETTINGS = 3
+PACKET_PING = 4
+PACKET_PONG = 5
+PACKET_HEAT_LOAD = 6
+
+
+def _crc_table(poly: int) -> bytes:
+    table = bytearray(256)
+    for i in range(256):
+        crc = i
+        for _ in range(8):
+            crc = ((crc << 1) ^ poly) if crc & 0x80 else (crc << 1)
+        table[i] = crc & 0xFF
+    return bytes(table)
+
+
+CRC_TABLE = _crc_table(CRC_POLY)
+
+
+def crc8(data: bytes) -> int:
+    crc = 0
+    for byte in data:
+        crc = CRC_TABLE[crc ^ byte]
+    return crc
+
+
+def encode_packet(payload: bytes, packet_id: int = 0) -> bytes:
+    """Frame a payload the way SerialTransfer::sendData() does."""
+    data = bytearray(payload)
+    if len(data) > MAX_PACKET_SIZE:
+        raise ValueError("payload too long for SerialTransfer")
+    positions = [i for i, b in enumerate(data) if b == START_BYTE]
+    overhead = positions[0] if positions else 0xFF
+    # each START_BYTE becomes the distance to the next one, the last becomes 0
+    for here, after in zip(positions, positions[1:] + positions[-1:]):
+        data[here] = after - here
+    return bytes(
+        [START_BYTE, packet_id, overhead, len(data)]
+        + list(data)
+        + [crc8(data), STOP_BYTE]
+    )
+
+
+class FrameDecoder:
+    """Incremental SerialTransfer parser: feed() bytes, get (id, payload) back."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.crc_errors = 0
+        self.framing_errors = 0
+
+    def feed(self, data: bytes) -> list[tuple[int, bytes]]:
+        self.buffer += data
+        frames = []
+        buf = self.buffer
+        pos = 0
+        while True:
+            start = buf.find(START_BYTE, pos)
+            if start < 0:
+                pos = len(buf)
+                break
+            if len(buf) - start < 4:
+                pos = start
+                break
+            packet_id, overhead, length = buf[start + 1], buf[start + 2], buf[start + 3]
+            end = start + 4 + length + 2
+            if length > MAX_PACKET_SIZE:
+                self.framing_errors += 1
+                pos = start + 1
+                continue
+            if len(buf) < end:
+                pos = start
+                break
+            payload = bytearray(buf[start + 4 : start + 4 + length])
+            if buf[end - 1] != STOP_BYTE:
+                self.framing_errors += 1
+                pos = start + 1
+                continue
+            if crc8(payload) != buf[end - 2]:
+                self.crc_errors += 1
+                pos = start + 1
+                continue
+            index = overhead
+            while index < length:
+                delta = payload[index]
+                payload[index] = START_BYTE
+                if delta == 0:
+                    break
+                index += delta
+            frames.append((packet_id, bytes(payload)))
+            pos = end
+        del buf[:pos]
+        return frames
+
+
+class ClockSync:
+    """Offset and drift of the chiller's micros64() against host wall time.
+
+    The same NTP exchange as the firmware's device_clock.h: ping() stamps t1,
+    the chiller fills in t2 and t3, pong() adds t4. With more memory to spare
+    than the loop controller, the estimate is a least-squares line through
+    the quickest quarter of the last ``window`` exchanges, since queueing
+    only ever adds delay. All times are microseconds; host times come from
+    time.time_ns(), so device timestamps map straight onto the log's time_ns.
+    """
+
+    DRIFT_SPAN_US = 60_000_000  # fit no drift until the quick exchanges span this long
+
+    def __init__(self, window: int = 256):
+        self.exchanges = deque(maxlen=window)  # (host midpoint, offset, delay)
+        self.next_id = 0
+        self.pings = 0
+        self.pongs = 0
+        self.reference = 0
+        self.offset_us = 0.0
+        self.drift = 0.0
+
+    @property
+    def valid(self) -> bool:
+        return bool(self.exchanges)
+
+    @property
+    def drift_ppm(self) -> float:
+        return self.drift * 1e6
+
+    @property
+    def delay_us(self) -> int:
+        return min(delay for _, _, delay in self.exchanges) if self.exchanges else 0
+
+    def ping(self) -> bytes:
+        """Payload for the next PACKET_PING."""
+        record = np.zeros(1, dtype=EXCHANGE)
+        record["id"] = self.next_id
+        record["t1"] = time.time_ns() // 1000
+        self.next_id = (self.next_id + 1) & 0xFFFFFFFF
+        self.pings += 1
+        return record.tobytes()
+
+    def pong(self, payload: bytes, received_us: int = None) -> bool:
+        """Add a PACKET_PONG; False if it answers anything but the latest ping."""
+        if received_us is None:
+            received_us = time.time_ns() // 1000
+        record = decode(payload, EXCHANGE)
+        if int(record["id"]) != (self.next_id - 1) & 0xFFFFFFFF:
+            return False
+        t1, t2, t3, t4 = int(record["t1"]), int(record["t2"]), int(record["t3"]), received_us
+        offset = ((t2 - t1) + (t3 - t4)) / 2
+        delay = max((t4 - t1) - (t3 - t2), 0)
+        self.exchanges.append((t1 + (t4 - t1) // 2, offset, delay))
+        self.pongs += 1
+        self._fit()
+        return True
+
+    def _fit(self):
+        times, offsets, delays = (np.array(column, dtype=np.float64) for column in zip(*self.exchanges))
+        quick = delays <= np.quantile(delays, 0.25)
+        times, offsets = times[quick], offsets[quick]
+        self.reference = int(times[-1])
+        if times[-1] - times[0] >= self.DRIFT_SPAN_US:
+            self.drift, self.offset_us = np.polyfit(times - self.reference, offsets, 1)
+        else:
+            self.drift, self.offset_us = 0.0, float(np.median(offsets))
+
+    def to_host_us(self, device_us):
+        """Device micros64() timestamps as host wall time, in microseconds."""
+        device_us = np.asarray(device_us, dtype=np.float64)
+        return (device_us - self.offset_us + self.drift * self.reference) / (1.0 + self.drift)
+
+
+class LinkMonitor:
+    """Lost frames from readings sequence gaps and the sample-to-log latency."""
+
+    def __init__(self, keep: int = 100000):
+        self.last_sequence = None
+        self.frames = 0
+        self.lost = 0
+        self.resets = 0
+        self.latency_us = deque(maxlen=keep)
+
+    def add(self, records: np.ndarray, logged_ns, sync: ClockSync = None):
+        for sequence in records["header.sequence"].astype(np.int64):
+            if self.last_sequence is not None:
+                if sequence > self.last_sequence:
+                    self.lost += sequence - self.last_sequence - 1
+                else:
+                    self.resets += 1  # the chiller restarted its count
+            self.last_sequence = sequence
+        self.frames += len(records)
+        if sync is not None and sync.valid:
+            sampled = sync.to_host_us(records["header.time_us"])
+            self.latency_us.extend(np.asarray(logged_ns, dtype=np.float64) / 1000 - sampled)
+
+    def summary(self) -> str:
+        text = f"{self.frames} frames, {self.lost} lost, {self.resets} chiller resets"
+        if self.latency_us:
+            p50, p90, p99 = np.percentile(np.array(self.latency_us), (50, 90, 99)) / 1000
+            text += (f"; sample to log latency p50 {p50:.1f}ms p90 {p90:.1f}ms p99 {p99:.1f}ms "
+                     f"max {max(self.latency_us) / 1000:.1f}ms")
+        return text
@@ -0,0 +1,215 @@
+"""Loss and duplication test of the command/ack link, firmware to firmware.
+
+Both ends are the firmware's own link code, built natively against the
+pty shims in firmware/link_host: the loop controller's link.cpp, which
+queues commands and retransmits the head of the queue until it is acked,
+and the chiller's link.cpp, which applies each (session, sequence) once and
+sends readings every CHILLER_PERIOD_MS. Each end has a pty of its own, and
+a relay between the two drops bytes and repeats whole frames:
+
+    (cd "firmware/CAN SMBus Water Cooling Loop Controller" && pio run -e link_end)
+    (cd "firmware/CAN CW-5200 Controller" && pio run -e link_end)
+    python link_test.py
+    python link_test.py --loss 0.05 --duplicate 0.05 --commands 400 --seed 7
+
+Time runs --speedup times faster than on the boards. Halfway through, the
+loop controller end is restarted twice, each run the next boot by the
+session count in its EEPROM file, so back to sequence 0 in a new session.
+Some setpoints are out of range for the chiller. A clean pass runs first,
+then a lossy one. The checks:
+
+    - with nothing lost, nothing is retransmitted or given up on, and no
+      readings frame is missed
+    - every command acked was applied exactly once
+    - every out of range setpoint was turned away, and none was applied
+    - no command was applied twice
+    - readings, clock pongs and heat loads got through on every run
+
+The exit status is 1 if any check fails.
+"""
+
+import argparse
+import os
+import random
+import re
+import select
+import subprocess
+import sys
+import tempfile
+import time
+import tty
+from collections import Counter
+from pathlib import Path
+
+import comms
+
+FIRMWARE = Path(__file__).resolve().parent.parent / "firmware"
+LOOP_PROGRAM = FIRMWARE / "CAN SMBus Water Cooling Loop Controller" / ".pio" / "build" / "link_end" / "program"
+CHILLER_PROGRAM = FIRMWARE / "CAN CW-5200 Controller" / ".pio" / "build" / "link_end" / "program"
+DEFINES = {name: int(value) for name, value in re.findall(r"#define (\w+) (\d+)\b", comms.COMMS_H.read_text())}
+PERIOD_S = DEFINES["CHILLER_PERIOD_MS"] / 1000
+ACK_TIMEOUT_S = 2 * PERIOD_S + 0.5  # LINK_ACK_TIMEOUT_MS
+RETRIES = 3  # LINK_RETRIES
+OUT_OF_RANGE_FROM = 100.0  # LINK_END_REJECT_BASE
+EEPROM_BYTES = 2048
+ACK_OK = 0
+ACK_OUT_OF_RANGE = 2
+ACK_NO_ANSWER = 4
+
+
+def pty_pair() -> tuple[int, int]:
+    """A raw pty: (the end's fd, the relay's fd)."""
+    relay, end = os.openpty()
+    tty.setraw(end)
+    for fd in (relay, end):
+        os.set_blocking(fd, False)
+    return end, relay
+
+
+def read_all(fd: int) -> bytes:
+    try:
+        return os.read(fd, 4096)
+    except BlockingIOError:
+        return b""
+
+
+class Relay:
+    """Passes frames between the ptys, repeating some whole and dropping bytes of others."""
+
+    def __init__(self, a: int, b: int, loss: float, duplicate: float, rng: random.Random):
+        self.routes = [(a, b, comms.FrameDecoder()), (b, a, comms.FrameDecoder())]
+        self.loss = loss
+        self.duplicate = duplicate
+        self.rng = rng
+        self.frames = 0
+        self.repeated = 0
+        self.dropped_bytes = 0
+        self.overflowed_bytes = 0
+
+    def pump(self):
+        for source, destination, decoder in self.routes:
+            out = bytearray()
+            for packet_id, payload in decoder.feed(read_all(source)):
+                self.frames += 1
+                copies = 1
+                if self.rng.random() < self.duplicate:
+                    copies = 2
+                    self.repeated += 1
+                for _ in range(copies):
+                    for byte in comms.encode_packet(payload, packet_id):
+                        if self.rng.random() < self.loss:
+                            self.dropped_bytes += 1
+                        else:
+                            out.append(byte)
+            # a pty nobody is reading, while the loop controller end restarts, fills up like a UART nobody drains
+            try:
+                written = os.write(destination, out) if out else 0
+            except BlockingIOError:
+                written = 0
+            self.overflowed_bytes += len(out) - written
+
+
+def parse_stats(line: str) -> dict[str, int]:
+    fields = line.split()[1:]
+    return {name: int(value) for name, value in zip(fields[::2], fields[1::2])}
+
+
+def run(name: str, args, loss: float, duplicate: float, rng: random.Random) -> int:
+    loop_fd, loop_relay = pty_pair()
+    chiller_fd, chiller_relay = pty_pair()
+    relay = Relay(loop_relay, chiller_relay, loss, duplicate, rng)
+    speedup = str(args.speedup)
+    failures = []
+    results = []  # (value, ack status) from every run of the loop controller end
+    totals = Counter()
+
+    with tempfile.TemporaryDirectory() as scratch:
+        eeprom = Path(scratch) / "eeprom.bin"
+        # any boot count to start from, so the first session is any of them
+        eeprom.write_bytes(bytes([rng.getrandbits(8)]) + b"\xff" * (EEPROM_BYTES - 1))
+        chiller = subprocess.Popen([str(args.chiller), os.ttyname(chiller_fd), speedup],
+                                   stdout=subprocess.PIPE, text=True)
+        half = args.commands // 2
+        for first, count in ((0, half), (half, 1), (half + 1, args.commands - half - 1)):
+            loop = subprocess.Popen([str(args.loop), os.ttyname(loop_fd), str(eeprom), str(first), str(count), speedup],
+                                    stdout=subprocess.PIPE, text=True)
+            deadline = time.monotonic() + count * (RETRIES + 1) * ACK_TIMEOUT_S / args.speedup + 10
+            while loop.poll() is None and time.monotonic() < deadline:
+                select.select([loop_relay, chiller_relay], [], [], 0.001)
+                relay.pump()
+            if loop.poll() is None:
+                loop.kill()
+                failures.append(f"loop controller end timed out on commands {first} to {first + count - 1}")
+            stats = {}
+            for line in loop.communicate()[0].splitlines():
+                if line.startswith("result "):
+                    value, status = line.split()[1:]
+                    results.append((value, int(status)))
+                elif line.startswith("stats "):
+                    stats = parse_stats(line)
+            totals.update(stats)
+            for counter in ("readings", "pongs"):
+                if not stats.get(counter):
+                    failures.append(f"no {counter} on the run from command {first}")
+
+        # hanging up the chiller's pty ends it
+        for fd in (loop_relay, chiller_relay, loop_fd, chiller_fd):
+            os.close(fd)
+        try:
+            chiller_lines = chiller.communicate(timeout=10)[0].splitlines()
+        except subprocess.TimeoutExpired:
+            chiller.kill()
+            chiller_lines = chiller.communicate()[0].splitlines()
+            failures.append("chiller end did not stop when its pty hung up")
+
+    applied = Counter(line.split()[1] for line in chiller_lines if line.startswith("applied "))
+    heat_loads = [float(line.split()[1]) for line in chiller_lines if line.startswith("heat_load ")]
+    if not heat_loads or heat_loads[0] <= 0:
+        failures.append("no heat load reached the chiller")
+
+    statuses = Counter(status for _, status in results)
+    if len(results) != args.commands:
+        failures.append(f"{len(results)} of {args.commands} commands finished")
+    if loss == 0 and duplicate == 0 and (totals["retransmits"] or statuses[ACK_NO_ANSWER] or totals["lost"]):
+        failures.append(f"{totals['retransmits']} retransmits, {statuses[ACK_NO_ANSWER]} given up and "
+                        f"{totals['lost']} readings lost on a clean link")
+    for value, status in results:
+        out_of_range = float(value) >= OUT_OF_RANGE_FROM
+        if out_of_range and status not in (ACK_OUT_OF_RANGE, ACK_NO_ANSWER):
+            failures.append(f"out of range setpoint {value} answered {status}")
+        if out_of_range and applied[value]:
+            failures.append(f"out of range setpoint {value} applied")
+        if status == ACK_OK and applied[value] != 1:
+            failures.append(f"command {value} acked, applied {applied[value]} times")
+    for value, times in applied.items():
+        if times > 1:
+            failures.append(f"command {value} applied {times} times")
+
+    print(f"{name}: {totals['sent']} commands, {totals['retransmits']} retransmits, {statuses[ACK_OK]} acked, "
+          f"{statuses[ACK_OUT_OF_RANGE]} out of range, {statuses[ACK_NO_ANSWER]} given up; {totals['readings']} "
+          f"readings, {totals['lost']} lost, {totals['pongs']} pongs; relay {relay.frames} frames, "
+          f"{relay.repeated} repeated, {relay.dropped_bytes} bytes dropped, {relay.overflowed_bytes} overflowed")
+    for failure in failures[:20]:
+        print(f"  FAILED {failure}")
+    return len(failures)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--loop", type=Path, default=LOOP_PROGRAM, help="the loop controller's link_end build")
+    parser.add_argument("--chiller", type=Path, default=CHILLER_PROGRAM, help="the chiller's link_end build")
+    parser.add_argument("--commands", type=int, default=200, help="commands per pass")
+    parser.add_argument("--loss", type=float, default=0.01, help="chance of each byte being dropped")
+    parser.add_argument("--duplicate", type=float, default=0.05, help="chance of each frame being sent twice")
+    parser.add_argument("--speedup", type=float, default=50, help="times faster than the boards' clocks")
+    parser.add_argument("--seed", type=int, default=None, help="for a repeatable lossy pass")
+    args = parser.parse_args()
+    rng = random.Random(args.seed)
+    failures = run("clean", args, 0.0, 0.0, rng)
+    failures += run("lossy", args, args.loss, args.duplicate, rng)
+    print(f"{failures} checks failed")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
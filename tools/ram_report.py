@@ -0,0 +1,202 @@
+"""Per-module flash and RAM use from a firmware link map.
+
+Adds up every input section the linker kept, grouped by object file (or by
+library archive), and lists who references the heap. Our own code, the
+project's src/ and firmware/lib/, must not: in the zero_heap build that fails
+the link, so a new feature that quietly reaches for malloc or new shows up at
+build time rather than as fragmentation a week into a run.
+
+As a PlatformIO extra script it asks the linker for the map and a cross
+reference table and runs after every link:
+
+    [env:zero_heap]
+    extra_scripts = post:../../tools/ram_report.py
+
+or by hand on an existing map:
+
+    python ram_report.py firmware.map --ram 65536 --flash 262144
+"""
+
+import argparse
+import re
+import sys
+from collections import defaultdict
+from pathlib import Path
+
+OWN_LIBRARIES = {p.name for p in (Path(__file__).resolve().parent.parent / "firmware" / "lib").iterdir() if p.is_dir()}
+
+# entry points into the allocator; with --wrap=_malloc_r the wrapped name shows up too
+HEAP_SYMBOLS = {
+    "malloc": "malloc",
+    "calloc": "calloc",
+    "realloc": "realloc",
+    "strdup": "strdup",
+    "_Znwj": "operator new",
+    "_Znaj": "operator new[]",
+    "_ZnwjRKSt9nothrow_t": "operator new",
+    "_ZnajRKSt9nothrow_t": "operator new[]",
+}
+
+FLASH_ONLY = (".text", ".rodata", ".ARM.extab", ".ARM.exidx", ".init", ".fini", ".vectors", ".flashconfig",
+              ".startup", ".glue_7", ".vfp11_veneer", ".v4_bx", ".iplt", ".rel")
+FLASH_AND_RAM = (".data",)
+RAM_ONLY = (".bss", "COMMON", ".dmabuffers", ".usbbuffers", ".usbdescriptortable", ".noinit")
+
+_ONE_LINE = re.compile(r"^ (\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+_NAME_ONLY = re.compile(r"^ (\S+)$")
+_CONTINUED = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+_ARCHIVE = re.compile(r"^(.*?)([^/\\]+)\.a\((.+)\)$")
+
+
+def _kind(section: str):
+    if section.startswith(RAM_ONLY):
+        return "ram"
+    if section.startswith(FLASH_AND_RAM):
+        return "data"
+    if section.startswith(FLASH_ONLY):
+        return "flash"
+    return None
+
+
+def module_name(path: str, by_object: bool = False) -> str:
+    """src/main.cpp for project objects, the library name for archive members."""
+    path = path.strip()
+    archive = _ARCHIVE.match(path)
+    if archive:
+        library = archive.group(2)
+        library = library[3:] if library.startswith("lib") else library
+        return f"{library}({archive.group(3)})" if by_object else library
+    path = path.replace("\\", "/")
+    if "/src/" in path:
+        path = "src/" + path.split("/src/", 1)[1]
+    else:
+        path = path.rsplit("/", 1)[-1]
+    return path[:-2] if path.endswith(".o") else path
+
+
+def is_own(path: str) -> bool:
+    path = path.strip().replace("\\", "/")
+    archive = _ARCHIVE.match(path)
+    if archive:
+        library = archive.group(2)
+        return (library[3:] if library.startswith("lib") else library) in OWN_LIBRARIES
+    parts = path.split("/")
+    return "src" in parts or any(part in OWN_LIBRARIES for part in parts)
+
+
+def parse_map(text: str, by_object: bool = False):
+    """Return ({module: {"flash": n, "ram": n}}, {symbol: [referencing files]})."""
+    sizes = defaultdict(lambda: {"flash": 0, "ram": 0})
+    lines = text.splitlines()
+    start = next((i for i, line in enumerate(lines) if line.startswith("Linker script and memory map")), 0)
+    pending = None
+    i = start
+    while i < len(lines):
+        line = lines[i]
+        if line.startswith("Cross Reference Table"):
+            break
+        i += 1
+        if line.startswith(" *"):
+            pending = None
+            continue
+        match = _ONE_LINE.match(line)
+        if match:
+            section, size, path = match.group(1), int(match.group(3), 16), match.group(4)
+        elif pending is not None and _CONTINUED.match(line):
+            match = _CONTINUED.match(line)
+            section, size, path = pending, int(match.group(2), 16), match.group(3)
+        else:
+            name = _NAME_ONLY.match(line)
+            pending = name.group(1) if name else None
+            continue
+        pending = None
+        kind = _kind(section)
+        if kind is None or size == 0 or path.startswith("load address"):
+            continue
+        module = module_name(path, by_object)
+        if kind in ("flash", "data"):
+            sizes[module]["flash"] += size
+        if kind in ("ram", "data"):
+            sizes[module]["ram"] += size
+
+    references = defaultdict(list)
+    symbol = None
+    for line in lines[i + 1 :]:
+        if not line.strip() or line.startswith("Symbol"):
+            continue
+        if not line.startswith(" "):
+            fields = line.split()
+            symbol = fields[0]
+            continue  # the first file listed defines the symbol
+        if symbol is not None:
+            references[symbol].append(line.strip())
+    return sizes, references
+
+
+def heap_users(references: dict) -> dict:
+    """{referencing file: set of allocator entry points it calls}."""
+    users = defaultdict(set)
+    for symbol, name in HEAP_SYMBOLS.items():
+        for path in references.get(symbol, []):
+            users[path].add(name)
+    return users
+
+
+def report(map_path: Path, ram_budget: int = 0, flash_budget: int = 0, by_object: bool = False,
+           forbid_heap: bool = False, out=sys.stdout) -> int:
+    sizes, references = parse_map(Path(map_path).read_text(errors="replace"), by_object)
+    rows = sorted(sizes.items(), key=lambda item: (-item[1]["ram"], -item[1]["flash"]))
+    width = max([len(name) for name, _ in rows] + [24])
+    print(f"{'module':{width}s} {'flash':>8s} {'ram':>8s}", file=out)
+    for name, used in rows:
+        print(f"{name:{width}s} {used['flash']:8d} {used['ram']:8d}", file=out)
+    flash = sum(used["flash"] for used in sizes.values())
+    ram = sum(used["ram"] for used in sizes.values())
+    print(f"{'total':{width}s} {flash:8d} {ram:8d}", file=out)
+    if flash_budget:
+        print(f"flash: {flash} of {flash_budget} bytes ({100.0 * flash / flash_budget:.1f}%)", file=out)
+    if ram_budget:
+        print(f"RAM: {ram} of {ram_budget} bytes static ({100.0 * ram / ram_budget:.1f}%), "
+              f"{ram_budget - ram} left for stack and heap", file=out)
+
+    users = heap_users(references)
+    own = {path: names for path, names in users.items() if is_own(path)}
+    others = {module_name(path): names for path, names in users.items() if not is_own(path)}
+    for name, names in sorted(others.items()):
+        print(f"heap: {name} calls {', '.join(sorted(names))}", file=out)
+    status = 0
+    for path, names in sorted(own.items()):
+        print(f"heap: {module_name(path)} calls {', '.join(sorted(names))}"
+              + (" (not allowed in this build)" if forbid_heap else ""), file=out)
+        status = 1 if forbid_heap else status
+    if ram_budget and ram > ram_budget or flash_budget and flash > flash_budget:
+        status = 1
+    return status
+
+
+try:
+    Import("env")  # noqa: F821 - defined when PlatformIO runs this as an extra script
+
+    map_file = env.subst("$BUILD_DIR/firmware.map")  # noqa: F821
+    env.Append(LINKFLAGS=[f"-Wl,-Map,{map_file}", "-Wl,--cref"])  # noqa: F821
+    board = env.BoardConfig()  # noqa: F821
+
+    def _after_link(target, source, env):
+        return report(
+            Path(map_file),
+            ram_budget=int(board.get("upload.maximum_ram_size", 0)),
+            flash_budget=int(board.get("upload.maximum_size", 0)),
+            forbid_heap="ZERO_HEAP" in str(env.get("CPPDEFINES", [])),
+        )
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", _after_link)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+        parser.add_argument("map", type=Path)
+        parser.add_argument("--ram", default=65536, type=int, help="RAM budget in bytes, 0 for none")
+        parser.add_argument("--flash", default=262144, type=int, help="flash budget in bytes, 0 for none")
+        parser.add_argument("--by-object", action="store_true", help="split libraries into their objects")
+        parser.add_argument("--forbid-heap", action="store_true", help="fail if our own code calls the allocator")
+        args = parser.parse_args()
+        sys.exit(report(args.map, args.ram, args.flash, args.by_object, args.forbid_heap))
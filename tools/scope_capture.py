@@ -0,0 +1,136 @@
+"""Capture the CW-5200 controller's USB scope stream.
+
+Asks the board for its scope channels, starts streaming the chosen ones at
+the given period and writes every sample to CSV (or .npz), with the board's
+micros() timestamps unwrapped into one monotonic column. Frames the board had
+to drop because the host fell behind show up as sequence gaps and are counted,
+never silently papered over.
+
+    python scope_capture.py --port COM16 --channels Filter,Pump,Valve --period 500 --duration 30 pump_start.csv
+
+The frame layout mirrors struct_scope_header in the firmware's scope.h.
+"""
+
+import argparse
+import sys
+import time
+from pathlib import Path
+
+import numpy as np
+import serial
+
+SYNC = b"SCOP"
+HEADER = np.dtype([("sync", "<u4"), ("sequence", "<u2"), ("period_us", "<u2"), ("channels", "<u4"), ("samples", "<u2")])
+FRAME_BYTES = 480
+
+
+class ScopeDecoder:
+    """Incremental frame parser: feed() bytes, get arrays of sample sets back."""
+
+    def __init__(self, names: list[str], mask: int):
+        self.mask = mask
+        self.dtype = np.dtype([("time_us", "<u4")] + [(n, "<u2") for i, n in enumerate(names) if mask & (1 << i)])
+        self.buffer = bytearray()
+        self.last_sequence = None
+        self.frames = 0
+        self.dropped = 0
+        self.skipped_bytes = 0
+
+    def feed(self, data: bytes) -> list[np.ndarray]:
+        self.buffer += data
+        buf = self.buffer
+        out = []
+        pos = 0
+        while True:
+            start = buf.find(SYNC, pos)
+            if start < 0:
+                # keep a partial sync word that may straddle the next read
+                keep = max(len(buf) - len(SYNC) + 1, pos)
+                self.skipped_bytes += keep - pos
+                pos = keep
+                break
+            self.skipped_bytes += start - pos  # text printed between frames
+            if len(buf) - start < HEADER.itemsize:
+                pos = start
+                break
+            header = np.frombuffer(bytes(buf[start : start + HEADER.itemsize]), dtype=HEADER)[0]
+            length = HEADER.itemsize + int(header["samples"]) * self.dtype.itemsize
+            if int(header["channels"]) != self.mask or header["samples"] == 0 or length > FRAME_BYTES:
+                self.skipped_bytes += 1
+                pos = start + 1  # "SCOP" in the text, not a frame
+                continue
+            if len(buf) - start < length:
+                pos = start
+                break
+            sequence = int(header["sequence"])
+            if self.last_sequence is not None:
+                self.dropped += (sequence - self.last_sequence - 1) & 0xFFFF
+            self.last_sequence = sequence
+            self.frames += 1
+            out.append(np.frombuffer(bytes(buf[start + HEADER.itemsize : start + length]), dtype=self.dtype))
+            pos = start + length
+        del buf[:pos]
+        return out
+
+
+def unwrap_micros(time_us: np.ndarray) -> np.ndarray:
+    steps = np.diff(time_us.astype(np.int64)) % (1 << 32)
+    return np.concatenate([[0], np.cumsum(steps)]) + int(time_us[0]) if len(time_us) else time_us.astype(np.int64)
+
+
+def list_channels(port: serial.Serial, timeout: float = 2.0) -> list[str]:
+    port.reset_input_buffer()
+    port.write(b"s?\n")
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        line = port.readline().decode(errors="replace")
+        if "Scope channels:" in line:
+            return [n.strip() for n in line.split("Scope channels:", 1)[1].split(",")]
+    raise RuntimeError("no channel list from the board; is this the CW-5200 controller's USB port?")
+
+
+def capture(args):
+    with serial.Serial(args.port, timeout=0.1) as port:
+        names = list_channels(port)
+        chosen = names if args.channels is None else [c.strip() for c in args.channels.split(",")]
+        unknown = [c for c in chosen if c not in names]
+        if unknown:
+            sys.exit(f"unknown channels {unknown}; the board has {names}")
+        mask = sum(1 << names.index(c) for c in chosen)
+        decoder = ScopeDecoder(names, mask)
+        parts = []
+        port.write(f"s{mask:x} {args.period}\n".encode())
+        started = time.monotonic()
+        try:
+            while args.duration is None or time.monotonic() - started < args.duration:
+                data = port.read(max(port.in_waiting, 1))
+                if data:
+                    parts += decoder.feed(data)
+        except KeyboardInterrupt:
+            pass
+        finally:
+            port.write(b"s0\n")
+
+    if not parts:
+        sys.exit(f"no frames received, {decoder.skipped_bytes} bytes of text")
+    samples = np.concatenate(parts)
+    time_us = unwrap_micros(samples["time_us"])
+    columns = {"time_us": time_us} | {n: samples[n] for n in samples.dtype.names[1:]}
+    if args.output.suffix == ".npz":
+        np.savez_compressed(args.output, **columns)
+    else:
+        np.savetxt(args.output, np.column_stack(list(columns.values())), fmt="%d", delimiter=",",
+                   header=",".join(columns), comments="")
+    span = (time_us[-1] - time_us[0]) / 1e6 if len(time_us) > 1 else 0.0
+    print(f"{len(samples)} samples over {span:.3f}s in {decoder.frames} frames, {decoder.dropped} frames dropped, "
+          f"{decoder.skipped_bytes} bytes of text skipped", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("output", type=Path, help=".csv or .npz")
+    parser.add_argument("--port", default="COM16", help="the board's USB serial port")
+    parser.add_argument("--channels", help="comma separated names, default: all")
+    parser.add_argument("--period", default=1000, type=int, help="sample period in microseconds")
+    parser.add_argument("--duration", type=float, help="seconds, default: until Ctrl-C")
+    capture(parser.parse_args())
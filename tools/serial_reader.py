@@ -1,4 +1,3 @@
-import json
 import time
 
 import arrow
@@ -14,103 +13,37 @@ from rich.progress import (
     TextColumn,
 )
 
+import comms
+from telemetry_log import LogWriter
+
 PORT = "COM17"
 BAUD = 19200
 
 
+PING_INTERVAL = 2.0  # seconds between clock pings to the chiller
+
+
 def get_readings(link: txfer.SerialTransfer):
-    readings = {
-        "reservoir": {
-            "temperature": 0.0,
-            "setpoint": 0.0,
-            "level_sense": 0.0,
-            "level_ref": 0.0,
-        },
-        "chassis": {
-            "inside_temperature": 0.0,
-            "outside_temperature": 0.0,
-            "humidity": 0.0,
-            "filter_dp": 0,
-            "fans": {
-                "top_tach": 0.0,
-                "bottom_tach": 0.0,
-                "pwm": 0,
-            },
-        },
-        "compressor": {
-            "running": False,
-            "valve": False,
-            "compressor_time": 0,
-            "valve_time": 0,
-        },
-        "pump": {
-            "running": False,
-            "flow_ok": False,
-        },
-        "error": {
-            "alert": False,
-            "code": 0,
-        },
-    }
+    record = comms.decode(bytes(link.rxBuff[: comms.READINGS.itemsize]))
+    return record, comms.to_nested(record)
 
-    recSize = 0
-    readings["reservoir"]["temperature"] = link.rx_obj(obj_type="f", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["f"]
-    readings["reservoir"]["setpoint"] = link.rx_obj(obj_type="f", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["f"]
-    readings["reservoir"]["level_sense"] = link.rx_obj(obj_type="f", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["f"]
-    readings["reservoir"]["level_ref"] = link.rx_obj(obj_type="f", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["f"]
-    readings["chassis"]["inside_temperature"] = link.rx_obj(
-        obj_type="f", start_pos=recSize
-    )
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["f"]
-    readings["chassis"]["outside_temperature"] = link.rx_obj(
-        obj_type="f", start_pos=recSize
-    )
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["f"]
-    readings["chassis"]["humidity"] = link.rx_obj(obj_type="f", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["f"]
-    readings["chassis"]["filter_dp"] = link.rx_obj(obj_type="H", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["H"]
-    readings["chassis"]["fans"]["top_tach"] = link.rx_obj(
-        obj_type="f", start_pos=recSize
-    )
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["f"]
-    readings["chassis"]["fans"]["bottom_tach"] = link.rx_obj(
-        obj_type="f", start_pos=recSize
-    )
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["f"]
-    readings["chassis"]["fans"]["pwm"] = link.rx_obj(obj_type="B", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["B"]
-    readings["compressor"]["running"] = link.rx_obj(obj_type="?", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["?"]
-    readings["compressor"]["valve"] = link.rx_obj(obj_type="?", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["?"]
-    readings["compressor"]["compressor_time"] = link.rx_obj(
-        obj_type="i", start_pos=recSize
-    )
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["i"]
-    readings["compressor"]["valve_time"] = link.rx_obj(obj_type="i", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["i"]
-    readings["pump"]["running"] = link.rx_obj(obj_type="?", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["?"]
-    readings["pump"]["flow_ok"] = link.rx_obj(obj_type="?", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["?"]
-    readings["error"]["alert"] = link.rx_obj(obj_type="?", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["?"]
-    readings["error"]["code"] = link.rx_obj(obj_type="H", start_pos=recSize)
-    recSize += txfer.STRUCT_FORMAT_LENGTHS["H"]
 
-    return readings
+def send_ping(link: txfer.SerialTransfer, sync: comms.ClockSync):
+    payload = sync.ping()
+    for index, byte in enumerate(payload):
+        link.txBuff[index] = byte
+    link.send(len(payload), packet_id=comms.PACKET_PING)
 
 
 if __name__ == "__main__":
-    link = txfer.SerialTransfer("COM17", baud=19200)
+    link = txfer.SerialTransfer(PORT, baud=BAUD)
     link.open()
+    log = LogWriter("logs")
+    sync = comms.ClockSync()
+    monitor = comms.LinkMonitor()
     time.sleep(2)
     started = False
+    last_ping = 0.0
 
     res_meters = Progress(
         TextColumn(
@@ -190,8 +123,19 @@ if __name__ == "__main__":
         with Live(meter_group):
 
             while True:
+                if time.monotonic() - last_ping >= PING_INTERVAL:
+                    send_ping(link, sync)
+                    last_ping = time.monotonic()
                 if link.available():
-                    readings = get_readings(link)
+                    received = time.time_ns()
+                    if link.idByte == comms.PACKET_PONG:
+                        sync.pong(bytes(link.rxBuff[: comms.EXCHANGE.itemsize]), received // 1000)
+                        continue
+                    if link.idByte != comms.PACKET_READINGS:
+                        # acks and settings replies meant for the loop controller
+                        continue
+                    record, readings = get_readings(link)
+                    monitor.add(record.reshape(1), [received], sync)
                     if not started:
                         started = True
                         updated = arrow.get(tzinfo="America/Detroit")
@@ -241,17 +185,17 @@ if __name__ == "__main__":
                     )
                     fan_meters.update(
                         fan_top_tach,
-                        completed=int(readings["chassis"]["fans"]["top_tach"]),
+                        completed=int(readings["chassis"]["fan"]["top_tach"]),
                         refresh=True,
                     )
                     fan_meters.update(
                         fan_bottom_tach,
-                        completed=int(readings["chassis"]["fans"]["bottom_tach"]),
+                        completed=int(readings["chassis"]["fan"]["bottom_tach"]),
                         refresh=True,
                     )
                     fan_meters.update(
                         fan_pwm,
-                        completed=int(readings["chassis"]["fans"]["pwm"]),
+                        completed=int(readings["chassis"]["fan"]["pwm"]),
                         refresh=True,
                     )
                     state_meters.update(
@@ -279,16 +223,11 @@ if __name__ == "__main__":
 
                     state_meters.update(
                         state_updated,
-                        description=f'{updated.format("YYYY-MM-DD HH:mm:ss")} ({updated.humanize()})',
+                        description=f'{updated.format("YYYY-MM-DD HH:mm:ss")} ({updated.humanize()}), {monitor.summary()}',
                         refresh=True,
                     )
 
-                    with open(
-                        f'logs/{updated.format("YYYY_MM_DD_HH_mm_ss_SSSZ")}.json',
-                        "w",
-                        encoding="utf-8",
-                    ) as f:
-                        json.dump(readings, f)
+                    log.append(bytes(link.rxBuff[: link.bytesRead]), received)
                 elif link.status < 0:
                     if link.status == txfer.Status.CRC_ERROR:
                         print("ERROR: CRC_ERROR")
@@ -300,4 +239,5 @@ if __name__ == "__main__":
                         print(f"ERROR: {link.status.name}")
 
     except KeyboardInterrupt:
+        log.close()
         link.close()
@@ -0,0 +1,57 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/can.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "can_socket.h"
+
+int openCANSocket(const char *name)
+{
+    int fd;
+    if (strncmp(name, "fd:", 3) == 0)
+        fd = atoi(name + 3);
+    else
+    {
+        fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+        if (fd < 0)
+            return -1;
+        sockaddr_can address = {};
+        address.can_family = AF_CAN;
+        address.can_ifindex = if_nametoindex(name);
+        if (address.can_ifindex == 0 || bind(fd, (sockaddr *)&address, sizeof(address)) < 0)
+        {
+            close(fd);
+            return -1;
+        }
+    }
+    if (fd < 0 || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)
+        return -1;
+    return fd;
+}
+
+int readCANFrame(int fd, uint16_t *id, uint8_t *length, uint8_t *data)
+{
+    can_frame frame;
+    ssize_t n = read(fd, &frame, sizeof(frame));
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return 0;
+    if (n != sizeof(frame))
+        return -1;
+    *id = frame.can_id & CAN_SFF_MASK;
+    *length = frame.can_dlc > 8 ? 8 : frame.can_dlc;
+    memcpy(data, frame.data, *length);
+    return 1;
+}
+
+bool writeCANFrame(int fd, uint16_t id, uint8_t length, const uint8_t *data)
+{
+    can_frame frame = {};
+    frame.can_id = id;
+    frame.can_dlc = length;
+    memcpy(frame.data, data, length);
+    return write(fd, &frame, sizeof(frame)) == sizeof(frame);
+}
@@ -0,0 +1,19 @@
+#ifndef __TELEMETRY_CAN_SOCKET__
+#define __TELEMETRY_CAN_SOCKET__
+#include <cstdint>
+
+/*
+ *   SocketCAN for the host tools
+ *
+ *   A bus is a SocketCAN interface such as can0, or fd:N for a socket
+ *   already open that carries the same 16 byte struct can_frame, as in
+ *   firmware/link_host. linux/can.h has a struct can_frame of its own, so
+ *   it stays in can_socket.cpp and frames cross as their fields.
+ */
+
+int openCANSocket(const char *name); // -1 if it will not open
+// 1 with a frame, 0 with none waiting, -1 once the bus is gone
+int readCANFrame(int fd, uint16_t *id, uint8_t *length, uint8_t *data);
+bool writeCANFrame(int fd, uint16_t id, uint8_t length, const uint8_t *data);
+
+#endif
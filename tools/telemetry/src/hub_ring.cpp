@@ -0,0 +1,170 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hub_ring.h"
+
+// shm_open() wants one leading slash
+static std::string sharedName(const char *name)
+{
+    return name[0] == '/' ? name : std::string("/") + name;
+}
+
+hub_ring::~hub_ring()
+{
+    if (!header)
+        return;
+    munmap(header, bytes);
+    shm_unlink(name.c_str());
+}
+
+bool hub_ring::create(const char *ring_name, uint32_t capacity, const std::vector<std::string> &sources)
+{
+    if (capacity == 0 || sources.size() > HUB_MAX_SOURCES)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    name = sharedName(ring_name);
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 && errno == EEXIST)
+    {
+        // left behind by a hub that was killed
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    }
+    if (fd < 0)
+        return false;
+    bytes = HUB_SLOTS_OFFSET + (size_t)capacity * sizeof(struct_hub_slot);
+    void *base = MAP_FAILED;
+    if (ftruncate(fd, bytes) == 0)
+        base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    header = new (base) struct_hub_header();
+    header->slot_bytes = sizeof(struct_hub_slot);
+    header->readings_bytes = sizeof(struct_readings);
+    header->capacity = capacity;
+    header->sources = sources.size();
+    for (size_t i = 0; i < sources.size(); i++)
+        snprintf(header->names[i], HUB_SOURCE_NAME_BYTES, "%s", sources[i].c_str());
+    slots = (struct_hub_slot *)((uint8_t *)base + HUB_SLOTS_OFFSET);
+    for (uint32_t i = 0; i < capacity; i++)
+        new (&slots[i]) struct_hub_slot();
+    // the magic last, so a reader that attaches while the ring is laid out is turned away
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, HUB_MAGIC, sizeof(HUB_MAGIC));
+    return true;
+}
+
+struct_readings *hub_ring::claim(uint16_t source, uint16_t kind, int64_t time_ns)
+{
+    filling = &slots[next % header->capacity];
+    filling->sequence.store(2 * next + 1, std::memory_order_relaxed);
+    // a reader that sees any of the body below also sees the odd sequence, after its own fence
+    std::atomic_thread_fence(std::memory_order_release);
+    filling->source = source;
+    filling->kind = kind;
+    filling->time_ns = time_ns;
+    return &filling->readings;
+}
+
+void hub_ring::publish()
+{
+    filling->sequence.store(2 * next + 2, std::memory_order_release);
+    header->written.store(++next, std::memory_order_release);
+}
+
+void hub_ring::write(uint16_t source, uint16_t kind, int64_t time_ns, const struct_readings &readings)
+{
+    memcpy(claim(source, kind, time_ns), &readings, sizeof(readings));
+    publish();
+}
+
+hub_reader::~hub_reader()
+{
+    if (header)
+        munmap((void *)header, bytes);
+}
+
+bool hub_reader::attach(const char *ring_name)
+{
+    int fd = shm_open(sharedName(ring_name).c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    struct stat status;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && status.st_size >= HUB_SLOTS_OFFSET)
+        base = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    bytes = status.st_size;
+    header = (const struct_hub_header *)base;
+    bool laid_out = memcmp(header->magic, HUB_MAGIC, sizeof(HUB_MAGIC)) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!laid_out || header->slot_bytes != sizeof(struct_hub_slot) || header->readings_bytes != sizeof(struct_readings) ||
+        bytes < HUB_SLOTS_OFFSET + (size_t)header->capacity * sizeof(struct_hub_slot))
+    {
+        errno = EINVAL;
+        return false;
+    }
+    slots = (const struct_hub_slot *)((const uint8_t *)base + HUB_SLOTS_OFFSET);
+    following = header->written.load(std::memory_order_acquire);
+    return true;
+}
+
+bool hub_reader::next(hub_view *view)
+{
+    uint64_t written = header->written.load(std::memory_order_acquire);
+    if (written - following > header->capacity)
+    {
+        lost += written - header->capacity - following;
+        following = written - header->capacity;
+    }
+    while (following < written)
+    {
+        const struct_hub_slot *slot = &slots[following % header->capacity];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        uint64_t expected = 2 * following + 2;
+        ++following;
+        if (sequence == expected)
+        {
+            *view = {slot, sequence};
+            return true;
+        }
+        ++lost; // lapped since written was loaded
+    }
+    return false;
+}
+
+bool hub_reader::intact(const hub_view &view)
+{
+    // orders the reads of the body before the second look at the sequence
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (view.slot->sequence.load(std::memory_order_relaxed) == view.sequence)
+    {
+        ++read;
+        return true;
+    }
+    ++torn;
+    return false;
+}
+
+const char *hub_reader::sourceName(uint16_t source) const
+{
+    return source < header->sources ? header->names[source] : "?";
+}
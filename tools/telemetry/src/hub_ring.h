@@ -0,0 +1,125 @@
+#ifndef __TELEMETRY_HUB_RING__
+#define __TELEMETRY_HUB_RING__
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <comms.h>
+
+/*
+ *   The telemetry hub's ring of readings sets, in POSIX shared memory
+ *
+ *     0     struct_hub_header: magic "CWHUB2", slot and readings sizes,
+ *           capacity, the sources' names, and the count of writes done
+ *     4096  capacity struct_hub_slot, 128 bytes each
+ *
+ *   There is one writer, the hub, and no locks. While write n fills its
+ *   slot, the slot's sequence is 2n+1; once the write is done it is 2n+2,
+ *   stored with release ordering, and only then is `written` bumped, also
+ *   with release. A reader loads `written` and a slot's sequence with
+ *   acquire, so the body it then reads in place is at least write n's.
+ *   After using it, an acquire fence and a second look at the sequence tell
+ *   it whether the writer has since lapped it and started on the slot
+ *   again; if so, whatever it made of the body is dropped as torn. Slots
+ *   the writer lapped before a reader got to them are counted as lost, and
+ *   a stalled reader never holds the hub up.
+ *
+ *   The ordering is the C++ memory model's, not any one machine's, so the
+ *   ring is sound on ARM hosts such as a Raspberry Pi as well as on x86.
+ *   Only the 64-bit atomics must be lock-free, or they would not work
+ *   across processes at all.
+ */
+
+#define HUB_MAGIC "CWHUB2"
+#define HUB_DEFAULT_NAME "/cw_telemetry_hub"
+#define HUB_DEFAULT_CAPACITY (1 << 16) // slots; 8 MB, 5 s of bench at 64 controllers x 200 Hz
+#define HUB_MAX_SOURCES 64
+#define HUB_SOURCE_NAME_BYTES 32
+#define HUB_SLOTS_OFFSET 4096
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the ring's sequences must be lock-free to be shared between processes");
+
+enum hub_kind : uint16_t
+{
+    HUB_KIND_SERIAL = 0, // a whole struct_readings off a serial link
+    HUB_KIND_CAN,        // assembled from the loop controller's CAN frames
+};
+
+struct alignas(64) struct_hub_slot
+{
+    std::atomic<uint64_t> sequence;
+    uint16_t source;
+    uint16_t kind; // hub_kind
+    uint32_t reserved;
+    int64_t time_ns; // host receive time
+    struct_readings readings;
+};
+
+struct struct_hub_header
+{
+    char magic[8];
+    uint32_t slot_bytes;
+    uint32_t readings_bytes; // a reader built from another comms.h will not attach
+    uint32_t capacity;
+    uint32_t sources;
+    alignas(64) std::atomic<uint64_t> written;
+    char names[HUB_MAX_SOURCES][HUB_SOURCE_NAME_BYTES];
+};
+
+static_assert(sizeof(struct_hub_slot) == 128, "slots are two cache lines");
+static_assert(sizeof(struct_hub_header) <= HUB_SLOTS_OFFSET, "ring header overlaps its slots");
+
+// the hub's end
+class hub_ring
+{
+public:
+    ~hub_ring();
+
+    bool create(const char *name, uint32_t capacity, const std::vector<std::string> &sources);
+    // starts the next write and returns its readings to be filled in place; publish() finishes it
+    struct_readings *claim(uint16_t source, uint16_t kind, int64_t time_ns);
+    void publish();
+    void write(uint16_t source, uint16_t kind, int64_t time_ns, const struct_readings &readings);
+    uint64_t written() const { return next; }
+
+private:
+    std::string name;
+    size_t bytes = 0;
+    struct_hub_header *header = nullptr;
+    struct_hub_slot *slots = nullptr;
+    struct_hub_slot *filling = nullptr;
+    uint64_t next = 0;
+};
+
+// a slot as a reader found it, read in place until checked
+struct hub_view
+{
+    const struct_hub_slot *slot;
+    uint64_t sequence;
+};
+
+// follows the ring from where it is when attached
+class hub_reader
+{
+public:
+    ~hub_reader();
+
+    bool attach(const char *name);
+    bool next(hub_view *view); // false when caught up
+    bool intact(const hub_view &view); // false if the writer has started on the slot since; counts it torn
+    uint32_t sources() const { return header->sources; }
+    const char *sourceName(uint16_t source) const;
+
+    uint64_t read = 0;
+    uint64_t lost = 0; // lapped by the writer before they were read
+    uint64_t torn = 0; // rewritten while they were read
+
+private:
+    size_t bytes = 0;
+    const struct_hub_header *header = nullptr;
+    const struct_hub_slot *slots = nullptr;
+    uint64_t following = 0;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef __TELEMETRY_READINGS_COLUMNS__
+#define __TELEMETRY_READINGS_COLUMNS__
+#include <cstddef>
+#include <cstdint>
+#include <comms.h>
+
+/*
+ *   struct_readings, one column per field
+ *
+ *   Each entry names a field of comms.h's struct_readings; its offset, size
+ *   and type come from the compiler, so the log is laid out exactly as the
+ *   boards pack the frame. The table must cover the struct end to end with
+ *   no gaps: a field added to comms.h and not listed here stops the build,
+ *   rather than going missing from the log.
+ */
+
+enum column_type : uint8_t
+{
+    COLUMN_BOOL = 0,
+    COLUMN_U8,
+    COLUMN_I16,
+    COLUMN_U16,
+    COLUMN_U32,
+    COLUMN_I64,
+    COLUMN_U64,
+    COLUMN_F32,
+};
+
+struct readings_column
+{
+    const char *name;
+    uint16_t offset; // in struct_readings
+    uint8_t size;
+    column_type type;
+};
+
+constexpr column_type columnTypeOf(const bool *) { return COLUMN_BOOL; }
+constexpr column_type columnTypeOf(const uint8_t *) { return COLUMN_U8; }
+constexpr column_type columnTypeOf(const int16_t *) { return COLUMN_I16; }
+constexpr column_type columnTypeOf(const uint16_t *) { return COLUMN_U16; }
+constexpr column_type columnTypeOf(const uint32_t *) { return COLUMN_U32; }
+constexpr column_type columnTypeOf(const int64_t *) { return COLUMN_I64; }
+constexpr column_type columnTypeOf(const uint64_t *) { return COLUMN_U64; }
+constexpr column_type columnTypeOf(const float *) { return COLUMN_F32; }
+
+constexpr uint8_t columnSize(column_type type)
+{
+    return type == COLUMN_BOOL || type == COLUMN_U8    ? 1
+           : type == COLUMN_I16 || type == COLUMN_U16  ? 2
+           : type == COLUMN_U32 || type == COLUMN_F32  ? 4
+                                                        : 8;
+}
+
+#define READINGS_COLUMN(field)                                                                                  \
+    {                                                                                                           \
+        #field, offsetof(struct_readings, field), sizeof(((struct_readings *)nullptr)->field),                  \
+            columnTypeOf((decltype(((struct_readings *)nullptr)->field) *)nullptr)                              \
+    }
+
+constexpr readings_column readings_columns[] = {
+    READINGS_COLUMN(header.sequence),
+    READINGS_COLUMN(header.time_us),
+    READINGS_COLUMN(reservoir.temperature),
+    READINGS_COLUMN(reservoir.setpoint),
+    READINGS_COLUMN(reservoir.level_sense),
+    READINGS_COLUMN(reservoir.level_ref),
+    READINGS_COLUMN(chassis.inside_temperature),
+    READINGS_COLUMN(chassis.outside_temperature),
+    READINGS_COLUMN(chassis.humidity),
+    READINGS_COLUMN(chassis.filter_dp),
+    READINGS_COLUMN(chassis.fan.top_tach),
+    READINGS_COLUMN(chassis.fan.bottom_tach),
+    READINGS_COLUMN(chassis.fan.pwm),
+    READINGS_COLUMN(compressor.running),
+    READINGS_COLUMN(compressor.valve),
+    READINGS_COLUMN(compressor.compressor_time),
+    READINGS_COLUMN(compressor.valve_time),
+    READINGS_COLUMN(pump.running),
+    READINGS_COLUMN(pump.flow_ok),
+    READINGS_COLUMN(error.alert),
+    READINGS_COLUMN(error.code),
+    READINGS_COLUMN(maintenance.compressor_seconds),
+    READINGS_COLUMN(maintenance.compressor_starts),
+    READINGS_COLUMN(maintenance.starts_per_hour),
+    READINGS_COLUMN(maintenance.short_cycles),
+    READINGS_COLUMN(maintenance.pump_seconds),
+    READINGS_COLUMN(maintenance.fan_seconds),
+    READINGS_COLUMN(maintenance.filter_hours_left),
+};
+
+#define READINGS_COLUMNS (sizeof(readings_columns) / sizeof(readings_columns[0]))
+
+// each column starts where the last ended, has its type's size, and the last ends the struct
+constexpr bool columnsCoverReadings(size_t i = 0, size_t offset = 0)
+{
+    return i == READINGS_COLUMNS
+               ? offset == sizeof(struct_readings)
+               : readings_columns[i].offset == offset &&
+                     readings_columns[i].size == columnSize(readings_columns[i].type) &&
+                     columnsCoverReadings(i + 1, offset + readings_columns[i].size);
+}
+
+static_assert(columnsCoverReadings(), "readings_columns does not match struct_readings in comms.h");
+
+// a readings set as the log stores and exports it: the host receive time, then the frame as the chiller sent it
+struct __attribute__((packed)) struct_logged_readings
+{
+    int64_t time_ns;
+    struct_readings readings;
+};
+
+static_assert(sizeof(struct_logged_readings) == sizeof(int64_t) + sizeof(struct_readings),
+              "logged readings must stay packed for the replay build");
+
+#endif
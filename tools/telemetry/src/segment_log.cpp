@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "segment_log.h"
+
+#define LOG_FLUSH_MS 1000 // between count updates while appending
+
+static uint32_t align(uint64_t offset)
+{
+    return (uint32_t)((offset + LOG_ALIGN - 1) / LOG_ALIGN * LOG_ALIGN);
+}
+
+log_segment::~log_segment()
+{
+    if (writable)
+        commit();
+    if (base)
+        munmap(base, mapped);
+    if (fd >= 0)
+        close(fd);
+}
+
+// a map does not follow its file as it grows, so each new block maps it again
+bool log_segment::map(size_t bytes)
+{
+    if (base)
+        munmap(base, mapped);
+    int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *address = mmap(nullptr, bytes, protection, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED)
+    {
+        base = nullptr;
+        header = nullptr;
+        return false;
+    }
+    base = (uint8_t *)address;
+    mapped = bytes;
+    header = (struct_segment_header *)base;
+    return true;
+}
+
+bool log_segment::create(const char *path, uint64_t capacity, uint32_t block)
+{
+    fd = ::open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 || ftruncate(fd, LOG_DATA_OFFSET) != 0)
+        return false;
+    writable = true;
+    if (!map(LOG_DATA_OFFSET))
+        return false;
+    memcpy(header->magic, LOG_MAGIC, sizeof(LOG_MAGIC));
+    header->columns = LOG_COLUMNS;
+    header->block = (uint32_t)std::min<uint64_t>(block, capacity);
+    header->capacity = capacity;
+    header->count = 0;
+
+    struct_segment_column *columns = (struct_segment_column *)(base + LOG_COLUMNS_OFFSET);
+    strcpy(columns[0].name, "time_ns");
+    columns[0].offset = 0;
+    columns[0].type = COLUMN_I64;
+    columns[0].size = sizeof(int64_t);
+    uint32_t offset = align((uint64_t)sizeof(int64_t) * header->block);
+    for (size_t i = 0; i < READINGS_COLUMNS; i++)
+    {
+        const readings_column &field = readings_columns[i];
+        struct_segment_column &column = columns[i + 1];
+        snprintf(column.name, sizeof(column.name), "%s", field.name);
+        column.offset = offset;
+        column.type = field.type;
+        column.size = field.size;
+        offsets[i] = offset;
+        offset = align(offset + (uint64_t)field.size * header->block);
+    }
+    header->block_bytes = offset;
+    time_offset = 0;
+    return true;
+}
+
+bool log_segment::open(const char *path)
+{
+    struct stat status;
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &status) != 0)
+        return false;
+    if (status.st_size < LOG_DATA_OFFSET || !map(status.st_size))
+    {
+        errno = EINVAL;
+        return false;
+    }
+    if (memcmp(header->magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 || header->block == 0 || header->block_bytes == 0 ||
+        LOG_COLUMNS_OFFSET + header->columns * sizeof(struct_segment_column) > LOG_DATA_OFFSET)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    blocks = (status.st_size - LOG_DATA_OFFSET) / header->block_bytes;
+
+    // by name, type and size, so a field moved, added or dropped in comms.h since is still found or reads as zero
+    const struct_segment_column *columns = (const struct_segment_column *)(base + LOG_COLUMNS_OFFSET);
+    time_offset = LOG_NO_COLUMN;
+    std::fill(offsets, offsets + READINGS_COLUMNS, LOG_NO_COLUMN);
+    for (uint32_t i = 0; i < header->columns; i++)
+    {
+        const struct_segment_column &column = columns[i];
+        if (strncmp(column.name, "time_ns", sizeof(column.name)) == 0 && column.type == COLUMN_I64)
+            time_offset = column.offset;
+        for (size_t j = 0; j < READINGS_COLUMNS; j++)
+        {
+            const readings_column &field = readings_columns[j];
+            if (strncmp(column.name, field.name, sizeof(column.name)) == 0 && column.type == field.type &&
+                column.size == field.size)
+                offsets[j] = column.offset;
+        }
+    }
+    if (time_offset == LOG_NO_COLUMN)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    return true;
+}
+
+uint8_t *log_segment::at(uint32_t offset, uint8_t size, uint64_t index) const
+{
+    return base + LOG_DATA_OFFSET + index / header->block * header->block_bytes + offset + index % header->block * size;
+}
+
+bool log_segment::append(int64_t time_ns, const struct_readings &readings)
+{
+    if (appended >= header->capacity)
+        return false;
+    uint64_t index = appended / header->block;
+    if (index >= blocks)
+    {
+        size_t bytes = LOG_DATA_OFFSET + (index + 1) * header->block_bytes;
+        commit();
+        if (ftruncate(fd, bytes) != 0 || !map(bytes))
+            return false;
+        blocks = index + 1;
+    }
+    memcpy(at(time_offset, sizeof(int64_t), appended), &time_ns, sizeof(int64_t));
+    for (size_t i = 0; i < READINGS_COLUMNS; i++)
+    {
+        const readings_column &field = readings_columns[i];
+        memcpy(at(offsets[i], field.size, appended), (const uint8_t *)&readings + field.offset, field.size);
+    }
+    ++appended;
+    return true;
+}
+
+void log_segment::commit()
+{
+    if (!header)
+        return;
+    __atomic_store_n(&header->count, appended, __ATOMIC_RELEASE);
+    msync(base, mapped, MS_ASYNC);
+}
+
+uint64_t log_segment::count() const
+{
+    if (writable)
+        return appended;
+    // a reader may have mapped the file before the writer last grew it
+    return std::min(__atomic_load_n(&header->count, __ATOMIC_ACQUIRE), blocks * header->block);
+}
+
+int64_t log_segment::time(uint64_t index) const
+{
+    int64_t time_ns;
+    memcpy(&time_ns, at(time_offset, sizeof(int64_t), index), sizeof(int64_t));
+    return time_ns;
+}
+
+uint64_t log_segment::search(int64_t time_ns) const
+{
+    uint64_t sets = count();
+    if (sets == 0)
+        return 0;
+    // the first time of each block, one page each, picks the block; equal times may end the one before
+    uint64_t low = 0;
+    uint64_t high = (sets + header->block - 1) / header->block;
+    while (low < high)
+    {
+        uint64_t middle = low + (high - low) / 2;
+        if (time(middle * header->block) < time_ns)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    low = (low ? low - 1 : 0) * header->block;
+    high = std::min(sets, low + header->block);
+    while (low < high)
+    {
+        uint64_t middle = low + (high - low) / 2;
+        if (time(middle) < time_ns)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+const uint8_t *log_segment::value(size_t column, uint64_t index) const
+{
+    if (offsets[column] == LOG_NO_COLUMN)
+        return nullptr;
+    return at(offsets[column], readings_columns[column].size, index);
+}
+
+void log_segment::row(uint64_t index, struct_logged_readings *out) const
+{
+    out->time_ns = time(index);
+    uint8_t *readings = (uint8_t *)&out->readings;
+    for (size_t i = 0; i < READINGS_COLUMNS; i++)
+    {
+        const readings_column &field = readings_columns[i];
+        const uint8_t *from = value(i, index);
+        if (from)
+            memcpy(readings + field.offset, from, field.size);
+        else
+            memset(readings + field.offset, 0, field.size);
+    }
+}
+
+static uint64_t steadyMillis()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+bool log_writer::begin(const char *path, uint64_t segment_capacity)
+{
+    directory = path;
+    capacity = segment_capacity;
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+bool log_writer::append(int64_t time_ns, const struct_readings &readings)
+{
+    time_ns = std::max(time_ns, last_ns);
+    last_ns = time_ns;
+    if (!segment || !segment->append(time_ns, readings))
+    {
+        // full: roll to a new segment named for its first set
+        char name[32];
+        snprintf(name, sizeof(name), "/%020" PRId64 ".tlog", time_ns);
+        segment.reset(new log_segment());
+        if (!segment->create((directory + name).c_str(), capacity))
+        {
+            perror((directory + name).c_str());
+            segment.reset();
+            return false;
+        }
+        if (!segment->append(time_ns, readings))
+            return false;
+    }
+    uint64_t now = steadyMillis();
+    if (now - last_flush_ms >= LOG_FLUSH_MS)
+    {
+        flush();
+        last_flush_ms = now;
+    }
+    return true;
+}
+
+void log_writer::flush()
+{
+    if (segment)
+        segment->commit();
+}
+
+bool log_reader::open(const char *directory)
+{
+    DIR *listing = opendir(directory);
+    if (!listing)
+        return false;
+    std::vector<std::pair<int64_t, std::string>> found;
+    while (dirent *entry = readdir(listing))
+    {
+        const char *dot = strrchr(entry->d_name, '.');
+        if (!dot || strcmp(dot, ".tlog") != 0)
+            continue;
+        found.emplace_back(strtoll(entry->d_name, nullptr, 10), std::string(directory) + "/" + entry->d_name);
+    }
+    closedir(listing);
+    std::sort(found.begin(), found.end());
+    for (const auto &segment : found)
+    {
+        starts.push_back(segment.first);
+        paths.push_back(segment.second);
+    }
+    segments.resize(paths.size());
+    return true;
+}
+
+std::vector<log_range> log_reader::query(int64_t start_ns, int64_t end_ns)
+{
+    std::vector<log_range> ranges;
+    // the segment holding start_ns is the last one that starts at or before it
+    size_t first = std::upper_bound(starts.begin(), starts.end(), start_ns) - starts.begin();
+    size_t last = std::lower_bound(starts.begin(), starts.end(), end_ns) - starts.begin();
+    for (size_t i = first ? first - 1 : 0; i < last; i++)
+    {
+        if (!segments[i])
+        {
+            segments[i].reset(new log_segment());
+            if (!segments[i]->open(paths[i].c_str()))
+            {
+                perror(paths[i].c_str());
+                segments[i].reset();
+                continue;
+            }
+        }
+        uint64_t low = segments[i]->search(start_ns);
+        uint64_t high = segments[i]->search(end_ns);
+        if (high > low)
+            ranges.push_back({segments[i].get(), low, high});
+    }
+    return ranges;
+}
@@ -0,0 +1,137 @@
+#ifndef __TELEMETRY_SEGMENT_LOG__
+#define __TELEMETRY_SEGMENT_LOG__
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "readings_columns.h"
+
+/*
+ *   Segmented columnar log of readings sets
+ *
+ *   Each segment is one file of up to a capacity of sets:
+ *
+ *     0     struct_segment_header, magic "CWTLOG3"
+ *     64    struct_segment_column for time_ns, then each of readings_columns
+ *     4096  blocks of `block` sets, each one array per column, 64-byte aligned
+ *
+ *   A segment starts as its header and grows a block at a time, so a file
+ *   only takes the space of the blocks written, and written blocks never
+ *   move, so a reader can map a segment that is still being appended to.
+ *   The header's count is stored after the sets it covers, with release
+ *   ordering, and loaded with acquire, so a reader never sees a set before
+ *   it is whole.
+ *
+ *   The first column, time_ns, is the host receive time, kept monotonic so
+ *   it is the segment's time index: a range query bisects the segments by
+ *   the start time in their names, then the first time of each block, then
+ *   the times inside one block. A segment written with another comms.h is
+ *   still read, column by column by name and type; a field it lacks reads
+ *   as zero.
+ */
+
+#define LOG_MAGIC "CWTLOG3"
+#define LOG_COLUMNS_OFFSET 64
+#define LOG_DATA_OFFSET 4096
+#define LOG_ALIGN 64
+#define LOG_NAME_BYTES 40
+#define LOG_DEFAULT_CAPACITY (1 << 20) // ~12 days at 1 Hz, ~17 minutes at 1 kHz
+#define LOG_DEFAULT_BLOCK (1 << 12)    // sets a segment grows by, ~1 hour at 1 Hz, ~4 s at 1 kHz
+#define LOG_COLUMNS (READINGS_COLUMNS + 1)
+#define LOG_NO_COLUMN UINT32_MAX
+
+struct struct_segment_header
+{
+    char magic[8];
+    uint32_t columns;
+    uint32_t block;
+    uint64_t capacity;
+    uint64_t count; // sets appended and whole
+    uint64_t block_bytes;
+};
+
+struct struct_segment_column
+{
+    char name[LOG_NAME_BYTES];
+    uint32_t offset; // in a block
+    uint8_t type;    // column_type
+    uint8_t size;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(struct_segment_header) <= LOG_COLUMNS_OFFSET, "segment header overlaps its columns");
+static_assert(LOG_COLUMNS_OFFSET + 2 * LOG_COLUMNS * sizeof(struct_segment_column) <= LOG_DATA_OFFSET,
+              "no room for the columns of a later comms.h");
+
+class log_segment
+{
+public:
+    ~log_segment();
+
+    bool create(const char *path, uint64_t capacity, uint32_t block = LOG_DEFAULT_BLOCK);
+    bool open(const char *path); // read only
+    bool append(int64_t time_ns, const struct_readings &readings); // false when full
+    void commit();
+
+    uint64_t count() const;
+    uint64_t capacity() const { return header->capacity; }
+    uint64_t search(int64_t time_ns) const; // the first set at or after time_ns
+    int64_t time(uint64_t index) const;
+    // readings_columns[column] of set index, or nullptr if this segment has no such column
+    const uint8_t *value(size_t column, uint64_t index) const;
+    void row(uint64_t index, struct_logged_readings *out) const;
+
+private:
+    bool map(size_t bytes);
+    uint8_t *at(uint32_t offset, uint8_t size, uint64_t index) const;
+
+    int fd = -1;
+    bool writable = false;
+    uint8_t *base = nullptr;
+    size_t mapped = 0;
+    struct_segment_header *header = nullptr;
+    uint64_t blocks = 0;
+    uint64_t appended = 0;
+    uint32_t time_offset = 0;
+    uint32_t offsets[READINGS_COLUMNS]; // each of readings_columns in a block, or LOG_NO_COLUMN
+};
+
+class log_writer
+{
+public:
+    ~log_writer() { flush(); }
+
+    bool begin(const char *directory, uint64_t capacity = LOG_DEFAULT_CAPACITY);
+    bool append(int64_t time_ns, const struct_readings &readings);
+    void flush();
+
+private:
+    std::string directory;
+    uint64_t capacity = LOG_DEFAULT_CAPACITY;
+    std::unique_ptr<log_segment> segment;
+    int64_t last_ns = INT64_MIN;
+    uint64_t last_flush_ms = 0;
+};
+
+struct log_range
+{
+    const log_segment *segment;
+    uint64_t first;
+    uint64_t last; // one past
+};
+
+class log_reader
+{
+public:
+    bool open(const char *directory);
+    // the sets from start_ns up to but not including end_ns, segment by segment
+    std::vector<log_range> query(int64_t start_ns, int64_t end_ns);
+
+private:
+    std::vector<std::string> paths;
+    std::vector<int64_t> starts;
+    std::vector<std::unique_ptr<log_segment>> segments; // opened as a query first needs them
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <cinttypes>
+#include <ctime>
+
+#include "serial_link.h"
+
+int64_t wallNanos()
+{
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+bool serial_link::open(const char *path, uint32_t baud, double ping_interval_s)
+{
+    if (!port.open(path, baud))
+        return false;
+    link.begin(port);
+    ping_s = ping_interval_s;
+    return true;
+}
+
+void serial_link::due()
+{
+    if (ping_s <= 0 || (pings && millis() - last_ping_ms < ping_s * 1000))
+        return;
+    struct_clock_exchange ping = {++ping_id, (uint64_t)(wallNanos() / 1000), 0, 0};
+    link.txObj(ping);
+    link.sendData(sizeof(ping), PACKET_PING);
+    last_ping_ms = millis();
+    ++pings;
+}
+
+bool serial_link::next()
+{
+    while (port.available())
+    {
+        if (!link.available())
+        {
+            if (link.status == CRC_ERROR)
+                ++crc_errors;
+            else if (link.status < 0)
+                ++framing_errors;
+            continue;
+        }
+        received_ns = wallNanos();
+        if (link.currentPacketID() == PACKET_READINGS)
+        {
+            if (link.bytesRead == sizeof(struct_readings))
+                return true;
+            ++wrong_sizes;
+        }
+        else if (link.currentPacketID() == PACKET_PONG && link.bytesRead == sizeof(struct_clock_exchange))
+        {
+            struct_clock_exchange pong;
+            link.rxObj(pong);
+            // only an answer to the latest ping has a t1 this side still trusts
+            if (pong.id != ping_id)
+                continue;
+            addClockExchange(sync, pong.t1, pong.t2, pong.t3, received_ns / 1000);
+            ++pongs;
+        }
+        // acks and settings replies meant for the loop controller go by
+    }
+    return false;
+}
+
+void serial_link::take(struct_readings *readings)
+{
+    link.rxObj(*readings);
+    if (started && readings->header.sequence > last_sequence)
+        lost += readings->header.sequence - last_sequence - 1;
+    else if (started)
+        ++resets; // the chiller restarted its count
+    started = true;
+    last_sequence = readings->header.sequence;
+    ++frames;
+    if (!sync.valid)
+        return;
+    float latency = (float)(received_ns / 1000 - (int64_t)remoteToLocal(sync, readings->header.time_us));
+    if (latency_us.size() < LINK_KEEP_LATENCIES)
+        latency_us.push_back(latency);
+    else
+        latency_us[next_latency++ % LINK_KEEP_LATENCIES] = latency;
+}
+
+void serial_link::report(FILE *out) const
+{
+    fprintf(out, "%" PRIu64 " frames, %" PRIu64 " lost, %" PRIu64 " chiller resets", frames, lost, resets);
+    if (!latency_us.empty())
+    {
+        std::vector<float> sorted(latency_us);
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&](double p) { return sorted[(size_t)(p * (sorted.size() - 1))] / 1000; };
+        fprintf(out, "; sample to host latency p50 %.1fms p90 %.1fms p99 %.1fms max %.1fms", percentile(0.5),
+                percentile(0.9), percentile(0.99), sorted.back() / 1000);
+    }
+    if (sync.valid)
+        fprintf(out, "; clock offset %.6fs drift %.2fppm delay %.1fms (%u/%u pongs)", sync.offset_us / 1e6,
+                sync.drift_ppm, sync.delay_us / 1000.0, pongs, pings);
+    else if (ping_s > 0)
+        fprintf(out, "; no clock sync yet");
+    fprintf(out, "; %" PRIu64 " CRC errors, %" PRIu64 " framing errors, %" PRIu64 " readings frames of the wrong size\n",
+            crc_errors, framing_errors, wrong_sizes);
+}
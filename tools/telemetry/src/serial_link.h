@@ -0,0 +1,62 @@
+#ifndef __TELEMETRY_SERIAL_LINK__
+#define __TELEMETRY_SERIAL_LINK__
+#include <Arduino.h>
+#include <SerialTransfer.h>
+#include <cstdio>
+#include <vector>
+#include <comms.h>
+#include <device_clock.h>
+
+/*
+ *   The chiller's serial link, from the host
+ *
+ *   A serial port or pty read with the SerialTransfer framing the boards
+ *   run, from firmware/link_host. next() parses what has arrived up to the
+ *   next readings frame, taking the pongs to its own pings on the way, and
+ *   take() copies that frame, as the chiller packed it, wherever the caller
+ *   wants it, so it is decoded once. The chiller is pinged every ping_s for
+ *   the clock sync in device_clock.h, with the host's wall clock as the
+ *   local one, so its sample times map onto receive times. Sets lost are
+ *   counted from gaps in header.sequence.
+ */
+
+#define LINK_KEEP_LATENCIES 100000
+
+int64_t wallNanos();
+
+class serial_link
+{
+public:
+    bool open(const char *path, uint32_t baud, double ping_s);
+    int descriptor() const { return port.descriptor(); }
+    bool hungUp() const { return port.hungUp(); }
+
+    void due(); // a ping, when one is due
+    bool next();
+    void take(struct_readings *readings);
+    void report(FILE *out) const;
+
+    int64_t received_ns = 0; // of the frame next() found
+    struct_clock_sync sync;
+    uint64_t frames = 0;
+    uint64_t lost = 0;
+    uint64_t resets = 0;
+
+private:
+    Stream port;
+    SerialTransfer link;
+    double ping_s = 0;
+    uint64_t last_ping_ms = 0;
+    uint32_t ping_id = 0;
+    uint32_t pings = 0;
+    uint32_t pongs = 0;
+    uint64_t crc_errors = 0;
+    uint64_t framing_errors = 0;
+    uint64_t wrong_sizes = 0;
+    bool started = false;
+    uint32_t last_sequence = 0;
+    std::vector<float> latency_us; // sample to receive
+    size_t next_latency = 0;
+};
+
+#endif
@@ -0,0 +1,689 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <poll.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include <can_frames.h>
+#include <comms.h>
+
+#include "can_socket.h"
+#include "hub_ring.h"
+#include "serial_link.h"
+
+/*
+ *   Telemetry hub: one host process for every controller link
+ *
+ *   serial_reader.py, telemetry_log and can_host.py each open their own
+ *   link, so a dashboard, a logger and the CAN monitor side by side mean a
+ *   process per port, each decoding every frame again. serve owns all the
+ *   links instead: serial ports and ptys through serial_link.h, and
+ *   SocketCAN interfaces through comms' unpackReadings(). Each readings set
+ *   is copied once, as struct_readings, into a slot of the shared memory
+ *   ring in hub_ring.h, and any number of readers on the host read it there
+ *   in place. watch prints each source's latest set once a second, and
+ *   telemetry_log ingest --hub logs them.
+ *
+ *     telemetry_hub serve [--name /cw_telemetry_hub] --serial chiller=/dev/ttyACM0 --can loop=can0 [--baud 19200] [--capacity N]
+ *     telemetry_hub watch [--name ...]
+ *     telemetry_hub bench [--simulate 64] [--rate 200] [--readers 4] [--seconds 10] [--capacity N]
+ *
+ *   A link is NAME=TARGET, or just the target, named for its last path
+ *   part; a CAN target may also be fd:N, as in firmware/link_host.
+ *
+ *   bench loads the hub with simulated controllers: one pty each, written
+ *   with SerialTransfer frames by a forked process, and served like any
+ *   other link. Forked readers check every set they are handed in place,
+ *   before asking the ring whether it is intact. It reports frames/s, the
+ *   hub's busy time, reader lag, and sets dropped as torn or lost, and
+ *   exits 1 if any reader was handed a set that a concurrent write had torn.
+ */
+
+#define HUB_POLL_MS 100
+#define HUB_DRAIN_MS 50      // bench: quiet this long after its time is up, and every frame sent has been read
+#define HUB_PING_S 2.0       // between clock pings down each serial link
+#define HUB_REPORT_S 10.0    // between serve's link summaries
+#define HUB_BENCH_BURST_MS 10 // of frames a simulated controller writes at once
+
+double link_speedup = 1;
+
+struct link_spec
+{
+    hub_kind kind;
+    std::string name;
+    std::string target;
+};
+
+struct options
+{
+    const char *command = nullptr;
+    const char *name = HUB_DEFAULT_NAME;
+    std::vector<link_spec> links;
+    uint32_t baud = LINK_BAUD;
+    uint32_t capacity = HUB_DEFAULT_CAPACITY;
+    uint32_t simulate = 64;
+    double rate = 200;
+    uint32_t readers = 4;
+    double seconds = 10;
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int)
+{
+    stopping = 1;
+}
+
+static uint64_t steadyMillis()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// the loop controller's readings sets off a SocketCAN bus; the fields the bus does not carry stay 0
+class can_link
+{
+public:
+    bool open(const char *name)
+    {
+        fd = openCANSocket(name);
+        started_ms = millis();
+        return fd >= 0;
+    }
+    int descriptor() const { return fd; }
+    bool hungUp() const { return hung_up; }
+
+    // the loop controller watches for the host's heartbeat, as can_host.py monitor sends it
+    void due()
+    {
+        uint32_t now = millis();
+        if (beats && now - last_beat_ms < CAN_HEARTBEAT_MS)
+            return;
+        struct_can_heartbeat beat = {now - started_ms, ++counter, 0, 0};
+        can_frame frame;
+        packFrame(CAN_ID_HEARTBEAT + CAN_NODE_HOST, beat, &frame);
+        writeCANFrame(fd, frame.id, frame.length, frame.data);
+        last_beat_ms = now;
+        ++beats;
+    }
+
+    bool next()
+    {
+        can_frame frame;
+        int got;
+        while ((got = readCANFrame(fd, &frame.id, &frame.length, frame.data)) > 0)
+        {
+            if (frame.id < CAN_ID_READINGS || frame.id > CAN_ID_READINGS_LAST)
+                continue;
+            if (frame.id == CAN_ID_READINGS)
+            {
+                if (assembling)
+                    ++partial;
+                memset(&assembly, 0, sizeof(assembly));
+                assembling = true;
+            }
+            // a set joined part way through is skipped
+            if (!assembling || !unpackReadings(&frame, &assembly))
+                continue;
+            assembling = false;
+            received_ns = wallNanos();
+            if (started && assembly.header.sequence > last_sequence)
+                lost += assembly.header.sequence - last_sequence - 1;
+            started = true;
+            last_sequence = assembly.header.sequence;
+            ++sets;
+            return true;
+        }
+        if (got < 0)
+            hung_up = true;
+        return false;
+    }
+
+    void take(struct_readings *readings) const { memcpy(readings, &assembly, sizeof(assembly)); }
+
+    void report(FILE *out) const
+    {
+        fprintf(out, "%" PRIu64 " readings sets, %" PRIu64 " lost, %" PRIu64 " incomplete\n", sets, lost, partial);
+    }
+
+    int64_t received_ns = 0;
+
+private:
+    int fd = -1;
+    bool hung_up = false;
+    uint32_t started_ms = 0;
+    uint32_t last_beat_ms = 0;
+    uint64_t beats = 0;
+    uint8_t counter = 0;
+    struct_readings assembly;
+    bool assembling = false;
+    bool started = false;
+    uint32_t last_sequence = 0;
+    uint64_t sets = 0;
+    uint64_t lost = 0;
+    uint64_t partial = 0; // started again before they were complete
+};
+
+// one served link, by its kind
+struct hub_source
+{
+    uint16_t id;
+    link_spec spec;
+    serial_link serial;
+    can_link can;
+
+    bool open(uint32_t baud, double ping_s)
+    {
+        if (spec.kind == HUB_KIND_CAN)
+            return can.open(spec.target.c_str());
+        return serial.open(spec.target.c_str(), baud, ping_s);
+    }
+    int descriptor() const { return spec.kind == HUB_KIND_CAN ? can.descriptor() : serial.descriptor(); }
+    bool hungUp() const { return spec.kind == HUB_KIND_CAN ? can.hungUp() : serial.hungUp(); }
+    int64_t receivedNanos() const { return spec.kind == HUB_KIND_CAN ? can.received_ns : serial.received_ns; }
+
+    void due()
+    {
+        if (spec.kind == HUB_KIND_CAN)
+            can.due();
+        else
+            serial.due();
+    }
+    bool next() { return spec.kind == HUB_KIND_CAN ? can.next() : serial.next(); }
+    void take(struct_readings *readings)
+    {
+        if (spec.kind == HUB_KIND_CAN)
+            can.take(readings);
+        else
+            serial.take(readings);
+    }
+    void report(FILE *out) const
+    {
+        fprintf(out, "%s: ", spec.name.c_str());
+        if (spec.kind == HUB_KIND_CAN)
+            can.report(out);
+        else
+            serial.report(out);
+    }
+};
+
+typedef std::vector<std::unique_ptr<hub_source>> hub_sources;
+
+static bool openSources(const std::vector<link_spec> &specs, uint32_t baud, double ping_s, hub_sources *sources)
+{
+    for (const link_spec &spec : specs)
+    {
+        std::unique_ptr<hub_source> source(new hub_source());
+        source->id = sources->size() % HUB_MAX_SOURCES;
+        source->spec = spec;
+        if (!source->open(baud, ping_s))
+        {
+            perror(spec.target.c_str());
+            return false;
+        }
+        sources->push_back(std::move(source));
+    }
+    return true;
+}
+
+// until stopped or every link hangs up, or past until_ms once the links go quiet; returns the seconds spent busy
+static double serveLinks(hub_ring &ring, hub_sources &sources, double report_s, uint64_t until_ms)
+{
+    std::vector<pollfd> waits;
+    std::vector<hub_source *> waiting;
+    uint64_t last_report = steadyMillis();
+    std::chrono::duration<double> busy(0);
+    while (!stopping)
+    {
+        waits.clear();
+        waiting.clear();
+        for (auto &source : sources)
+            if (!source->hungUp())
+            {
+                source->due();
+                waits.push_back({source->descriptor(), POLLIN, 0});
+                waiting.push_back(source.get());
+            }
+        if (waits.empty())
+            break;
+        bool draining = steadyMillis() >= until_ms;
+        int ready = poll(waits.data(), waits.size(), draining ? HUB_DRAIN_MS : HUB_POLL_MS);
+        if (ready == 0 && draining)
+            break;
+        auto started = std::chrono::steady_clock::now();
+        for (size_t i = 0; ready > 0 && i < waits.size(); i++)
+        {
+            if (!waits[i].revents)
+                continue;
+            hub_source *source = waiting[i];
+            // decoded straight into the slot
+            while (source->next())
+            {
+                source->take(ring.claim(source->id, source->spec.kind, source->receivedNanos()));
+                ring.publish();
+            }
+            if (source->hungUp())
+                fprintf(stderr, "%s: hung up\n", source->spec.name.c_str());
+        }
+        busy += std::chrono::steady_clock::now() - started;
+        if (report_s > 0 && steadyMillis() - last_report >= report_s * 1000)
+        {
+            for (auto &source : sources)
+                source->report(stderr);
+            last_report = steadyMillis();
+        }
+    }
+    return busy.count();
+}
+
+static int serve(const options &opt)
+{
+    if (opt.links.empty())
+    {
+        fprintf(stderr, "nothing to serve: give --serial and/or --can\n");
+        return 2;
+    }
+    if (opt.links.size() > HUB_MAX_SOURCES)
+    {
+        fprintf(stderr, "at most %d links\n", HUB_MAX_SOURCES);
+        return 2;
+    }
+    std::vector<std::string> names;
+    for (const link_spec &spec : opt.links)
+        names.push_back(spec.name);
+    hub_ring ring;
+    if (!ring.create(opt.name, opt.capacity, names))
+    {
+        perror(opt.name);
+        return 1;
+    }
+    hub_sources sources;
+    if (!openSources(opt.links, opt.baud, HUB_PING_S, &sources))
+        return 1;
+    fprintf(stderr, "serving");
+    for (const link_spec &spec : opt.links)
+        fprintf(stderr, " %s=%s", spec.name.c_str(), spec.target.c_str());
+    fprintf(stderr, " on %s\n", opt.name);
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    serveLinks(ring, sources, HUB_REPORT_S, UINT64_MAX);
+    for (auto &source : sources)
+        source->report(stderr);
+    fprintf(stderr, "%" PRIu64 " readings written\n", ring.written());
+    return 0;
+}
+
+static int watch(const options &opt)
+{
+    hub_reader hub;
+    if (!hub.attach(opt.name))
+    {
+        fprintf(stderr, "%s: no hub running: %s\n", opt.name, strerror(errno));
+        return 1;
+    }
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    struct latest_set
+    {
+        bool seen = false;
+        int64_t time_ns;
+        struct_readings readings;
+    };
+    std::vector<latest_set> latest(hub.sources());
+    hub_view view;
+    while (!stopping)
+    {
+        sleep(1);
+        // only the latest of each source is kept, so only that is copied out of the ring
+        while (hub.next(&view))
+        {
+            uint16_t source = view.slot->source;
+            latest_set set;
+            set.seen = true;
+            set.time_ns = view.slot->time_ns;
+            memcpy(&set.readings, &view.slot->readings, sizeof(set.readings));
+            if (hub.intact(view) && source < latest.size())
+                latest[source] = set;
+        }
+        int64_t now = wallNanos();
+        for (size_t i = 0; i < latest.size(); i++)
+        {
+            if (!latest[i].seen)
+                continue;
+            const struct_readings &r = latest[i].readings;
+            printf("%s: readings %" PRIu32 " %.1fs ago, reservoir %.2fC (setpoint %.1fC), filter %dPa, error %04X\n",
+                   hub.sourceName(i), (uint32_t)r.header.sequence, (now - latest[i].time_ns) / 1e9,
+                   (double)r.reservoir.temperature, (double)r.reservoir.setpoint, (int)r.chassis.filter_dp,
+                   (unsigned)r.error.code);
+        }
+        printf("%" PRIu64 " read, %" PRIu64 " lost, %" PRIu64 " torn\n", hub.read, hub.lost, hub.torn);
+        fflush(stdout);
+    }
+    return 0;
+}
+
+// set n of a simulated controller: n at both ends of the struct, so a reader handed one torn by a write can tell
+static void simulatedReadings(uint32_t controller, uint32_t n, struct_readings *readings)
+{
+    memset(readings, 0, sizeof(*readings));
+    readings->header.sequence = n;
+    readings->header.time_us = wallNanos() / 1000;
+    readings->reservoir.temperature = 20 + sinf(n / 16.0f + controller);
+    readings->chassis.filter_dp = controller;
+    readings->maintenance.compressor_seconds = n;
+    readings->maintenance.filter_hours_left = n;
+}
+
+static bool simulatedWhole(const struct_readings &readings)
+{
+    return readings.maintenance.compressor_seconds == readings.header.sequence &&
+           readings.maintenance.filter_hours_left == (uint16_t)readings.header.sequence;
+}
+
+// forked: writes the frames into each pty at the rate, and holds the ptys open until release_fd closes,
+// as hanging up would throw away what the hub has not read yet
+static void benchControllers(const std::vector<int> &masters, const options &opt, int release_fd)
+{
+    std::vector<Stream> ports(masters.size());
+    std::vector<SerialTransfer> links(masters.size());
+    std::vector<uint32_t> sent(masters.size());
+    for (size_t i = 0; i < masters.size(); i++)
+    {
+        std::string path = "fd:" + std::to_string(masters[i]);
+        if (!ports[i].open(path.c_str()))
+            _exit(1);
+        links[i].begin(ports[i]);
+    }
+    uint32_t burst = std::max((uint32_t)(opt.rate * HUB_BENCH_BURST_MS / 1000), (uint32_t)1);
+    struct_readings readings;
+    auto start = std::chrono::steady_clock::now();
+    for (;;)
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= opt.seconds)
+            break;
+        uint32_t due = elapsed.count() * opt.rate;
+        for (size_t i = 0; i < masters.size(); i++)
+            // a burst at most, so an overloaded hub falls behind rather than being flooded
+            for (uint32_t n = 0; sent[i] < due && n < burst; n++)
+            {
+                simulatedReadings(i, sent[i]++, &readings);
+                links[i].txObj(readings);
+                links[i].sendData(sizeof(readings), PACKET_READINGS);
+            }
+        usleep(1000);
+    }
+    char released;
+    while (read(release_fd, &released, 1) < 0 && errno == EINTR)
+        ;
+    _exit(0);
+}
+
+// forked: checks each set in place, then whether it was intact, until done_fd closes and the ring is read
+static void benchReader(int index, const char *name, int attached_fd, int done_fd, int result_fd)
+{
+    hub_reader hub;
+    char attached = hub.attach(name);
+    if (write(attached_fd, &attached, 1) != 1 || !attached)
+        _exit(2);
+    std::vector<float> lag_ms;
+    uint64_t corrupt = 0;
+    hub_view view;
+    for (;;)
+    {
+        pollfd done = {done_fd, POLLIN, 0};
+        bool finished = poll(&done, 1, 0) > 0;
+        int64_t last_ns = 0;
+        while (hub.next(&view))
+        {
+            bool whole = simulatedWhole(view.slot->readings);
+            int64_t time_ns = view.slot->time_ns;
+            if (!hub.intact(view))
+                continue;
+            if (!whole)
+                ++corrupt;
+            last_ns = time_ns;
+        }
+        if (last_ns)
+            lag_ms.push_back((wallNanos() - last_ns) / 1e6);
+        else if (finished)
+            break;
+        else
+            usleep(1000);
+    }
+    if (lag_ms.empty())
+        lag_ms.push_back(0);
+    std::sort(lag_ms.begin(), lag_ms.end());
+    char line[256];
+    int length = snprintf(line, sizeof(line),
+                          "reader %d: %" PRIu64 " read, %" PRIu64 " lost, %" PRIu64 " torn and dropped, %" PRIu64
+                          " corrupt; lag p50 %.2fms p99 %.2fms max %.2fms\n",
+                          index, hub.read, hub.lost, hub.torn, corrupt, lag_ms[lag_ms.size() / 2],
+                          lag_ms[(size_t)(0.99 * (lag_ms.size() - 1))], lag_ms.back());
+    // one write under PIPE_BUF, so the readers' lines do not interleave
+    if (write(result_fd, line, length) != length)
+        _exit(2);
+    _exit(corrupt ? 1 : 0);
+}
+
+static int bench(const options &opt)
+{
+    if (opt.simulate == 0 || opt.rate <= 0 || opt.seconds <= 0)
+    {
+        fprintf(stderr, "bench needs --simulate, --rate and --seconds above 0\n");
+        return 2;
+    }
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < std::min(opt.simulate, (uint32_t)HUB_MAX_SOURCES); i++)
+        names.push_back("sim" + std::to_string(i));
+    hub_ring ring;
+    if (!ring.create(opt.name, opt.capacity, names))
+    {
+        perror(opt.name);
+        return 1;
+    }
+
+    int attached[2], done[2], results[2];
+    if (pipe(attached) < 0 || pipe(done) < 0 || pipe(results) < 0)
+    {
+        perror("pipe");
+        return 1;
+    }
+    std::vector<pid_t> readers;
+    for (uint32_t i = 0; i < opt.readers; i++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(attached[0]);
+            close(done[1]);
+            close(results[0]);
+            benchReader(i, opt.name, attached[1], done[0], results[1]);
+        }
+        if (pid < 0)
+        {
+            perror("fork");
+            return 1;
+        }
+        readers.push_back(pid);
+    }
+    close(attached[1]);
+    close(done[0]);
+    close(results[1]);
+    for (uint32_t i = 0; i < opt.readers; i++)
+    {
+        char ok = 0;
+        if (read(attached[0], &ok, 1) != 1 || !ok)
+        {
+            fprintf(stderr, "a reader could not attach to %s\n", opt.name);
+            return 1;
+        }
+    }
+
+    // the slaves are opened before the controllers start, so nothing is written into a pty with no reader
+    std::vector<int> masters;
+    std::vector<link_spec> specs;
+    for (uint32_t i = 0; i < opt.simulate; i++)
+    {
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+        {
+            perror("pty");
+            return 1;
+        }
+        masters.push_back(master);
+        specs.push_back({HUB_KIND_SERIAL, "sim" + std::to_string(i), ptsname(master)});
+    }
+    hub_sources sources;
+    if (!openSources(specs, 0, 0, &sources))
+        return 1;
+    int release[2];
+    if (pipe(release) < 0)
+    {
+        perror("pipe");
+        return 1;
+    }
+    pid_t controllers = fork();
+    if (controllers == 0)
+    {
+        close(release[1]);
+        close(done[1]);
+        for (auto &source : sources)
+            close(source->descriptor());
+        benchControllers(masters, opt, release[0]);
+    }
+    if (controllers < 0)
+    {
+        perror("fork");
+        return 1;
+    }
+    close(release[0]);
+    for (int master : masters)
+        close(master);
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    auto start = std::chrono::steady_clock::now();
+    double busy_s = serveLinks(ring, sources, 0, steadyMillis() + opt.seconds * 1000);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    close(release[1]);
+    waitpid(controllers, nullptr, 0);
+    close(done[1]);
+
+    uint64_t written = ring.written();
+    double offered = opt.simulate * opt.rate;
+    printf("%" PRIu32 " controllers at %.0f Hz: %" PRIu64 " frames in %.1fs, %.0f/s of %.0f/s offered, "
+           "hub busy %.0f%%, %.1fus a frame\n",
+           opt.simulate, opt.rate, written, elapsed.count(), written / elapsed.count(), offered,
+           100 * busy_s / elapsed.count(), busy_s / std::max(written, (uint64_t)1) * 1e6);
+    fflush(stdout);
+    char line[256];
+    ssize_t length;
+    while ((length = read(results[0], line, sizeof(line))) > 0)
+        fwrite(line, 1, length, stdout);
+    int failed = 0;
+    for (pid_t reader : readers)
+    {
+        int status;
+        if (waitpid(reader, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            ++failed;
+    }
+    if (failed)
+        fprintf(stderr, "%d readers were handed a torn set, or failed\n", failed);
+    return failed ? 1 : 0;
+}
+
+static bool addLink(hub_kind kind, const char *spec, options *opt)
+{
+    link_spec link = {kind, "", spec};
+    const char *equals = strchr(spec, '=');
+    if (equals)
+    {
+        link.name.assign(spec, equals - spec);
+        link.target = equals + 1;
+    }
+    else
+    {
+        const char *slash = strrchr(spec, '/');
+        link.name = slash ? slash + 1 : spec;
+    }
+    if (link.name.empty() || link.target.empty() || link.name.size() >= HUB_SOURCE_NAME_BYTES)
+        return false;
+    opt->links.push_back(link);
+    return true;
+}
+
+static int usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s serve [--name NAME] [--serial [NAME=]PORT]... [--can [NAME=]IFACE]... [--baud N] [--capacity N]\n"
+            "       %s watch [--name NAME]\n"
+            "       %s bench [--name NAME] [--simulate N] [--rate HZ] [--readers N] [--seconds S] [--capacity N]\n",
+            program, program, program);
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    options opt;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--", 2) != 0)
+        {
+            if (opt.command)
+                return usage(argv[0]);
+            opt.command = arg;
+            continue;
+        }
+        if (i + 1 == argc)
+            return usage(argv[0]);
+        const char *value = argv[++i];
+        if (strcmp(arg, "--name") == 0)
+            opt.name = value;
+        else if (strcmp(arg, "--serial") == 0 || strcmp(arg, "--can") == 0)
+        {
+            if (!addLink(strcmp(arg, "--can") == 0 ? HUB_KIND_CAN : HUB_KIND_SERIAL, value, &opt))
+            {
+                fprintf(stderr, "%s: not [NAME=]TARGET, with a name under %d characters\n", value,
+                        HUB_SOURCE_NAME_BYTES);
+                return 2;
+            }
+        }
+        else if (strcmp(arg, "--baud") == 0)
+            opt.baud = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--capacity") == 0)
+            opt.capacity = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--simulate") == 0)
+            opt.simulate = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--rate") == 0)
+            opt.rate = atof(value);
+        else if (strcmp(arg, "--readers") == 0)
+            opt.readers = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--seconds") == 0)
+            opt.seconds = atof(value);
+        else
+            return usage(argv[0]);
+    }
+    if (opt.capacity == 0)
+        return usage(argv[0]);
+    if (opt.command && strcmp(opt.command, "serve") == 0)
+        return serve(opt);
+    if (opt.command && strcmp(opt.command, "watch") == 0)
+        return watch(opt);
+    if (opt.command && strcmp(opt.command, "bench") == 0)
+        return bench(opt);
+    return usage(argv[0]);
+}
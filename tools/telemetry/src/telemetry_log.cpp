@@ -0,0 +1,493 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <poll.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include <comms.h>
+
+#include "hub_ring.h"
+#include "readings_columns.h"
+#include "segment_log.h"
+#include "serial_link.h"
+
+/*
+ *   Telemetry log of the chiller's readings
+ *
+ *   ingest reads a serial port or pty with the SerialTransfer framing the
+ *   boards run, from firmware/link_host, and appends every readings frame
+ *   to the segmented columnar log in segment_log.h, stamped with the host
+ *   time it arrived. The frame is copied into comms.h's struct_readings as
+ *   the chiller packed it, so nothing on this side can disagree with the
+ *   firmware about the layout. While ingesting, the chiller is pinged for
+ *   its clock (--ping 0 on a listen-only tap), and the sets lost (gaps in
+ *   header.sequence) and the latency from the chiller sampling a set to it
+ *   being logged are reported to stderr every --report seconds. Where
+ *   telemetry_hub owns the link, ingest --hub follows its ring instead,
+ *   optionally only the one --source, and logs the sets as the hub
+ *   stamped them.
+ *
+ *   append takes frames from another program on stdin, each an int64
+ *   receive time in ns, a length byte and the readings payload as received,
+ *   for tools/serial_reader.py. query summarises a time range, and export
+ *   writes it out as CSV, JSON lines, or raw: packed struct_logged_readings
+ *   records, which the chiller's replay build reads.
+ *
+ *     telemetry_log [--dir logs] ingest --port /dev/ttyUSB0 [--baud 19200] [--capacity N] [--ping 2] [--report 60]
+ *     telemetry_log [--dir logs] ingest --hub /cw_telemetry_hub [--source chiller] [--capacity N]
+ *     telemetry_log [--dir logs] append < frames
+ *     telemetry_log [--dir logs] query [--start 2024-08-01] [--end 2024-08-08T12:00]
+ *     telemetry_log [--dir logs] export [--start ...] [--end ...] [--format csv|json|raw] > week.bin
+ *
+ *   Times are UTC, ISO 8601 to the second.
+ */
+
+#define LOG_POLL_MS 50
+#define LOG_OUTPUT_BUFFER (1 << 20)
+
+double link_speedup = 1;
+
+struct options
+{
+    const char *command = nullptr;
+    const char *dir = "logs";
+    const char *port = nullptr;
+    const char *hub = nullptr;
+    const char *source = nullptr;
+    uint32_t baud = LINK_BAUD;
+    uint64_t capacity = LOG_DEFAULT_CAPACITY;
+    double ping_s = 2.0;
+    double report_s = 60.0;
+    int64_t start_ns = INT64_MIN;
+    int64_t end_ns = INT64_MAX;
+    const char *format = "csv";
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int)
+{
+    stopping = 1;
+}
+
+static uint64_t steadyMillis()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static bool parseTime(const char *text, int64_t *time_ns)
+{
+    static const char *const formats[] = {"%Y-%m-%dT%H:%M:%S", "%Y-%m-%d %H:%M:%S", "%Y-%m-%dT%H:%M",
+                                          "%Y-%m-%d %H:%M", "%Y-%m-%d"};
+    for (const char *format : formats)
+    {
+        tm fields = {};
+        const char *end = strptime(text, format, &fields);
+        if (end && (*end == '\0' || strcmp(end, "Z") == 0))
+        {
+            *time_ns = (int64_t)timegm(&fields) * 1000000000;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void formatTime(int64_t time_ns, char *text, size_t size)
+{
+    time_t seconds = time_ns / 1000000000;
+    tm fields;
+    gmtime_r(&seconds, &fields);
+    size_t length = strftime(text, size, "%Y-%m-%dT%H:%M:%S", &fields);
+    snprintf(text + length, size - length, ".%09" PRId64 "Z", time_ns % 1000000000);
+}
+
+static double number(column_type type, const uint8_t *value)
+{
+    switch (type)
+    {
+    case COLUMN_BOOL:
+    case COLUMN_U8:
+        return *value;
+    case COLUMN_I16:
+    {
+        int16_t v;
+        memcpy(&v, value, sizeof(v));
+        return v;
+    }
+    case COLUMN_U16:
+    {
+        uint16_t v;
+        memcpy(&v, value, sizeof(v));
+        return v;
+    }
+    case COLUMN_U32:
+    {
+        uint32_t v;
+        memcpy(&v, value, sizeof(v));
+        return v;
+    }
+    case COLUMN_I64:
+    {
+        int64_t v;
+        memcpy(&v, value, sizeof(v));
+        return (double)v;
+    }
+    case COLUMN_U64:
+    {
+        uint64_t v;
+        memcpy(&v, value, sizeof(v));
+        return (double)v;
+    }
+    case COLUMN_F32:
+    {
+        float v;
+        memcpy(&v, value, sizeof(v));
+        return v;
+    }
+    }
+    return 0;
+}
+
+// a column's value as text, exactly: 64-bit integers are not put through a double, floats round trip
+static void printValue(FILE *out, column_type type, const uint8_t *value, bool json)
+{
+    uint8_t zero[8] = {};
+    if (!value)
+        value = zero; // a field this segment was written without
+    if (type == COLUMN_BOOL && json)
+        fputs(*value ? "true" : "false", out);
+    else if (type == COLUMN_U64)
+    {
+        uint64_t v;
+        memcpy(&v, value, sizeof(v));
+        fprintf(out, "%" PRIu64, v);
+    }
+    else if (type == COLUMN_F32)
+    {
+        float v;
+        memcpy(&v, value, sizeof(v));
+        if (json && !isfinite(v))
+            fputs("null", out);
+        else
+            fprintf(out, "%.9g", v);
+    }
+    else
+        fprintf(out, "%.0f", number(type, value));
+}
+
+// a reader of telemetry_hub's ring, for when the hub owns the link
+static int ingestHub(const options &opt)
+{
+    hub_reader hub;
+    if (!hub.attach(opt.hub))
+    {
+        fprintf(stderr, "%s: no hub running: %s\n", opt.hub, strerror(errno));
+        return 1;
+    }
+    log_writer writer;
+    if (!writer.begin(opt.dir, opt.capacity))
+    {
+        perror(opt.dir);
+        return 1;
+    }
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    hub_view view;
+    struct_logged_readings record;
+    bool logging = true;
+    while (!stopping && logging)
+    {
+        while (logging && hub.next(&view))
+        {
+            if (opt.source && strcmp(hub.sourceName(view.slot->source), opt.source) != 0)
+                continue;
+            record.time_ns = view.slot->time_ns;
+            memcpy(&record.readings, &view.slot->readings, sizeof(record.readings));
+            // the copy goes in the log only if the hub did not lap it meanwhile
+            if (hub.intact(view))
+                logging = writer.append(record.time_ns, record.readings);
+        }
+        usleep(LOG_POLL_MS * 1000);
+    }
+    writer.flush();
+    fprintf(stderr, "%" PRIu64 " sets read, %" PRIu64 " lost, %" PRIu64 " torn\n", hub.read, hub.lost, hub.torn);
+    return logging ? 0 : 1;
+}
+
+static int ingest(const options &opt)
+{
+    if (opt.hub)
+        return ingestHub(opt);
+    if (!opt.port)
+    {
+        fprintf(stderr, "ingest needs --port or --hub\n");
+        return 2;
+    }
+    serial_link link;
+    if (!link.open(opt.port, opt.baud, opt.ping_s))
+    {
+        perror(opt.port);
+        return 1;
+    }
+    log_writer writer;
+    if (!writer.begin(opt.dir, opt.capacity))
+    {
+        perror(opt.dir);
+        return 1;
+    }
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    struct_readings readings;
+    uint64_t last_report = steadyMillis();
+    bool logging = true;
+    while (!stopping && !link.hungUp() && logging)
+    {
+        link.due();
+        uint64_t now = steadyMillis();
+        if (opt.report_s > 0 && now - last_report >= opt.report_s * 1000)
+        {
+            if (link.frames)
+                link.report(stderr);
+            last_report = now;
+        }
+        while (logging && link.next())
+        {
+            link.take(&readings);
+            logging = writer.append(link.received_ns, readings);
+        }
+        pollfd wait = {link.descriptor(), POLLIN, 0};
+        poll(&wait, 1, LOG_POLL_MS);
+    }
+    writer.flush();
+    link.report(stderr);
+    return logging ? 0 : 1;
+}
+
+static int append(const options &opt)
+{
+    log_writer writer;
+    if (!writer.begin(opt.dir, opt.capacity))
+    {
+        perror(opt.dir);
+        return 1;
+    }
+    uint64_t appended = 0;
+    uint64_t wrong_sizes = 0;
+    int64_t time_ns;
+    uint8_t length;
+    uint8_t payload[UINT8_MAX];
+    while (fread(&time_ns, sizeof(time_ns), 1, stdin) == 1 && fread(&length, 1, 1, stdin) == 1 &&
+           fread(payload, 1, length, stdin) == length)
+    {
+        if (length != sizeof(struct_readings))
+        {
+            ++wrong_sizes;
+            continue;
+        }
+        struct_readings readings;
+        memcpy(&readings, payload, sizeof(readings));
+        if (!writer.append(time_ns, readings))
+            return 1;
+        ++appended;
+    }
+    fprintf(stderr, "%" PRIu64 " sets appended, %" PRIu64 " of the wrong size\n", appended, wrong_sizes);
+    return 0;
+}
+
+static int query(const options &opt)
+{
+    log_reader reader;
+    if (!reader.open(opt.dir))
+    {
+        perror(opt.dir);
+        return 1;
+    }
+    auto started = std::chrono::steady_clock::now();
+    std::vector<log_range> ranges = reader.query(opt.start_ns, opt.end_ns);
+    uint64_t sets = 0;
+    double low[READINGS_COLUMNS], high[READINGS_COLUMNS], sum[READINGS_COLUMNS];
+    std::fill(low, low + READINGS_COLUMNS, INFINITY);
+    std::fill(high, high + READINGS_COLUMNS, -INFINITY);
+    std::fill(sum, sum + READINGS_COLUMNS, 0.0);
+    // column by column, so each pass reads one contiguous array per block
+    for (const log_range &range : ranges)
+    {
+        sets += range.last - range.first;
+        for (size_t i = 0; i < READINGS_COLUMNS; i++)
+            for (uint64_t index = range.first; index < range.last; index++)
+            {
+                const uint8_t *value = range.segment->value(i, index);
+                double v = value ? number(readings_columns[i].type, value) : 0.0;
+                low[i] = std::min(low[i], v);
+                high[i] = std::max(high[i], v);
+                sum[i] += v;
+            }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+    printf("%" PRIu64 " sets in %.3fs\n", sets, elapsed.count());
+    if (!sets)
+        return 0;
+    char first[40], last[40];
+    formatTime(ranges.front().segment->time(ranges.front().first), first, sizeof(first));
+    formatTime(ranges.back().segment->time(ranges.back().last - 1), last, sizeof(last));
+    printf("from %s to %s\n", first, last);
+    for (size_t i = 0; i < READINGS_COLUMNS; i++)
+        printf("%-32s min %12.2f mean %12.2f max %12.2f\n", readings_columns[i].name, low[i], sum[i] / sets, high[i]);
+    return 0;
+}
+
+// nested by the dotted column names, as comms.h nests the structs
+static void printJson(FILE *out, const log_segment &segment, uint64_t index)
+{
+    fprintf(out, "{\"time_ns\": %" PRId64, segment.time(index));
+    std::vector<std::string> nesting;
+    for (size_t i = 0; i < READINGS_COLUMNS; i++)
+    {
+        std::vector<std::string> path;
+        const char *name = readings_columns[i].name;
+        for (const char *dot; (dot = strchr(name, '.')); name = dot + 1)
+            path.emplace_back(name, dot - name);
+        size_t common = 0;
+        while (common < nesting.size() && common < path.size() && nesting[common] == path[common])
+            ++common;
+        for (; nesting.size() > common; nesting.pop_back())
+            fputc('}', out);
+        for (; nesting.size() < path.size(); nesting.push_back(path[nesting.size()]))
+            fprintf(out, ", \"%s\": {", path[nesting.size()].c_str());
+        // the first field of a struct just opened takes no comma
+        fprintf(out, i && common == path.size() ? ", \"%s\": " : "\"%s\": ", name);
+        printValue(out, readings_columns[i].type, segment.value(i, index), true);
+    }
+    for (; !nesting.empty(); nesting.pop_back())
+        fputc('}', out);
+    fputs("}\n", out);
+}
+
+static int exportLog(const options &opt)
+{
+    bool csv = strcmp(opt.format, "csv") == 0;
+    bool json = strcmp(opt.format, "json") == 0;
+    bool raw = strcmp(opt.format, "raw") == 0;
+    if (!csv && !json && !raw)
+    {
+        fprintf(stderr, "unknown format %s: csv, json or raw\n", opt.format);
+        return 2;
+    }
+    log_reader reader;
+    if (!reader.open(opt.dir))
+    {
+        perror(opt.dir);
+        return 1;
+    }
+    static char buffer[LOG_OUTPUT_BUFFER];
+    setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+    if (csv)
+    {
+        fputs("time_ns", stdout);
+        for (const readings_column &column : readings_columns)
+            printf(",%s", column.name);
+        fputc('\n', stdout);
+    }
+    for (const log_range &range : reader.query(opt.start_ns, opt.end_ns))
+        for (uint64_t index = range.first; index < range.last; index++)
+        {
+            if (raw)
+            {
+                struct_logged_readings record;
+                range.segment->row(index, &record);
+                fwrite(&record, sizeof(record), 1, stdout);
+            }
+            else if (json)
+                printJson(stdout, *range.segment, index);
+            else
+            {
+                printf("%" PRId64, range.segment->time(index));
+                for (size_t i = 0; i < READINGS_COLUMNS; i++)
+                {
+                    fputc(',', stdout);
+                    printValue(stdout, readings_columns[i].type, range.segment->value(i, index), false);
+                }
+                fputc('\n', stdout);
+            }
+        }
+    return fflush(stdout) == 0 ? 0 : 1;
+}
+
+static int usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [--dir DIR] ingest --port PATH [--baud N] [--capacity N] [--ping S] [--report S]\n"
+            "       %s [--dir DIR] ingest --hub NAME [--source NAME] [--capacity N]\n"
+            "       %s [--dir DIR] append < frames\n"
+            "       %s [--dir DIR] query [--start TIME] [--end TIME]\n"
+            "       %s [--dir DIR] export [--start TIME] [--end TIME] [--format csv|json|raw]\n",
+            program, program, program, program, program);
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    options opt;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--", 2) != 0)
+        {
+            if (opt.command)
+                return usage(argv[0]);
+            opt.command = arg;
+            continue;
+        }
+        if (i + 1 == argc)
+            return usage(argv[0]);
+        const char *value = argv[++i];
+        if (strcmp(arg, "--dir") == 0)
+            opt.dir = value;
+        else if (strcmp(arg, "--port") == 0)
+            opt.port = value;
+        else if (strcmp(arg, "--hub") == 0)
+            opt.hub = value;
+        else if (strcmp(arg, "--source") == 0)
+            opt.source = value;
+        else if (strcmp(arg, "--baud") == 0)
+            opt.baud = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--capacity") == 0)
+            opt.capacity = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--ping") == 0)
+            opt.ping_s = atof(value);
+        else if (strcmp(arg, "--report") == 0)
+            opt.report_s = atof(value);
+        else if (strcmp(arg, "--format") == 0)
+            opt.format = value;
+        else if (strcmp(arg, "--start") == 0 || strcmp(arg, "--end") == 0)
+        {
+            if (!parseTime(value, strcmp(arg, "--start") == 0 ? &opt.start_ns : &opt.end_ns))
+            {
+                fprintf(stderr, "%s: not a time, e.g. 2024-08-01T12:00:00\n", value);
+                return 2;
+            }
+        }
+        else
+            return usage(argv[0]);
+    }
+    if (opt.capacity == 0)
+        return usage(argv[0]);
+    if (opt.command && strcmp(opt.command, "ingest") == 0)
+        return ingest(opt);
+    if (opt.command && strcmp(opt.command, "append") == 0)
+        return append(opt);
+    if (opt.command && strcmp(opt.command, "query") == 0)
+        return query(opt);
+    if (opt.command && strcmp(opt.command, "export") == 0)
+        return exportLog(opt);
+    return usage(argv[0]);
+}
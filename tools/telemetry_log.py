@@ -0,0 +1,38 @@
+"""Python end of the telemetry log, for tools that own the link themselves.
+
+The log is written and read by the C++ telemetry_log in tools/telemetry,
+built from the firmware's own comms.h, so the segment layout never comes
+from parsing that header here. LogWriter hands it each readings payload as
+received, with its receive time, through the program's ``append`` command:
+
+    (cd tools/telemetry && pio run -e telemetry_log)
+
+Querying and exporting go to the program directly:
+
+    tools/telemetry/.pio/build/telemetry_log/program query --start 2024-08-01 --end 2024-08-08
+    tools/telemetry/.pio/build/telemetry_log/program export --start 2024-08-01 --format raw > week.bin
+"""
+
+import struct
+import subprocess
+import time
+from pathlib import Path
+
+PROGRAM = Path(__file__).resolve().parent / "telemetry" / ".pio" / "build" / "telemetry_log" / "program"
+
+
+class LogWriter:
+    """Appends readings payloads to the log through ``telemetry_log append``."""
+
+    def __init__(self, directory: Path, program: Path = PROGRAM):
+        self.process = subprocess.Popen([str(program), "--dir", str(directory), "append"], stdin=subprocess.PIPE)
+
+    def append(self, payload: bytes, time_ns: int = None):
+        if time_ns is None:
+            time_ns = time.time_ns()
+        # a payload of any other size than struct_readings is counted and skipped by the program
+        self.process.stdin.write(struct.pack("<qB", time_ns, len(payload)) + bytes(payload))
+
+    def close(self):
+        self.process.stdin.close()
+        self.process.wait()